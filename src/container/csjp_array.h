@@ -9,6 +9,8 @@
 #include <string.h>
 #include <csjp_object.h>
 #include <csjp_string.h>
+#include <csjp_arena.h>
+#include <csjp_inline_storage.h>
 
 namespace csjp {
 
@@ -18,10 +20,20 @@ namespace csjp {
  *
  * Uses c++ new and delete operators for stored objects,
  * and uses libc alloc and free for storing the pointers of c++ objects.
+ *
+ * An array constructed with an arena constructs the objects and stores the
+ * pointers in the arena, objects are only destructed when removed. Such an
+ * array can not adopt or give away objects by pointer. Moving an array moves
+ * its arena too. The objects themselves allocate from the arena only if they
+ * are constructed with it, like add(arena) for an Array<String>.
+ *
+ * The pointers of the first Inline objects are kept in the array object
+ * itself, so an Array<T, N> allocates only the objects up to N of them.
+ * The default for Inline is given at the declaration in csjp_astr.h.
  */
 
-template <typename DataType>
-class Array
+template <typename DataType, unsigned Inline>
+class Array : private InlineStorage<DataType *, Inline>
 {
 public:
 	class iterator
@@ -37,13 +49,14 @@ public:
 	};
 
 #define ArrayInitializer : \
-		cap(0), \
+		cap(Inline), \
 		len(0), \
-		val(NULL), \
+		val(this->inlineItems()), \
+		arena(NULL), \
 		capacity(cap), \
 		length(len)
 public:
-	explicit Array(const Array<DataType> & orig)
+	explicit Array(const Array<DataType, Inline> & orig)
 		ArrayInitializer
 	{
 		setCapacity(orig.len);
@@ -54,34 +67,42 @@ public:
 			add(**iter);
 		val[len] = 0;
 	}
-	const Array & operator=(const Array<DataType> & orig) = delete;
+	const Array & operator=(const Array<DataType, Inline> & orig) = delete;
 
-	Array(Array<DataType> && temp) :
-		cap(temp.cap),
-		len(temp.len),
-		val(temp.val),
-		capacity(cap),
-		length(len)
+	Array(Array<DataType, Inline> && temp)
+		ArrayInitializer
 	{
-		temp.val = 0;
-		temp.len = 0;
-		temp.cap = 0;
+		takeOver(temp);
 	}
-	const Array & operator=(Array<DataType> && temp)
+	const Array & operator=(Array<DataType, Inline> && temp)
 	{
 		clear();
-		if(val)
+		if(val && !arena && !this->isInline(val))
 			free(val);
 
-		val = temp.val;
+		takeOver(temp);
+
+		return *this;
+	}
+
+private:
+	/* Inline pointers can not be stolen, those are copied. */
+	void takeOver(Array<DataType, Inline> & temp)
+	{
 		len = temp.len;
 		cap = temp.cap;
-
-		temp.val = 0;
+		arena = temp.arena;
+		if(temp.isInline(temp.val)){
+			val = this->inlineItems();
+			memcpy(val, temp.val, sizeof(DataType*) * (len + 1));
+		} else
+			val = temp.val;
+
+		temp.val = temp.inlineItems();
 		temp.len = 0;
-		temp.cap = 0;
-
-		return *this;
+		temp.cap = Inline;
+		if(temp.val)
+			temp.val[0] = 0;
 	}
 
 public:
@@ -93,14 +114,17 @@ public:
 	virtual ~Array()
 	{
 		clear();
-		if(val)
+		if(val && !arena && !this->isInline(val))
 			free(val);
 	}
 
+	explicit Array(Arena & arena) ArrayInitializer { this->arena = &arena; }
+
 private:
 	size_t cap; // capacity
 	size_t len;
 	DataType **val;
+	Arena * arena;
 	/*
 	 * Invariants:
 	 * - if val != NULL and points to valid area :
@@ -121,17 +145,42 @@ public:
 		setCapacity(s);
 	}
 
+	Arena * getArena() const { return arena; }
+
 	void setCapacity(size_t _cap)
 	{
-		DataType **dst = (DataType **)realloc(val, sizeof(DataType*) * (_cap + 1));
+		if(_cap < len)
+			len = _cap;
+
+		if(Inline && _cap <= Inline){
+			if(!this->isInline(val)){
+				DataType **dst = this->inlineItems();
+				if(len)
+					memcpy(dst, val, sizeof(DataType*) * len);
+				if(val && !arena)
+					free(val);
+				val = dst;
+			}
+			cap = Inline;
+			val[len] = 0;
+			return;
+		}
+
+		DataType **src = this->isInline(val) ? NULL : val;
+		DataType **dst;
+		if(arena)
+			dst = (DataType **)arena->reallocate(src, sizeof(DataType*) *
+					(src ? cap + 1 : 0), sizeof(DataType*) * (_cap + 1));
+		else
+			dst = (DataType **)realloc(src, sizeof(DataType*) * (_cap + 1));
 		if(!dst)
 			throw OutOfMemory("No enough memory for Array allocation with "
 					"% number of elements.", _cap);
+		if(src != val)
+			memcpy(dst, val, sizeof(DataType*) * len);
 
 		cap = _cap;
 		val = dst;
-		if(_cap < len)
-			len = _cap;
 		val[len] = 0;
 	}
 
@@ -178,6 +227,7 @@ public:
 	 */
 	void add(Object<DataType> & t)
 	{
+		ENSURE(!arena, InvalidState);
 		if(cap <= len)
 			extendCapacity(len + 1);
 
@@ -188,6 +238,7 @@ public:
 
 	void add(DataType * && dt)
 	{
+		ENSURE(!arena, InvalidState);
 		if(cap <= len)
 			extendCapacity(len + 1);
 
@@ -202,7 +253,7 @@ public:
 		if(cap <= len)
 			extendCapacity(len + 1);
 
-		val[len] = new DataType(dt);
+		val[len] = create(dt);
 		len++;
 		val[len] = 0;
 	}
@@ -229,7 +280,7 @@ public:
 		if(cap <= len)
 			extendCapacity(len + 1);
 
-		val[len] = new DataType(args...);
+		val[len] = create(args...);
 		len++;
 		val[len] = 0;
 	}
@@ -240,13 +291,14 @@ public:
 		if(cap <= len)
 			extendCapacity(len + 1);
 
-		val[len] = new DataType(args...);
+		val[len] = create(args...);
 		len++;
 		val[len] = 0;
 	}
 
-	void join(Array<DataType> & array)
+	void join(Array<DataType, Inline> & array)
 	{
+		ENSURE(arena == array.arena, InvalidArgument);
 		if(cap < len + array.length)
 			extendCapacity(len + array.length);
 
@@ -259,7 +311,7 @@ public:
 		array.len = 0;
 	}
 
-	void join(Array<DataType> && array)
+	void join(Array<DataType, Inline> && array)
 	{
 		join(array);
 	}
@@ -313,7 +365,7 @@ public:
 		DataType ** srcUntil = val + len;/* points to the first not to move */
 		DataType ** srcPtr = val + i + 1;
 		DataType ** dstPtr = val + i;
-		delete val[i];
+		destroy(val[i]);
 		for(; srcPtr < srcUntil; srcPtr++, dstPtr++)
 			*dstPtr = *srcPtr;
 		len--;
@@ -342,6 +394,7 @@ public:
 	 */
 	Object<DataType> pop()
 	{
+		ENSURE(!arena, InvalidState);
 		ENSURE(!val || 0 < len,  ObjectNotFound);
 		len--;
 		Object<DataType> o(val[len]);
@@ -355,12 +408,30 @@ public:
 	void clear()
 	{
 		for(DataType ** i = val; i < val + len; i++)
-			delete *i;
+			destroy(*i);
 		len = 0;
 		if(val)
 			val[len] = 0;
 	}
 
+private:
+	template<typename... Args>
+	DataType * create(Args && ... args)
+	{
+		if(arena)
+			return new(*arena) DataType(args...);
+		return new DataType(args...);
+	}
+
+	void destroy(DataType * dt)
+	{
+		if(arena)
+			dt->~DataType();
+		else
+			delete dt;
+	}
+
+public:
 	/**
 	 * Runtime:		guess O(1)	<br/>
 	 */
@@ -479,7 +550,7 @@ public:
 	/**
 	 * Runtime:		constant	<br/>
 	 */
-	bool isEqual(const Array<DataType> &c) const
+	bool isEqual(const Array<DataType, Inline> &c) const
 	{
 		if(c.len != len)
 			return false;
@@ -498,7 +569,8 @@ public:
 /**
  * Runtime:		O(n)					<br/>
  */
-template <typename DataType> bool operator==(const Array<DataType> &a, const Array<DataType> &b)
+template <typename DataType, unsigned Inline>
+bool operator==(const Array<DataType, Inline> &a, const Array<DataType, Inline> &b)
 {
 	return a.isEqual(b);
 }
@@ -506,7 +578,8 @@ template <typename DataType> bool operator==(const Array<DataType> &a, const Arr
 /**
  * Runtime:		O(n)					<br/>
  */
-template <typename DataType> bool operator!=(const Array<DataType> &a, const Array<DataType> &b)
+template <typename DataType, unsigned Inline>
+bool operator!=(const Array<DataType, Inline> &a, const Array<DataType, Inline> &b)
 {
 	return !a.isEqual(b);
 }
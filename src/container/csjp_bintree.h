@@ -9,6 +9,8 @@
 #include <csjp_object.h>
 
 #include <csjp_string.h>
+#include <csjp_arena.h>
+#include <csjp_pod_array.h>
 
 namespace csjp {
 
@@ -46,7 +48,7 @@ public:
 #endif
 
 template <typename DataType>
-class BinTree
+class BinTree : public ArenaObject
 {
 public:
 	explicit BinTree(const BinTree<DataType> &) = delete;
@@ -494,6 +496,72 @@ public:
 		size = 1;
 	}/*}}}*/
 
+	/**
+	 * Destructs the subtree without giving back the memory of the nodes, for
+	 * containers resetting the pool of their nodes afterwards.
+	 *
+	 * Runtime:		linear, O(n)				<br/>
+	 */
+	void destruct()   /*{{{*/
+	{
+		if(left != NULL)
+			left->destruct();
+		if(right != NULL)
+			right->destruct();
+		left = NULL;
+		right = NULL;
+		this->~BinTree();
+	}/*}}}*/
+
+	/**
+	 * Links the given unlinked nodes into a perfectly balanced tree keeping
+	 * their order, without comparing any data. Returns the root.
+	 *
+	 * Runtime:		linear, O(n)				<br/>
+	 */
+	static BinTree<DataType> * build(BinTree<DataType> * const * nodes, /*{{{*/
+			unsigned n, BinTree<DataType> * parent = NULL)
+	{
+		if(!n)
+			return NULL;
+		unsigned mid = n / 2;
+		BinTree<DataType> * node = nodes[mid];
+		node->parent = parent;
+		node->left = build(nodes, mid, node);
+		node->right = build(nodes + mid + 1, n - mid - 1, node);
+		node->size = n;
+		return node;
+	}/*}}}*/
+
+	/**
+	 * Stable merge sort of the nodes by their data. Neighbouring runs
+	 * already in order are not merged, so sorted input needs only n
+	 * comparisons. The buffer has to have room for n nodes.
+	 *
+	 * Runtime:		O(n * log(n)), linear for sorted input	<br/>
+	 */
+	static void sort(BinTree<DataType> ** nodes, unsigned n, /*{{{*/
+			BinTree<DataType> ** buffer)
+	{
+		if(n < 2)
+			return;
+		unsigned mid = n / 2;
+		sort(nodes, mid, buffer);
+		sort(nodes + mid, n - mid, buffer);
+		if(!(*nodes[mid]->data < *nodes[mid - 1]->data))
+			return;
+		memcpy(buffer, nodes, mid * sizeof(BinTree<DataType> *));
+		unsigned i = 0, j = mid, k = 0;
+		while(i < mid && j < n){
+			if(*nodes[j]->data < *buffer[i]->data)
+				nodes[k++] = nodes[j++];
+			else
+				nodes[k++] = buffer[i++];
+		}
+		while(i < mid)
+			nodes[k++] = buffer[i++];
+	}/*}}}*/
+
 	/**
 	 * Runtime:		O(log(n))				<br/>
 	 */
@@ -758,6 +826,26 @@ template <typename DataType> bool operator!=(/*{{{*/
 	return !a.isEqual(b);
 }/*}}}*/
 
+/**
+ * Nodes not linked into a tree yet, deleted together with the guard unless
+ * released.
+ */
+template <typename DataType>
+class BinTreeGuard
+{
+public:
+	explicit BinTreeGuard(const BinTreeGuard &) = delete;
+	const BinTreeGuard & operator=(const BinTreeGuard &) = delete;
+
+	explicit BinTreeGuard(unsigned capacity) : nodes(capacity) {}
+	~BinTreeGuard() { for(auto node : nodes) delete node; }
+
+	void add(BinTree<DataType> * node) { nodes.add(node); }
+	void release() { nodes.clear(); }
+
+	PodArray<BinTree<DataType> *> nodes;
+};
+
 }
 
 #endif
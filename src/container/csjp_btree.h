@@ -0,0 +1,749 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <string.h>
+
+#include <csjp_object.h>
+#include <csjp_string.h>
+
+namespace csjp {
+
+/** Idea:
+ *
+ * Order statistic B+ tree of data pointers, an alternative of BinTree with
+ * far less pointer chasing. The data pointers are kept in the leaves, which
+ * are linked for iteration. The inner nodes keep for each child its subtree
+ * size and its first data pointer as key, so positional lookups need no
+ * comparison at all and key lookups compare only a few keys per level.
+ * Nodes are nodeBytes (a few cache lines) large.
+ *
+ * '<' relation is used for ordering, data with equal key is inserted after
+ * the existing ones. The tree does not own the data.
+ *
+ * Do not inherit from this class!
+ */
+template <typename DataType>
+class BTree
+{
+private:
+	struct Node
+	{
+		explicit Node(bool leaf) : count(0), leaf(leaf) {}
+		unsigned short count;
+		bool leaf;
+	};
+
+public:
+	static const unsigned nodeBytes = 256;
+	static const unsigned leafSlots =
+		(nodeBytes - 3 * sizeof(void *)) / sizeof(void *);
+	static const unsigned innerSlots =
+		(nodeBytes - sizeof(void *)) / (sizeof(unsigned) + 2 * sizeof(void *));
+
+private:
+	/* Deep enough for the fanout of half filled inner nodes. */
+	static const unsigned maxHeight = 32;
+
+	struct Leaf : public Node
+	{
+		Leaf() : Node(true), prev(NULL), next(NULL) {}
+		Leaf * prev;
+		Leaf * next;
+		DataType * items[leafSlots];
+	};
+
+	struct Inner : public Node
+	{
+		Inner() : Node(false) {}
+		unsigned sizes[innerSlots]; /* of the child subtrees */
+		DataType * keys[innerSlots]; /* first data of the child subtrees */
+		Node * children[innerSlots];
+	};
+
+public:
+	class iterator
+	{
+	public:
+		iterator(Leaf * leaf) : leaf(leaf), pos(0) {}
+		iterator operator++() const
+		{
+			if(++pos == leaf->count){
+				leaf = leaf->next;
+				pos = 0;
+			}
+			return *this;
+		}
+		bool operator!=(const iterator & other) const
+				{ return leaf != other.leaf || pos != other.pos; }
+		const DataType& operator*() const { return *(leaf->items[pos]); }
+		DataType& operator*() { return *(leaf->items[pos]); }
+	private:
+		mutable Leaf * leaf;
+		mutable unsigned pos;
+	};
+
+#define BTreeInitializer : \
+	root(NULL), \
+	head(NULL), \
+	tail(NULL), \
+	count(0)
+public:
+	explicit BTree(const BTree & orig) = delete;
+	const BTree & operator=(const BTree &) = delete;
+
+	BTree(BTree && temp) :
+		root(temp.root),
+		head(temp.head),
+		tail(temp.tail),
+		count(temp.count)
+	{
+		temp.root = NULL;
+		temp.head = NULL;
+		temp.tail = NULL;
+		temp.count = 0;
+	}
+
+	const BTree & operator=(BTree && temp)
+	{
+		clear();
+
+		root = temp.root;
+		head = temp.head;
+		tail = temp.tail;
+		count = temp.count;
+
+		temp.root = NULL;
+		temp.head = NULL;
+		temp.tail = NULL;
+		temp.count = 0;
+
+		return *this;
+	}
+
+public:
+	explicit BTree() BTreeInitializer { }
+	/**
+	 * Runtime:		linear, O(n)				<br/>
+	 */
+	~BTree() { clear(); }
+
+	const iterator begin() const { return iterator(head); }
+	const iterator end() const { return iterator(NULL); }
+	iterator begin() { return iterator(head); }
+	iterator end() { return iterator(NULL); }
+
+	/**
+	 * Runtime:		constant	<br/>
+	 */
+	unsigned size() const { return count; }
+	bool empty() const { return !count; }
+
+	/**
+	 * Full nodes on the way down are split before descending, so on
+	 * allocation failure the tree stays intact without the new data.
+	 *
+	 * Runtime:		O(log(n))				<br/>
+	 */
+	void insert(DataType * item) /*{{{*/
+	{
+		if(!root){
+			Leaf * leaf = new Leaf;
+			leaf->items[0] = item;
+			leaf->count = 1;
+			root = head = tail = leaf;
+			count = 1;
+			return;
+		}
+
+		if(full(root)){
+			Object<Inner> top(new Inner);
+			top->children[0] = root;
+			top->sizes[0] = count;
+			top->keys[0] = firstOf(root);
+			top->count = 1;
+			split(*top, 0);
+			root = top.release();
+		}
+
+		Inner * path[maxHeight];
+		unsigned at[maxHeight];
+		unsigned depth = 0;
+		Node * node = root;
+		while(!node->leaf){
+			Inner & inner = *static_cast<Inner *>(node);
+			unsigned i = upperBound(inner.keys + 1, inner.count - 1, *item);
+			if(full(inner.children[i])){
+				split(inner, i);
+				if(!(*item < *inner.keys[i + 1]))
+					i++;
+			}
+			path[depth] = &inner;
+			at[depth] = i;
+			depth++;
+			node = inner.children[i];
+		}
+
+		/* From here on nothing can fail. */
+		Leaf & leaf = *static_cast<Leaf *>(node);
+		unsigned pos = upperBound(leaf.items, leaf.count, *item);
+		memmove(leaf.items + pos + 1, leaf.items + pos,
+				(leaf.count - pos) * sizeof(DataType *));
+		leaf.items[pos] = item;
+		leaf.count++;
+		while(depth--){
+			path[depth]->sizes[at[depth]]++;
+			path[depth]->keys[at[depth]] =
+				firstOf(path[depth]->children[at[depth]]);
+		}
+		count++;
+	}/*}}}*/
+
+	/**
+	 * Returns the data removed from the tree.
+	 *
+	 * Runtime:		O(log(n))				<br/>
+	 */
+	DataType * removeAt(unsigned i) /*{{{*/
+	{
+		ENSURE(i < count, IndexOutOfRange);
+
+		Inner * path[maxHeight];
+		unsigned at[maxHeight];
+		unsigned depth = 0;
+		Node * node = root;
+		while(!node->leaf){
+			Inner & inner = *static_cast<Inner *>(node);
+			unsigned c = 0;
+			while(inner.sizes[c] <= i)
+				i -= inner.sizes[c++];
+			path[depth] = &inner;
+			at[depth] = c;
+			depth++;
+			node = inner.children[c];
+		}
+
+		Leaf & leaf = *static_cast<Leaf *>(node);
+		DataType * item = leaf.items[i];
+		leaf.count--;
+		memmove(leaf.items + i, leaf.items + i + 1,
+				(leaf.count - i) * sizeof(DataType *));
+		count--;
+
+		while(depth--){
+			Inner & inner = *path[depth];
+			unsigned c = at[depth];
+			inner.sizes[c]--;
+			if(inner.children[c]->count < minimum(inner.children[c]))
+				rebalance(inner, c);
+			else
+				inner.keys[c] = firstOf(inner.children[c]);
+		}
+
+		if(root->leaf){
+			if(!root->count){
+				delete static_cast<Leaf *>(root);
+				root = head = tail = NULL;
+			}
+		} else if(root->count == 1){
+			Inner * top = static_cast<Inner *>(root);
+			root = top->children[0];
+			delete top;
+		}
+
+		return item;
+	}/*}}}*/
+
+	/**
+	 * Removes the first data equal to the given one and returns it.
+	 *
+	 * Runtime:		O(log(n))				<br/>
+	 */
+	template <typename TypeRemove>
+	DataType * remove(const TypeRemove & tr) /*{{{*/
+	{
+		const Leaf * leaf;
+		unsigned pos, i;
+		if(!find(tr, leaf, pos, i))
+			throw ObjectNotFound(EXCLI);
+		return removeAt(i);
+	}/*}}}*/
+
+	/**
+	 * Removes the nodes only, the data is left to the caller.
+	 *
+	 * Runtime:		linear, O(n)				<br/>
+	 */
+	void clear() /*{{{*/
+	{
+		if(!root)
+			return;
+		destroy(root);
+		root = head = tail = NULL;
+		count = 0;
+	}/*}}}*/
+
+	/**
+	 * Runtime:		constant	<br/>
+	 */
+	DataType & first() const /*{{{*/
+	{
+		ENSURE(root != NULL, IndexOutOfRange);
+		return *(head->items[0]);
+	}/*}}}*/
+
+	DataType & last() const /*{{{*/
+	{
+		ENSURE(root != NULL, IndexOutOfRange);
+		return *(tail->items[tail->count - 1]);
+	}/*}}}*/
+
+	/**
+	 * Runtime:		O(log n)	<br/>
+	 * Precondition:	i < size()	<br/>
+	 */
+	DataType & queryAt(unsigned i) const /*{{{*/
+	{
+		ENSURE(i < count, IndexOutOfRange);
+
+		const Node * node = root;
+		while(!node->leaf){
+			const Inner & inner = *static_cast<const Inner *>(node);
+			unsigned c = 0;
+			while(inner.sizes[c] <= i)
+				i -= inner.sizes[c++];
+			node = inner.children[c];
+		}
+		return *(static_cast<const Leaf *>(node)->items[i]);
+	}/*}}}*/
+
+	/**
+	 * The first data equal to the given one.
+	 *
+	 * Runtime:		O(log(n))				<br/>
+	 */
+	template <typename TypeQuery>
+	DataType & query(const TypeQuery & tq) const /*{{{*/
+	{
+		const Leaf * leaf;
+		unsigned pos, i;
+		if(!find(tq, leaf, pos, i))
+			throw ObjectNotFound(EXCLI);
+		return *(leaf->items[pos]);
+	}/*}}}*/
+
+	/**
+	 * Runtime:		O(log(n))				<br/>
+	 */
+	template <typename TypeHas>
+	bool has(const TypeHas & th) const /*{{{*/
+	{
+		const Leaf * leaf;
+		unsigned pos, i;
+		return find(th, leaf, pos, i);
+	}/*}}}*/
+
+	/**
+	 * Index of the first data equal to the given one.
+	 *
+	 * Runtime:		O(log(n))				<br/>
+	 */
+	template <typename TypeIndex>
+	unsigned index(const TypeIndex & ti) const /*{{{*/
+	{
+		const Leaf * leaf;
+		unsigned pos, i;
+		if(!find(ti, leaf, pos, i))
+			throw ObjectNotFound(EXCLI);
+		return i;
+	}/*}}}*/
+
+	/**
+	 * Runtime:		O(n)					<br/>
+	 */
+	bool isEqual(const BTree<DataType> & tree) const /*{{{*/
+	{
+		if(count != tree.count)
+			return false;
+
+		const Leaf * a = head;
+		const Leaf * b = tree.head;
+		unsigned i = 0, j = 0;
+		for(unsigned n = 0; n < count; n++){
+			if(*(a->items[i]) != *(b->items[j]))
+				return false;
+			if(++i == a->count){
+				a = a->next;
+				i = 0;
+			}
+			if(++j == b->count){
+				b = b->next;
+				j = 0;
+			}
+		}
+		return true;
+	}/*}}}*/
+
+#ifndef PERFMODE
+	/**
+	 * Check the sizes, keys, ordering, fill factor and the leaf links.
+	 *
+	 * Runtime:		linear, O(n)	<br/>
+	 */
+	void validity() const /*{{{*/
+	{
+		if(!root){
+			ENSURE(!count && !head && !tail, InvariantFailure);
+			return;
+		}
+		ENSURE(root->leaf || 2 <= root->count, InvariantFailure);
+		const Leaf * prev = NULL;
+		unsigned leafDepth = 0;
+		ENSURE(validity(root, 0, leafDepth, prev) == count,
+				InvariantFailure);
+		ENSURE(prev == tail && !tail->next, InvariantFailure);
+	}/*}}}*/
+#endif
+
+private:
+	static bool full(const Node * node)
+	{
+		return node->count == (node->leaf ? leafSlots : innerSlots);
+	}
+
+	/* Fill factor of non root nodes. */
+	static unsigned minimum(const Node * node)
+	{
+		return (node->leaf ? leafSlots : innerSlots) / 2;
+	}
+
+	static DataType * firstOf(const Node * node)
+	{
+		return node->leaf ? static_cast<const Leaf *>(node)->items[0] :
+			static_cast<const Inner *>(node)->keys[0];
+	}
+
+	static unsigned sizeOf(const Node * node)
+	{
+		if(node->leaf)
+			return node->count;
+		const Inner & inner = *static_cast<const Inner *>(node);
+		unsigned size = 0;
+		for(unsigned i = 0; i < inner.count; i++)
+			size += inner.sizes[i];
+		return size;
+	}
+
+	/* Number of the leading keys less than the query. */
+	template <typename TypeQuery>
+	static unsigned lowerBound(DataType * const * keys, unsigned n,
+			const TypeQuery & tq)
+	{
+		unsigned lo = 0;
+		while(n){
+			unsigned half = n / 2;
+			if(*keys[lo + half] < tq){
+				lo += half + 1;
+				n -= half + 1;
+			} else
+				n = half;
+		}
+		return lo;
+	}
+
+	/* Number of the leading keys not greater than the data. */
+	static unsigned upperBound(DataType * const * keys, unsigned n,
+			const DataType & data)
+	{
+		unsigned lo = 0;
+		while(n){
+			unsigned half = n / 2;
+			if(!(data < *keys[lo + half])){
+				lo += half + 1;
+				n -= half + 1;
+			} else
+				n = half;
+		}
+		return lo;
+	}
+
+	/* Position and index of the first data not less than the query, true if
+	 * it is equal to the query. */
+	template <typename TypeQuery>
+	bool find(const TypeQuery & tq, const Leaf *& leaf, unsigned & pos,
+			unsigned & index) const /*{{{*/
+	{
+		if(!root)
+			return false;
+
+		index = 0;
+		const Node * node = root;
+		while(!node->leaf){
+			const Inner & inner = *static_cast<const Inner *>(node);
+			unsigned c = lowerBound(inner.keys + 1, inner.count - 1, tq);
+			for(unsigned i = 0; i < c; i++)
+				index += inner.sizes[i];
+			node = inner.children[c];
+		}
+
+		leaf = static_cast<const Leaf *>(node);
+		pos = lowerBound(leaf->items, leaf->count, tq);
+		index += pos;
+		if(pos == leaf->count){
+			/* The keys of the inner nodes might be equal to the query
+			 * while the previous subtree ends with smaller ones. */
+			leaf = leaf->next;
+			pos = 0;
+			if(!leaf)
+				return false;
+		}
+		return !(tq < *(leaf->items[pos]));
+	}/*}}}*/
+
+	/* Splits the full child into two halves, the parent is not full. */
+	void split(Inner & parent, unsigned c) /*{{{*/
+	{
+		Node * node = parent.children[c];
+		Node * sibling;
+		unsigned moved;
+		if(node->leaf){
+			Leaf & left = *static_cast<Leaf *>(node);
+			Leaf & right = *new Leaf;
+			unsigned half = left.count / 2;
+			right.count = left.count - half;
+			memcpy(right.items, left.items + half,
+					right.count * sizeof(DataType *));
+			left.count = half;
+			right.prev = &left;
+			right.next = left.next;
+			if(left.next)
+				left.next->prev = &right;
+			else
+				tail = &right;
+			left.next = &right;
+			moved = right.count;
+			sibling = &right;
+		} else {
+			Inner & left = *static_cast<Inner *>(node);
+			Inner & right = *new Inner;
+			unsigned half = left.count / 2;
+			right.count = left.count - half;
+			memcpy(right.sizes, left.sizes + half,
+					right.count * sizeof(unsigned));
+			memcpy(right.keys, left.keys + half,
+					right.count * sizeof(DataType *));
+			memcpy(right.children, left.children + half,
+					right.count * sizeof(Node *));
+			left.count = half;
+			moved = sizeOf(&right);
+			sibling = &right;
+		}
+
+		unsigned n = parent.count - c - 1;
+		memmove(parent.sizes + c + 2, parent.sizes + c + 1,
+				n * sizeof(unsigned));
+		memmove(parent.keys + c + 2, parent.keys + c + 1,
+				n * sizeof(DataType *));
+		memmove(parent.children + c + 2, parent.children + c + 1,
+				n * sizeof(Node *));
+		parent.sizes[c] -= moved;
+		parent.sizes[c + 1] = moved;
+		parent.keys[c + 1] = firstOf(sibling);
+		parent.children[c + 1] = sibling;
+		parent.count++;
+	}/*}}}*/
+
+	/* The child has one less entry than the minimum. It borrows from a
+	 * sibling having more or gets merged with one. */
+	void rebalance(Inner & parent, unsigned c) /*{{{*/
+	{
+		if(0 < c && minimum(parent.children[c - 1]) <
+				parent.children[c - 1]->count)
+			borrowLeft(parent, c);
+		else if(c + 1 < parent.count && minimum(parent.children[c + 1]) <
+				parent.children[c + 1]->count)
+			borrowRight(parent, c);
+		else if(0 < c)
+			merge(parent, c - 1);
+		else
+			merge(parent, c);
+	}/*}}}*/
+
+	void borrowLeft(Inner & parent, unsigned c) /*{{{*/
+	{
+		Node * node = parent.children[c];
+		unsigned moved;
+		if(node->leaf){
+			Leaf & left = *static_cast<Leaf *>(parent.children[c - 1]);
+			Leaf & leaf = *static_cast<Leaf *>(node);
+			memmove(leaf.items + 1, leaf.items,
+					leaf.count * sizeof(DataType *));
+			leaf.items[0] = left.items[--left.count];
+			moved = 1;
+		} else {
+			Inner & left = *static_cast<Inner *>(parent.children[c - 1]);
+			Inner & inner = *static_cast<Inner *>(node);
+			memmove(inner.sizes + 1, inner.sizes,
+					inner.count * sizeof(unsigned));
+			memmove(inner.keys + 1, inner.keys,
+					inner.count * sizeof(DataType *));
+			memmove(inner.children + 1, inner.children,
+					inner.count * sizeof(Node *));
+			left.count--;
+			inner.sizes[0] = left.sizes[left.count];
+			inner.keys[0] = left.keys[left.count];
+			inner.children[0] = left.children[left.count];
+			moved = inner.sizes[0];
+		}
+		node->count++;
+		parent.sizes[c - 1] -= moved;
+		parent.sizes[c] += moved;
+		parent.keys[c] = firstOf(node);
+	}/*}}}*/
+
+	void borrowRight(Inner & parent, unsigned c) /*{{{*/
+	{
+		Node * node = parent.children[c];
+		Node * right = parent.children[c + 1];
+		unsigned moved;
+		if(node->leaf){
+			Leaf & from = *static_cast<Leaf *>(right);
+			Leaf & leaf = *static_cast<Leaf *>(node);
+			leaf.items[leaf.count] = from.items[0];
+			from.count--;
+			memmove(from.items, from.items + 1,
+					from.count * sizeof(DataType *));
+			moved = 1;
+		} else {
+			Inner & from = *static_cast<Inner *>(right);
+			Inner & inner = *static_cast<Inner *>(node);
+			inner.sizes[inner.count] = from.sizes[0];
+			inner.keys[inner.count] = from.keys[0];
+			inner.children[inner.count] = from.children[0];
+			moved = from.sizes[0];
+			from.count--;
+			memmove(from.sizes, from.sizes + 1,
+					from.count * sizeof(unsigned));
+			memmove(from.keys, from.keys + 1,
+					from.count * sizeof(DataType *));
+			memmove(from.children, from.children + 1,
+					from.count * sizeof(Node *));
+		}
+		node->count++;
+		parent.sizes[c] += moved;
+		parent.sizes[c + 1] -= moved;
+		parent.keys[c] = firstOf(node);
+		parent.keys[c + 1] = firstOf(right);
+	}/*}}}*/
+
+	/* Merges the child after the given one into it. */
+	void merge(Inner & parent, unsigned c) /*{{{*/
+	{
+		Node * node = parent.children[c];
+		Node * right = parent.children[c + 1];
+		if(node->leaf){
+			Leaf & leaf = *static_cast<Leaf *>(node);
+			Leaf & from = *static_cast<Leaf *>(right);
+			memcpy(leaf.items + leaf.count, from.items,
+					from.count * sizeof(DataType *));
+			leaf.count += from.count;
+			leaf.next = from.next;
+			if(from.next)
+				from.next->prev = &leaf;
+			else
+				tail = &leaf;
+			delete &from;
+		} else {
+			Inner & inner = *static_cast<Inner *>(node);
+			Inner & from = *static_cast<Inner *>(right);
+			memcpy(inner.sizes + inner.count, from.sizes,
+					from.count * sizeof(unsigned));
+			memcpy(inner.keys + inner.count, from.keys,
+					from.count * sizeof(DataType *));
+			memcpy(inner.children + inner.count, from.children,
+					from.count * sizeof(Node *));
+			inner.count += from.count;
+			delete &from;
+		}
+
+		parent.sizes[c] += parent.sizes[c + 1];
+		parent.keys[c] = firstOf(node);
+		parent.count--;
+		unsigned n = parent.count - c - 1;
+		memmove(parent.sizes + c + 1, parent.sizes + c + 2,
+				n * sizeof(unsigned));
+		memmove(parent.keys + c + 1, parent.keys + c + 2,
+				n * sizeof(DataType *));
+		memmove(parent.children + c + 1, parent.children + c + 2,
+				n * sizeof(Node *));
+	}/*}}}*/
+
+	static void destroy(Node * node) /*{{{*/
+	{
+		if(node->leaf){
+			delete static_cast<Leaf *>(node);
+			return;
+		}
+		Inner * inner = static_cast<Inner *>(node);
+		for(unsigned i = 0; i < inner->count; i++)
+			destroy(inner->children[i]);
+		delete inner;
+	}/*}}}*/
+
+#ifndef PERFMODE
+	/* Size of the subtree. */
+	unsigned validity(const Node * node, unsigned depth, unsigned & leafDepth,
+			const Leaf *& prev) const /*{{{*/
+	{
+		ENSURE(depth < maxHeight, InvariantFailure);
+		ENSURE(node == root || minimum(node) <= node->count,
+				InvariantFailure);
+		ENSURE(node->count <= (node->leaf ? leafSlots : innerSlots),
+				InvariantFailure);
+
+		if(node->leaf){
+			const Leaf * leaf = static_cast<const Leaf *>(node);
+			if(!leafDepth)
+				leafDepth = depth + 1;
+			ENSURE(leafDepth == depth + 1, InvariantFailure);
+			ENSURE(leaf->prev == prev, InvariantFailure);
+			ENSURE(prev ? prev->next == leaf : head == leaf,
+					InvariantFailure);
+			if(prev)
+				ENSURE(!(*(leaf->items[0]) <
+						*(prev->items[prev->count - 1])),
+						InvariantFailure);
+			for(unsigned i = 1; i < leaf->count; i++)
+				ENSURE(!(*(leaf->items[i]) < *(leaf->items[i - 1])),
+						InvariantFailure);
+			prev = leaf;
+			return leaf->count;
+		}
+
+		const Inner * inner = static_cast<const Inner *>(node);
+		unsigned size = 0;
+		for(unsigned i = 0; i < inner->count; i++){
+			const Node * child = inner->children[i];
+			ENSURE(inner->keys[i] == firstOf(child), InvariantFailure);
+			unsigned childSize = validity(child, depth + 1,
+					leafDepth, prev);
+			ENSURE(inner->sizes[i] == childSize, InvariantFailure);
+			size += childSize;
+		}
+		return size;
+	}/*}}}*/
+#endif
+
+	Node * root;
+	Leaf * head;
+	Leaf * tail;
+	unsigned count;
+};
+
+}
+
+#endif
@@ -6,7 +6,7 @@
 #ifndef CONTAINER_H
 #define CONTAINER_H
 
-#include <csjp_bintree.h>
+#include <csjp_ownerbintree.h>
 
 namespace csjp {
 
@@ -27,23 +27,32 @@ public:
 	};
 
 #define ContainerInitializer : \
-	root(0)
+	root(0), \
+	arena(0), \
+	pool(0)
 public:
 	explicit Container(const Container & orig) ContainerInitializer { }
 	const Container & operator=(const Container &) = delete;
 
 	Container(Container && temp) :
-		root(temp.root)
+		root(temp.root),
+		arena(temp.arena),
+		pool(temp.pool)
 	{
 		temp.root = 0;
+		temp.pool = 0;
 	}
 
 	const Container & operator=(Container && temp)
 	{
 		clear();
+		delete pool;
 
 		root = temp.root;
 		temp.root = 0;
+		arena = temp.arena;
+		pool = temp.pool;
+		temp.pool = 0;
 
 		return *this;
 	}
@@ -53,10 +62,61 @@ public:
 	/**
 	 * Runtime:		linear, O(n)				<br/>
 	 */
-	virtual ~Container() { clear(); }
+	virtual ~Container() { clear(); delete pool; }
+
+	/** Nodes are allocated from the arena. They can be deleted as any other
+	 * node, moving the container moves its arena too. */
+	explicit Container(Arena & arena) : root(0), arena(&arena), pool(0) { }
+	Arena * getArena() const { return arena; }
 
 protected:
+	/** Without an arena the nodes are allocated from a pool of the container,
+	 * created at the first use. */
+	Pool & nodePool()
+	{
+		if(!pool)
+			pool = new Pool(ArenaObject::header + sizeof(OwnerBinTree<DataType>));
+		return *pool;
+	}
+
+	/**
+	 * Merges the given sorted, unlinked nodes with the ones in the tree and
+	 * links all of them into a balanced tree. Among equal keys the nodes
+	 * already in the tree come first. The buffer has to have room for all
+	 * the nodes, nothing is allocated.
+	 *
+	 * Runtime:		linear, O(n + m)			<br/>
+	 */
+	void merge(const PodArray<BinTree<DataType> *> & nodes, /*{{{*/
+			PodArray<BinTree<DataType> *> & buffer)
+	{
+		unsigned n = size() + nodes.length;
+		ENSURE(n <= buffer.capacity, InvalidArgument);
+
+		BinTree<DataType> * iter = root ? root->first() : NULL;
+		BinTree<DataType> * const * added = nodes.data;
+		BinTree<DataType> * const * end = nodes.data + nodes.length;
+		buffer.clear();
+		while(iter && added < end){
+			if(*(*added)->data < *iter->data){
+				buffer.add(*added);
+				added++;
+			} else {
+				buffer.add(iter);
+				iter = iter->next();
+			}
+		}
+		for(; iter; iter = iter->next())
+			buffer.add(iter);
+		for(; added < end; added++)
+			buffer.add(*added);
+
+		root = BinTree<DataType>::build(buffer.data, n);
+	}/*}}}*/
+
 	BinTree<DataType> *root;
+	Arena * arena;
+	Pool * pool;
 
 public:
 	const iterator begin() const {
@@ -110,6 +170,10 @@ public:
 	}/*}}}*/
 
 	/**
+	 * With the nodes in the pool of the container, they are only destructed
+	 * and the pool is recycled at once. The memory of the pool is kept for
+	 * the next nodes up to Pool::maxKeptBlocks nodes.
+	 *
 	 * Runtime:		linear, O(n)				<br/>
 	 */
 	void clear()/*{{{*/
@@ -117,6 +181,13 @@ public:
 		if(!root)
 			return;
 
+		if(pool){
+			root->destruct();
+			root = NULL;
+			pool->recycle();
+			return;
+		}
+
 		root->clear();
 		delete root;
 		root = NULL;
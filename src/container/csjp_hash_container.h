@@ -0,0 +1,455 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#ifndef HASH_CONTAINER_H
+#define HASH_CONTAINER_H
+
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define CSJP_HASH_SSE2
+#endif
+
+#include <csjp_object.h>
+#include <csjp_string.h>
+
+namespace csjp {
+
+/**
+ * Hash values of the keys in a HashContainer. Data types and the query types
+ * of heterogeneous lookups provide their hash() next to their operator==,
+ * giving the same value for equal keys. The container mixes the bits of the
+ * value, so the identity is fine for integers.
+ */
+inline size_t hash(int v) { return (size_t)v; }
+inline size_t hash(unsigned v) { return v; }
+inline size_t hash(long int v) { return (size_t)v; }
+inline size_t hash(long unsigned v) { return v; }
+inline size_t hash(long long int v) { return (size_t)v; }
+inline size_t hash(long long unsigned v) { return (size_t)v; }
+
+/* FNV-1a taking 8 bytes at once. */
+inline size_t hashBytes(const char * data, size_t length)
+{
+	uint64_t hash = 14695981039346656037ull;
+	uint64_t word;
+	for(; 8 <= length; data += 8, length -= 8){
+		memcpy(&word, data, sizeof(word));
+		hash = (hash ^ word) * 1099511628211ull;
+	}
+	word = length;
+	memcpy(&word, data, length);
+	return (size_t)((hash ^ word) * 1099511628211ull);
+}
+
+inline size_t hash(const AStr & s) { return hashBytes(s.c_str(), s.length); }
+inline size_t hash(const char * s) { return hashBytes(s, strlen(s)); }
+
+/**
+ * Control bytes of a slot group, matched at once with SSE2 or as a 64 bit
+ * word otherwise. A control byte is the 7 low bits of the hash for a used
+ * slot, empty or deleted (both negative) otherwise.
+ */
+class HashGroup
+{
+public:
+	static const signed char empty = -128;
+	static const signed char deleted = -2;
+
+#ifdef CSJP_HASH_SSE2
+	typedef uint32_t Mask;
+	static const unsigned width = 16;
+
+	explicit HashGroup(const signed char * pos) :
+		ctrl(_mm_loadu_si128((const __m128i *)pos)) {}
+
+	Mask match(signed char h2) const
+		{ return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)); }
+	Mask matchEmpty() const { return match(empty); }
+	/* Empty or deleted slots. */
+	Mask matchFree() const { return _mm_movemask_epi8(ctrl); }
+
+	static unsigned trailing(Mask mask) { return __builtin_ctz(mask); }
+	static unsigned leading(Mask mask) { return __builtin_clz(mask) - 16; }
+private:
+	__m128i ctrl;
+#else
+	typedef uint64_t Mask;
+	static const unsigned width = 8;
+
+	explicit HashGroup(const signed char * pos)
+	{
+		memcpy(&ctrl, pos, sizeof(ctrl));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		ctrl = __builtin_bswap64(ctrl);
+#endif
+	}
+
+	/* Might have false positives next to real ones, but only on used slots. */
+	Mask match(signed char h2) const
+	{
+		uint64_t x = ctrl ^ (lsbs * (unsigned char)h2);
+		return (x - lsbs) & ~x & msbs;
+	}
+	Mask matchEmpty() const { return ctrl & ~(ctrl << 6) & msbs; }
+	/* Empty or deleted slots. */
+	Mask matchFree() const { return ctrl & msbs; }
+
+	static unsigned trailing(Mask mask) { return __builtin_ctzll(mask) >> 3; }
+	static unsigned leading(Mask mask) { return __builtin_clzll(mask) >> 3; }
+private:
+	static const uint64_t lsbs = 0x0101010101010101ull;
+	static const uint64_t msbs = 0x8080808080808080ull;
+	uint64_t ctrl;
+#endif
+
+public:
+	/* Index of the lowest slot in the mask, which gets removed. */
+	static unsigned next(Mask & mask)
+	{
+		unsigned i = trailing(mask);
+		mask &= mask - 1;
+		return i;
+	}
+};
+
+/** Idea:
+ *
+ * Open addressing hash table of data pointers (Swiss table). Besides the
+ * slots, a control byte is kept for each of them, so a probe checks a whole
+ * group of slots with a few instructions and touches the data only on a
+ * likely match. The first group of the control bytes is repeated after the
+ * last one, so groups can be loaded from any position.
+ *
+ * Lookups need a hash() of the data or query type and an operator== between
+ * the data and the query. Data with equal keys can be added more times,
+ * lookups find one of them. There is no order, the iteration goes in the order
+ * of the slots. The container does not own the data, see OwnerHashContainer.
+ */
+template <typename DataType>
+class HashContainer
+{
+public:
+	class iterator
+	{
+	public:
+		iterator(const HashContainer * table, size_t pos) :
+			table(table), pos(pos) { skip(); }
+		iterator operator++() const { pos++; skip(); return *this; }
+		bool operator!=(const iterator & other) const { return pos != other.pos; }
+		const DataType& operator*() const { return *(table->slots[pos]); }
+		DataType& operator*() { return *(table->slots[pos]); }
+	private:
+		void skip() const { while(pos < table->cap && table->ctrl[pos] < 0) pos++; }
+		const HashContainer * table;
+		mutable size_t pos;
+	};
+
+	static const unsigned width = HashGroup::width;
+
+#define HashContainerInitializer : \
+	slots(NULL), \
+	ctrl(NULL), \
+	cap(0), \
+	count(0), \
+	growthLeft(0)
+public:
+	explicit HashContainer(const HashContainer & orig) = delete;
+	const HashContainer & operator=(const HashContainer &) = delete;
+
+	HashContainer(HashContainer && temp) :
+		slots(temp.slots),
+		ctrl(temp.ctrl),
+		cap(temp.cap),
+		count(temp.count),
+		growthLeft(temp.growthLeft)
+	{
+		temp.slots = NULL;
+		temp.ctrl = NULL;
+		temp.cap = 0;
+		temp.count = 0;
+		temp.growthLeft = 0;
+	}
+
+	const HashContainer & operator=(HashContainer && temp)
+	{
+		free(slots);
+
+		slots = temp.slots;
+		ctrl = temp.ctrl;
+		cap = temp.cap;
+		count = temp.count;
+		growthLeft = temp.growthLeft;
+
+		temp.slots = NULL;
+		temp.ctrl = NULL;
+		temp.cap = 0;
+		temp.count = 0;
+		temp.growthLeft = 0;
+
+		return *this;
+	}
+
+public:
+	explicit HashContainer() HashContainerInitializer { }
+	virtual ~HashContainer() { free(slots); }
+
+	const iterator begin() const { return iterator(this, 0); }
+	const iterator end() const { return iterator(this, cap); }
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, cap); }
+
+	/**
+	 * Runtime:		constant	<br/>
+	 */
+	bool empty() const { return count == 0; }
+	unsigned size() const { return count; }
+	/* Number of slots, 7/8 of them can be used. */
+	size_t capacity() const { return cap; }
+
+	/**
+	 * Makes room for n data without rehashing.
+	 *
+	 * Runtime:		linear, O(n)				<br/>
+	 */
+	void reserve(unsigned n) /*{{{*/
+	{
+		size_t c = width;
+		while(c - c / 8 < n)
+			c *= 2;
+		if(cap < c)
+			rehash(c);
+	}/*}}}*/
+
+	/**
+	 * Runtime:		constant on average			<br/>
+	 */
+	template <typename TypeHas>
+	bool has(const TypeHas & th) const
+	{
+		size_t i;
+		return find(th, i);
+	}
+
+	/**
+	 * Runtime:		constant on average			<br/>
+	 */
+	template <typename TypeQuery>
+	const DataType& query(const TypeQuery & tq) const /*{{{*/
+	{
+		size_t i;
+		if(!find(tq, i))
+			throw ObjectNotFound(EXCLI);
+		return *slots[i];
+	}/*}}}*/
+
+	template <typename TypeQuery>
+	DataType& query(const TypeQuery & tq) /*{{{*/
+	{
+		size_t i;
+		if(!find(tq, i))
+			throw ObjectNotFound(EXCLI);
+		return *slots[i];
+	}/*}}}*/
+
+	/**
+	 * Same size and every data has an equal pair in the other container.
+	 *
+	 * Runtime:		O(n) on average				<br/>
+	 */
+	bool isEqual(const HashContainer<DataType> & c) const /*{{{*/
+	{
+		if(count != c.count)
+			return false;
+		for(auto & data : *this)
+			if(!c.has(data))
+				return false;
+		return true;
+	}/*}}}*/
+
+protected:
+	/**
+	 * On error nothing is changed.
+	 *
+	 * Runtime:		constant on average			<br/>
+	 */
+	void insert(DataType * data) /*{{{*/
+	{
+		size_t h = mix(hash(*data));
+		if(!cap || (!growthLeft && ctrl[findFree(h)] != HashGroup::deleted)){
+			/* Only rehash in place if mostly deleted slots are used up. */
+			if(cap && count < (cap - cap / 8) / 2)
+				rehash(cap);
+			else
+				rehash(cap ? cap * 2 : width);
+		}
+		place(data, h);
+	}/*}}}*/
+
+	/**
+	 * Removes and returns the data found.
+	 *
+	 * Runtime:		constant on average			<br/>
+	 */
+	template <typename TypeRemove>
+	DataType * take(const TypeRemove & tr) /*{{{*/
+	{
+		size_t i;
+		if(!find(tr, i))
+			throw ObjectNotFound(EXCLI);
+		DataType * data = slots[i];
+
+		/* The slot can be empty again if no probe could go over it, that is
+		 * no full group of used or deleted slots contains it. */
+		size_t mask = cap - 1;
+		HashGroup::Mask emptyBefore =
+			HashGroup(ctrl + ((i - width) & mask)).matchEmpty();
+		HashGroup::Mask emptyAfter = HashGroup(ctrl + i).matchEmpty();
+		if(emptyBefore && emptyAfter && HashGroup::trailing(emptyAfter) +
+				HashGroup::leading(emptyBefore) < width){
+			setCtrl(i, HashGroup::empty);
+			growthLeft++;
+		} else
+			setCtrl(i, HashGroup::deleted);
+		count--;
+
+		return data;
+	}/*}}}*/
+
+	/**
+	 * Forgets all the data, the slots are kept.
+	 *
+	 * Runtime:		linear in capacity			<br/>
+	 */
+	void reset() /*{{{*/
+	{
+		if(!cap)
+			return;
+		memset(ctrl, HashGroup::empty, cap + width);
+		count = 0;
+		growthLeft = cap - cap / 8;
+	}/*}}}*/
+
+private:
+	static size_t mix(size_t h)
+	{
+		uint64_t x = (uint64_t)h * 0x9E3779B97F4A7C15ull;
+		return (size_t)(x ^ (x >> 32));
+	}
+
+	void setCtrl(size_t i, signed char c)
+	{
+		ctrl[i] = c;
+		if(i < width)
+			ctrl[cap + i] = c;
+	}
+
+	template <typename TypeQuery>
+	bool find(const TypeQuery & tq, size_t & index) const /*{{{*/
+	{
+		if(!count)
+			return false;
+
+		size_t h = mix(hash(tq));
+		signed char h2 = h & 0x7f;
+		size_t mask = cap - 1;
+		size_t pos = (h >> 7) & mask;
+		for(size_t step = width; ; step += width){
+			HashGroup group(ctrl + pos);
+			for(HashGroup::Mask m = group.match(h2); m; ){
+				size_t i = (pos + HashGroup::next(m)) & mask;
+				if(*slots[i] == tq){
+					index = i;
+					return true;
+				}
+			}
+			if(group.matchEmpty())
+				return false;
+			pos = (pos + step) & mask;
+		}
+	}/*}}}*/
+
+	/* There is always an empty slot, so the probing ends. */
+	size_t findFree(size_t h) const /*{{{*/
+	{
+		size_t mask = cap - 1;
+		size_t pos = (h >> 7) & mask;
+		for(size_t step = width; ; step += width){
+			HashGroup::Mask m = HashGroup(ctrl + pos).matchFree();
+			if(m)
+				return (pos + HashGroup::next(m)) & mask;
+			pos = (pos + step) & mask;
+		}
+	}/*}}}*/
+
+	void place(DataType * data, size_t h) /*{{{*/
+	{
+		size_t i = findFree(h);
+		if(ctrl[i] == HashGroup::empty)
+			growthLeft--;
+		setCtrl(i, h & 0x7f);
+		slots[i] = data;
+		count++;
+	}/*}}}*/
+
+	void rehash(size_t newCap) /*{{{*/
+	{
+		HashContainer<DataType> table;
+		void * mem = malloc(newCap * sizeof(DataType *) + newCap + width);
+		if(!mem)
+			throw OutOfMemory("No enough memory for HashContainer allocation "
+					"with % number of slots.", newCap);
+		table.slots = (DataType **)mem;
+		table.ctrl = (signed char *)(table.slots + newCap);
+		table.cap = newCap;
+		table.reset();
+
+		for(size_t i = 0; i < cap; i++)
+			if(0 <= ctrl[i])
+				table.place(slots[i], mix(hash(*slots[i])));
+
+		*this = move_cast(table);
+	}/*}}}*/
+
+	DataType ** slots;
+	signed char * ctrl;
+	size_t cap; /* power of 2, at least width */
+	size_t count;
+	size_t growthLeft; /* empty slots to use before rehashing */
+
+public:
+#ifndef PERFMODE
+	/**
+	 * Runtime:		linear, O(n)	<br/>
+	 */
+	void validity() const /*{{{*/
+	{
+		size_t used = 0, deleted = 0;
+		for(size_t i = 0; i < cap; i++){
+			if(i < width)
+				ENSURE(ctrl[cap + i] == ctrl[i], InvariantFailure);
+			if(ctrl[i] == HashGroup::deleted)
+				deleted++;
+			if(ctrl[i] < 0)
+				continue;
+			used++;
+			ENSURE(ctrl[i] == (signed char)(mix(hash(*slots[i])) & 0x7f),
+					InvariantFailure);
+			ENSURE(has(*slots[i]), InvariantFailure);
+		}
+		ENSURE(used == count, InvariantFailure);
+		if(cap)
+			ENSURE(used + deleted + growthLeft == cap - cap / 8,
+					InvariantFailure);
+	}/*}}}*/
+#endif
+};
+
+}
+
+#endif
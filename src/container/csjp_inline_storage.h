@@ -0,0 +1,41 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#ifndef CSJP_INLINE_STORAGE_H
+#define CSJP_INLINE_STORAGE_H
+
+#include <string.h>
+
+namespace csjp {
+
+/**
+ * Room for the first Size items of an array (and for the zero item closing
+ * them) inside the array object itself. The arrays inherit from it, so with
+ * zero Size it takes no space at all.
+ */
+template <typename ItemType, unsigned Size>
+class InlineStorage
+{
+protected:
+	InlineStorage() { memset(items, 0, sizeof(ItemType)); }
+
+	ItemType * inlineItems() { return items; }
+	bool isInline(const ItemType * ptr) const { return ptr == items; }
+
+private:
+	ItemType items[Size + 1];
+};
+
+template <typename ItemType>
+class InlineStorage<ItemType, 0>
+{
+protected:
+	ItemType * inlineItems() { return NULL; }
+	bool isInline(const ItemType *) const { return false; }
+};
+
+}
+
+#endif
@@ -62,7 +62,7 @@ private:
 	bool readArray(const String & key);
 
 private:
-	RefArray<Json> objectStack;
+	RefArray<Json, 16> objectStack;
 	const Str & data; /* Json formatted text. */
 	Json & target; /* Object want to receive findings. */
 	size_t len; /* Length of data */
@@ -9,10 +9,11 @@
 #include <csjp_owner_container.h>
 #include <csjp_array.h>
 #include <csjp_string.h>
+#include <csjp_arena.h>
 
 namespace csjp {
 
-class Json
+class Json : public ArenaObject
 {
 /**
  * Do not inherit from this class!
@@ -33,7 +34,8 @@ public:
 		type(Type::Null),
 		string(orig.string),
 		properties(orig.properties),
-		array(orig.array)
+		array(orig.array),
+		arena(0)
 	{}
 	const Json & operator=(const Json & orig)
 	{
@@ -62,7 +64,8 @@ public:
 		type(temp.type),
 		string(move_cast(temp.string)),
 		properties(move_cast(temp.properties)),
-		array(move_cast(temp.array))
+		array(move_cast(temp.array)),
+		arena(temp.arena)
 	{}
 	/* The target key will not be overwritten so just skip it. */
 	const Json & operator=(Json && temp)
@@ -71,6 +74,7 @@ public:
 		string = move_cast(temp.string);
 		properties = move_cast(temp.properties);
 		array = move_cast(temp.array);
+		arena = temp.arena;
 		return *this;
 	}
 	const Json & operator=(String && temp)
@@ -88,7 +92,17 @@ public:
 
 
 public:
-	explicit Json(Type type = Type::Null) : type(type) {}
+	explicit Json(Type type = Type::Null) : type(type), arena(0) {}
+	/** The node, its strings and its descendants are all allocated from the
+	 * arena. */
+	explicit Json(Arena & arena, Type type = Type::Null) :
+		key(arena),
+		type(type),
+		string(arena),
+		properties(arena),
+		array(arena),
+		arena(&arena)
+	{}
 	~Json() { }
 
 public:
@@ -120,8 +134,12 @@ public:
 	Json & operator[](size_t idx)
 	{
 		if(idx == array.length){
-			Object<Json> child(new Json());
-			array.add(child);
+			if(arena)
+				array.add(*arena);
+			else {
+				Object<Json> child(new Json());
+				array.add(child);
+			}
 			type = Json::Type::Array;
 		}
 		if(idx < array.length)
@@ -153,7 +171,7 @@ public:
 	Json & operator[](const Type & obj)
 	{
 		if(!properties.has(obj)){
-			Object<Json> child(new Json());
+			Object<Json> child(arena ? new(*arena) Json(*arena) : new Json());
 			child->key = obj;
 			properties.add(child);
 			type = Json::Type::Object;
@@ -195,6 +213,7 @@ public:
 	}
 
 	const String & value() const { return string; }
+	Arena * getArena() const { return arena; }
 
 	void setValue(const csjp::Str & v)		{ string = v; }
 	void setValue(const unsigned v)			{ string.cutAt(0); string << v; }
@@ -237,8 +256,9 @@ public:
 	Type type;
 	String string;
 	OwnerContainer<Json> properties;
-	Array<Json> array;
+	Array<Json, 4> array;
 private:
+	Arena * arena;
 	static Json empty;
 };
 
@@ -0,0 +1,211 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#ifndef OWNER_BTREE_CONTAINER_H
+#define OWNER_BTREE_CONTAINER_H
+
+#include <csjp_btree.h>
+
+namespace csjp {
+
+/**
+ * Same as OwnerContainer, but kept in a BTree instead of a BinTree. Lookups,
+ * positional access and iteration touch much less memory, the data is still
+ * allocated one by one and owned by the container.
+ *
+ * Do not inherit from this class!
+ */
+template <typename DataType>
+class OwnerBTreeContainer
+{
+public:
+	typedef typename BTree<DataType>::iterator iterator;
+
+#define OwnerBTreeContainerInitializer : tree()
+public:
+	explicit OwnerBTreeContainer(const OwnerBTreeContainer & orig)
+		OwnerBTreeContainerInitializer { copy(orig); }
+	const OwnerBTreeContainer & operator=(const OwnerBTreeContainer &) = delete;
+
+	OwnerBTreeContainer(OwnerBTreeContainer && temp) :
+		tree(move_cast(temp.tree))
+	{}
+
+	const OwnerBTreeContainer & operator=(OwnerBTreeContainer && temp)
+	{
+		clear();
+		tree = move_cast(temp.tree);
+		return *this;
+	}
+
+public:
+	explicit OwnerBTreeContainer() OwnerBTreeContainerInitializer { }
+	/**
+	 * Runtime:		linear, O(n)				<br/>
+	 */
+	~OwnerBTreeContainer() { clear(); }
+
+private:
+	/**
+	 * Runtime:		O(n * log(n))	<br/>
+	 */
+	void copy(const OwnerBTreeContainer<DataType> & orig) /*{{{*/
+	{
+		/* Built aside, so the copies made are deleted on error. */
+		OwnerBTreeContainer<DataType> copy;
+		for(auto & data : orig)
+			copy.add(new DataType(data));
+
+		/* Everything ok, lets take over the copies. */
+		*this = move_cast(copy);
+	}/*}}}*/
+
+	BTree<DataType> tree;
+
+public:
+	const iterator begin() const { return tree.begin(); }
+	const iterator end() const { return tree.end(); }
+	iterator begin() { return tree.begin(); }
+	iterator end() { return tree.end(); }
+
+	/**
+	 * Runtime:		O(log(n))				<br/>
+	 */
+	void add(DataType *& t) /* {{{ */
+	{
+		tree.insert(t);
+		t = NULL;
+	}/*}}}*/
+
+	void add(Object<DataType> & odt)
+	{
+		add(odt.ptr);
+	}
+
+	/** Not 100% transactional. On error, the object pointed will be destructed! */
+	void add(DataType * && dt)
+	{
+		Object<DataType> o(dt);
+		add(o);
+	}
+
+	/**
+	 * Runtime:		O(log(n))	<br/>
+	 */
+	void removeAt(unsigned i)
+	{
+		delete tree.removeAt(i);
+	}
+
+	/**
+	 * Runtime:		O(log(n))				<br/>
+	 */
+	void remove(const DataType &t)
+	{
+		delete tree.remove(t);
+	}
+
+	/**
+	 * Runtime:		O(log(n))				<br/>
+	 */
+	template <class TypeRemove>
+	void remove(const TypeRemove &tr)
+	{
+		delete tree.remove(tr);
+	}
+
+	/**
+	 * Runtime:		linear, O(n)				<br/>
+	 */
+	void clear() /*{{{*/
+	{
+		for(auto & data : tree)
+			delete &data;
+		tree.clear();
+	}/*}}}*/
+
+	/**
+	 * Runtime:		constant	<br/>
+	 */
+	const DataType & last() const { return tree.last(); }
+	DataType & last() { return tree.last(); }
+
+	/**
+	 * Runtime:		O(log n)	<br/>
+	 * Precondition:	i < size()	<br/>
+	 */
+	const DataType& operator[](unsigned i) const { return tree.queryAt(i); }
+	DataType& operator[](unsigned i) { return tree.queryAt(i); }
+	const DataType& queryAt(unsigned i) const { return tree.queryAt(i); }
+
+	/**
+	 * Runtime:		O(log(n))				<br/>
+	 */
+	const DataType& query(const DataType &t) const { return tree.query(t); }
+
+	template <typename TypeQuery>
+	const DataType& query(const TypeQuery &tq) const { return tree.query(tq); }
+
+	template <typename TypeQuery>
+	DataType& query(const TypeQuery &tq) { return tree.query(tq); }
+
+	/**
+	 * Runtime:		constant	<br/>
+	 */
+	bool empty() const { return tree.empty(); }
+	unsigned size() const { return tree.size(); }
+
+	/**
+	 * Runtime:		O(log(n))			<br/>
+	 */
+	unsigned index(const DataType &t) const { return tree.index(t); }
+
+	template <class TypeIndex>
+	unsigned index(const TypeIndex &ti) const { return tree.index(ti); }
+
+	bool has(const DataType &t) const { return tree.has(t); }
+
+	template <class TypeHas>
+	bool has(const TypeHas &th) const { return tree.has(th); }
+
+	/**
+	 * Runtime:		O(n)					<br/>
+	 */
+	bool isEqual(const OwnerBTreeContainer<DataType> &c) const
+	{
+		return tree.isEqual(c.tree);
+	}
+
+#ifndef PERFMODE
+	/**
+	 * Runtime:		linear, O(n)	<br/>
+	 */
+	void validity() const { tree.validity(); }
+#endif
+};
+
+/**
+ * Runtime:		O(n)					<br/>
+ */
+template <typename DataType> bool operator==(/*{{{*/
+		const OwnerBTreeContainer<DataType> &a,
+		const OwnerBTreeContainer<DataType> &b)
+{
+	return a.isEqual(b);
+}/*}}}*/
+
+/**
+ * Runtime:		O(n)					<br/>
+ */
+template <typename DataType> bool operator!=(/*{{{*/
+		const OwnerBTreeContainer<DataType> &a,
+		const OwnerBTreeContainer<DataType> &b)
+{
+	return !a.isEqual(b);
+}/*}}}*/
+
+}
+
+#endif
@@ -32,11 +32,14 @@ public:
 
 public:
 	explicit OwnerContainer() OwnerContainerInitializer { }
+	explicit OwnerContainer(Arena & arena) : Container<DataType>(arena) { }
 	virtual ~OwnerContainer() { }
 
 private:
 	/**
-	 * Runtime:		O(n) + O(n_src * log(n_src))	<br/>
+	 * The copies are linked in the order of the original, without comparing.
+	 *
+	 * Runtime:		O(n) + O(n_src)	<br/>
 	 */
 	void copy(const OwnerContainer<DataType> & orig) /*{{{*/
 	{
@@ -45,13 +48,13 @@ private:
 			return;
 		}
 
-		Object<BinTree<DataType> > copy(NULL);
+		BinTreeGuard<DataType> copy(orig.size());
 
 		BinTree<DataType> *iter;
 		for(iter = orig.root->first(); iter != NULL; iter = iter->next()){
 			Object<DataType> cp(new DataType(*(iter->data)));
-			BinTree<DataType> * node = new OwnerBinTree<DataType>(cp.ptr);
-			node->insert(copy.ptr);
+			copy.add(new(Container<DataType>::nodePool())
+					OwnerBinTree<DataType>(cp.ptr));
 		}
 
 		/* Everything ok, lets clear the old content. */
@@ -61,7 +64,9 @@ private:
 		}
 
 		/* ... and set the new. */
-		Container<DataType>::root = copy.release();
+		Container<DataType>::root = BinTree<DataType>::build(
+				copy.nodes.data, copy.nodes.length);
+		copy.release();
 	}/*}}}*/
 
 public:
@@ -70,7 +75,10 @@ public:
 	 */
 	void add(DataType *& t) /* {{{ */
 	{
-		OwnerBinTree<DataType> * node = new OwnerBinTree<DataType>(t);
+		Arena * arena = Container<DataType>::arena;
+		OwnerBinTree<DataType> * node = arena ?
+			new(*arena) OwnerBinTree<DataType>(t) :
+			new(Container<DataType>::nodePool()) OwnerBinTree<DataType>(t);
 		node->insert(Container<DataType>::root);
 	}/*}}}*/
 
@@ -86,6 +94,51 @@ public:
 		add(o);
 	}
 
+	/**
+	 * Takes over the data of a sorted range of pointers, like a
+	 * PodArray<DataType *>, and sets its items to NULL. The new nodes are
+	 * merged with the existing ones and the tree is rebuilt at once, equal
+	 * keys are kept in the order of adding. Throws InvalidArgument for an
+	 * unsorted range. On error the range still owns its data.
+	 *
+	 * Runtime:		linear, O(n + m)			<br/>
+	 */
+	template <typename Range>
+	void addSorted(Range & range) /* {{{ */
+	{
+		unsigned m = 0;
+		const DataType * prev = NULL;
+		for(DataType * data : range){
+			if(prev && *data < *prev)
+				throw InvalidArgument("Item % of the range to add "
+						"is out of order.", m);
+			prev = data;
+			m++;
+		}
+		if(!m)
+			return;
+
+		Arena * arena = Container<DataType>::arena;
+		BinTreeGuard<DataType> nodes(m);
+		for(unsigned i = 0; i < m; i++){
+			DataType * none = NULL;
+			nodes.add(arena ?
+				new(*arena) OwnerBinTree<DataType>(none) :
+				new(Container<DataType>::nodePool())
+					OwnerBinTree<DataType>(none));
+		}
+		PodArray<BinTree<DataType> *> buffer(Container<DataType>::size() + m);
+
+		/* Nothing is allocated from here on. */
+		BinTree<DataType> ** node = nodes.nodes.data;
+		for(DataType *& data : range){
+			(*node++)->data = data;
+			data = NULL;
+		}
+		Container<DataType>::merge(nodes.nodes, buffer);
+		nodes.release();
+	}/*}}}*/
+
 };
 
 /**
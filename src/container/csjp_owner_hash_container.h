@@ -0,0 +1,131 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#ifndef OWNER_HASH_CONTAINER_H
+#define OWNER_HASH_CONTAINER_H
+
+#include <csjp_hash_container.h>
+
+namespace csjp {
+
+/**
+ * HashContainer owning its data, the same way as OwnerContainer does. Key
+ * lookups are constant time on average instead of O(log(n)), but there is no
+ * order and no positional access.
+ *
+ * Do not inherit from this class!
+ */
+template <typename DataType>
+class OwnerHashContainer : public HashContainer<DataType>
+{
+#define OwnerHashContainerInitializer : HashContainer<DataType>()
+public:
+	explicit OwnerHashContainer(const OwnerHashContainer & orig)
+		OwnerHashContainerInitializer { copy(orig); }
+	const OwnerHashContainer & operator=(const OwnerHashContainer &) = delete;
+
+	OwnerHashContainer(OwnerHashContainer && temp) :
+		HashContainer<DataType>(move_cast(temp))
+	{}
+
+	const OwnerHashContainer & operator=(OwnerHashContainer && temp)
+	{
+		clear();
+		HashContainer<DataType>::operator=(move_cast(temp));
+		return *this;
+	}
+
+public:
+	explicit OwnerHashContainer() OwnerHashContainerInitializer { }
+	/**
+	 * Runtime:		linear, O(n)				<br/>
+	 */
+	virtual ~OwnerHashContainer() { clear(); }
+
+private:
+	/**
+	 * Runtime:		O(n) on average				<br/>
+	 */
+	void copy(const OwnerHashContainer<DataType> & orig) /*{{{*/
+	{
+		/* Built aside, so the copies made are deleted on error. */
+		OwnerHashContainer<DataType> copy;
+		copy.reserve(orig.size());
+		for(auto & data : orig)
+			copy.add(new DataType(data));
+
+		/* Everything ok, lets take over the copies. */
+		*this = move_cast(copy);
+	}/*}}}*/
+
+public:
+	/**
+	 * On error the data is left with the caller.
+	 *
+	 * Runtime:		constant on average			<br/>
+	 */
+	void add(DataType *& t) /* {{{ */
+	{
+		HashContainer<DataType>::insert(t);
+		t = NULL;
+	}/*}}}*/
+
+	void add(Object<DataType> & odt)
+	{
+		add(odt.ptr);
+	}
+
+	/** Not 100% transactional. On error, the object pointed will be destructed! */
+	void add(DataType * && dt)
+	{
+		Object<DataType> o(dt);
+		add(o);
+	}
+
+	/**
+	 * Runtime:		constant on average			<br/>
+	 */
+	template <class TypeRemove>
+	void remove(const TypeRemove & tr)
+	{
+		delete HashContainer<DataType>::take(tr);
+	}
+
+	/**
+	 * The slots are kept for the next data.
+	 *
+	 * Runtime:		linear, O(n)				<br/>
+	 */
+	void clear() /*{{{*/
+	{
+		for(auto & data : *this)
+			delete &data;
+		HashContainer<DataType>::reset();
+	}/*}}}*/
+};
+
+/**
+ * Runtime:		O(n) on average				<br/>
+ */
+template <typename DataType> bool operator==(/*{{{*/
+		const OwnerHashContainer<DataType> &a,
+		const OwnerHashContainer<DataType> &b)
+{
+	return a.isEqual(b);
+}/*}}}*/
+
+/**
+ * Runtime:		O(n) on average				<br/>
+ */
+template <typename DataType> bool operator!=(/*{{{*/
+		const OwnerHashContainer<DataType> &a,
+		const OwnerHashContainer<DataType> &b)
+{
+	return !a.isEqual(b);
+}/*}}}*/
+
+}
+
+#endif
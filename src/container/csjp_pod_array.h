@@ -8,6 +8,8 @@
 
 #include <string.h>
 #include <csjp_string.h>
+#include <csjp_arena.h>
+#include <csjp_inline_storage.h>
 
 namespace csjp {
 
@@ -15,11 +17,15 @@ namespace csjp {
  * General array for old C types and structures.
  * Added data is copied, collected data is stored in one block.
  *
- * Uses libc alloc and free for the stored data.
+ * Uses libc alloc and free for the stored data, or the given arena.
+ * Moving an array moves its arena too.
+ *
+ * The first Inline elements are stored in the array object itself, so a
+ * PodArray<T, N> holding at most N elements does not allocate at all.
  */
 
-template <typename DataType>
-class PodArray
+template <typename DataType, unsigned Inline = 0>
+class PodArray : private InlineStorage<DataType, Inline>
 {
 public:
 	class iterator
@@ -35,14 +41,15 @@ public:
 	};
 
 #define PodArrayInitializer : \
-		cap(0), \
+		cap(Inline), \
 		len(0), \
-		val(NULL), \
+		val(this->inlineItems()), \
+		arena(NULL), \
 		capacity(cap), \
 		length(len), \
 		data(val)
 public:
-	explicit PodArray(const PodArray<DataType> & orig)
+	explicit PodArray(const PodArray<DataType, Inline> & orig)
 		PodArrayInitializer
 	{
 		setCapacity(orig.len);
@@ -50,34 +57,41 @@ public:
 		memcpy(val, orig.val, sizeof(DataType) * orig.length);
 		len = orig.len;
 	}
-	const PodArray & operator=(const PodArray<DataType> & orig) = delete;
+	const PodArray & operator=(const PodArray<DataType, Inline> & orig) = delete;
 
-	PodArray(PodArray<DataType> && temp) :
-		cap(temp.cap),
-		len(temp.len),
-		val(temp.val),
-		capacity(cap),
-		length(len),
-		data(val)
+	PodArray(PodArray<DataType, Inline> && temp)
+		PodArrayInitializer
 	{
-		temp.val = 0;
-		temp.len = 0;
-		temp.cap = 0;
+		takeOver(temp);
 	}
-	const PodArray & operator=(PodArray<DataType> && temp)
+	const PodArray & operator=(PodArray<DataType, Inline> && temp)
 	{
-		if(val)
+		if(val && !arena && !this->isInline(val))
 			free(val);
 
-		val= temp.val;
+		takeOver(temp);
+
+		return *this;
+	}
+
+private:
+	/* Inline elements can not be stolen, those are copied. */
+	void takeOver(PodArray<DataType, Inline> & temp)
+	{
 		len = temp.len;
 		cap = temp.cap;
-
-		temp.val = 0;
+		arena = temp.arena;
+		if(temp.isInline(temp.val)){
+			val = this->inlineItems();
+			memcpy(val, temp.val, sizeof(DataType) * (len + 1));
+		} else
+			val = temp.val;
+
+		temp.val = temp.inlineItems();
 		temp.len = 0;
-		temp.cap = 0;
-
-		return *this;
+		temp.cap = Inline;
+		if(temp.val)
+			memset(temp.val, 0, sizeof(DataType));
 	}
 
 public:
@@ -86,12 +100,15 @@ public:
 	/**
 	 * Runtime:		linear, O(n)	<br/>
 	 */
-	virtual ~PodArray() { if(val) free(val); }
+	virtual ~PodArray() { if(val && !arena && !this->isInline(val)) free(val); }
+
+	explicit PodArray(Arena & arena) PodArrayInitializer { this->arena = &arena; }
 
 private:
 	size_t cap; // capacity
 	size_t len;
 	DataType *val;
+	Arena * arena;
 	/*
 	 * Invariants:
 	 * - if val != NULL and points to valid area :
@@ -113,17 +130,42 @@ public:
 		setCapacity(s);
 	}
 
+	Arena * getArena() const { return arena; }
+
 	void setCapacity(size_t _cap)
 	{
-		DataType *dst = (DataType *)realloc(val, sizeof(DataType) * (_cap + 1));
+		if(_cap < len)
+			len = _cap;
+
+		if(Inline && _cap <= Inline){
+			if(!this->isInline(val)){
+				DataType * dst = this->inlineItems();
+				if(len)
+					memcpy(dst, val, sizeof(DataType) * len);
+				if(val && !arena)
+					free(val);
+				val = dst;
+			}
+			cap = Inline;
+			memset(val + len, 0, sizeof(DataType));
+			return;
+		}
+
+		DataType *src = this->isInline(val) ? NULL : val;
+		DataType *dst;
+		if(arena)
+			dst = (DataType *)arena->reallocate(src, sizeof(DataType) *
+					(src ? cap + 1 : 0), sizeof(DataType) * (_cap + 1));
+		else
+			dst = (DataType *)realloc(src, sizeof(DataType) * (_cap + 1));
 		if(!dst)
 			throw OutOfMemory("No enough memory for PodArray allocation with "
 					"% number of elements.", _cap);
+		if(src != val)
+			memcpy(dst, val, sizeof(DataType) * len);
 
 		cap = _cap;
 		val = dst;
-		if(_cap < len)
-			len = _cap;
 		memset(val + len, 0, sizeof(DataType));
 	}
 
@@ -226,9 +268,11 @@ public:
 	}
 
 	/**
+	 * Not virtual, so operator<() is needed only by the DataTypes compared.
+	 *
 	 * Runtime:		O(n) <br/>
 	 */
-	virtual int compare(const DataType &a, const DataType &b) const
+	int compare(const DataType &a, const DataType &b) const
 	{
 		if(a < b)
 			return -1;
@@ -424,7 +468,7 @@ public:
 	/**
 	 * Runtime:		constant	<br/>
 	 */
-	bool isEqual(const PodArray<DataType> &c) const
+	bool isEqual(const PodArray<DataType, Inline> &c) const
 	{
 		if(c.len != len)
 			return false;
@@ -443,7 +487,8 @@ public:
 /**
  * Runtime:		O(n)					<br/>
  */
-template <typename DataType> bool operator==(const PodArray<DataType> &a, const PodArray<DataType> &b)
+template <typename DataType, unsigned Inline>
+bool operator==(const PodArray<DataType, Inline> &a, const PodArray<DataType, Inline> &b)
 {
 	return a.isEqual(b);
 }
@@ -451,7 +496,8 @@ template <typename DataType> bool operator==(const PodArray<DataType> &a, const
 /**
  * Runtime:		O(n)					<br/>
  */
-template <typename DataType> bool operator!=(const PodArray<DataType> &a, const PodArray<DataType> &b)
+template <typename DataType, unsigned Inline>
+bool operator!=(const PodArray<DataType, Inline> &a, const PodArray<DataType, Inline> &b)
 {
 	return !a.isEqual(b);
 }
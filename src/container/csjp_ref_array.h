@@ -9,16 +9,20 @@
 #include <string.h>
 #include <csjp_object.h>
 #include <csjp_string.h>
+#include <csjp_inline_storage.h>
 
 namespace csjp {
 
 /**
  * Stores pointers as references to any type of data (C POD and C++ objects as well).
  * Does not care refernce counting, nor deleting on destruction or removal.
+ *
+ * The first Inline references are stored in the array object itself, handy
+ * for short lived stacks of a few references.
  */
 
-template <typename DataType>
-class RefArray
+template <typename DataType, unsigned Inline = 0>
+class RefArray : private InlineStorage<DataType *, Inline>
 {
 public:
 	class iterator
@@ -34,13 +38,13 @@ public:
 	};
 
 #define RefArrayInitializer : \
-		cap(0), \
+		cap(Inline), \
 		len(0), \
-		val(NULL), \
+		val(this->inlineItems()), \
 		capacity(cap), \
 		length(len)
 public:
-	explicit RefArray(const RefArray<DataType> & orig)
+	explicit RefArray(const RefArray<DataType, Inline> & orig)
 		RefArrayInitializer
 	{
 		setCapacity(orig.len);
@@ -51,33 +55,40 @@ public:
 			add(**iter);
 		val[len] = 0;
 	}
-	const RefArray & operator=(const RefArray<DataType> & orig) = delete;
+	const RefArray & operator=(const RefArray<DataType, Inline> & orig) = delete;
 
-	RefArray(RefArray<DataType> && temp) :
-		cap(temp.cap),
-		len(temp.len),
-		val(temp.val),
-		capacity(cap),
-		length(len)
+	RefArray(RefArray<DataType, Inline> && temp)
+		RefArrayInitializer
 	{
-		temp.val = 0;
-		temp.len = 0;
-		temp.cap = 0;
+		takeOver(temp);
 	}
-	const RefArray & operator=(RefArray<DataType> && temp)
+	const RefArray & operator=(RefArray<DataType, Inline> && temp)
 	{
-		if(val)
+		if(val && !this->isInline(val))
 			free(val);
 
-		val= temp.val;
+		takeOver(temp);
+
+		return *this;
+	}
+
+private:
+	/* Inline references can not be stolen, those are copied. */
+	void takeOver(RefArray<DataType, Inline> & temp)
+	{
 		len = temp.len;
 		cap = temp.cap;
+		if(temp.isInline(temp.val)){
+			val = this->inlineItems();
+			memcpy(val, temp.val, sizeof(DataType*) * (len + 1));
+		} else
+			val = temp.val;
 
-		temp.val = 0;
+		temp.val = temp.inlineItems();
 		temp.len = 0;
-		temp.cap = 0;
-
-		return *this;
+		temp.cap = Inline;
+		if(temp.val)
+			temp.val[0] = 0;
 	}
 
 public:
@@ -88,7 +99,7 @@ public:
 	 */
 	virtual ~RefArray()
 	{
-		if(val)
+		if(val && !this->isInline(val))
 			free(val);
 	}
 
@@ -118,15 +129,32 @@ public:
 
 	void setCapacity(size_t _cap)
 	{
-		DataType **dst = (DataType **)realloc(val, sizeof(DataType*) * (_cap + 1));
+		if(_cap < len)
+			len = _cap;
+
+		if(Inline && _cap <= Inline){
+			if(!this->isInline(val)){
+				DataType **dst = this->inlineItems();
+				if(len)
+					memcpy(dst, val, sizeof(DataType*) * len);
+				free(val);
+				val = dst;
+			}
+			cap = Inline;
+			val[len] = 0;
+			return;
+		}
+
+		DataType **src = this->isInline(val) ? NULL : val;
+		DataType **dst = (DataType **)realloc(src, sizeof(DataType*) * (_cap + 1));
 		if(!dst)
 			throw OutOfMemory("No enough memory for RefArray allocation with "
 					"% number of elements.", _cap);
+		if(src != val)
+			memcpy(dst, val, sizeof(DataType*) * len);
 
 		cap = _cap;
 		val = dst;
-		if(_cap < len)
-			len = _cap;
 		val[len] = 0;
 	}
 
@@ -391,7 +419,7 @@ public:
 	/**
 	 * Runtime:		constant	<br/>
 	 */
-	bool isEqual(const RefArray<DataType> &c) const
+	bool isEqual(const RefArray<DataType, Inline> &c) const
 	{
 		if(c.len != len)
 			return false;
@@ -410,7 +438,8 @@ public:
 /**
  * Runtime:		O(n)					<br/>
  */
-template <typename DataType> bool operator==(const RefArray<DataType> &a, const RefArray<DataType> &b)
+template <typename DataType, unsigned Inline>
+bool operator==(const RefArray<DataType, Inline> &a, const RefArray<DataType, Inline> &b)
 {
 	return a.isEqual(b);
 }
@@ -418,7 +447,8 @@ template <typename DataType> bool operator==(const RefArray<DataType> &a, const
 /**
  * Runtime:		O(n)					<br/>
  */
-template <typename DataType> bool operator!=(const RefArray<DataType> &a, const RefArray<DataType> &b)
+template <typename DataType, unsigned Inline>
+bool operator!=(const RefArray<DataType, Inline> &a, const RefArray<DataType, Inline> &b)
 {
 	return !a.isEqual(b);
 }
@@ -31,6 +31,7 @@ public:
 
 public:
 	explicit ReferenceContainer() : Container<DataType>(){}
+	explicit ReferenceContainer(Arena & arena) : Container<DataType>(arena){}
 	virtual ~ReferenceContainer(){}
 
 private:
@@ -48,7 +49,8 @@ private:
 
 		BinTree<DataType> *iter;
 		for(iter = orig.root->first(); iter != NULL; iter = iter->next()){
-			BinTree<DataType> *node = new BinTree<DataType>();
+			BinTree<DataType> *node =
+				new(Container<DataType>::nodePool()) BinTree<DataType>();
 			node->data = const_cast<DataType*>(iter->data);
 			node->insert(copy.ptr);
 		}
@@ -69,7 +71,10 @@ public:
 	 */
 	void add(DataType & t) /* {{{ */
 	{
-		BinTree<DataType> * node = new BinTree<DataType>();
+		Arena * arena = Container<DataType>::arena;
+		BinTree<DataType> * node = arena ?
+			new(*arena) BinTree<DataType>() :
+			new(Container<DataType>::nodePool()) BinTree<DataType>();
 		node->data = &t;
 		node->insert(Container<DataType>::root);
 	}/*}}}*/
@@ -18,7 +18,7 @@ template <typename DataType> class CustomBox;
 template <typename Type> bool operator<(const Type &a, const Type &b) { return &a < &b; }
 
 template <typename DataType>
-class PrimaryBox
+class PrimaryBox : public ArenaObject
 {
 /**
  * Do not inherit from this class! Actually, it is best if you are not using this class at all.
@@ -109,7 +109,7 @@ template <typename DataType> bool operator!=(/*{{{*/
 }/*}}}*/
 
 template <typename DataType>
-class CustomBox
+class CustomBox : public ArenaObject
 {
 /**
  * Do not inherit from this class! Actually, it is best if you are not using this class at all.
@@ -195,7 +195,8 @@ public:
 
 #define SorterContainerInitializer : \
 		root(NULL), \
-		custom(NULL)
+		custom(NULL), \
+		pool(NULL)
 public:
 	explicit SorterContainer(const SorterContainer<DataType> & orig)
 		SorterContainerInitializer { copy(orig); }
@@ -203,21 +204,26 @@ public:
 
 	SorterContainer(SorterContainer<DataType> && temp) :
 		root(temp.root),
-		custom(temp.custom)
+		custom(temp.custom),
+		pool(temp.pool)
 	{
 		temp.root = 0;
 		temp.custom = 0;
+		temp.pool = 0;
 	}
 
 	const SorterContainer & operator=(SorterContainer<DataType> && temp)
 	{
 		clear();
+		delete pool;
 
 		root = temp.root;
 		custom = temp.custom;
+		pool = temp.pool;
 
 		temp.root = 0;
 		temp.custom = 0;
+		temp.pool = 0;
 
 		return *this;
 	}
@@ -228,10 +234,13 @@ public:
 	/**
 	 * Runtime:		linear, O(n)				<br/>
 	 */
-	virtual ~SorterContainer() { clear(); }
+	virtual ~SorterContainer() { clear(); delete pool; }
 
 private:
 	/**
+	 * Both trees are linked in the order of the original, without comparing.
+	 * The custom position of a copy is the index of the original.
+	 *
 	 * Runtime:		O(n) + O(n_src * log(n_src))	<br/>
 	 */
 	void copy(const SorterContainer<DataType> & orig) /*{{{*/
@@ -241,8 +250,11 @@ private:
 			return;
 		}
 
-		Object<BinTree< PrimaryBox<DataType> > > newRoot(NULL);
-		Object<BinTree< CustomBox<DataType> > > newCustom(NULL);
+		unsigned n = orig.size();
+		BinTreeGuard< PrimaryBox<DataType> > primaries(n);
+		BinTreeGuard< CustomBox<DataType> > customs(n);
+		for(unsigned i = 0; i < n; i++)
+			customs.add(NULL);
 
 		Object<DataType> dataObj(NULL);
 
@@ -256,15 +268,17 @@ private:
 				data = iter->data->data;
 
 			Object<CustomBox<DataType> > customBox(
-					new CustomBox<DataType>(*this, data,
+					new(nodePool()) CustomBox<DataType>(*this, data,
 							iter->data->custom->data->order));
 			Object<OwnerBinTree< CustomBox<DataType> > > customNode(
-					new OwnerBinTree< CustomBox<DataType> >(customBox.ptr));
+					new(nodePool()) OwnerBinTree< CustomBox<DataType> >(
+						customBox.ptr));
 
 			Object<PrimaryBox<DataType> > primaryBox(
-					new PrimaryBox<DataType>(data));
+					new(nodePool()) PrimaryBox<DataType>(data));
 			Object<OwnerBinTree< PrimaryBox<DataType> > > primaryNode(
-					new OwnerBinTree< PrimaryBox<DataType> >(primaryBox.ptr));
+					new(nodePool()) OwnerBinTree< PrimaryBox<DataType> >(
+						primaryBox.ptr));
 
 			primaryNode->data->custom = customNode.ptr;
 			customNode->data->primary = primaryNode.ptr;
@@ -273,10 +287,9 @@ private:
 			primaryNode->data->owner = iter->data->owner;
 			dataObj.ptr = NULL;
 
-			primaryNode->insert(newRoot.ptr);
-			primaryNode.ptr = NULL;
-			customNode->insert(newCustom.ptr);
-			customNode.ptr = NULL;
+			primaries.add(primaryNode.release());
+			customs.nodes.data[iter->data->custom->index()] =
+				customNode.release();
 		}
 		/* No exception should occur from here. */
 
@@ -288,13 +301,31 @@ private:
 			delete root;
 		}
 
-		root = newRoot.release();
-		custom = newCustom.release();
+		root = BinTree< PrimaryBox<DataType> >::build(primaries.nodes.data, n);
+		custom = BinTree< CustomBox<DataType> >::build(customs.nodes.data, n);
+		primaries.release();
+		customs.release();
 	}/*}}}*/
 
 protected:
+	/** The nodes of both trees and their boxes are allocated from a pool of
+	 * the container, created at the first use. */
+	Pool & nodePool()
+	{
+		if(!pool){
+			size_t size = sizeof(OwnerBinTree< PrimaryBox<DataType> >);
+			if(size < sizeof(PrimaryBox<DataType>))
+				size = sizeof(PrimaryBox<DataType>);
+			if(size < sizeof(CustomBox<DataType>))
+				size = sizeof(CustomBox<DataType>);
+			pool = new Pool(ArenaObject::header + size);
+		}
+		return *pool;
+	}
+
 	BinTree< PrimaryBox<DataType> > *root;
 	BinTree< CustomBox<DataType> > *custom;
+	Pool * pool;
 	/* FIXME : before overflow, lets reassign order values from zero again. */
 	static long long unsigned lastOrder;
 
@@ -318,42 +349,29 @@ public:
 	}
 
 	/**
-	 * Runtime:		O(n) + 2 * O(n * log n)	<br/>
+	 * The custom nodes are taken in the primary order, stable merge sorted
+	 * and relinked, nothing is allocated but two arrays of pointers. When
+	 * compare() agrees with the primary order, only n comparisons are done.
+	 *
+	 * Runtime:		O(n * log n), linear for sorted nodes	<br/>
 	 */
 	void sort() /*{{{*/
 	{
 		if(root == NULL)
 			return;
 
-		Object<BinTree< CustomBox<DataType> > > newCustom(NULL);
+		unsigned n = size();
+		PodArray<BinTree< CustomBox<DataType> > *> nodes(n);
+		PodArray<BinTree< CustomBox<DataType> > *> buffer(n);
 
 		BinTree< PrimaryBox<DataType> > *iter;
-		for(iter = root->first(); iter != NULL; iter = iter->next()){
-			Object<CustomBox<DataType> > customBox(
-					new CustomBox<DataType>(*this, iter->data->data,
-							iter->data->custom->data->order));
-			Object<OwnerBinTree< CustomBox<DataType> > > customNode(
-					new OwnerBinTree< CustomBox<DataType> >(customBox.ptr));
-
-			customNode->data->primary = iter;
+		for(iter = root->first(); iter != NULL; iter = iter->next())
+			nodes.add(iter->data->custom);
+		/* From here, only a failing compare() can throw, leaving the tree
+		 * untouched. */
 
-			customNode->insert(newCustom.ptr);
-			customNode.ptr = NULL;
-		}
-		/* From here, no exception should happen. */
-
-		/* Update primary nodes to point to new custom ones. */
-		BinTree< CustomBox<DataType> > *citer;
-		for(citer = newCustom->first(); citer != NULL; citer = citer->next())
-			root->query( *(citer->data->data) )->data->custom = citer;
-
-		/* Everything ok, lets clear the old content. */
-		if(custom){
-			custom->clear();
-			delete custom;
-		}
-
-		custom = newCustom.release();
+		BinTree< CustomBox<DataType> >::sort(nodes.data, n, buffer.data);
+		custom = BinTree< CustomBox<DataType> >::build(nodes.data, n);
 	}/*}}}*/
 
 	/**
@@ -400,6 +418,9 @@ public:
 	}/*}}}*/
 
 	/**
+	 * The nodes and boxes are only destructed and their pool is recycled at
+	 * once, keeping its memory up to Pool::maxKeptBlocks blocks.
+	 *
 	 * Runtime:		linear, O(n)				<br/>
 	 */
 	void clear()/*{{{*/
@@ -407,12 +428,11 @@ public:
 		if(!root)
 			return;
 
-		custom->clear();
-		delete custom;
+		custom->destruct();
 		custom = NULL;
-		root->clear();
-		delete root;
+		root->destruct();
 		root = NULL;
+		pool->recycle();
 	}/*}}}*/
 
 	/**
@@ -41,14 +41,16 @@ public:
 	void add(DataType *& t) /* {{{ */
 	{
 		Object<CustomBox<DataType> > customBox(
-				new CustomBox<DataType>(*this, t, this->lastOrder + 1));
+				new(this->nodePool()) CustomBox<DataType>(*this, t, this->lastOrder + 1));
 		Object<OwnerBinTree< CustomBox<DataType> > > customNode(
-				new OwnerBinTree< CustomBox<DataType> >(customBox.ptr));
+				new(this->nodePool()) OwnerBinTree< CustomBox<DataType> >(
+					customBox.ptr));
 
 		Object<PrimaryBox<DataType> > primaryBox(
-				new PrimaryBox<DataType>(t));
+				new(this->nodePool()) PrimaryBox<DataType>(t));
 		Object<OwnerBinTree< PrimaryBox<DataType> > > primaryNode(
-				new OwnerBinTree< PrimaryBox<DataType> >(primaryBox.ptr));
+				new(this->nodePool()) OwnerBinTree< PrimaryBox<DataType> >(
+					primaryBox.ptr));
 
 		primaryNode->data->owner = true;
 		t = NULL;
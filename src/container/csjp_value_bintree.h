@@ -7,6 +7,7 @@
 #define VALUE_BINTREE_H
 
 #include <csjp_string.h>
+#include <csjp_arena.h>
 
 namespace csjp {
 
@@ -33,7 +34,7 @@ namespace csjp {
  */
 
 template <typename DataType>
-class ValueBinTree
+class ValueBinTree : public ArenaObject
 {
 public:
 	explicit ValueBinTree(const ValueBinTree<DataType> &) = delete;
@@ -493,6 +494,23 @@ public:
 		size = 1;
 	}/*}}}*/
 
+	/**
+	 * Destructs the subtree without giving back the memory of the nodes, for
+	 * containers resetting the pool of their nodes afterwards.
+	 *
+	 * Runtime:		linear, O(n)				<br/>
+	 */
+	void destruct()   /*{{{*/
+	{
+		if(left != NULL)
+			left->destruct();
+		if(right != NULL)
+			right->destruct();
+		left = NULL;
+		right = NULL;
+		this->~ValueBinTree();
+	}/*}}}*/
+
 	/**
 	 * Runtime:		O(log(n))				<br/>
 	 */
@@ -27,23 +27,29 @@ public:
 	};
 
 #define ValueContainerInitializer : \
-	root(0)
+	root(0), \
+	pool(0)
 public:
 	explicit ValueContainer(const ValueContainer & orig) ValueContainerInitializer { }
 	const ValueContainer & operator=(const ValueContainer &) = delete;
 
 	ValueContainer(ValueContainer && temp) :
-		root(temp.root)
+		root(temp.root),
+		pool(temp.pool)
 	{
 		temp.root = 0;
+		temp.pool = 0;
 	}
 
 	const ValueContainer & operator=(ValueContainer && temp)
 	{
 		clear();
+		delete pool;
 
 		root = temp.root;
 		temp.root = 0;
+		pool = temp.pool;
+		temp.pool = 0;
 
 		return *this;
 	}
@@ -53,10 +59,20 @@ public:
 	/**
 	 * Runtime:		linear, O(n)				<br/>
 	 */
-	virtual ~ValueContainer() { clear(); }
+	virtual ~ValueContainer() { clear(); delete pool; }
 
 protected:
+	/** The nodes are allocated from a pool of the container, created at the
+	 * first use. */
+	Pool & nodePool()
+	{
+		if(!pool)
+			pool = new Pool(ArenaObject::header + sizeof(ValueBinTree<DataType>));
+		return *pool;
+	}
+
 	ValueBinTree<DataType> *root;
+	Pool * pool;
 
 public:
 	const iterator begin() const {
@@ -110,6 +126,9 @@ public:
 	}/*}}}*/
 
 	/**
+	 * The nodes are only destructed and their pool is recycled at once,
+	 * keeping its memory up to Pool::maxKeptBlocks nodes.
+	 *
 	 * Runtime:		linear, O(n)				<br/>
 	 */
 	void clear()/*{{{*/
@@ -117,9 +136,9 @@ public:
 		if(!root)
 			return;
 
-		root->clear();
-		delete root;
+		root->destruct();
 		root = NULL;
+		pool->recycle();
 	}/*}}}*/
 
 	/**
@@ -289,7 +308,8 @@ public:
 	 */
 	void add(DataType & t) /* {{{ */
 	{
-		ValueBinTree<DataType> * node = new ValueBinTree<DataType>(t);
+		ValueBinTree<DataType> * node =
+			new(nodePool()) ValueBinTree<DataType>(t);
 		node->insert(ValueContainer<DataType>::root);
 	}/*}}}*/
 };
@@ -7,12 +7,15 @@
 #include <csjp_object.h>
 #include <csjp_test.h>
 
+TEST_COUNT_ALLOCATIONS
+
 class TestArray
 {
 public:
 	void empty();
 	void singleNode();
 	void manyOrderedNodes();
+	void inlineStorage();
 };
 
 void TestArray::empty()
@@ -159,6 +162,55 @@ void TestArray::manyOrderedNodes()
 	VERIFY(c3.empty() == true);
 }
 
+void TestArray::inlineStorage()
+{
+	csjp::Array<char, 4> a;
+
+	TESTSTEP("Small array allocates the objects only");
+	VERIFY(a.capacity == 4);
+	for(char c = 'a'; c < 'e'; c++){
+		csjp::Object<char> ch(new char(c));
+		NOALLOC_VERIFY(a.add(ch));
+	}
+	char c = 'a';
+	for(auto & ch : a)
+		VERIFY(ch == c++);
+	VERIFY(c == 'e');
+
+	TESTSTEP("Moving copies the inline pointers");
+	csjp::Array<char, 4> b(csjp::move_cast(a));
+	VERIFY(a.empty());
+	VERIFY(a.capacity == 4);
+	VERIFY(b.size() == 4);
+	VERIFY(b[3] == 'd');
+
+	TESTSTEP("Growing moves the pointers to the heap");
+	b.add('e');
+	VERIFY(4 < b.capacity);
+	for(unsigned i = 0; i < 5; i++)
+		VERIFY(b[i] == char('a' + i));
+
+	TESTSTEP("Moving a grown array takes over the objects");
+	a.add('x');
+	a = csjp::move_cast(b);
+	VERIFY(b.empty());
+	VERIFY(a.size() == 5);
+	VERIFY(a.last() == 'e');
+
+	TESTSTEP("Shrinking moves the pointers back");
+	csjp::Object<char> last = a.pop();
+	a.setCapacity(4);
+	VERIFY(a.capacity == 4);
+	csjp::Array<char, 4> d(csjp::move_cast(a));
+	VERIFY(d.size() == 4);
+	VERIFY(d.first() == 'a');
+	VERIFY(d.last() == 'd');
+
+	TESTSTEP("Copy constructing");
+	csjp::Array<char, 4> e(d);
+	VERIFY(e == d);
+	VERIFY(&e[0] != &d[0]);
+}
 
 TEST_INIT(Array)
 
@@ -168,4 +220,6 @@ TEST_INIT(Array)
 
 	TEST_RUN(manyOrderedNodes);
 
+	TEST_RUN(inlineStorage);
+
 TEST_FINISH(Array)
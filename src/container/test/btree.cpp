@@ -0,0 +1,240 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#include <stdlib.h>
+
+#include <csjp_owner_btree_container.h>
+#include <csjp_owner_container.h>
+#include <csjp_test.h>
+
+class Number
+{
+public:
+	static int alive;
+	static unsigned copiesLeft; // copying fails after these many if not 0
+
+	Number(unsigned key, unsigned serial = 0) : key(key), serial(serial)
+			{ alive++; }
+	Number(const Number & orig) : key(orig.key), serial(orig.serial)
+	{
+		if(copiesLeft && !--copiesLeft)
+			throw csjp::OutOfMemory("Copy failed.");
+		alive++;
+	}
+	~Number() { alive--; }
+
+	unsigned key;
+	unsigned serial; /* insertion order among the equal keys */
+};
+int Number::alive = 0;
+unsigned Number::copiesLeft = 0;
+
+bool operator<(const Number & a, const Number & b) { return a.key < b.key; }
+bool operator<(const Number & a, unsigned b) { return a.key < b; }
+bool operator<(unsigned a, const Number & b) { return a < b.key; }
+bool operator==(const Number & a, const Number & b)
+		{ return a.key == b.key && a.serial == b.serial; }
+bool operator!=(const Number & a, const Number & b) { return !(a == b); }
+
+class TestBTree
+{
+public:
+	void empty();
+	void ordered();
+	void reversed();
+	void equalKeys();
+	void randomAgainstBinTree();
+	void copyAndMove();
+};
+
+void TestBTree::empty()
+{
+	csjp::OwnerBTreeContainer<Number> c1, c2;
+
+	VERIFY(c1.size() == 0);
+	VERIFY(c1.empty());
+	VERIFY(c1 == c2);
+	VERIFY(!c1.has(5u));
+	VERIFY(!(c1.begin() != c1.end()));
+	EXC_VERIFY(c1.queryAt(0), csjp::IndexOutOfRange);
+	EXC_VERIFY(c1.query(5u), csjp::ObjectNotFound);
+	EXC_VERIFY(c1.removeAt(0), csjp::IndexOutOfRange);
+	IN_SAFEMODE(c1.validity());
+}
+
+void TestBTree::ordered()
+{
+	const unsigned count = 10000;
+	csjp::OwnerBTreeContainer<Number> c;
+
+	TESTSTEP("Growing in order splits the last leaves");
+	for(unsigned i = 0; i < count; i++){
+		c.add(new Number(i));
+		if(i % 97 == 0)
+			IN_SAFEMODE(c.validity());
+	}
+	IN_SAFEMODE(c.validity());
+	VERIFY(c.size() == count);
+	for(unsigned i = 0; i < count; i++){
+		VERIFY(c.queryAt(i).key == i);
+		VERIFY(c.index(i) == i);
+		VERIFY(c.query(i).key == i);
+	}
+	VERIFY(!c.has(count));
+	VERIFY(c.last().key == count - 1);
+
+	TESTSTEP("Iteration is in order");
+	unsigned i = 0;
+	for(auto & n : c)
+		VERIFY(n.key == i++);
+	VERIFY(i == count);
+
+	TESTSTEP("Removing from the front merges and borrows");
+	for(unsigned i = 0; i < count / 2; i++){
+		c.removeAt(0);
+		if(i % 97 == 0)
+			IN_SAFEMODE(c.validity());
+	}
+	IN_SAFEMODE(c.validity());
+	VERIFY(c.queryAt(0).key == count / 2);
+
+	TESTSTEP("Removing by key");
+	for(unsigned i = count / 2; i < count; i += 2)
+		c.remove(i);
+	IN_SAFEMODE(c.validity());
+	VERIFY(c.size() == count / 4);
+	EXC_VERIFY(c.remove(count / 2), csjp::ObjectNotFound);
+
+	c.clear();
+	VERIFY(c.empty());
+	VERIFY(Number::alive == 0);
+}
+
+void TestBTree::reversed()
+{
+	const unsigned count = 10000;
+	csjp::OwnerBTreeContainer<Number> c;
+
+	TESTSTEP("Growing in reverse order splits the first leaves");
+	for(unsigned i = count; i; i--)
+		c.add(new Number(i));
+	IN_SAFEMODE(c.validity());
+	for(unsigned i = 0; i < count; i++)
+		VERIFY(c.queryAt(i).key == i + 1);
+
+	TESTSTEP("Removing from the back");
+	while(c.size())
+		c.removeAt(c.size() - 1);
+	IN_SAFEMODE(c.validity());
+	VERIFY(Number::alive == 0);
+}
+
+void TestBTree::equalKeys()
+{
+	const unsigned keys = 10;
+	const unsigned copies = 200;
+	csjp::OwnerBTreeContainer<Number> c;
+
+	TESTSTEP("Equal keys keep the order of insertion");
+	for(unsigned s = 0; s < copies; s++)
+		for(unsigned k = 0; k < keys; k++)
+			c.add(new Number(k, s));
+	IN_SAFEMODE(c.validity());
+	for(unsigned i = 0; i < c.size(); i++){
+		VERIFY(c.queryAt(i).key == i / copies);
+		VERIFY(c.queryAt(i).serial == i % copies);
+	}
+
+	TESTSTEP("Lookups find the first one of the equal keys");
+	for(unsigned k = 0; k < keys; k++){
+		VERIFY(c.index(k) == k * copies);
+		VERIFY(c.query(k).serial == 0);
+	}
+
+	TESTSTEP("Removing by key takes the first one");
+	for(unsigned s = 0; s < copies; s++){
+		c.remove(3u);
+		if(s + 1 < copies)
+			VERIFY(c.query(3u).serial == s + 1);
+	}
+	VERIFY(!c.has(3u));
+	IN_SAFEMODE(c.validity());
+	VERIFY(c.index(4u) == 3 * copies);
+}
+
+void TestBTree::randomAgainstBinTree()
+{
+	const unsigned rounds = 20000;
+	csjp::OwnerBTreeContainer<Number> btree;
+	csjp::OwnerContainer<Number> bintree;
+
+	TESTSTEP("Random adds and removes behave as in the BinTree");
+	srand(1);
+	for(unsigned r = 0; r < rounds; r++){
+		unsigned op = rand() % 3;
+		if(op < 2 || !bintree.size()){
+			unsigned key = rand() % 5000;
+			btree.add(new Number(key, r));
+			bintree.add(new Number(key, r));
+		} else {
+			unsigned i = rand() % bintree.size();
+			btree.removeAt(i);
+			bintree.removeAt(i);
+		}
+		if(r % 1000 == 0)
+			IN_SAFEMODE(btree.validity());
+	}
+	IN_SAFEMODE(btree.validity());
+	VERIFY(btree.size() == bintree.size());
+	for(unsigned i = 0; i < btree.size(); i++)
+		VERIFY(btree.queryAt(i) == bintree.queryAt(i));
+	for(unsigned k = 0; k < 5000; k += 7){
+		VERIFY(btree.has(k) == bintree.has(k));
+		if(bintree.has(k))
+			VERIFY(btree.query(k).key == k);
+	}
+}
+
+void TestBTree::copyAndMove()
+{
+	csjp::OwnerBTreeContainer<Number> c1;
+	for(unsigned i = 0; i < 1000; i++)
+		c1.add(new Number((i * 7919) % 1000));
+
+	TESTSTEP("Copy constructing copies the data");
+	csjp::OwnerBTreeContainer<Number> c2(c1);
+	IN_SAFEMODE(c2.validity());
+	VERIFY(c1 == c2);
+	VERIFY(Number::alive == 2000);
+
+	TESTSTEP("Moving takes over the tree");
+	csjp::OwnerBTreeContainer<Number> c3(csjp::move_cast(c2));
+	VERIFY(c2.empty());
+	VERIFY(c1 == c3);
+	c2 = csjp::move_cast(c3);
+	VERIFY(c3.empty());
+	VERIFY(c1 == c2);
+	VERIFY(c1 != c3);
+
+	TESTSTEP("Failing copy construction leaves no copies behind");
+	Number::copiesLeft = 500;
+	EXC_VERIFY(csjp::OwnerBTreeContainer<Number> c4(c1), csjp::OutOfMemory);
+	VERIFY(Number::copiesLeft == 0);
+	VERIFY(Number::alive == 2000);
+	c1.clear();
+	c2.clear();
+	VERIFY(Number::alive == 0);
+}
+
+TEST_INIT(BTree)
+
+	TEST_RUN(empty);
+	TEST_RUN(ordered);
+	TEST_RUN(reversed);
+	TEST_RUN(equalKeys);
+	TEST_RUN(randomAgainstBinTree);
+	TEST_RUN(copyAndMove);
+
+TEST_FINISH(BTree)
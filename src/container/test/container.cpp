@@ -4,6 +4,7 @@
  */
 
 #include <csjp_owner_container.h>
+#include <csjp_pod_array.h>
 #include <csjp_test.h>
 
 class Char
@@ -106,6 +107,7 @@ public:
 	void manyUnorderedNodes();
 	void specialCase1();
 	void specialCaseForDoubleUnbalancedness();
+	void addSorted();
 };
 
 void TestOwnerContainer::empty()
@@ -443,6 +445,51 @@ void TestOwnerContainer::specialCaseForDoubleUnbalancedness()
 	IN_SAFEMODE(cont.validity());
 }
 
+void TestOwnerContainer::addSorted()
+{
+	Char::resetLeakCount();
+	{
+		csjp::OwnerContainer<Char> cont;
+		csjp::PodArray<Char *> range;
+
+		TESTSTEP("Adding a sorted range to an empty container");
+		for(unsigned char c = 'a'; c <= 'z'; c += 2)
+			range.add(new Char(c));
+		cont.addSorted(range);
+		IN_SAFEMODE(cont.validity());
+		VERIFY(cont.size() == 13);
+		for(auto data : range)
+			VERIFY(data == NULL);
+
+		TESTSTEP("Merging a sorted range with the content");
+		range.clear();
+		for(unsigned char c = 'b'; c <= 'z'; c += 2)
+			range.add(new Char(c));
+		cont.addSorted(range);
+		IN_SAFEMODE(cont.validity());
+		VERIFY(cont.size() == 'z' - 'a' + 1);
+		for(unsigned char c = 'a'; c <= 'z'; c++){
+			VERIFY(cont.queryAt(c - 'a') == Char(c));
+			VERIFY(cont.index(Char(c)) == (unsigned)(c - 'a'));
+		}
+
+		TESTSTEP("Unsorted range is refused and kept");
+		range.clear();
+		range.add(new Char('1'));
+		range.add(new Char('0'));
+		EXC_VERIFY(cont.addSorted(range), csjp::InvalidArgument);
+		VERIFY(cont.size() == 'z' - 'a' + 1);
+		for(auto data : range)
+			delete data;
+
+		TESTSTEP("Copy constructing links the copies in order");
+		csjp::OwnerContainer<Char> copy(cont);
+		IN_SAFEMODE(copy.validity());
+		VERIFY(copy == cont);
+	}
+	VERIFY(Char::leakFree());
+}
+
 TEST_INIT(OwnerContainer)
 
 	TEST_RUN(empty);
@@ -457,4 +504,6 @@ TEST_INIT(OwnerContainer)
 
 	TEST_RUN(specialCaseForDoubleUnbalancedness);
 
+	TEST_RUN(addSorted);
+
 TEST_FINISH(OwnerContainer)
@@ -17,6 +17,8 @@
 #include <csjp_exception.h>
 #include <csjp_pod_array.h>
 #include <csjp_owner_container.h>
+#include <csjp_owner_btree_container.h>
+#include <csjp_owner_hash_container.h>
 #include <csjp_sorter_owner_container.h>
 #include <csjp_file.h>
 #include <csjp_stopper.h>
@@ -45,6 +47,11 @@ DataStruct newDataStruct(unsigned u)
 	return d;
 }
 
+bool operator<(const DataStruct & a, const DataStruct & b)
+{
+	return a.data < b.data;
+}
+
 class Data
 {
 public:
@@ -147,12 +154,17 @@ bool operator==(const Data &a, const Data &b)
 {
 	return a.isEqual(b);
 }
-/*
+
 bool operator==(const Data &a, const unsigned int &b)
 {
 	return a.isEqual(b);
 }
-*/
+
+size_t hash(const Data &d)
+{
+	return csjp::hash(d.data);
+}
+
 class DataContainer : public csjp::SorterOwnerContainer<Data>
 {
 public:
@@ -188,6 +200,7 @@ private:
 	csjp::File addElementsPlotFile;
 	csjp::File reverseSortingPlotFile;
 	csjp::File sameSortingPlotFile;
+	csjp::File copyElementsPlotFile;
 	csjp::File lookupByIndexPlotFile;
 	csjp::File lookupByKeyPlotFile;
 	csjp::File removeElementsPlotFile;
@@ -201,6 +214,8 @@ private:
 	csjp::PodArray<DataStruct> podArray;
 	csjp::OwnerContainer<Data> container;
 	DataContainer sorterContainer;
+	csjp::OwnerBTreeContainer<Data> btreeContainer;
+	csjp::OwnerHashContainer<Data> hashContainer;
 
 public:
 	SpeedTest() = delete;
@@ -213,6 +228,7 @@ public:
 	void addRemoveTest(unsigned numOfTestItems);
 	void reverseSorting(unsigned numOfTestItems);
 	void sameOrderSorting(unsigned numOfTestItems);
+	void copyElements(unsigned numOfTestItems);
 	void lookupByIndex(unsigned numOfTestItems);
 	void lookupByKey(unsigned numOfTestItems);
 };
@@ -222,6 +238,7 @@ SpeedTest::SpeedTest(unsigned repeats) :
 	addElementsPlotFile("container-speed-test-add-elements.data"),
 	reverseSortingPlotFile("container-speed-test-reverse-sorting.data"),
 	sameSortingPlotFile("container-speed-test-same-sorting.data"),
+	copyElementsPlotFile("container-speed-test-copy-elements.data"),
 	lookupByIndexPlotFile("container-speed-test-lookup-by-index.data"),
 	lookupByKeyPlotFile("container-speed-test-lookup-by-key.data"),
 	removeElementsPlotFile("container-speed-test-remove-elements.data")
@@ -232,6 +249,8 @@ SpeedTest::SpeedTest(unsigned repeats) :
 		reverseSortingPlotFile.resize(0);
 	if(sameSortingPlotFile.exists())
 		sameSortingPlotFile.resize(0);
+	if(copyElementsPlotFile.exists())
+		copyElementsPlotFile.resize(0);
 	if(lookupByIndexPlotFile.exists())
 		lookupByIndexPlotFile.resize(0);
 	if(lookupByKeyPlotFile.exists())
@@ -241,22 +260,32 @@ SpeedTest::SpeedTest(unsigned repeats) :
 
 	addElementsPlotFile.appendf(
 			"\"container size\" std::vector std::map std::unordered_map "
-			"csjp::Array csjp::PodArray csjp::OwnerContainer csjp::SorterOwnerContainer\n");
+			"csjp::Array csjp::PodArray csjp::OwnerContainer csjp::SorterOwnerContainer "
+			"csjp::OwnerBTreeContainer csjp::OwnerHashContainer\n");
 	reverseSortingPlotFile.appendf(
 			"\"container size\" std::vector std::map std::unordered_map "
-			"csjp::Array csjp::PodArray csjp::OwnerContainer csjp::SorterOwnerContainer\n");
+			"csjp::Array csjp::PodArray csjp::OwnerContainer csjp::SorterOwnerContainer "
+			"csjp::OwnerBTreeContainer csjp::OwnerHashContainer\n");
 	sameSortingPlotFile.appendf(
 			"\"container size\" std::vector std::map std::unordered_map "
-			"csjp::Array csjp::PodArray csjp::OwnerContainer csjp::SorterOwnerContainer\n");
+			"csjp::Array csjp::PodArray csjp::OwnerContainer csjp::SorterOwnerContainer "
+			"csjp::OwnerBTreeContainer csjp::OwnerHashContainer\n");
+	copyElementsPlotFile.appendf(
+			"\"container size\" std::vector std::map std::unordered_map "
+			"csjp::Array csjp::PodArray csjp::OwnerContainer csjp::SorterOwnerContainer "
+			"csjp::OwnerBTreeContainer csjp::OwnerHashContainer\n");
 	lookupByIndexPlotFile.appendf(
 			"\"container size\" std::vector std::map std::unordered_map "
-			"csjp::Array csjp::PodArray csjp::OwnerContainer csjp::SorterOwnerContainer\n");
+			"csjp::Array csjp::PodArray csjp::OwnerContainer csjp::SorterOwnerContainer "
+			"csjp::OwnerBTreeContainer csjp::OwnerHashContainer\n");
 	lookupByKeyPlotFile.appendf(
 			"\"container size\" std::vector std::map std::unordered_map "
-			"csjp::Array csjp::PodArray csjp::OwnerContainer csjp::SorterOwnerContainer\n");
+			"csjp::Array csjp::PodArray csjp::OwnerContainer csjp::SorterOwnerContainer "
+			"csjp::OwnerBTreeContainer csjp::OwnerHashContainer\n");
 	removeElementsPlotFile.appendf(
 			"\"container size\" std::vector std::map std::unordered_map "
-			"csjp::Array csjp::PodArray csjp::OwnerContainer csjp::SorterOwnerContainer\n");
+			"csjp::Array csjp::PodArray csjp::OwnerContainer csjp::SorterOwnerContainer "
+			"csjp::OwnerBTreeContainer csjp::OwnerHashContainer\n");
 }
 
 void SpeedTest::renames()
@@ -275,6 +304,10 @@ void SpeedTest::renames()
 	name.catf("--repeated-%-times.data", repeats);
 	sameSortingPlotFile.rename(name);
 
+	name.assign("container-speed-test-copy-elements");
+	name.catf("--repeated-%-times.data", repeats);
+	copyElementsPlotFile.rename(name);
+
 	name.assign("container-speed-test-lookup-by-index");
 	name.catf("--repeated-%-times.data", repeats);
 	lookupByIndexPlotFile.rename(name);
@@ -302,6 +335,8 @@ void SpeedTest::fillAllTheContainers(unsigned numOfTestItems)
 		umap.insert(std::pair<unsigned, Data>(d.data, d));
 		container.add(new Data(i));
 		sorterContainer.add(new Data(i));
+		btreeContainer.add(new Data(i));
+		hashContainer.add(new Data(i));
 #endif
 	}
 }
@@ -318,6 +353,8 @@ void SpeedTest::clearAllTheContainers(unsigned numOfTestItems)
 		umap.erase(umap.begin());
 		container.removeAt(0);
 		sorterContainer.removeAt(0);
+		btreeContainer.removeAt(0);
+		hashContainer.remove(i);
 	}
 #endif
 }
@@ -331,6 +368,8 @@ void SpeedTest::addRemoveTest(unsigned numOfTestItems)
 	double podArrayAddTime = 0;
 	double containerAddTime = 0;
 	double sorterContainerAddTime = 0;
+	double btreeContainerAddTime = 0;
+	double hashContainerAddTime = 0;
 
 	double vectorRemoveTime = 0;
 	double mapRemoveTime = 0;
@@ -339,6 +378,8 @@ void SpeedTest::addRemoveTest(unsigned numOfTestItems)
 	double podArrayRemoveTime = 0;
 	double containerRemoveTime = 0;
 	double sorterContainerRemoveTime = 0;
+	double btreeContainerRemoveTime = 0;
+	double hashContainerRemoveTime = 0;
 
 	DBG("Adding % number of allocated elements to and removing them from:\n", numOfTestItems);
 
@@ -349,6 +390,8 @@ void SpeedTest::addRemoveTest(unsigned numOfTestItems)
 	csjp::PodArray<DataStruct> *podArray[repeats];
 	csjp::OwnerContainer<Data> *container[repeats];
 	DataContainer *sorterContainer[repeats];
+	csjp::OwnerBTreeContainer<Data> *btreeContainer[repeats];
+	csjp::OwnerHashContainer<Data> *hashContainer[repeats];
 
 	stopper.restart();
 	for(unsigned r = 0; r < repeats; r++){
@@ -522,6 +565,46 @@ void SpeedTest::addRemoveTest(unsigned numOfTestItems)
 	}
 	sorterContainerRemoveTime += stopper.elapsedSoFar();
 	DBG("- removed from csjp::SorterOwnerContainer<Data> in % time.\n", sorterContainerRemoveTime);
+
+
+
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		btreeContainer[r] = new csjp::OwnerBTreeContainer<Data>;
+		for(unsigned i=0; i < numOfTestItems; i++)
+			btreeContainer[r]->add(new Data(i));
+	}
+	btreeContainerAddTime += stopper.elapsedSoFar();
+	DBG("- added to csjp::OwnerBTreeContainer<Data> in % time.\n", btreeContainerAddTime);
+
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		for(unsigned i=0; i < numOfTestItems; i++)
+			btreeContainer[r]->removeAt(0);
+		delete btreeContainer[r];
+	}
+	btreeContainerRemoveTime += stopper.elapsedSoFar();
+	DBG("- removed from csjp::OwnerBTreeContainer<Data> in % time.\n", btreeContainerRemoveTime);
+
+
+
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		hashContainer[r] = new csjp::OwnerHashContainer<Data>;
+		for(unsigned i=0; i < numOfTestItems; i++)
+			hashContainer[r]->add(new Data(i));
+	}
+	hashContainerAddTime += stopper.elapsedSoFar();
+	DBG("- added to csjp::OwnerHashContainer<Data> in % time.\n", hashContainerAddTime);
+
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		for(unsigned i=0; i < numOfTestItems; i++)
+			hashContainer[r]->remove(i);
+		delete hashContainer[r];
+	}
+	hashContainerRemoveTime += stopper.elapsedSoFar();
+	DBG("- removed from csjp::OwnerHashContainer<Data> in % time.\n", hashContainerRemoveTime);
 #endif
 
 /*	vectorAddTime /= repeats;
@@ -538,12 +621,14 @@ void SpeedTest::addRemoveTest(unsigned numOfTestItems)
 	containerRemoveTime /= repeats;
 	sorterContainerRemoveTime /= repeats;
 */
-	addElementsPlotFile.appendf("% % % % % % % %\n", numOfTestItems,
+	addElementsPlotFile.appendf("% % % % % % % % % %\n", numOfTestItems,
 			vectorAddTime, mapAddTime, umapAddTime,
-			arrayAddTime, podArrayAddTime, containerAddTime, sorterContainerAddTime);
-	removeElementsPlotFile.appendf("% % % % % % % %\n", numOfTestItems,
+			arrayAddTime, podArrayAddTime, containerAddTime, sorterContainerAddTime,
+			btreeContainerAddTime, hashContainerAddTime);
+	removeElementsPlotFile.appendf("% % % % % % % % % %\n", numOfTestItems,
 			vectorRemoveTime, mapRemoveTime, umapRemoveTime,
-			arrayRemoveTime, podArrayAddTime, containerRemoveTime, sorterContainerRemoveTime);
+			arrayRemoveTime, podArrayAddTime, containerRemoveTime, sorterContainerRemoveTime,
+			btreeContainerRemoveTime, hashContainerRemoveTime);
 }
 
 void SpeedTest::reverseSorting(unsigned numOfTestItems)
@@ -555,6 +640,8 @@ void SpeedTest::reverseSorting(unsigned numOfTestItems)
 	double podArrayTime = 0;
 	double containerTime = 0;
 	double sorterContainerTime = 0;
+	double btreeContainerTime = 0;
+	double hashContainerTime = 0;
 
 	DBG("Reverse sorting:\n");
 
@@ -571,6 +658,8 @@ void SpeedTest::reverseSorting(unsigned numOfTestItems)
 	arrayTime = -0.0;
 	podArrayTime = -0.0;
 	containerTime = -0.0;
+	btreeContainerTime = -0.0;
+	hashContainerTime = -0.0;
 
 #ifdef GENERAL_CONT
 	stopper.restart();
@@ -592,9 +681,10 @@ void SpeedTest::reverseSorting(unsigned numOfTestItems)
 	containerTime /= repeats;
 	sorterContainerTime /= repeats;*/
 
-	reverseSortingPlotFile.appendf("% % % % % % % %\n", numOfTestItems,
+	reverseSortingPlotFile.appendf("% % % % % % % % % %\n", numOfTestItems,
 			vectorTime, mapTime, umapTime,
-			arrayTime, podArrayTime, containerTime, sorterContainerTime);
+			arrayTime, podArrayTime, containerTime, sorterContainerTime,
+			btreeContainerTime, hashContainerTime);
 }
 
 void SpeedTest::sameOrderSorting(unsigned numOfTestItems)
@@ -606,6 +696,8 @@ void SpeedTest::sameOrderSorting(unsigned numOfTestItems)
 	double podArrayTime = 0;
 	double containerTime = 0;
 	double sorterContainerTime = 0;
+	double btreeContainerTime = 0;
+	double hashContainerTime = 0;
 
 	DBG("Resorting in same order:\n");
 
@@ -623,6 +715,8 @@ void SpeedTest::sameOrderSorting(unsigned numOfTestItems)
 	arrayTime = -0.0;
 	podArrayTime = -0.0;
 	containerTime = -0.0;
+	btreeContainerTime = -0.0;
+	hashContainerTime = -0.0;
 
 #ifdef GENERAL_CONT
 	sorterContainer.reverseOrdered = false;
@@ -644,9 +738,97 @@ void SpeedTest::sameOrderSorting(unsigned numOfTestItems)
 	containerTime /= repeats;
 	sorterContainerTime /= repeats;*/
 
-	sameSortingPlotFile.appendf("% % % % % % % %\n", numOfTestItems,
+	sameSortingPlotFile.appendf("% % % % % % % % % %\n", numOfTestItems,
 			vectorTime, mapTime, umapTime,
-			arrayTime, podArrayTime, containerTime, sorterContainerTime);
+			arrayTime, podArrayTime, containerTime, sorterContainerTime,
+			btreeContainerTime, hashContainerTime);
+}
+
+void SpeedTest::copyElements(unsigned numOfTestItems)
+{
+	double vectorTime = 0;
+	double mapTime = 0;
+	double umapTime = 0;
+	double arrayTime = 0;
+	double podArrayTime = 0;
+	double containerTime = 0;
+	double sorterContainerTime = 0;
+	double btreeContainerTime = 0;
+	double hashContainerTime = 0;
+
+	DBG("Copying % elements of:\n", numOfTestItems);
+
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		std::vector<Data> copy(vector);
+	}
+	vectorTime += stopper.elapsedSoFar();
+	DBG("- std::vector<Data> in % time.\n", vectorTime);
+
+#ifdef GENERAL_CONT
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		std::map<unsigned, Data> copy(map);
+	}
+	mapTime += stopper.elapsedSoFar();
+	DBG("- std::map<Data> in % time.\n", mapTime);
+
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		std::unordered_map<unsigned, Data> copy(umap);
+	}
+	umapTime += stopper.elapsedSoFar();
+	DBG("- std::unordered_map<Data> in % time.\n", umapTime);
+#endif
+
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		csjp::Array<Data> copy(array);
+	}
+	arrayTime += stopper.elapsedSoFar();
+	DBG("- csjp::Array<Data> in % time.\n", arrayTime);
+
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		csjp::PodArray<DataStruct> copy(podArray);
+	}
+	podArrayTime += stopper.elapsedSoFar();
+	DBG("- csjp::PodArray<DataStruct> in % time.\n", podArrayTime);
+
+#ifdef GENERAL_CONT
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		csjp::OwnerContainer<Data> copy(container);
+	}
+	containerTime += stopper.elapsedSoFar();
+	DBG("- csjp::OwnerContainer<Data> in % time.\n", containerTime);
+
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		csjp::SorterOwnerContainer<Data> copy(sorterContainer);
+	}
+	sorterContainerTime += stopper.elapsedSoFar();
+	DBG("- csjp::SorterOwnerContainer<Data> in % time.\n", sorterContainerTime);
+
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		csjp::OwnerBTreeContainer<Data> copy(btreeContainer);
+	}
+	btreeContainerTime += stopper.elapsedSoFar();
+	DBG("- csjp::OwnerBTreeContainer<Data> in % time.\n", btreeContainerTime);
+
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		csjp::OwnerHashContainer<Data> copy(hashContainer);
+	}
+	hashContainerTime += stopper.elapsedSoFar();
+	DBG("- csjp::OwnerHashContainer<Data> in % time.\n", hashContainerTime);
+#endif
+
+	copyElementsPlotFile.appendf("% % % % % % % % % %\n", numOfTestItems,
+			vectorTime, mapTime, umapTime,
+			arrayTime, podArrayTime, containerTime, sorterContainerTime,
+			btreeContainerTime, hashContainerTime);
 }
 
 void SpeedTest::lookupByIndex(unsigned numOfTestItems)
@@ -658,6 +840,8 @@ void SpeedTest::lookupByIndex(unsigned numOfTestItems)
 	double podArrayTime = 0;
 	double containerTime = 0;
 	double sorterContainerTime = 0;
+	double btreeContainerTime = 0;
+	double hashContainerTime = 0;
 
 	DBG("Looking up % elements by indexes in:\n", numOfTestItems);
 
@@ -706,8 +890,18 @@ void SpeedTest::lookupByIndex(unsigned numOfTestItems)
 	}
 	sorterContainerTime += stopper.elapsedSoFar();
 	DBG("- csjp::SorterOwnerContainer<Data> in % time.\n", sorterContainerTime);
+
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		for(unsigned i=0; i < numOfTestItems; i++)
+			volatile Data u(btreeContainer.queryAt(i));
+	}
+	btreeContainerTime += stopper.elapsedSoFar();
+	DBG("- csjp::OwnerBTreeContainer<Data> in % time.\n", btreeContainerTime);
 #endif
 
+	hashContainerTime = -0.0;
+
 /*	vectorTime /= repeats;
 	mapTime /= repeats;
 	umapTime /= repeats;
@@ -716,9 +910,10 @@ void SpeedTest::lookupByIndex(unsigned numOfTestItems)
 	containerTime /= repeats;
 	sorterContainerTime /= repeats;*/
 
-	lookupByIndexPlotFile.appendf("% % % % % % % %\n", numOfTestItems,
+	lookupByIndexPlotFile.appendf("% % % % % % % % % %\n", numOfTestItems,
 			vectorTime, mapTime, umapTime,
-			arrayTime, podArrayTime, containerTime, sorterContainerTime);
+			arrayTime, podArrayTime, containerTime, sorterContainerTime,
+			btreeContainerTime, hashContainerTime);
 }
 
 void SpeedTest::lookupByKey(unsigned numOfTestItems)
@@ -730,6 +925,8 @@ void SpeedTest::lookupByKey(unsigned numOfTestItems)
 	double podArrayTime = 0;
 	double containerTime = 0;
 	double sorterContainerTime = 0;
+	double btreeContainerTime = 0;
+	double hashContainerTime = 0;
 
 	DBG("Looking up % elements by key in:\n", numOfTestItems);
 
@@ -819,6 +1016,22 @@ void SpeedTest::lookupByKey(unsigned numOfTestItems)
 	}
 	sorterContainerTime += stopper.elapsedSoFar();
 	DBG("- csjp::SorterOwnerContainer<Data> in % time.\n", sorterContainerTime);
+
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		for(unsigned i=0; i < numOfTestItems; i++)
+			volatile Data u(btreeContainer.query(i));
+	}
+	btreeContainerTime += stopper.elapsedSoFar();
+	DBG("- csjp::OwnerBTreeContainer<Data> in % time.\n", btreeContainerTime);
+
+	stopper.restart();
+	for(unsigned r = 0; r < repeats; r++){
+		for(unsigned i=0; i < numOfTestItems; i++)
+			volatile Data u(hashContainer.query(i));
+	}
+	hashContainerTime += stopper.elapsedSoFar();
+	DBG("- csjp::OwnerHashContainer<Data> in % time.\n", hashContainerTime);
 #endif
 
 /*	vectorTime /= repeats;
@@ -829,9 +1042,10 @@ void SpeedTest::lookupByKey(unsigned numOfTestItems)
 	containerTime /= repeats;
 	sorterContainerTime /= repeats;*/
 
-	lookupByKeyPlotFile.appendf("% % % % % % % %\n", numOfTestItems,
+	lookupByKeyPlotFile.appendf("% % % % % % % % % %\n", numOfTestItems,
 			vectorTime, mapTime, umapTime,
-			arrayTime, podArrayTime, containerTime, sorterContainerTime);
+			arrayTime, podArrayTime, containerTime, sorterContainerTime,
+			btreeContainerTime, hashContainerTime);
 }
 
 int main(int argc, const char * args[])
@@ -846,7 +1060,7 @@ int main(int argc, const char * args[])
 		"\n"
 		"	%s _options_\n"
 		"		Runs the tests (add and remove elements, sort in same and reverse\n"
-		"		order, lookup by index and key) according to the given options.\n"
+		"		order, copy, lookup by index and key) according to the given options.\n"
 		"\n"
 		"	Where _options_ can be any of the below in any order:\n"
 		"\n"
@@ -955,6 +1169,7 @@ int main(int argc, const char * args[])
 			test.fillAllTheContainers(i);
 			test.reverseSorting(i);
 			test.sameOrderSorting(i);
+			test.copyElements(i);
 			test.lookupByIndex(i);
 			test.lookupByKey(i);
 			test.clearAllTheContainers(i);
@@ -46,7 +46,9 @@ while test "x$1" != "x"; do
 		"${INPUT_FILE}" using 1:5 every 1::0 title columnhead axes x1y1, \
 		"${INPUT_FILE}" using 1:6 every 1::0 title columnhead axes x1y1, \
 		"${INPUT_FILE}" using 1:7 every 1::0 title columnhead axes x1y1, \
-		"${INPUT_FILE}" using 1:8 every 1::0 title columnhead axes x1y1
+		"${INPUT_FILE}" using 1:8 every 1::0 title columnhead axes x1y1, \
+		"${INPUT_FILE}" using 1:9 every 1::0 title columnhead axes x1y1, \
+		"${INPUT_FILE}" using 1:10 every 1::0 title columnhead axes x1y1
 
 	set output "${NAME}.pdf"
 	set terminal pdf noenhanced mono dashed lw 2 font "Helvetica 12" size 29.7cm,21cm
@@ -0,0 +1,268 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#include <stdlib.h>
+
+#include <csjp_owner_hash_container.h>
+#include <csjp_owner_container.h>
+#include <csjp_test.h>
+
+TEST_COUNT_ALLOCATIONS
+
+class Number
+{
+public:
+	static int alive;
+	static unsigned copiesLeft; // copying fails after these many if not 0
+
+	Number(unsigned key, unsigned value = 0) : key(key), value(value)
+			{ alive++; }
+	Number(const Number & orig) : key(orig.key), value(orig.value)
+	{
+		if(copiesLeft && !--copiesLeft)
+			throw csjp::OutOfMemory("Copy failed.");
+		alive++;
+	}
+	~Number() { alive--; }
+
+	unsigned key;
+	unsigned value;
+};
+int Number::alive = 0;
+unsigned Number::copiesLeft = 0;
+
+size_t hash(const Number & n) { return csjp::hash(n.key); }
+bool operator==(const Number & a, const Number & b) { return a.key == b.key; }
+bool operator==(const Number & a, unsigned b) { return a.key == b; }
+bool operator<(const Number & a, const Number & b) { return a.key < b.key; }
+bool operator<(const Number & a, unsigned b) { return a.key < b; }
+bool operator<(unsigned a, const Number & b) { return a < b.key; }
+
+class Header
+{
+public:
+	Header(const char * name, const char * value) : name(name), value(value) {}
+
+	csjp::String name;
+	csjp::String value;
+};
+
+size_t hash(const Header & h) { return csjp::hash(h.name); }
+bool operator==(const Header & a, const Header & b) { return a.name == b.name; }
+bool operator==(const Header & a, const csjp::Str & b)
+		{ return a.name.isEqual(b.c_str(), b.length); }
+
+class TestHash
+{
+public:
+	void empty();
+	void addQueryRemove();
+	void growAndShrink();
+	void randomAgainstContainer();
+	void strings();
+	void copyAndMove();
+};
+
+void TestHash::empty()
+{
+	csjp::OwnerHashContainer<Number> c1, c2;
+
+	VERIFY(c1.size() == 0);
+	VERIFY(c1.empty());
+	VERIFY(c1.capacity() == 0);
+	VERIFY(c1 == c2);
+	VERIFY(!c1.has(5u));
+	VERIFY(!(c1.begin() != c1.end()));
+	EXC_VERIFY(c1.query(5u), csjp::ObjectNotFound);
+	EXC_VERIFY(c1.remove(5u), csjp::ObjectNotFound);
+	c1.clear();
+	IN_SAFEMODE(c1.validity());
+}
+
+void TestHash::addQueryRemove()
+{
+	csjp::OwnerHashContainer<Number> c;
+
+	TESTSTEP("Adding takes over the data");
+	Number * n = new Number(7, 70);
+	c.add(n);
+	VERIFY(n == NULL);
+	csjp::Object<Number> o(new Number(8, 80));
+	c.add(o);
+	VERIFY(o.ptr == NULL);
+	c.add(new Number(9, 90));
+	IN_SAFEMODE(c.validity());
+	VERIFY(c.size() == 3);
+
+	TESTSTEP("Lookup by data and by key");
+	VERIFY(c.query(Number(8)).value == 80);
+	VERIFY(c.query(9u).value == 90);
+	VERIFY(c.has(7u));
+	VERIFY(!c.has(10u));
+	c.query(7u).value = 71;
+	VERIFY(c.query(7u).value == 71);
+
+	TESTSTEP("Iteration visits every data once");
+	unsigned sum = 0;
+	for(auto & num : c)
+		sum += num.key;
+	VERIFY(sum == 7 + 8 + 9);
+
+	TESTSTEP("Removing by key");
+	c.remove(8u);
+	VERIFY(!c.has(8u));
+	VERIFY(c.size() == 2);
+	EXC_VERIFY(c.remove(8u), csjp::ObjectNotFound);
+	IN_SAFEMODE(c.validity());
+	c.clear();
+	VERIFY(c.empty());
+	VERIFY(Number::alive == 0);
+}
+
+void TestHash::growAndShrink()
+{
+	const unsigned count = 10000;
+	csjp::OwnerHashContainer<Number> c;
+
+	TESTSTEP("Growing");
+	for(unsigned i = 0; i < count; i++){
+		c.add(new Number(i));
+		if(i % 997 == 0)
+			IN_SAFEMODE(c.validity());
+	}
+	IN_SAFEMODE(c.validity());
+	VERIFY(c.size() == count);
+	VERIFY(c.size() <= c.capacity() - c.capacity() / 8);
+	for(unsigned i = 0; i < count; i++)
+		VERIFY(c.query(i).key == i);
+	VERIFY(!c.has(count));
+
+	TESTSTEP("Removing every second");
+	for(unsigned i = 0; i < count; i += 2)
+		c.remove(i);
+	IN_SAFEMODE(c.validity());
+	for(unsigned i = 0; i < count; i++)
+		VERIFY(c.has(i) == (i % 2 == 1));
+
+	TESTSTEP("Adding and removing does not grow over the deleted slots");
+	size_t capacity = c.capacity();
+	for(unsigned r = 0; r < 10; r++){
+		for(unsigned i = 0; i < count; i += 2)
+			c.add(new Number(count + i));
+		for(unsigned i = 0; i < count; i += 2)
+			c.remove(count + i);
+	}
+	IN_SAFEMODE(c.validity());
+	VERIFY(c.capacity() == capacity);
+	VERIFY(c.size() == count / 2);
+
+	TESTSTEP("Reserved room is used without allocation");
+	c.clear();
+	c.reserve(count);
+	capacity = c.capacity();
+	csjp::PodArray<Number *> numbers(count);
+	for(unsigned i = 0; i < count; i++)
+		numbers.add(new Number(i));
+	for(unsigned i = 0; i < count; i++)
+		NOALLOC_VERIFY(c.add(numbers[i]));
+	VERIFY(c.capacity() == capacity);
+	IN_SAFEMODE(c.validity());
+	c.clear();
+	VERIFY(Number::alive == 0);
+}
+
+void TestHash::randomAgainstContainer()
+{
+	const unsigned rounds = 20000;
+	const unsigned keys = 3000;
+	csjp::OwnerHashContainer<Number> hash;
+	csjp::OwnerContainer<Number> tree;
+
+	TESTSTEP("Random adds and removes behave as in the OwnerContainer");
+	srand(1);
+	for(unsigned r = 0; r < rounds; r++){
+		unsigned key = rand() % keys;
+		if(tree.has(key)){
+			VERIFY(hash.query(key).value == tree.query(key).value);
+			hash.remove(key);
+			tree.remove(key);
+		} else {
+			hash.add(new Number(key, r));
+			tree.add(new Number(key, r));
+		}
+		if(r % 1000 == 0)
+			IN_SAFEMODE(hash.validity());
+	}
+	IN_SAFEMODE(hash.validity());
+	VERIFY(hash.size() == tree.size());
+	for(unsigned k = 0; k < keys; k++)
+		VERIFY(hash.has(k) == tree.has(k));
+	for(auto & n : hash)
+		VERIFY(tree.query(n.key).value == n.value);
+}
+
+void TestHash::strings()
+{
+	csjp::OwnerHashContainer<Header> headers;
+
+	TESTSTEP("Heterogeneous lookup by Str");
+	headers.add(new Header("Host", "localhost"));
+	headers.add(new Header("Content-Length", "12"));
+	headers.add(new Header("A-Header-Name-Longer-Than-Sixteen-Bytes", "x"));
+	VERIFY(headers.query(csjp::Str("Host")).value == "localhost");
+	VERIFY(headers.query(csjp::Str("Content-Length")).value == "12");
+	VERIFY(headers.has(csjp::Str("A-Header-Name-Longer-Than-Sixteen-Bytes")));
+	VERIFY(!headers.has(csjp::Str("Hos")));
+	VERIFY(!headers.has(csjp::Str("Host2")));
+	IN_SAFEMODE(headers.validity());
+
+	TESTSTEP("Hash of the same bytes is the same");
+	csjp::String s("Content-Length");
+	VERIFY(csjp::hash(s) == csjp::hash(csjp::Str("Content-Length")));
+	VERIFY(csjp::hash(s) == csjp::hash("Content-Length"));
+	VERIFY(csjp::hash(s) != csjp::hash("Content-Lengti"));
+}
+
+void TestHash::copyAndMove()
+{
+	csjp::OwnerHashContainer<Number> c1;
+	for(unsigned i = 0; i < 1000; i++)
+		c1.add(new Number((i * 7919) % 1000, i));
+
+	TESTSTEP("Copy constructing copies the data");
+	csjp::OwnerHashContainer<Number> c2(c1);
+	IN_SAFEMODE(c2.validity());
+	VERIFY(c1 == c2);
+	VERIFY(Number::alive == 2000);
+
+	TESTSTEP("Moving takes over the table");
+	csjp::OwnerHashContainer<Number> c3(csjp::move_cast(c2));
+	VERIFY(c2.empty());
+	VERIFY(c1 == c3);
+	c2 = csjp::move_cast(c3);
+	VERIFY(c3.empty());
+	VERIFY(c1 == c2);
+	VERIFY(c1 != c3);
+
+	TESTSTEP("Failing copy construction leaves no copies behind");
+	Number::copiesLeft = 500;
+	EXC_VERIFY(csjp::OwnerHashContainer<Number> c4(c1), csjp::OutOfMemory);
+	VERIFY(Number::copiesLeft == 0);
+	VERIFY(Number::alive == 2000);
+	c1.clear();
+	c2.clear();
+	VERIFY(Number::alive == 0);
+}
+
+TEST_INIT(Hash)
+
+	TEST_RUN(empty);
+	TEST_RUN(addQueryRemove);
+	TEST_RUN(growAndShrink);
+	TEST_RUN(randomAgainstContainer);
+	TEST_RUN(strings);
+	TEST_RUN(copyAndMove);
+
+TEST_FINISH(Hash)
@@ -11,6 +11,8 @@
 
 #include <csjp_json.h>
 
+TEST_COUNT_ALLOCATIONS
+
 class TestJson
 {
 public:
@@ -20,6 +22,7 @@ public:
 	void multipleSources();
 	void parseItself();
 	void array();
+	void inArena();
 };
 
 void TestJson::onlyValues()
@@ -217,6 +220,47 @@ void TestJson::array()
 	VERIFY(ot == ot2);
 }
 
+static void buildDocument(csjp::Json & doc)
+{
+	doc["content-type"] <<= "text/html; charset=UTF-8";
+	doc["content-length"] <<= 1234;
+	doc["user-agent"] <<= "Mozilla/5.0 (X11; Linux x86_64; rv:45.0) Gecko/20100101";
+	csjp::Json & list = doc["accept"];
+	list[0] <<= "text/html";
+	list[1] <<= "application/xhtml+xml";
+	list[2] <<= "application/xml;q=0.9";
+}
+
+void TestJson::inArena()
+{
+	csjp::Arena arena;
+
+	TESTSTEP("Build a document in the arena");
+	csjp::Json doc(arena);
+	buildDocument(doc);
+	VERIFY(doc == csjp::Json::Type::Object);
+	VERIFY(doc.size() == 4);
+	VERIFY(doc["content-length"] == "1234");
+	VERIFY(doc["accept"] == csjp::Json::Type::Array);
+	VERIFY(doc["accept"][2] == "application/xml;q=0.9");
+	VERIFY(doc["accept"][2].getArena() == &arena);
+
+	TESTSTEP("Rebuilding after clear and reset does not allocate from the heap");
+	doc.clear();
+	arena.reset();
+	NOALLOC_VERIFY(buildDocument(doc));
+	VERIFY(doc["user-agent"] == "Mozilla/5.0 (X11; Linux x86_64; rv:45.0) "
+			"Gecko/20100101");
+	VERIFY(doc["accept"].size() == 3);
+
+	TESTSTEP("Export is the same as of a heap document");
+	csjp::Json heapDoc;
+	buildDocument(heapDoc);
+	VERIFY(doc.toString() == heapDoc.toString());
+	doc.clear();
+	arena.reset();
+}
+
 TEST_INIT(Json)
 
 	TEST_RUN(onlyValues);
@@ -224,5 +268,6 @@ TEST_INIT(Json)
 	TEST_RUN(valuesInObjects);
 	TEST_RUN(multipleSources);
 	TEST_RUN(array);
+	TEST_RUN(inArena);
 
 TEST_FINISH(Json)
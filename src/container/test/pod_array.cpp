@@ -7,12 +7,15 @@
 #include <csjp_object.h>
 #include <csjp_test.h>
 
+TEST_COUNT_ALLOCATIONS
+
 class TestPodArray
 {
 public:
 	void empty();
 	void singleNode();
 	void manyOrderedNodes();
+	void inlineStorage();
 };
 
 void TestPodArray::empty()
@@ -148,6 +151,56 @@ void TestPodArray::manyOrderedNodes()
 	VERIFY(c3.empty() == true);
 }
 
+void TestPodArray::inlineStorage()
+{
+	csjp::PodArray<int, 4> a;
+
+	TESTSTEP("Small array does not allocate");
+	VERIFY(a.capacity == 4);
+	for(int i = 0; i < 4; i++)
+		NOALLOC_VERIFY(a.add(i));
+	int i = 0;
+	for(auto & n : a)
+		VERIFY(n == i++);
+	VERIFY(i == 4);
+
+	TESTSTEP("Moving copies the inline elements");
+	csjp::PodArray<int, 4> b(csjp::move_cast(a));
+	VERIFY(a.empty());
+	VERIFY(a.capacity == 4);
+	VERIFY(b.size() == 4);
+	VERIFY(b[3] == 3);
+	NOALLOC_VERIFY(a.add(7));
+	VERIFY(b[0] == 0);
+
+	TESTSTEP("Growing moves the elements to the heap");
+	b.add(4);
+	VERIFY(4 < b.capacity);
+	for(int i = 0; i < 5; i++)
+		VERIFY(b[i] == i);
+
+	TESTSTEP("Moving a grown array takes over its memory");
+	const int * data = b.data;
+	a = csjp::move_cast(b);
+	VERIFY(a.data == data);
+	VERIFY(a.size() == 5);
+	VERIFY(b.empty());
+	VERIFY(b.capacity == 4);
+
+	TESTSTEP("Shrinking moves the elements back");
+	a.removeAt(4);
+	a.setCapacity(4);
+	VERIFY(a.capacity == 4);
+	VERIFY(a.data != data);
+	for(int i = 0; i < 4; i++)
+		VERIFY(a[i] == i);
+	VERIFY(a.data[4] == 0);
+
+	TESTSTEP("Copy constructing");
+	csjp::PodArray<int, 4> c(a);
+	VERIFY(c == a);
+	VERIFY(c.data != a.data);
+}
 
 TEST_INIT(PodArray)
 
@@ -157,4 +210,6 @@ TEST_INIT(PodArray)
 
 	TEST_RUN(manyOrderedNodes);
 
+	TEST_RUN(inlineStorage);
+
 TEST_FINISH(PodArray)
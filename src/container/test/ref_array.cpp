@@ -8,12 +8,15 @@
 #include <csjp_object.h>
 #include <csjp_test.h>
 
+TEST_COUNT_ALLOCATIONS
+
 class TestRefArray
 {
 public:
 	void empty();
 	void singleNode();
 	void manyOrderedNodes();
+	void inlineStorage();
 };
 
 void TestRefArray::empty()
@@ -158,6 +161,42 @@ void TestRefArray::manyOrderedNodes()
 	VERIFY(c3.empty() == true);
 }
 
+void TestRefArray::inlineStorage()
+{
+	int numbers[6] = { 0, 1, 2, 3, 4, 5 };
+	csjp::RefArray<int, 4> a;
+
+	TESTSTEP("Small array does not allocate");
+	for(unsigned i = 0; i < 4; i++)
+		NOALLOC_VERIFY(a.add(numbers[i]));
+	VERIFY(&a[2] == numbers + 2);
+	int i = 0;
+	for(auto & n : a)
+		VERIFY(&n == numbers + i++);
+
+	TESTSTEP("Moving copies the inline references");
+	csjp::RefArray<int, 4> b(csjp::move_cast(a));
+	VERIFY(a.empty());
+	VERIFY(b.size() == 4);
+	VERIFY(&b.last() == numbers + 3);
+
+	TESTSTEP("Growing and moving the grown array");
+	b.add(numbers[4]);
+	b.add(numbers[5]);
+	a = csjp::move_cast(b);
+	VERIFY(b.empty());
+	VERIFY(a.size() == 6);
+	for(unsigned i = 0; i < 6; i++)
+		VERIFY(&a[i] == numbers + i);
+
+	TESTSTEP("Removing and shrinking");
+	a.removeAt(0);
+	a.remove(5);
+	a.setCapacity(4);
+	VERIFY(a.capacity == 4);
+	VERIFY(&a.first() == numbers + 1);
+	VERIFY(&a.last() == numbers + 4);
+}
 
 TEST_INIT(RefArray)
 
@@ -167,4 +206,6 @@ TEST_INIT(RefArray)
 
 	TEST_RUN(manyOrderedNodes);
 
+	TEST_RUN(inlineStorage);
+
 TEST_FINISH(RefArray)
@@ -410,6 +410,25 @@ void TestSorterOwnerContainer::manyUnorderedNodes()
 		VERIFY(c1.queryAt(c-'a') == Char(i));
 	}
 
+	TESTSTEP("Sorting again gives the same order.");
+	c1.sort();
+	IN_SAFEMODE(c1.validity());
+	for(c='a', i='z'; c <= 'z'; c++, i--){
+		VERIFY(c1.queryAt(c-'a') == Char(i));
+		VERIFY(c1.index(Char(i)) == c-'a');
+	}
+
+	TESTSTEP("Copy constructing keeps the custom order.");
+	{
+		CharContainer c4(c1);
+		IN_SAFEMODE(c4.validity());
+		VERIFY(c4 == c1);
+		for(c='a', i='z'; c <= 'z'; c++, i--){
+			VERIFY(c4.queryAt(c-'a') == Char(i));
+			VERIFY(c4.index(Char(i)) == c-'a');
+		}
+	}
+
 	TESTSTEP("Custom (normal) ordering c1.");
 	c1.reverseOrdered = false;
 	c1.sort();
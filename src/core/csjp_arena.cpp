@@ -0,0 +1,225 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2016 Csaszar, Peter
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "csjp_string.h"
+#include "csjp_arena.h"
+
+namespace csjp {
+
+/* Room for the chunk header keeping the allocations aligned. */
+const size_t Arena::chunkHeader = (sizeof(Arena::Chunk) + Arena::alignment - 1) &
+		~(Arena::alignment - 1);
+
+static inline char * alignUp(char * ptr, size_t align)
+{
+	return (char *)(((uintptr_t)ptr + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+void Arena::addChunk(size_t minSize)
+{
+	size_t size = chunkSize;
+	if(chunks && size < chunks->size * 2)
+		size = chunks->size * 2;
+	if(size < minSize + alignment)
+		size = minSize + alignment;
+
+	Chunk * chunk = (Chunk *)malloc(chunkHeader + size);
+	if(!chunk)
+		throw OutOfMemory("No enough memory for arena chunk allocation with size of "
+				"% bytes.", chunkHeader + size);
+	chunk->next = chunks;
+	chunk->size = size;
+	chunks = chunk;
+	pos = (char *)chunk + chunkHeader;
+	end = pos + size;
+	last = 0;
+}
+
+void * Arena::allocate(size_t size, size_t align)
+{
+	char * ptr = alignUp(pos, align);
+	if(!pos || (size_t)(end - ptr) < size || end < ptr){
+		addChunk(size + align);
+		ptr = alignUp(pos, align);
+	}
+	pos = ptr + size;
+	last = ptr;
+	used += size;
+	return ptr;
+}
+
+void * Arena::reallocate(void * ptr, size_t oldSize, size_t newSize, size_t align)
+{
+	if(ptr && ptr == last && newSize <= (size_t)(end - last)){
+		pos = last + newSize;
+		used += newSize - oldSize;
+		return ptr;
+	}
+	void * dst = allocate(newSize, align);
+	if(ptr)
+		memcpy(dst, ptr, oldSize < newSize ? oldSize : newSize);
+	return dst;
+}
+
+void Arena::reset()
+{
+	if(chunks && chunks->next){
+		size_t size = reserved();
+		release();
+		addChunk(size);
+	}
+	if(chunks){
+		pos = (char *)chunks + chunkHeader;
+		end = pos + chunks->size;
+	}
+	last = 0;
+	used = 0;
+}
+
+void Arena::release()
+{
+	while(chunks){
+		Chunk * chunk = chunks;
+		chunks = chunk->next;
+		free(chunk);
+	}
+	pos = 0;
+	end = 0;
+	last = 0;
+	used = 0;
+}
+
+size_t Arena::reserved() const
+{
+	size_t size = 0;
+	for(Chunk * chunk = chunks; chunk; chunk = chunk->next)
+		size += chunk->size;
+	return size;
+}
+
+/* Room for the slab header keeping the blocks aligned. */
+const size_t Pool::slabHeader = (sizeof(Pool::Slab) + Arena::alignment - 1) &
+		~(Arena::alignment - 1);
+
+/* Continues with the slab after the current one, allocates a new one if there
+ * is none. */
+void Pool::nextSlab()
+{
+	Slab * slab = current ? current->next : slabs;
+	if(!slab){
+		size_t blocks = slabBlocks;
+		if(current && blocks < current->blocks * 2)
+			blocks = current->blocks * 2;
+		if(maxSlabBlocks < blocks && slabBlocks < blocks)
+			blocks = slabBlocks < maxSlabBlocks ? maxSlabBlocks : slabBlocks;
+
+		slab = (Slab *)malloc(slabHeader + blocks * blockSize);
+		if(!slab)
+			throw OutOfMemory("No enough memory for pool slab allocation with size "
+					"of % bytes.", slabHeader + blocks * blockSize);
+		slab->next = NULL;
+		slab->blocks = blocks;
+		if(current)
+			current->next = slab;
+		else
+			slabs = slab;
+	}
+	current = slab;
+	pos = (char *)slab + slabHeader;
+	end = pos + slab->blocks * blockSize;
+}
+
+void Pool::reset()
+{
+	current = 0;
+	pos = 0;
+	end = 0;
+	freeList = 0;
+	used = 0;
+}
+
+void Pool::recycle()
+{
+	if(maxKeptBlocks < reserved())
+		release();
+	else
+		reset();
+}
+
+void Pool::release()
+{
+	while(slabs){
+		Slab * slab = slabs;
+		slabs = slab->next;
+		::free(slab);
+	}
+	reset();
+}
+
+size_t Pool::reserved() const
+{
+	size_t blocks = 0;
+	for(Slab * slab = slabs; slab; slab = slab->next)
+		blocks += slab->blocks;
+	return blocks;
+}
+
+/* The header keeps the arena of the object, the pool of it with the lowest bit
+ * set or NULL for heap objects. */
+static const size_t objectHeader = ArenaObject::header;
+
+void * ArenaObject::operator new(size_t size)
+{
+	char * ptr = (char *)malloc(objectHeader + size);
+	if(!ptr)
+		throw OutOfMemory("No enough memory for object allocation with size of "
+				"% bytes.", objectHeader + size);
+	*(uintptr_t *)ptr = 0;
+	return ptr + objectHeader;
+}
+
+void * ArenaObject::operator new(size_t size, Arena & arena)
+{
+	char * ptr = (char *)arena.allocate(objectHeader + size);
+	*(uintptr_t *)ptr = (uintptr_t)&arena;
+	return ptr + objectHeader;
+}
+
+void * ArenaObject::operator new(size_t size, Pool & pool)
+{
+	if(pool.size() < objectHeader + size)
+		throw InvalidArgument("Object of % bytes does not fit into the % bytes "
+				"blocks of the pool.", size, pool.size());
+	char * ptr = (char *)pool.allocate();
+	*(uintptr_t *)ptr = (uintptr_t)&pool | 1;
+	return ptr + objectHeader;
+}
+
+void ArenaObject::operator delete(void * ptr)
+{
+	if(!ptr)
+		return;
+	char * header = (char *)ptr - objectHeader;
+	uintptr_t owner = *(uintptr_t *)header;
+	if(!owner)
+		free(header);
+	else if(owner & 1)
+		((Pool *)(owner & ~(uintptr_t)1))->free(header);
+}
+
+void ArenaObject::operator delete(void *, Arena &)
+{
+}
+
+void ArenaObject::operator delete(void * ptr, Pool & pool)
+{
+	pool.free((char *)ptr - objectHeader);
+}
+
+}
@@ -0,0 +1,216 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2016 Csaszar, Peter
+ */
+
+#ifndef CSJP_ARENA_H
+#define CSJP_ARENA_H
+
+#include <stddef.h>
+
+namespace csjp {
+
+/**
+ * Monotonic memory resource. Allocations are cut from big chunks one after the
+ * other and are never freed one by one. All the memory is given back at once by
+ * reset(), which keeps the chunks for reuse, thus a workload repeated after a
+ * reset does not allocate from the heap at all.
+ *
+ * String, Array, PodArray, the containers and Json can optionally allocate from
+ * an arena. The arena has to outlive every object allocated from it.
+ *
+ * Do not inherit from this class!
+ */
+class Arena
+{
+	struct Chunk
+	{
+		Chunk * next;
+		size_t size;
+	};
+
+#define ArenaInitializer : \
+		chunks(0), \
+		pos(0), \
+		end(0), \
+		last(0), \
+		chunkSize(chunkSize), \
+		used(0)
+public:
+	explicit Arena(const Arena & orig) = delete;
+	const Arena & operator=(const Arena & orig) = delete;
+
+	Arena(Arena && temp) = delete;
+	const Arena & operator=(Arena && temp) = delete;
+
+	/** The first chunk is allocated at the first allocation. */
+	explicit Arena(size_t chunkSize = 4096) ArenaInitializer {}
+	~Arena() { release(); }
+
+	/** Alignment of the allocations by default, enough for any type. */
+	static const size_t alignment = 16;
+
+	void * allocate(size_t size, size_t align = alignment);
+	/** Gives a block of newSize bytes with the content of ptr. The block of the
+	 * last allocation is grown in place if the chunk has room for it. */
+	void * reallocate(void * ptr, size_t oldSize, size_t newSize, size_t align = alignment);
+
+	/** Makes all the memory available again. If more than one chunk was in use,
+	 * they are replaced by one big enough for all of their content. */
+	void reset();
+	/** Frees all the chunks. */
+	void release();
+
+	/** Bytes allocated since the last reset. */
+	size_t allocated() const { return used; }
+	/** Size of the chunks owned. */
+	size_t reserved() const;
+
+private:
+	static const size_t chunkHeader;
+	void addChunk(size_t minSize);
+
+	Chunk * chunks; /* The current one, followed by the older ones. */
+	char * pos;
+	char * end;
+	char * last; /* Begining of the last allocation. */
+	size_t chunkSize;
+	size_t used;
+};
+
+/**
+ * Fixed size block allocator. Blocks are cut from slabs one after the other and
+ * the freed ones are kept in a free list for reuse, so the objects of a pool
+ * stay close to each other. reset() makes all the blocks free at once without
+ * looking at them, keeping the slabs for reuse.
+ *
+ * The containers keep their tree nodes in a pool of their own.
+ *
+ * Do not inherit from this class!
+ */
+class Pool
+{
+	struct Slab
+	{
+		Slab * next;
+		size_t blocks;
+	};
+
+	struct Block
+	{
+		Block * next;
+	};
+
+#define PoolInitializer : \
+		slabs(0), \
+		current(0), \
+		pos(0), \
+		end(0), \
+		freeList(0), \
+		blockSize((blockSize + Arena::alignment - 1) & ~(Arena::alignment - 1)), \
+		slabBlocks(slabBlocks), \
+		used(0)
+public:
+	explicit Pool(const Pool & orig) = delete;
+	const Pool & operator=(const Pool & orig) = delete;
+
+	Pool(Pool && temp) = delete;
+	const Pool & operator=(Pool && temp) = delete;
+
+	/** The block size is rounded up to the alignment of the arena. The first
+	 * slab is allocated at the first allocation, the later ones are doubled in
+	 * size up to maxSlabBlocks. */
+	explicit Pool(size_t blockSize, size_t slabBlocks = 32) PoolInitializer {}
+	~Pool() { release(); }
+
+	static const size_t maxSlabBlocks = 4096;
+	/** Blocks kept by recycle(). */
+	static const size_t maxKeptBlocks = 16 * maxSlabBlocks;
+
+	void * allocate()
+	{
+		if(freeList){
+			Block * block = freeList;
+			freeList = block->next;
+			used++;
+			return block;
+		}
+		if(pos == end)
+			nextSlab();
+		void * block = pos;
+		pos += blockSize;
+		used++;
+		return block;
+	}
+	void free(void * ptr)
+	{
+		Block * block = (Block *)ptr;
+		block->next = freeList;
+		freeList = block;
+		used--;
+	}
+
+	/** Makes all the blocks free again. */
+	void reset();
+	/** Like reset(), but frees the slabs if more than maxKeptBlocks blocks
+	 * are reserved, so a pool grown big once does not keep its memory. */
+	void recycle();
+	/** Frees all the slabs. */
+	void release();
+
+	size_t size() const { return blockSize; }
+	/** Blocks in use. */
+	size_t allocated() const { return used; }
+	/** Blocks in the slabs owned. */
+	size_t reserved() const;
+
+private:
+	static const size_t slabHeader;
+	void nextSlab();
+
+	Slab * slabs; /* In the order of allocation. */
+	Slab * current;
+	char * pos;
+	char * end;
+	Block * freeList;
+	size_t blockSize;
+	size_t slabBlocks;
+	size_t used;
+};
+
+/**
+ * Base for classes whose objects might be created in an arena or a pool like
+ *	new(arena) Type(...)
+ * and are deleted by code unaware of where they were created (like the nodes of
+ * the containers). A small header before the object tells delete whether the
+ * memory is to be freed, given back to its pool or left for the reset of the
+ * arena.
+ */
+class ArenaObject
+{
+public:
+	/** Bytes before the object, a pool for such objects needs blocks of
+	 * header + sizeof(Type) bytes. */
+	static const size_t header = Arena::alignment;
+
+	static void * operator new(size_t size);
+	static void * operator new(size_t size, Arena & arena);
+	static void * operator new(size_t size, Pool & pool);
+	static void operator delete(void * ptr);
+	static void operator delete(void * ptr, Arena & arena);
+	static void operator delete(void * ptr, Pool & pool);
+};
+
+}
+
+/** Placement new for types not derived from ArenaObject. Such objects can only be
+ * destructed explicitly, they must not be deleted. */
+inline void * operator new(size_t size, csjp::Arena & arena)
+{
+	return arena.allocate(size);
+}
+inline void operator delete(void *, csjp::Arena &)
+{
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdint.h>
 
+#include "csjp_search.h"
 #include "csjp_string.h"
 
 namespace csjp {
@@ -82,39 +83,14 @@ bool AStr::findFirst(size_t & pos, const char * str, size_t _length, size_t from
 	ENSURE(from <= until,  InvalidArgument);
 	ENSURE(str,  InvalidArgument);
 
-	if(!_length)
-		return false;
-
-	if(until - from < _length)
-		return false;
 	if(!data)
 		return false;
 
-	size_t p = 0;
-
-	const char * refPtr = data + from;
-	const char * const refEndPtr = data + until;
-	const char * strPtr = str;
-	const char * const strEndPtr = str + _length;
-
-	for(; refPtr < refEndPtr; refPtr++){
-		if(*refPtr != *strPtr){
-			if(strPtr == str)
-				continue;
-			strPtr = str;
-		}
-		if(*refPtr == *strPtr){
-			if(strPtr == str)
-				p = refPtr - data;
-			strPtr++;
-			if(strPtr == strEndPtr){
-				pos = p;
-				return true;
-			}
-		}
-	}
-
-	return false;
+	const char * found = search(data + from, data + until, str, _length);
+	if(!found)
+		return false;
+	pos = found - data;
+	return true;
 }
 
 bool AStr::findFirstOf(size_t & pos, const char * str, size_t _length, size_t from, size_t until)
@@ -125,26 +101,14 @@ bool AStr::findFirstOf(size_t & pos, const char * str, size_t _length, size_t fr
 	ENSURE(str,  InvalidArgument);
 	ENSURE(_length,  InvalidArgument);
 
-	if(until - from < _length)
-		return false;
 	if(!data)
 		return false;
 
-	const char * refPtr = data + from;
-	const char * const refEndPtr = data + until;
-	const char * strPtr = str;
-	const char * const strEndPtr = str + _length;
-
-	for(; refPtr < refEndPtr; refPtr++){
-		for(strPtr = str; strPtr < strEndPtr; strPtr++){
-			if(*refPtr == *strPtr){
-				pos = refPtr - data;
-				return true;
-			}
-		}
-	}
-
-	return false;
+	const char * found = searchFirstOf(data + from, data + until, str, _length);
+	if(!found)
+		return false;
+	pos = found - data;
+	return true;
 }
 
 bool AStr::findFirstNotOf(size_t & pos, const char * str, size_t _length, size_t from, size_t until)
@@ -158,26 +122,11 @@ bool AStr::findFirstNotOf(size_t & pos, const char * str, size_t _length, size_t
 	if(!data)
 		return false;
 
-	const char * refPtr = data + from;
-	const char * const refEndPtr = data + until;
-	const char * strPtr = str;
-	const char * const strEndPtr = str + _length;
-
-	for(; refPtr < refEndPtr; refPtr++){
-		bool stranger = true;
-		for(strPtr = str; strPtr < strEndPtr; strPtr++){
-			if(*refPtr == *strPtr){
-				stranger = false;
-				break;
-			}
-		}
-		if(stranger){
-			pos = refPtr - data;
-			return true;
-		}
-	}
-
-	return false;
+	const char * found = searchFirstNotOf(data + from, data + until, str, _length);
+	if(!found)
+		return false;
+	pos = found - data;
+	return true;
 }
 
 bool AStr::findLast(size_t & pos, const char * str, size_t _length, size_t until) const
@@ -189,26 +138,11 @@ bool AStr::findLast(size_t & pos, const char * str, size_t _length, size_t until
 	if(!data)
 		return false;
 
-	const char * refPtr = data + until - 1;
-	const char * strLastPtr = str + _length - 1;
-	const char * strPtr = strLastPtr;
-
-	for(; data <= refPtr; refPtr--){
-		if(*refPtr != *strPtr){
-			if(strPtr == strLastPtr)
-				continue;
-			strPtr = strLastPtr;
-		}
-		if(*refPtr == *strPtr){
-			strPtr--;
-			if(strPtr < str){
-				pos = refPtr - data;
-				return true;
-			}
-		}
-	}
-
-	return false;
+	const char * found = searchLast(data, data + until, str, _length);
+	if(!found)
+		return false;
+	pos = found - data;
+	return true;
 }
 
 bool AStr::findLastOf(size_t & pos, const char * str, size_t _length, size_t until) const
@@ -220,20 +154,11 @@ bool AStr::findLastOf(size_t & pos, const char * str, size_t _length, size_t unt
 	if(!data)
 		return false;
 
-	const char * refPtr = data + until - 1;
-	const char * strPtr = str;
-	const char * const strEndPtr = str + _length;
-
-	for(; data <= refPtr; refPtr--){
-		for(strPtr = str; strPtr < strEndPtr; strPtr++){
-			if(*refPtr == *strPtr){
-				pos = refPtr - data;
-				return true;
-			}
-		}
-	}
-
-	return false;
+	const char * found = searchLastOf(data, data + until, str, _length);
+	if(!found)
+		return false;
+	pos = found - data;
+	return true;
 }
 
 bool AStr::findLastNotOf(size_t & pos, const char * str, size_t _length, size_t until) const
@@ -241,36 +166,14 @@ bool AStr::findLastNotOf(size_t & pos, const char * str, size_t _length, size_t
 	ENSURE(until <= len,  InvalidArgument);
 	ENSURE(str || !_length,  InvalidArgument);
 
-	if(!until)
-		return false;
 	if(!data)
 		return false;
-	if(!str){
-		/* len != 0 ; if len was 0, until is either greater (invalid)
-		 * or 0 what is already handled by returning false. */
-		pos = len - 1;
-		return true;
-	}
-
-	const char * refPtr = data + until - 1;
-	const char * strPtr = str;
-	const char * const strEndPtr = str + _length;
-
-	for(; data <= refPtr; refPtr--){
-		bool stranger = true;
-		for(strPtr = str; strPtr < strEndPtr; strPtr++){
-			if(*refPtr == *strPtr){
-				stranger = false;
-				break;
-			}
-		}
-		if(stranger){
-			pos = refPtr - data;
-			return true;
-		}
-	}
 
-	return false;
+	const char * found = searchLastNotOf(data, data + until, str, _length);
+	if(!found)
+		return false;
+	pos = found - data;
+	return true;
 }
 
 bool AStr::startsWith(const char * str, size_t _length) const
@@ -323,23 +226,15 @@ size_t AStr::count(const char * str, size_t _length, size_t from, size_t until)
 	ENSURE(from <= until,  InvalidArgument);
 	ENSURE(str,  InvalidArgument);
 
-	if(until - from < _length)
+	if(!data)
 		return 0;
 
-	size_t pos = from;
-	size_t matches = 0;
-
-	while(findFirst(pos, str, _length, pos, until)){
-		pos += _length;
-		matches++;
-	}
-
-	return matches;
+	return countMatches(data + from, data + until, str, _length);
 }
 
-Array<Str> AStr::split(const char * delimiters, bool avoidEmptyResults) const
+Array<Str> AStr::split(const char * delimiters, bool avoidEmptyResults, Arena * arena) const
 {
-	Array<Str> result;
+	Array<Str> result = arena ? Array<Str>(*arena) : Array<Str>();
 
 	if(!delimiters || delimiters[0] == 0){
 		if(avoidEmptyResults && len == 0)
@@ -351,32 +246,17 @@ Array<Str> AStr::split(const char * delimiters, bool avoidEmptyResults) const
 
 	const char * until = data + len;
 	size_t d_len = strlen(delimiters);
-	const char * d_until = delimiters + d_len;
 
 	const char * res_start = data;
-	size_t res_len = 0;
-	const char * iter = data;
-
-	while(iter < until){
-		const char * d_iter = delimiters;
-		for(; d_iter < d_until; d_iter++)
-			if(*iter == *d_iter)
-				break;
-
-		if(d_iter == d_until){
-			iter++;
-			res_len++;
-			continue;
-		}
+	const char * iter;
 
-		if(!avoidEmptyResults || res_len)
-			result.add(res_start, res_len);
-		iter++;
-		res_start = iter;
-		res_len = 0;
+	while((iter = searchFirstOf(res_start, until, delimiters, d_len))){
+		if(!avoidEmptyResults || iter != res_start)
+			result.add(res_start, iter - res_start);
+		res_start = iter + 1;
 	}
-	if(!avoidEmptyResults || res_len)
-		result.add(res_start, res_len);
+	if(!avoidEmptyResults || res_start != until)
+		result.add(res_start, until - res_start);
 
 	return result;
 }
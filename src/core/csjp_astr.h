@@ -12,7 +12,8 @@ namespace csjp {
 
 class Str;
 class String;
-template <typename DataType> class Array;
+class Arena;
+template <typename DataType, unsigned Inline = 0> class Array;
 
 class AStr
 {
@@ -62,7 +63,8 @@ public:
 	bool startsWith(const char * str, size_t _length) const;
 	bool endsWith(const char * str, size_t _length) const;
 	size_t count(const char * str, size_t _length, size_t from, size_t until) const;
-	Array<Str> split(const char * delimiters, bool avoidEmptyResults) const;
+	Array<Str> split(const char * delimiters, bool avoidEmptyResults,
+			Arena * arena = 0) const;
 	String encodeBase64() const;
 	String decodeBase64() const;
 	String toHexaString() const;
@@ -4,35 +4,226 @@
  */
 
 #include <sched.h>
+#include <limits.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 
 #include "csjp_mutex.h"
 
 namespace csjp {
 
-void Mutex::lock()
+/* We are going to use gcc's low level atomic operations.
+ * https://gcc.gnu.org/onlinedocs/gcc/_005f_005fatomic-Builtins.html */
+#if not (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+#error "We need gcc 4.7 or later for the __atomic builtins"
+#endif
+
+/* Upper limit of the spinning before going to sleep. */
+static const int maxSpins = 100;
+
+static inline void cpuRelax()
 {
-	/* We are going to use gcc's special low level atomic operations.
-	 * http://gcc.gnu.org/onlinedocs/gcc-4.1.2/gcc/Atomic-Builtins.html#Atomic-Builtins
-	 * type __sync_fetch_and_add (type *ptr, type value, ...)
-	 * type __sync_fetch_and_sub (type *ptr, type value, ...)
-	 */
-#if not __GNUC__ >= 4
-#error "We need gcc 4 or later for __sync_fetch_and_add() and __sync_fetch_and_sub()"
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#else
+	__asm__ __volatile__("" ::: "memory");
 #endif
-	unsigned mutexLast = 1;
-	while(mutexLast){
-		/* __sync_fetch_and_... functions returns the original value of the first param. */
-		mutexLast = __sync_fetch_and_add(&mutex, 1);
-		if(mutexLast){
-			__sync_fetch_and_sub(&mutex, 1);
-			sched_yield();
-		}
+}
+
+/* Sleeps while *addr is value. Might return spuriously. */
+static inline void futexWait(int * addr, int value)
+{
+#ifdef __linux__
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+#else
+	(void)addr;
+	(void)value;
+	sched_yield();
+#endif
+}
+
+static inline void futexWake(int * addr, int count)
+{
+#ifdef __linux__
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+#else
+	(void)addr;
+	(void)count;
+#endif
+}
+
+static inline int load(int * addr)
+{
+	return __atomic_load_n(addr, __ATOMIC_ACQUIRE);
+}
+
+static inline bool cas(int * addr, int expected, int desired)
+{
+	return __atomic_compare_exchange_n(addr, &expected, desired, false,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/* Spins at most limit times while *addr is value. Returns true if it changed. */
+static inline bool spinWhile(int * addr, int value, int limit = maxSpins)
+{
+	for(int i = 0; i < limit; i++){
+		if(load(addr) != value)
+			return true;
+		cpuRelax();
 	}
+	return false;
+}
+
+void Mutex::lock()
+{
+	if(cas(&mutex, 0, 1))
+		return;
+
+	/* Spin about twice as long as the recent contended locks needed. The
+	 * estimate is shared by the threads without the lock, so it is accessed
+	 * atomically, a lost update only makes it less accurate. */
+	int spun = __atomic_load_n(&spins, __ATOMIC_RELAXED);
+	int limit = spun * 2 + 10;
+	if(maxSpins < limit)
+		limit = maxSpins;
+	int count = 0;
+	for(; count < limit; count++){
+		cpuRelax();
+		if(!load(&mutex) && cas(&mutex, 0, 1))
+			break;
+	}
+	__atomic_store_n(&spins, spun + (count - spun) / 8, __ATOMIC_RELAXED);
+	if(count < limit)
+		return;
+
+	/* Mark the mutex as having sleepers, so that unlock wakes us up. */
+	while(__atomic_exchange_n(&mutex, 2, __ATOMIC_ACQUIRE))
+		futexWait(&mutex, 2);
 }
 
 void Mutex::unlock()
 {
-	__sync_fetch_and_sub(&mutex, 1);
+	if(__atomic_exchange_n(&mutex, 0, __ATOMIC_RELEASE) == 2)
+		futexWake(&mutex, 1);
+}
+
+static const int rwWriter = 1 << 30;
+static const int rwWriterWaiting = 1 << 29;
+static const int rwReaders = rwWriterWaiting - 1;
+
+void RWMutex::wait(int value)
+{
+	if(spinWhile(&state, value))
+		return;
+	__atomic_add_fetch(&waiters, 1, __ATOMIC_SEQ_CST);
+	futexWait(&state, value);
+	__atomic_sub_fetch(&waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+void RWMutex::lockRead()
+{
+	while(true){
+		int s = load(&state);
+		if(!(s & (rwWriter | rwWriterWaiting))){
+			if(cas(&state, s, s + 1))
+				return;
+			continue;
+		}
+		wait(s);
+	}
+}
+
+void RWMutex::unlockRead()
+{
+	int s = __atomic_sub_fetch(&state, 1, __ATOMIC_SEQ_CST);
+	if(!(s & rwReaders) && __atomic_load_n(&waiters, __ATOMIC_SEQ_CST))
+		futexWake(&state, INT_MAX);
+}
+
+void RWMutex::lockWrite()
+{
+	while(true){
+		int s = load(&state);
+		if(!(s & (rwWriter | rwReaders))){
+			if(cas(&state, s, rwWriter))
+				return;
+			continue;
+		}
+		if(!(s & rwWriterWaiting)){
+			if(!cas(&state, s, s | rwWriterWaiting))
+				continue;
+			s |= rwWriterWaiting;
+		}
+		wait(s);
+	}
+}
+
+void RWMutex::unlockWrite()
+{
+	__atomic_and_fetch(&state, ~rwWriter, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&waiters, __ATOMIC_SEQ_CST))
+		futexWake(&state, INT_MAX);
+}
+
+void TicketMutex::lock()
+{
+	int ticket = __atomic_fetch_add(&next, 1, __ATOMIC_RELAXED);
+	for(int i = 0; i < maxSpins; i++){
+		if(load(&serving) == ticket)
+			return;
+		cpuRelax();
+	}
+
+	__atomic_add_fetch(&waiters, 1, __ATOMIC_SEQ_CST);
+	int s;
+	while((s = __atomic_load_n(&serving, __ATOMIC_SEQ_CST)) != ticket)
+		futexWait(&serving, s);
+	__atomic_sub_fetch(&waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+void TicketMutex::unlock()
+{
+	__atomic_add_fetch(&serving, 1, __ATOMIC_SEQ_CST);
+	/* Only the owner of the next ticket can continue, but we do not know
+	 * which of the sleepers it is. */
+	if(__atomic_load_n(&waiters, __ATOMIC_SEQ_CST))
+		futexWake(&serving, INT_MAX);
+}
+
+void MCSMutex::lock(Lock & node)
+{
+	node.next = 0;
+	node.locked = 1;
+	Lock * pred = __atomic_exchange_n(&tail, &node, __ATOMIC_ACQ_REL);
+	if(!pred)
+		return;
+	__atomic_store_n(&pred->next, &node, __ATOMIC_RELEASE);
+
+	if(spinWhile(&node.locked, 1))
+		return;
+	if(!cas(&node.locked, 1, 2))
+		return;
+	while(load(&node.locked))
+		futexWait(&node.locked, 2);
+}
+
+void MCSMutex::unlock(Lock & node)
+{
+	Lock * succ = __atomic_load_n(&node.next, __ATOMIC_ACQUIRE);
+	if(!succ){
+		Lock * expected = &node;
+		if(__atomic_compare_exchange_n(&tail, &expected, (Lock *)0, false,
+					__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			return;
+		/* A successor is about to link itself to us. */
+		while(!(succ = __atomic_load_n(&node.next, __ATOMIC_ACQUIRE)))
+			cpuRelax();
+	}
+	if(__atomic_exchange_n(&succ->locked, 0, __ATOMIC_RELEASE) == 2)
+		futexWake(&succ->locked, 1);
 }
 
 }
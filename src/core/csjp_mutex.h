@@ -10,13 +10,18 @@
 
 namespace csjp {
 /**
+ * Adaptive mutex. A contended lock() spins for a bounded time, learning the
+ * typical hold time of the lock, and then sleeps on a futex until the owner
+ * wakes it. The uncontended lock and unlock is a single atomic instruction.
+ *
  * Do not inherit from this class!
  */
 class Mutex
 {
 public:
 #define MutexInitializer : \
-		mutex(0)
+		mutex(0), \
+		spins(0)
 public:
 	explicit Mutex(const Mutex & orig) = delete;
 	const Mutex & operator=(const Mutex & orig) = delete;
@@ -31,7 +36,10 @@ private:
 	void lock();
 	void unlock();
 
-	unsigned mutex;
+	/* 0: unlocked, 1: locked, 2: locked and might have sleepers */
+	int mutex;
+	/* Average spin count of the recent contended locks, accessed atomically. */
+	int spins;
 
 public:
 	class Lock
@@ -53,6 +61,183 @@ public:
 	};
 };
 
+/**
+ * Reader/writer lock. Any number of readers or a single writer can hold the lock.
+ * A waiting writer blocks the new readers, thus writers do not starve.
+ *
+ * Do not inherit from this class!
+ */
+class RWMutex
+{
+public:
+#define RWMutexInitializer : \
+		state(0), \
+		waiters(0)
+public:
+	explicit RWMutex(const RWMutex & orig) = delete;
+	const RWMutex & operator=(const RWMutex & orig) = delete;
+
+	RWMutex(RWMutex && temp) = delete;
+	const RWMutex & operator=(RWMutex && temp) = delete;
+
+	explicit RWMutex() RWMutexInitializer {}
+	~RWMutex() {}
+
+private:
+	void lockRead();
+	void unlockRead();
+	void lockWrite();
+	void unlockWrite();
+	void wait(int value);
+
+	/* Number of readers and the writer bits. */
+	int state;
+	int waiters;
+
+public:
+	class ReadLock
+	{
+	public:
+		explicit ReadLock() = delete;
+
+		explicit ReadLock(const ReadLock & orig) = delete;
+		const ReadLock & operator=(const ReadLock & orig) = delete;
+
+		ReadLock(ReadLock && temp) = delete;
+		const ReadLock & operator=(ReadLock && temp) = delete;
+
+		ReadLock(RWMutex & _mutex) : mutex(_mutex) { mutex.lockRead(); }
+		~ReadLock() { mutex.unlockRead(); }
+
+	private:
+		RWMutex & mutex;
+	};
+
+	class WriteLock
+	{
+	public:
+		explicit WriteLock() = delete;
+
+		explicit WriteLock(const WriteLock & orig) = delete;
+		const WriteLock & operator=(const WriteLock & orig) = delete;
+
+		WriteLock(WriteLock && temp) = delete;
+		const WriteLock & operator=(WriteLock && temp) = delete;
+
+		WriteLock(RWMutex & _mutex) : mutex(_mutex) { mutex.lockWrite(); }
+		~WriteLock() { mutex.unlockWrite(); }
+
+	private:
+		RWMutex & mutex;
+	};
+};
+
+/**
+ * Fair mutex. Threads get the lock in the order they asked for it. Waiters spin
+ * for a while and then sleep on a futex.
+ *
+ * Do not inherit from this class!
+ */
+class TicketMutex
+{
+public:
+#define TicketMutexInitializer : \
+		next(0), \
+		serving(0), \
+		waiters(0)
+public:
+	explicit TicketMutex(const TicketMutex & orig) = delete;
+	const TicketMutex & operator=(const TicketMutex & orig) = delete;
+
+	TicketMutex(TicketMutex && temp) = delete;
+	const TicketMutex & operator=(TicketMutex && temp) = delete;
+
+	explicit TicketMutex() TicketMutexInitializer {}
+	~TicketMutex() {}
+
+private:
+	void lock();
+	void unlock();
+
+	int next;
+	int serving;
+	int waiters;
+
+public:
+	class Lock
+	{
+	public:
+		explicit Lock() = delete;
+
+		explicit Lock(const Lock & orig) = delete;
+		const Lock & operator=(const Lock & orig) = delete;
+
+		Lock(Lock && temp) = delete;
+		const Lock & operator=(Lock && temp) = delete;
+
+		Lock(TicketMutex & _mutex) : mutex(_mutex) { mutex.lock(); }
+		~Lock() { mutex.unlock(); }
+
+	private:
+		TicketMutex & mutex;
+	};
+};
+
+/**
+ * Fair queue lock (Mellor-Crummey and Scott). Every waiter spins on its own
+ * node, kept in its Lock, thus the handover touches only the cache line of the
+ * next waiter. Waiters spinning for too long sleep on a futex.
+ *
+ * Do not inherit from this class!
+ */
+class MCSMutex
+{
+public:
+	class Lock;
+
+#define MCSMutexInitializer : \
+		tail(0)
+public:
+	explicit MCSMutex(const MCSMutex & orig) = delete;
+	const MCSMutex & operator=(const MCSMutex & orig) = delete;
+
+	MCSMutex(MCSMutex && temp) = delete;
+	const MCSMutex & operator=(MCSMutex && temp) = delete;
+
+	explicit MCSMutex() MCSMutexInitializer {}
+	~MCSMutex() {}
+
+private:
+	void lock(Lock & node);
+	void unlock(Lock & node);
+
+	Lock * tail;
+
+public:
+	class Lock
+	{
+	public:
+		explicit Lock() = delete;
+
+		explicit Lock(const Lock & orig) = delete;
+		const Lock & operator=(const Lock & orig) = delete;
+
+		Lock(Lock && temp) = delete;
+		const Lock & operator=(Lock && temp) = delete;
+
+		Lock(MCSMutex & _mutex) : mutex(_mutex), next(0), locked(0)
+				{ mutex.lock(*this); }
+		~Lock() { mutex.unlock(*this); }
+
+	private:
+		friend class MCSMutex;
+		MCSMutex & mutex;
+		Lock * next;
+		/* 1: waiting, 2: sleeping, 0: got the lock */
+		int locked;
+	};
+};
+
 }
 
 #endif
@@ -0,0 +1,565 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2016 Csaszar, Peter
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "csjp_number.h"
+
+namespace csjp {
+
+static const char digitPairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const uint64_t pow10[20] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+	100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+	1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+	1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+	1000000000000000000ULL, 10000000000000000000ULL };
+
+unsigned decimalLength(long long unsigned n)
+{
+	/* 1233/4096 is log10(2); the table fixes up the estimation by one. */
+	unsigned bits = 64 - __builtin_clzll(n | 1);
+	unsigned length = (bits * 1233) >> 12;
+	return length + (pow10[length] <= (n | 1));
+}
+
+/* Writes the digits backward, ending right before end. */
+static inline void writeDigits(char * end, uint64_t n)
+{
+	while(100 <= n){
+		unsigned pair = (n % 100) * 2;
+		n /= 100;
+		*--end = digitPairs[pair + 1];
+		*--end = digitPairs[pair];
+	}
+	if(10 <= n){
+		*--end = digitPairs[n * 2 + 1];
+		*--end = digitPairs[n * 2];
+	} else
+		*--end = '0' + n;
+}
+
+unsigned formatNumber(char * buf, long long unsigned n)
+{
+	unsigned length = decimalLength(n);
+	writeDigits(buf + length, n);
+	return length;
+}
+
+unsigned formatNumber(char * buf, long long int n)
+{
+	if(n < 0){
+		*buf = '-';
+		/* Negation in unsigned to get the right value for the minimum too. */
+		return 1 + formatNumber(buf + 1, (long long unsigned)0 - n);
+	}
+	return formatNumber(buf, (long long unsigned)n);
+}
+
+/* Grisu2 {{{
+ * Florian Loitsch: Printing Floating-Point Numbers Quickly and Accurately with
+ * Integers, PLDI 2010. */
+
+struct DiyFp
+{
+	DiyFp() {}
+	DiyFp(uint64_t f, int e) : f(f), e(e) {}
+
+	uint64_t f;
+	int e;
+};
+
+static inline DiyFp operator-(const DiyFp & a, const DiyFp & b)
+{
+	return DiyFp(a.f - b.f, a.e);
+}
+
+static inline DiyFp operator*(const DiyFp & x, const DiyFp & y)
+{
+	const uint64_t m32 = 0xFFFFFFFFULL;
+	uint64_t a = x.f >> 32, b = x.f & m32;
+	uint64_t c = y.f >> 32, d = y.f & m32;
+	uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+	uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+	tmp += 1U << 31; /* round */
+	return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64);
+}
+
+static inline DiyFp normalize(const DiyFp & x)
+{
+	int shift = __builtin_clzll(x.f);
+	return DiyFp(x.f << shift, x.e - shift);
+}
+
+/* Normalized 10^k for k = -348, -340, ..., 340 */
+static const uint64_t cachedPowersF[] = {
+	0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+	0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+	0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+	0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+	0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+	0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+	0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+	0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+	0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+	0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+	0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+	0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+	0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+	0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+	0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+	0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+	0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+	0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+	0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+	0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+	0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+	0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+	0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+	0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+	0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+	0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+	0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+	0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+	0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+
+static const int16_t cachedPowersE[] = {
+	-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+	-954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+	-688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+	-422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+	-157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+	109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+	375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+	641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+	907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static DiyFp cachedPower(int e, int & k)
+{
+	/* Chooses the power bringing the binary exponent of the product into
+	 * [-60, -32]; 0.30102999566398114 is log10(2). */
+	double dk = (-61 - e) * 0.30102999566398114 + 347;
+	int ik = (int)dk;
+	if(ik < dk)
+		ik++;
+	unsigned index = (unsigned)(ik >> 3) + 1;
+	k = -(-348 + (int)(index << 3));
+	return DiyFp(cachedPowersF[index], cachedPowersE[index]);
+}
+
+static inline void grisuRound(char * buf, unsigned length, uint64_t delta,
+		uint64_t rest, uint64_t tenKappa, uint64_t wpw)
+{
+	while(rest < wpw && tenKappa <= delta - rest &&
+			(rest + tenKappa < wpw || rest + tenKappa - wpw < wpw - rest)){
+		buf[length - 1]--;
+		rest += tenKappa;
+	}
+}
+
+static unsigned digitGen(const DiyFp & w, const DiyFp & mp, uint64_t delta,
+		char * buf, int & k)
+{
+	const DiyFp one(1ULL << -mp.e, mp.e);
+	const DiyFp wpw = mp - w;
+	uint32_t p1 = (uint32_t)(mp.f >> -one.e);
+	uint64_t p2 = mp.f & (one.f - 1);
+	int kappa = decimalLength(p1);
+	unsigned length = 0;
+
+	while(0 < kappa){
+		uint32_t d = p1 / pow10[kappa - 1];
+		p1 %= pow10[kappa - 1];
+		if(d || length)
+			buf[length++] = '0' + d;
+		kappa--;
+		uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+		if(rest <= delta){
+			k += kappa;
+			grisuRound(buf, length, delta, rest, pow10[kappa] << -one.e, wpw.f);
+			return length;
+		}
+	}
+
+	while(true){
+		p2 *= 10;
+		delta *= 10;
+		char d = (char)(p2 >> -one.e);
+		if(d || length)
+			buf[length++] = '0' + d;
+		p2 &= one.f - 1;
+		kappa--;
+		if(p2 < delta){
+			k += kappa;
+			int index = -kappa;
+			grisuRound(buf, length, delta, p2, one.f,
+					wpw.f * (index < 20 ? pow10[index] : 0));
+			return length;
+		}
+	}
+}
+
+/* Value is f * 2^e. The lower boundary is closer when f is a power of two
+ * with an exponent above the minimum of the original floating point type. */
+static unsigned grisu2(uint64_t f, int e, bool lowerBoundaryCloser, char * buf, int & k)
+{
+	DiyFp mp = normalize(DiyFp((f << 1) + 1, e - 1));
+	DiyFp mm = lowerBoundaryCloser ? DiyFp((f << 2) - 1, e - 2) : DiyFp((f << 1) - 1, e - 1);
+	mm.f <<= mm.e - mp.e;
+	mm.e = mp.e;
+
+	DiyFp cmk = cachedPower(mp.e, k);
+	DiyFp w = normalize(DiyFp(f, e)) * cmk;
+	DiyFp wp = mp * cmk;
+	DiyFp wm = mm * cmk;
+	wm.f++;
+	wp.f--;
+	return digitGen(w, wp, wp.f - wm.f, buf, k);
+}
+
+static unsigned writeExponent(char * buf, int k)
+{
+	char * pos = buf;
+	if(k < 0){
+		*pos++ = '-';
+		k = -k;
+	} else
+		*pos++ = '+';
+	unsigned length = decimalLength(k);
+	writeDigits(pos + length, k);
+	return pos - buf + length;
+}
+
+/* Places the decimal point or the exponent into the digits in buf, where the
+ * value is digits * 10^k. */
+static unsigned prettify(char * buf, unsigned length, int k)
+{
+	int kk = length + k; /* 10^(kk-1) <= v < 10^kk */
+
+	if(0 <= k && kk <= 21){
+		/* 1234e7 -> 12340000000 */
+		memset(buf + length, '0', k);
+		return kk;
+	}
+	if(0 < kk && kk <= 21){
+		/* 1234e-2 -> 12.34 */
+		memmove(buf + kk + 1, buf + kk, length - kk);
+		buf[kk] = '.';
+		return length + 1;
+	}
+	if(-6 < kk && kk <= 0){
+		/* 1234e-6 -> 0.001234 */
+		unsigned offset = 2 - kk;
+		memmove(buf + offset, buf, length);
+		buf[0] = '0';
+		buf[1] = '.';
+		memset(buf + 2, '0', offset - 2);
+		return length + offset;
+	}
+	if(length == 1){
+		/* 1e30 -> 1e+30 */
+		buf[1] = 'e';
+		return 2 + writeExponent(buf + 2, kk - 1);
+	}
+	/* 1234e30 -> 1.234e+33 */
+	memmove(buf + 2, buf + 1, length - 1);
+	buf[1] = '.';
+	buf[length + 1] = 'e';
+	return length + 2 + writeExponent(buf + length + 2, kk - 1);
+}
+
+/*}}}*/
+
+static unsigned formatSpecial(char * buf, bool negative, bool nan)
+{
+	if(nan){
+		memcpy(buf, "nan", 3);
+		return 3;
+	}
+	if(negative){
+		memcpy(buf, "-inf", 4);
+		return 4;
+	}
+	memcpy(buf, "inf", 3);
+	return 3;
+}
+
+unsigned formatNumber(char * buf, double n)
+{
+	uint64_t bits;
+	memcpy(&bits, &n, sizeof(bits));
+	bool negative = bits >> 63;
+	unsigned biased = (bits >> 52) & 0x7FF;
+	uint64_t significand = bits & ((1ULL << 52) - 1);
+
+	if(biased == 0x7FF)
+		return formatSpecial(buf, negative, significand);
+
+	char * pos = buf;
+	if(negative)
+		*pos++ = '-';
+	if(!biased && !significand){
+		*pos++ = '0';
+		return pos - buf;
+	}
+
+	int k = 0;
+	unsigned length;
+	if(biased)
+		length = grisu2(significand | (1ULL << 52), biased - 1075,
+				!significand && 1 < biased, pos, k);
+	else
+		length = grisu2(significand, -1074, false, pos, k);
+	return pos - buf + prettify(pos, length, k);
+}
+
+unsigned formatNumber(char * buf, float n)
+{
+	uint32_t bits;
+	memcpy(&bits, &n, sizeof(bits));
+	bool negative = bits >> 31;
+	unsigned biased = (bits >> 23) & 0xFF;
+	uint32_t significand = bits & ((1U << 23) - 1);
+
+	if(biased == 0xFF)
+		return formatSpecial(buf, negative, significand);
+
+	char * pos = buf;
+	if(negative)
+		*pos++ = '-';
+	if(!biased && !significand){
+		*pos++ = '0';
+		return pos - buf;
+	}
+
+	int k = 0;
+	unsigned length;
+	if(biased)
+		length = grisu2(significand | (1U << 23), biased - 150,
+				!significand && 1 < biased, pos, k);
+	else
+		length = grisu2(significand, -149, false, pos, k);
+	return pos - buf + prettify(pos, length, k);
+}
+
+/* Parsing {{{ */
+
+static inline bool isSpace(char c)
+{
+	return c == ' ' || ('\t' <= c && c <= '\r');
+}
+
+static inline bool isDigit(char c)
+{
+	return (unsigned char)(c - '0') < 10;
+}
+
+static inline const char * skipSpaces(const char * pos, const char * end)
+{
+	while(pos < end && isSpace(*pos))
+		pos++;
+	return pos;
+}
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/* Checks and converts 8 digit characters at once (SWAR). */
+static inline bool isEightDigits(uint64_t chunk)
+{
+	return ((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+		(((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+		0x3333333333333333ULL;
+}
+
+static inline uint32_t eightDigits(uint64_t chunk)
+{
+	chunk = (chunk & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+	chunk = (chunk & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+	return (uint32_t)((chunk & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32);
+}
+#endif
+
+/* Accumulates the digits at pos into value. Overflow is set if not all of them
+ * fit into value; the remaining digits are skipped then. */
+static const char * parseDigits(const char * pos, const char * end,
+		uint64_t & value, bool & overflow)
+{
+	uint64_t v = value;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	/* Below 10^11 another 8 digits can not overflow. */
+	while(8 <= end - pos && v < 100000000000ULL){
+		uint64_t chunk;
+		memcpy(&chunk, pos, sizeof(chunk));
+		if(!isEightDigits(chunk))
+			break;
+		v = v * 100000000 + eightDigits(chunk);
+		pos += 8;
+	}
+#endif
+	for(; pos < end && isDigit(*pos); pos++){
+		unsigned d = *pos - '0';
+		if((UINT64_MAX - d) / 10 < v)
+			overflow = true;
+		else if(!overflow)
+			v = v * 10 + d;
+	}
+	value = v;
+	return pos;
+}
+
+const char * parseNumber(const char * begin, const char * end, long long int & n)
+{
+	const char * pos = skipSpaces(begin, end);
+	bool negative = false;
+	if(pos < end && (*pos == '-' || *pos == '+'))
+		negative = (*pos++ == '-');
+
+	uint64_t value = 0;
+	bool overflow = false;
+	const char * digits = pos;
+	pos = parseDigits(pos, end, value, overflow);
+	if(pos == digits){
+		n = 0;
+		return begin;
+	}
+
+	if(negative){
+		if(overflow || (uint64_t)LLONG_MAX + 1 < value)
+			n = LLONG_MIN;
+		else
+			n = (long long int)(0 - value);
+	} else {
+		if(overflow || (uint64_t)LLONG_MAX < value)
+			n = LLONG_MAX;
+		else
+			n = value;
+	}
+	return pos;
+}
+
+const char * parseNumber(const char * begin, const char * end, long int & n)
+{
+	long long int ll;
+	const char * pos = parseNumber(begin, end, ll);
+	if(ll < LONG_MIN)
+		n = LONG_MIN;
+	else if(LONG_MAX < ll)
+		n = LONG_MAX;
+	else
+		n = ll;
+	return pos;
+}
+
+/* Uses strto[l]d() on a 0 terminated copy of the text. */
+template<typename Float>
+static const char * parseByLibc(const char * begin, const char * end, Float & n,
+		Float (*strtoFloat)(const char *, char **))
+{
+	size_t length = end - begin;
+	char buf[128];
+	char * text = buf;
+	if(sizeof(buf) <= length){
+		text = (char *)malloc(length + 1);
+		if(!text){
+			n = 0;
+			return begin;
+		}
+	}
+	memcpy(text, begin, length);
+	text[length] = 0;
+	char * last;
+	n = strtoFloat(text, &last);
+	const char * pos = begin + (last - text);
+	if(text != buf)
+		free(text);
+	return pos;
+}
+
+const char * parseNumber(const char * begin, const char * end, double & n)
+{
+	static const double exactPow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	const char * pos = skipSpaces(begin, end);
+	bool negative = false;
+	if(pos < end && (*pos == '-' || *pos == '+'))
+		negative = (*pos++ == '-');
+
+	/* Hexadecimal numbers, inf and nan are left for strtod(). */
+	if(pos < end && !isDigit(*pos) && *pos != '.')
+		return parseByLibc(begin, end, n, strtod);
+	if(pos + 1 < end && pos[0] == '0' && (pos[1] == 'x' || pos[1] == 'X'))
+		return parseByLibc(begin, end, n, strtod);
+
+	uint64_t mantissa = 0;
+	bool overflow = false;
+	const char * digits = pos;
+	pos = parseDigits(pos, end, mantissa, overflow);
+	size_t numOfDigits = pos - digits;
+	int exponent = 0;
+	if(pos < end && *pos == '.'){
+		const char * fraction = ++pos;
+		pos = parseDigits(pos, end, mantissa, overflow);
+		exponent = -(int)(pos - fraction);
+		numOfDigits += pos - fraction;
+	}
+	if(!numOfDigits){
+		n = 0;
+		return begin;
+	}
+	if(pos < end && (*pos == 'e' || *pos == 'E')){
+		const char * exp = pos + 1;
+		bool negativeExp = false;
+		if(exp < end && (*exp == '-' || *exp == '+'))
+			negativeExp = (*exp++ == '-');
+		if(exp < end && isDigit(*exp)){
+			int e = 0;
+			for(; exp < end && isDigit(*exp); exp++)
+				if(e < 100000)
+					e = e * 10 + (*exp - '0');
+			exponent += negativeExp ? -e : e;
+			pos = exp;
+		}
+	}
+
+	/* Clinger's fast path: both the mantissa and the power of ten are exact
+	 * doubles, so a single rounding operation gives the correct result. */
+	if(overflow || (1ULL << 53) < mantissa || exponent < -22 || 22 < exponent)
+		return parseByLibc(begin, end, n, strtod);
+
+	double value = mantissa;
+	if(exponent < 0)
+		value /= exactPow10[-exponent];
+	else
+		value *= exactPow10[exponent];
+	n = negative ? -value : value;
+	return pos;
+}
+
+const char * parseNumber(const char * begin, const char * end, long double & n)
+{
+	return parseByLibc(begin, end, n, strtold);
+}
+
+/*}}}*/
+
+}
@@ -0,0 +1,49 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2016 Csaszar, Peter
+ */
+
+#ifndef CSJP_NUMBER_H
+#define CSJP_NUMBER_H
+
+#include <stddef.h>
+
+namespace csjp {
+
+/** Number to text conversions without printf. The functions below write the
+ * decimal form of the number into the given buffer without terminating 0 and
+ * return the number of written characters. The buffer has to have room for
+ * at least the corresponding maximum length below.
+ */
+
+static const unsigned maxIntegerLength = 20;
+static const unsigned maxFloatLength = 25;
+
+unsigned decimalLength(long long unsigned n);
+
+unsigned formatNumber(char * buf, long long unsigned n);
+unsigned formatNumber(char * buf, long long int n);
+
+/** Floating point numbers are written with the least number of digits needed to
+ * read back exactly the same value (Grisu2 algorithm). Numbers between 1e-6 and
+ * 1e21 are written in decimal notation, others in exponential notation like 1e+30
+ * or 1.5e-7. Not-a-number and infinite values are written as nan, inf and -inf.
+ */
+unsigned formatNumber(char * buf, double n);
+unsigned formatNumber(char * buf, float n);
+
+/** The parse functions read the number at the beginning of [begin, end) the same
+ * way as strtoll() and strtod() with base 10 do: white spaces are skipped, the
+ * number ends at the first unexpected character, integers are clamped to their
+ * range. The result is 0 if there is no number. The position after the number or
+ * begin if there was no number is returned. The text does not need to be 0
+ * terminated.
+ */
+const char * parseNumber(const char * begin, const char * end, long long int & n);
+const char * parseNumber(const char * begin, const char * end, long int & n);
+const char * parseNumber(const char * begin, const char * end, double & n);
+const char * parseNumber(const char * begin, const char * end, long double & n);
+
+}
+
+#endif
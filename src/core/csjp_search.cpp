@@ -0,0 +1,307 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2016 Csaszar, Peter
+ */
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CSJP_SEARCH_X86
+#endif
+
+#include "csjp_search.h"
+
+namespace csjp {
+
+struct SearchKernels
+{
+	const char * (*byte)(const char *, const char *, char);
+	const char * (*lastByte)(const char *, const char *, char);
+	const char * (*of)(const char *, const char *, const char *, size_t, bool);
+	const char * (*lastOf)(const char *, const char *, const char *, size_t, bool);
+	const char * (*bytes)(const char *, const char *, const char *, size_t);
+	const char * (*lastBytes)(const char *, const char *, const char *, size_t);
+	size_t (*countByte)(const char *, const char *, char);
+};
+
+/* Sets bigger than this are searched by the scalar lookup table. */
+static const size_t maxVectorSet = 16;
+
+namespace scalar { /* {{{ */
+
+static const char * findByte(const char * begin, const char * end, char c)
+{
+	for(; begin < end; begin++)
+		if(*begin == c)
+			return begin;
+	return 0;
+}
+
+static const char * findLastByte(const char * begin, const char * end, char c)
+{
+	while(begin < end)
+		if(*--end == c)
+			return end;
+	return 0;
+}
+
+static void fillSetTable(bool * table, const char * set, size_t setLength, bool notOf)
+{
+	memset(table, notOf, 256);
+	for(size_t i = 0; i < setLength; i++)
+		table[(unsigned char)set[i]] = !notOf;
+}
+
+static const char * findOf(const char * begin, const char * end,
+		const char * set, size_t setLength, bool notOf)
+{
+	bool table[256];
+	fillSetTable(table, set, setLength, notOf);
+	for(; begin < end; begin++)
+		if(table[(unsigned char)*begin])
+			return begin;
+	return 0;
+}
+
+static const char * findLastOf(const char * begin, const char * end,
+		const char * set, size_t setLength, bool notOf)
+{
+	bool table[256];
+	fillSetTable(table, set, setLength, notOf);
+	while(begin < end)
+		if(table[(unsigned char)*--end])
+			return end;
+	return 0;
+}
+
+static const char * findBytes(const char * begin, const char * end,
+		const char * str, size_t length)
+{
+	for(const char * last = end - length; begin <= last; begin++)
+		if(*begin == *str && !memcmp(begin, str, length))
+			return begin;
+	return 0;
+}
+
+static const char * findLastBytes(const char * begin, const char * end,
+		const char * str, size_t length)
+{
+	for(const char * pos = end - length + 1; begin < pos; ){
+		pos--;
+		if(*pos == *str && !memcmp(pos, str, length))
+			return pos;
+	}
+	return 0;
+}
+
+static size_t countByte(const char * begin, const char * end, char c)
+{
+	size_t matches = 0;
+	for(; begin < end; begin++)
+		matches += (*begin == c);
+	return matches;
+}
+
+static const SearchKernels kernels = {
+	findByte,
+	findLastByte,
+	findOf,
+	findLastOf,
+	findBytes,
+	findLastBytes,
+	countByte
+};
+
+} /* }}} */
+
+#ifdef CSJP_SEARCH_X86
+
+namespace sse2 { /* {{{ */
+
+typedef __m128i Vec;
+static const size_t width = 16;
+static const unsigned allBits = 0xFFFF;
+static inline Vec load(const char * p) { return _mm_loadu_si128((const __m128i *)p); }
+static inline Vec splat(char c) { return _mm_set1_epi8(c); }
+static inline Vec eq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+static inline Vec orVec(Vec a, Vec b) { return _mm_or_si128(a, b); }
+static inline Vec andVec(Vec a, Vec b) { return _mm_and_si128(a, b); }
+static inline unsigned mask(Vec a) { return _mm_movemask_epi8(a); }
+
+#include "csjp_search_kernels.h"
+
+} /* }}} */
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+namespace avx2 { /* {{{ */
+
+typedef __m256i Vec;
+static const size_t width = 32;
+static const unsigned allBits = 0xFFFFFFFF;
+static inline Vec load(const char * p) { return _mm256_loadu_si256((const __m256i *)p); }
+static inline Vec splat(char c) { return _mm256_set1_epi8(c); }
+static inline Vec eq(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+static inline Vec orVec(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+static inline Vec andVec(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+static inline unsigned mask(Vec a) { return _mm256_movemask_epi8(a); }
+
+#include "csjp_search_kernels.h"
+
+} /* }}} */
+
+#pragma GCC pop_options
+
+#endif
+
+static SearchKernel detectedKernel()
+{
+#ifdef CSJP_SEARCH_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		return SearchKernel::AVX2;
+	return SearchKernel::SSE2;
+#else
+	return SearchKernel::Scalar;
+#endif
+}
+
+static const SearchKernels * kernelsOf(SearchKernel kernel)
+{
+	switch(kernel){
+#ifdef CSJP_SEARCH_X86
+		case SearchKernel::AVX2 :
+			return &avx2::kernels;
+		case SearchKernel::SSE2 :
+			return &sse2::kernels;
+#endif
+		default :
+			return &scalar::kernels;
+	}
+}
+
+/* Chosen at the first use, so that searching works during static initialization
+ * too. Any thread might choose it, so it is accessed atomically; the kernels
+ * themselves are constants, a relaxed load of the pointer is enough. */
+static const SearchKernels * currentKernels = 0;
+
+static inline const SearchKernels * activeKernels()
+{
+	const SearchKernels * kernels =
+			__atomic_load_n(&currentKernels, __ATOMIC_RELAXED);
+	if(!kernels){
+		kernels = kernelsOf(detectedKernel());
+		__atomic_store_n(&currentKernels, kernels, __ATOMIC_RELAXED);
+	}
+	return kernels;
+}
+
+SearchKernel searchKernel()
+{
+	const SearchKernels * kernels = activeKernels();
+#ifdef CSJP_SEARCH_X86
+	if(kernels == &avx2::kernels)
+		return SearchKernel::AVX2;
+	if(kernels == &sse2::kernels)
+		return SearchKernel::SSE2;
+#else
+	(void)kernels;
+#endif
+	return SearchKernel::Scalar;
+}
+
+bool useSearchKernel(SearchKernel kernel)
+{
+	if(detectedKernel() < kernel)
+		return false;
+	__atomic_store_n(&currentKernels, kernelsOf(kernel), __ATOMIC_RELAXED);
+	return true;
+}
+
+const char * searchByte(const char * begin, const char * end, char c)
+{
+	return activeKernels()->byte(begin, end, c);
+}
+
+const char * searchLastByte(const char * begin, const char * end, char c)
+{
+	return activeKernels()->lastByte(begin, end, c);
+}
+
+static inline const SearchKernels * setKernels(size_t setLength)
+{
+	return setLength <= maxVectorSet ? activeKernels() : &scalar::kernels;
+}
+
+const char * searchFirstOf(const char * begin, const char * end,
+		const char * set, size_t setLength)
+{
+	if(setLength == 1)
+		return activeKernels()->byte(begin, end, *set);
+	if(!setLength)
+		return 0;
+	return setKernels(setLength)->of(begin, end, set, setLength, false);
+}
+
+const char * searchFirstNotOf(const char * begin, const char * end,
+		const char * set, size_t setLength)
+{
+	if(!setLength)
+		return begin < end ? begin : 0;
+	return setKernels(setLength)->of(begin, end, set, setLength, true);
+}
+
+const char * searchLastOf(const char * begin, const char * end,
+		const char * set, size_t setLength)
+{
+	if(setLength == 1)
+		return activeKernels()->lastByte(begin, end, *set);
+	if(!setLength)
+		return 0;
+	return setKernels(setLength)->lastOf(begin, end, set, setLength, false);
+}
+
+const char * searchLastNotOf(const char * begin, const char * end,
+		const char * set, size_t setLength)
+{
+	if(!setLength)
+		return begin < end ? end - 1 : 0;
+	return setKernels(setLength)->lastOf(begin, end, set, setLength, true);
+}
+
+const char * search(const char * begin, const char * end, const char * str, size_t length)
+{
+	if(!length || (size_t)(end - begin) < length)
+		return 0;
+	if(length == 1)
+		return activeKernels()->byte(begin, end, *str);
+	return activeKernels()->bytes(begin, end, str, length);
+}
+
+const char * searchLast(const char * begin, const char * end, const char * str, size_t length)
+{
+	if(!length || (size_t)(end - begin) < length)
+		return 0;
+	if(length == 1)
+		return activeKernels()->lastByte(begin, end, *str);
+	return activeKernels()->lastBytes(begin, end, str, length);
+}
+
+size_t countMatches(const char * begin, const char * end, const char * str, size_t length)
+{
+	if(!length || (size_t)(end - begin) < length)
+		return 0;
+	if(length == 1)
+		return activeKernels()->countByte(begin, end, *str);
+	size_t matches = 0;
+	const char * pos = begin;
+	while((size_t)(end - pos) >= length && (pos = activeKernels()->bytes(pos, end, str, length))){
+		pos += length;
+		matches++;
+	}
+	return matches;
+}
+
+}
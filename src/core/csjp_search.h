@@ -0,0 +1,51 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2016 Csaszar, Peter
+ */
+
+#ifndef CSJP_SEARCH_H
+#define CSJP_SEARCH_H
+
+#include <stddef.h>
+
+namespace csjp {
+
+/** Byte searching kernels behind the find and count methods of AStr. All of them
+ * search in [begin, end) and return the position of the result or 0 if there is
+ * none. The vectorized implementations are chosen at runtime by the features of
+ * the cpu (AVX2, SSE2 or the scalar fallback).
+ */
+
+enum class SearchKernel
+{
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+SearchKernel searchKernel();
+/** Returns false (and keeps the current one) if the cpu can not run the kernel. */
+bool useSearchKernel(SearchKernel kernel);
+
+const char * searchByte(const char * begin, const char * end, char c);
+const char * searchLastByte(const char * begin, const char * end, char c);
+
+const char * searchFirstOf(const char * begin, const char * end,
+		const char * set, size_t setLength);
+const char * searchFirstNotOf(const char * begin, const char * end,
+		const char * set, size_t setLength);
+const char * searchLastOf(const char * begin, const char * end,
+		const char * set, size_t setLength);
+const char * searchLastNotOf(const char * begin, const char * end,
+		const char * set, size_t setLength);
+
+/** Substring search; returns the begining of the first/last match. */
+const char * search(const char * begin, const char * end, const char * str, size_t length);
+const char * searchLast(const char * begin, const char * end, const char * str, size_t length);
+
+/** Number of non-overlapping matches. */
+size_t countMatches(const char * begin, const char * end, const char * str, size_t length);
+
+}
+
+#endif
@@ -0,0 +1,162 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2016 Csaszar, Peter
+ */
+
+/* Vectorized search kernels. Not a public header: csjp_search.cpp includes it
+ * once for every instruction set, after defining Vec, width, load(), splat(),
+ * eq(), orVec(), andVec() and mask() for it. Callers of the kernels make sure
+ * that the searched range is not shorter than the searched string and that sets
+ * are not bigger than maxVectorSet. */
+
+static const char * findByte(const char * begin, const char * end, char c)
+{
+	const Vec needle = splat(c);
+	const char * pos = begin;
+	for(; width <= (size_t)(end - pos); pos += width){
+		unsigned m = mask(eq(load(pos), needle));
+		if(m)
+			return pos + __builtin_ctz(m);
+	}
+	for(; pos < end; pos++)
+		if(*pos == c)
+			return pos;
+	return 0;
+}
+
+static const char * findLastByte(const char * begin, const char * end, char c)
+{
+	const Vec needle = splat(c);
+	const char * pos = end;
+	for(; width <= (size_t)(pos - begin); pos -= width){
+		unsigned m = mask(eq(load(pos - width), needle));
+		if(m)
+			return pos - width + (31 - __builtin_clz(m));
+	}
+	while(begin < pos)
+		if(*--pos == c)
+			return pos;
+	return 0;
+}
+
+static inline unsigned setMask(const Vec & v, const Vec * set, size_t setLength)
+{
+	Vec m = eq(v, set[0]);
+	for(size_t i = 1; i < setLength; i++)
+		m = orVec(m, eq(v, set[i]));
+	return mask(m);
+}
+
+static const char * findOf(const char * begin, const char * end,
+		const char * set, size_t setLength, bool notOf)
+{
+	Vec sets[maxVectorSet];
+	for(size_t i = 0; i < setLength; i++)
+		sets[i] = splat(set[i]);
+	const unsigned flip = notOf ? allBits : 0;
+
+	const char * pos = begin;
+	for(; width <= (size_t)(end - pos); pos += width){
+		unsigned m = setMask(load(pos), sets, setLength) ^ flip;
+		if(m)
+			return pos + __builtin_ctz(m);
+	}
+	for(; pos < end; pos++)
+		if((memchr(set, *pos, setLength) == 0) == notOf)
+			return pos;
+	return 0;
+}
+
+static const char * findLastOf(const char * begin, const char * end,
+		const char * set, size_t setLength, bool notOf)
+{
+	Vec sets[maxVectorSet];
+	for(size_t i = 0; i < setLength; i++)
+		sets[i] = splat(set[i]);
+	const unsigned flip = notOf ? allBits : 0;
+
+	const char * pos = end;
+	for(; width <= (size_t)(pos - begin); pos -= width){
+		unsigned m = setMask(load(pos - width), sets, setLength) ^ flip;
+		if(m)
+			return pos - width + (31 - __builtin_clz(m));
+	}
+	while(begin < pos){
+		pos--;
+		if((memchr(set, *pos, setLength) == 0) == notOf)
+			return pos;
+	}
+	return 0;
+}
+
+/* Substring search comparing the first and the last byte of str at width
+ * positions at once; only the candidates matching both are compared fully.
+ * Length of str is at least 2. */
+static const char * findBytes(const char * begin, const char * end,
+		const char * str, size_t length)
+{
+	const Vec first = splat(str[0]);
+	const Vec last = splat(str[length - 1]);
+	const char * pos = begin;
+	for(; width + length - 1 <= (size_t)(end - pos); pos += width){
+		unsigned m = mask(andVec(eq(load(pos), first), eq(load(pos + length - 1), last)));
+		while(m){
+			unsigned i = __builtin_ctz(m);
+			if(!memcmp(pos + i + 1, str + 1, length - 2))
+				return pos + i;
+			m &= m - 1;
+		}
+	}
+	for(; length <= (size_t)(end - pos); pos++)
+		if(*pos == *str && !memcmp(pos, str, length))
+			return pos;
+	return 0;
+}
+
+static const char * findLastBytes(const char * begin, const char * end,
+		const char * str, size_t length)
+{
+	const Vec first = splat(str[0]);
+	const Vec last = splat(str[length - 1]);
+	/* One after the last possible start of a match. */
+	const char * pos = end - length + 1;
+	for(; width <= (size_t)(pos - begin); pos -= width){
+		const char * block = pos - width;
+		unsigned m = mask(andVec(eq(load(block), first),
+					eq(load(block + length - 1), last)));
+		while(m){
+			unsigned i = 31 - __builtin_clz(m);
+			if(!memcmp(block + i + 1, str + 1, length - 2))
+				return block + i;
+			m &= ~(1U << i);
+		}
+	}
+	while(begin < pos){
+		pos--;
+		if(*pos == *str && !memcmp(pos, str, length))
+			return pos;
+	}
+	return 0;
+}
+
+static size_t countByte(const char * begin, const char * end, char c)
+{
+	const Vec needle = splat(c);
+	size_t matches = 0;
+	const char * pos = begin;
+	for(; width <= (size_t)(end - pos); pos += width)
+		matches += __builtin_popcount(mask(eq(load(pos), needle)));
+	for(; pos < end; pos++)
+		matches += (*pos == c);
+	return matches;
+}
+
+static const SearchKernels kernels = {
+	findByte,
+	findLastByte,
+	findOf,
+	findLastOf,
+	findBytes,
+	findLastBytes,
+	countByte
+};
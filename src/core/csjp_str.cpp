@@ -569,6 +569,11 @@ Array<Str> Str::split(const char * delimiters, bool avoidEmptyResults) const
 	return AStr::split(delimiters, avoidEmptyResults);
 }
 
+Array<Str> Str::split(Arena & arena, const char * delimiters, bool avoidEmptyResults) const
+{
+	return AStr::split(delimiters, avoidEmptyResults, &arena);
+}
+
 bool operator<(const Str & a, const String & b)
 	{ Str chunk(b); return a < chunk; }
 bool operator<(const String & a, const Str & b)
@@ -124,6 +124,9 @@ public:
 	void trimBack(const Str &);
 
 	Array<Str> split(const char * delimiters, bool avoidEmptyResults = true) const;
+	/** The result array is allocated from the arena. */
+	Array<Str> split(Arena & arena, const char * delimiters,
+			bool avoidEmptyResults = true) const;
 
 	String encodeBase64() const;
 	String decodeBase64() const;
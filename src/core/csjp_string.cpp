@@ -8,21 +8,78 @@
 #include <stdint.h>
 #include <regex.h>
 
+#include "csjp_number.h"
 #include "csjp_string.h"
 
 namespace csjp {
 
+static String::GrowthPolicy stringGrowthPolicy = String::defaultGrowth;
+
+size_t String::defaultGrowth(size_t capacity)
+{
+	/* Preallocate 10% more bytes (or 100% more if 10% was less than 2048 bytes). */
+	size_t inc = capacity / 10;
+	if(inc < 2048)
+		inc = capacity;
+	return capacity + inc;
+}
+
+size_t String::geometricGrowth(size_t capacity)
+{
+	return capacity + capacity / 2;
+}
+
+size_t String::pageGrowth(size_t capacity)
+{
+	/* Allocation size (capacity + 1) is a multiple of the page size. */
+	return ((capacity + 1 + 4095) & ~(size_t)4095) - 1;
+}
+
+void String::setGrowthPolicy(GrowthPolicy policy)
+{
+	stringGrowthPolicy = policy ? policy : defaultGrowth;
+}
+
+String::GrowthPolicy String::growthPolicy()
+{
+	return stringGrowthPolicy;
+}
+
 void String::setCapacity(size_t _cap)
 {
-	char *dst = (char *)realloc(data, _cap + 1);
-	if(!dst)
-		throw OutOfMemory("No enough memory for string allocation with size of % bytes.",
-				size);
+	size_t _length = (_cap < len) ? _cap : len;
+	char *dst;
+	if(_cap < sizeof(local)){
+		if(data && data != local){
+			memcpy(local, data, _length);
+			if(!arena)
+				free(data);
+		}
+		dst = local;
+	} else if(arena){
+		if(!data || data == local){
+			dst = (char *)arena->allocate(_cap + 1, 1);
+			if(data)
+				memcpy(dst, local, _length);
+		} else
+			dst = (char *)arena->reallocate(data, _length + 1, _cap + 1, 1);
+	} else if(!data || data == local){
+		dst = (char *)malloc(_cap + 1);
+		if(!dst)
+			throw OutOfMemory("No enough memory for string allocation with size of "
+					"% bytes.", _cap + 1);
+		if(data)
+			memcpy(dst, local, _length);
+	} else {
+		dst = (char *)realloc(data, _cap + 1);
+		if(!dst)
+			throw OutOfMemory("No enough memory for string allocation with size of "
+					"% bytes.", _cap + 1);
+	}
 
 	size = _cap + 1;
 	data = dst;
-	if(_cap < len)
-		len = _cap;
+	len = _length;
 	data[len] = 0;
 }
 
@@ -30,15 +87,29 @@ void String::extendCapacity(size_t _cap)
 {
 	ENSURE(len <= _cap,  InvalidArgument);
 
-	/* Preallocate 10% more bytes (or 100% more if 10% was less than 2048 bytes). */
-	size_t inc = _cap / 10;
-	if(inc < 2048)
-		inc = _cap;
-	_cap += inc;
+	if(_cap < sizeof(local))
+		_cap = sizeof(local) - 1;
+	else
+		_cap = stringGrowthPolicy(_cap);
 
 	setCapacity(_cap);
 }
 
+void String::setArena(Arena * _arena)
+{
+	if(data && data != local && arena != _arena){
+		char * dst = _arena ? (char *)_arena->allocate(size, 1) : (char *)malloc(size);
+		if(!dst)
+			throw OutOfMemory("No enough memory for string allocation with size of "
+					"% bytes.", size);
+		memcpy(dst, data, len + 1);
+		if(!arena)
+			free(data);
+		data = dst;
+	}
+	arena = _arena;
+}
+
 size_t String::capacity() const
 {
 	return (0 < size) ? size - 1 : 0;
@@ -391,17 +462,12 @@ void String::append(long unsigned n)
 
 void String::append(long long unsigned n)
 {
-	long long unsigned number = n;
-	char buf[sizeof(long long unsigned) * 3 + 1];
-	memset(buf, ' ', sizeof(buf));
-	unsigned s = sizeof(buf) - 1;
-	buf[s--] = 0;
-	do {
-		buf[s--] = '0' + number % 10;
-		number /= 10;
-	} while(number);
+	unsigned _length = decimalLength(n);
+	if(size <= len + _length)
+		extendCapacity(len + _length);
 
-	append(buf + s + 1);
+	len += formatNumber(data + len, n);
+	data[len] = 0;
 }
 
 void String::append(int n)
@@ -416,28 +482,33 @@ void String::append(long int n)
 
 void String::append(long long int n)
 {
-	bool negative = (n < 0);
-	long long int number = n;
-	if(negative)
-		number *= -1;
-	char buf[sizeof(long long int) * 3 + 1];
-	memset(buf, ' ', sizeof(buf));
-	unsigned s = sizeof(buf) - 1;
-	buf[s--] = 0;
-	do {
-		buf[s--] = '0' + number % 10;
-		number /= 10;
-	} while(number);
-
-	if(negative)
-		buf[s--] = '-';
+	if(n < 0){
+		append('-');
+		append((long long unsigned)0 - n);
+	} else
+		append((long long unsigned)n);
+}
 
-	append(buf + s + 1);
+void String::append(float n)
+{
+	if(maxFloatLength < size - len){
+		len += formatNumber(data + len, n);
+		data[len] = 0;
+		return;
+	}
+	char buf[maxFloatLength];
+	append(buf, formatNumber(buf, n));
 }
 
 void String::append(double n)
 {
-	append((long double)n);
+	if(maxFloatLength < size - len){
+		len += formatNumber(data + len, n);
+		data[len] = 0;
+		return;
+	}
+	char buf[maxFloatLength];
+	append(buf, formatNumber(buf, n));
 }
 
 void String::append(long double n, unsigned precision)
@@ -753,7 +824,8 @@ void String::clear()
 	if(!data)
 		return;
 
-	free(data);
+	if(data != local && !arena)
+		free(data);
 	data = 0;
 	len = 0;
 	size = 0;
@@ -845,6 +917,11 @@ Array<Str> String::split(const char * delimiters, bool avoidEmptyResults) const
 	return AStr::split(delimiters, avoidEmptyResults);
 }
 
+Array<Str> String::split(Arena & arena, const char * delimiters, bool avoidEmptyResults) const
+{
+	return AStr::split(delimiters, avoidEmptyResults, &arena);
+}
+
 void String::adopt(char *& str, size_t _length, size_t _size)
 {
 	ENSURE(_length <= _size, InvalidArgument);
@@ -854,6 +931,14 @@ void String::adopt(char *& str, size_t _length, size_t _size)
 		return;
 	}
 
+	/* Memory of arena strings has to come from the arena. */
+	if(arena){
+		assign(str, _length);
+		free(str);
+		str = NULL;
+		return;
+	}
+
 	if(_size == _length){
 		_size += 1;
 		char * str_;
@@ -863,7 +948,7 @@ void String::adopt(char *& str, size_t _length, size_t _size)
 		str = str_;
 	}
 
-	if(data)
+	if(data != local)
 		free(data);
 
 	data = str;
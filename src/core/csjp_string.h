@@ -13,6 +13,8 @@
 #include <stdint.h>
 
 #include <csjp_str.h>
+#include <csjp_number.h>
+#include <csjp_arena.h>
 
 #include <csjp_exception.h>
 
@@ -33,18 +35,26 @@ class String : public AStr
 	};
 private:
 	size_t size; // != capacity; capacity == size - 1;
+	/* Strings with capacity less than sizeof(local) are stored here instead of
+	 * a heap allocated area. */
+	char local[24];
+	/* Data not fitting into local is allocated from here if set. */
+	Arena * arena;
 	/*
 	 * Invariants:
 	 * - if data != NULL and points to valid area :
 	 *   - len < size
 	 *   - data[len] == 0
+	 *   - data == local or data is allocated from the arena or from the
+	 *     heap if there is no arena (then it is not shorter than size)
 	 * - if data == NULL :
 	 *   - len == 0
 	 */
 
 #define StringInitializer : \
 	        AStr(), \
-		size(0)
+		size(0), \
+		arena(0)
 
 public:
 
@@ -52,9 +62,10 @@ public:
 	explicit String(const String & orig) StringInitializer { assign(orig.data, orig.length);}
 	explicit String(const Str & str) StringInitializer { assign(str); }
 	explicit String(const AStr & astr) StringInitializer { assign(astr); }
+	explicit String(Arena & arena) StringInitializer { this->arena = &arena; }
 	//template<typename... Args>
 	//explicit String(const char * fmt, const Args & ... args) { catf(fmt, args...); }
-	virtual ~String() { if(data) free(data); }
+	virtual ~String() { if(data != local && !arena) free(data); }
 
 	String(String && temp);
 	const String & operator=(String && temp);
@@ -63,9 +74,25 @@ public:
 	iterator end() const { return iterator(data + len); }
 
 public:
+	/** The growth policy tells the capacity to allocate when extendCapacity() is
+	 * asked for the given capacity. It has to return at least the asked capacity.
+	 */
+	typedef size_t (*GrowthPolicy)(size_t capacity);
+	static size_t defaultGrowth(size_t capacity); // +10%, or +100% below 20480 bytes
+	static size_t geometricGrowth(size_t capacity); // +50%
+	static size_t pageGrowth(size_t capacity); // rounds the allocation up to 4096 bytes
+	/** NULL sets back the default policy. */
+	static void setGrowthPolicy(GrowthPolicy policy);
+	static GrowthPolicy growthPolicy();
+
 	void setCapacity(size_t);
 	void extendCapacity(size_t); // reserves extra space for later usage
 	size_t capacity() const;
+	bool isInline() const { return data == local; }
+	/** Moves the content to memory of the given arena or to the heap if NULL.
+	 * Moving a String moves its arena too. */
+	void setArena(Arena * arena);
+	Arena * getArena() const { return arena; }
 	void setLength(size_t length);
 /*
 	const char& operator[](unsigned char i) const { return data[i]; }
@@ -168,6 +195,7 @@ public:
 	void append(int);
 	void append(long int);
 	void append(long long int);
+	void append(float);
 	void append(double);
 	void append(long double, unsigned precision = 6);
 
@@ -177,16 +205,29 @@ public:
 			__attribute__ ((format (printf, 2, 3)));
 
 	// http://goo.gl/19TOHg
-	template<typename Arg>
-	void cat(const Arg & arg) { *this << arg; }
-	template<typename Arg, typename... Args>
-	void cat(const Arg & arg, const Args & ... args) { *this << arg; cat(args...); }
-
+	/* Both cat() and catf() reserve the capacity for the whole result at once,
+	 * using the length bounds of the arguments known from their types. */
+	template<typename... Args>
+	void cat(const Args & ... args);
+
+	/* Each '%' in fmt is replaced by the next argument, "%%" stands for a '%'
+	 * while there are arguments left. The format is scanned only once, the
+	 * literal parts between placeholders are copied in one step. */
 	void catf(const char * fmt) { append(fmt); }
-	template<typename Arg>
-	void catf(const char * fmt, const Arg & arg);
+	template<typename... Args>
+	void catf(const char * fmt, const Args & ... args);
+private:
+	void catSegments() {}
+	template<typename Arg, typename... Args>
+	void catSegments(const Arg & arg, const Args & ... args)
+			{ *this << arg; catSegments(args...); }
+	/* Exact size for the first content, growth policy when appending more. */
+	void reserveFor(size_t _cap) { if(len) extendCapacity(_cap); else setCapacity(_cap); }
+	void catfSegments(const char * fmt, const char * end) { append(fmt, end - fmt); }
 	template<typename Arg, typename... Args>
-	void catf(const char * fmt, const Arg & arg, const Args & ... args);
+	void catfSegments(const char * fmt, const char * end,
+			const Arg & arg, const Args & ... args);
+public:
 
 	void insert(size_t pos, const char *, size_t _length);
 	void insert(size_t pos, const Str & str) { insert(pos, str.data, str.len); }
@@ -228,6 +269,9 @@ public:
 	void trimBack(const Str & str) { trimBack(str.data, str.len); }
 
 	Array<Str> split(const char * delimiters, bool avoidEmptyResults = true) const;
+	/** The result array is allocated from the arena. */
+	Array<Str> split(Arena & arena, const char * delimiters,
+			bool avoidEmptyResults = true) const;
 	bool isRegexpMatch(const char * regexp);
 	Array<Str> regexpMatches(const char * regexp, unsigned numOfExpectedMatches = 100);
 
@@ -297,15 +341,16 @@ inline String & operator<<=(String & lhs, const Str & rhs)
 
 
 
-int &			operator<<=(int & i,			const String & str);
-long int &		operator<<=(long int & i,		const String & str);
-long long int &		operator<<=(long long int & i,		const String & str);
-unsigned &		operator<<=(unsigned & i,		const String & str);
-long unsigned &		operator<<=(long unsigned & i,		const String & str);
-long long unsigned &	operator<<=(long long unsigned & i,	const String & str);
-float &			operator<<=(float & i,			const String & str);
-double &		operator<<=(double & i,			const String & str);
-long double &		operator<<=(long double & i,		const String & str);
+/* Conversions to numbers work on String and Str alike without any copy. */
+int &			operator<<=(int & i,			const AStr & str);
+long int &		operator<<=(long int & i,		const AStr & str);
+long long int &		operator<<=(long long int & i,		const AStr & str);
+unsigned &		operator<<=(unsigned & i,		const AStr & str);
+long unsigned &		operator<<=(long unsigned & i,		const AStr & str);
+long long unsigned &	operator<<=(long long unsigned & i,	const AStr & str);
+float &			operator<<=(float & i,			const AStr & str);
+double &		operator<<=(double & i,			const AStr & str);
+long double &		operator<<=(long double & i,		const AStr & str);
 
 /*}}}*/
 
@@ -367,6 +412,7 @@ public:
 			fflush(stdout); \
 			csjp::msgLogger(stderr, _csjpStr.c_str(), \
 					_csjpStr.length); \
+			csjp::flushLog(); \
 			fflush(stderr); \
 			exit(-1); \
 		}
@@ -501,21 +547,34 @@ inline String Str::encodeBase64() const { return AStr::encodeBase64(); }
 inline String Str::decodeBase64() const { return AStr::decodeBase64(); }
 
 /* Inline implementations {{{*/
-inline String::String(String && temp) : size(temp.size)
+inline String::String(String && temp) : size(temp.size), arena(temp.arena)
 {
-	data = temp.data;
 	len = temp.len;
+	if(temp.data == temp.local){
+		memcpy(local, temp.local, len + 1);
+		data = local;
+	} else
+		data = temp.data;
 	temp.data = 0;
 	temp.len = 0;
 	temp.size = 0;
 }
 inline const String & String::operator=(String && temp)
 {
-	free(data);
+	if(this == &temp)
+		return *this;
+
+	if(data != local && !arena)
+		free(data);
 
-	data = temp.data;
 	len = temp.len;
 	size = temp.size;
+	arena = temp.arena;
+	if(temp.data == temp.local){
+		memcpy(local, temp.local, len + 1);
+		data = local;
+	} else
+		data = temp.data;
 
 	temp.data = 0;
 	temp.len = 0;
@@ -524,60 +583,110 @@ inline const String & String::operator=(String && temp)
 	return *this;
 }
 
-template<typename Arg> void String::catf(const char * fmt, const Arg & arg)
+/* Upper bounds of the length of the arguments as catf() and cat() prints them.
+ * Types not listed here are bounded by 0, thus they might need reallocation. */
+template<typename Arg> struct CatLength {
+	static size_t of(const Arg &) { return 0; } };
+#define CSJP_CAT_LENGTH(type, bound) \
+	template<> struct CatLength<type> { \
+		static size_t of(type const &) { return bound; } };
+CSJP_CAT_LENGTH(char, 1)
+CSJP_CAT_LENGTH(unsigned char, 1)
+CSJP_CAT_LENGTH(unsigned, 10)
+CSJP_CAT_LENGTH(long unsigned, 20)
+CSJP_CAT_LENGTH(long long unsigned, 20)
+CSJP_CAT_LENGTH(int, 11)
+CSJP_CAT_LENGTH(long int, 20)
+CSJP_CAT_LENGTH(long long int, 20)
+CSJP_CAT_LENGTH(float, 32)
+CSJP_CAT_LENGTH(double, 32)
+CSJP_CAT_LENGTH(const void *, 18)
+#undef CSJP_CAT_LENGTH
+template<> struct CatLength<const char *> {
+	static size_t of(const char * str) { return str ? strlen(str) : 0; } };
+template<> struct CatLength<char *> {
+	static size_t of(const char * str) { return str ? strlen(str) : 0; } };
+template<size_t N> struct CatLength<char[N]> {
+	static size_t of(const char (&)[N]) { return N - 1; } };
+template<> struct CatLength<Str> {
+	static size_t of(const Str & str) { return str.length; } };
+template<> struct CatLength<String> {
+	static size_t of(const String & str) { return str.length; } };
+
+inline size_t catLength() { return 0; }
+template<typename Arg, typename... Args>
+size_t catLength(const Arg & arg, const Args & ... args)
 {
-	while(*fmt != 0){
-		if(*fmt == '%'){
-			fmt++;
-			if(*fmt != '%'){
-				*this << arg;
-				append(fmt);
-				return;
-			}
-		}
-		append(*fmt);
-		fmt++;
-	}
-	*this << arg;
+	return CatLength<Arg>::of(arg) + catLength(args...);
+}
+
+template<typename... Args> void String::cat(const Args & ... args)
+{
+	size_t need = len + catLength(args...);
+	if(capacity() < need)
+		reserveFor(need);
+	catSegments(args...);
+}
+
+template<typename... Args> void String::catf(const char * fmt, const Args & ... args)
+{
+	size_t fmtLength = fmt ? strlen(fmt) : 0;
+	size_t need = len + fmtLength + catLength(args...);
+	if(capacity() < need)
+		reserveFor(need);
+	catfSegments(fmt, fmt + fmtLength, args...);
 }
+
 template<typename Arg, typename... Args>
-void String::catf(const char * fmt, const Arg & arg, const Args & ... args)
+void String::catfSegments(const char * fmt, const char * end,
+		const Arg & arg, const Args & ... args)
 {
-	while(*fmt != 0){
-		if(*fmt == '%'){
-			fmt++;
-			if(*fmt != '%'){
-				*this << arg;
-				catf(fmt, args...);
-				return;
-			}
+	while(true){
+		const char * pos = fmt ? (const char *)memchr(fmt, '%', end - fmt) : 0;
+		if(!pos){
+			append(fmt, end - fmt);
+			catSegments(arg, args...);
+			return;
+		}
+		if(pos + 1 < end && pos[1] == '%'){
+			append(fmt, pos + 1 - fmt);
+			fmt = pos + 2;
+			continue;
 		}
-		append(*fmt);
-		fmt++;
+		append(fmt, pos - fmt);
+		*this << arg;
+		catfSegments(pos + 1, end, args...);
+		return;
 	}
-	cat(args...);
 }
 
-#define CSJP_C0 { if(!str.c_str()) i = 0; else i <<= CString(str.c_str()); return i; }
-#define CSJP_C1 { if(!str.c_str()) i = 0u; else i <<= CString(str.c_str()); return i; }
-#define CSJP_C2 { if(!str.c_str()) i = 0.0; else i <<= CString(str.c_str()); return i; }
-#define CSJP_C3 { if(!str.c_str()) i = '\0'; else i <<= CString(str.c_str()); return i; }
+/* Same semantics as the atoi(), atol(), atoll(), atof(), strtod() and strtold()
+ * based conversions of CString. */
+#define CSJP_P(parsed) { parsed n; parseNumber(str.c_str(), str.c_str() + str.length, n); \
+				i = n; return i; }
 #define CSJP_C4 { if(!str.c_str()) i = false; else i <<= CString(str.c_str()); return i; }
 
-inline char			& operator<<=(char & i,			const String & str) CSJP_C0
-inline unsigned char		& operator<<=(unsigned char & i,	const String & str) CSJP_C0
-inline int			& operator<<=(int & i,			const String & str) CSJP_C0
-inline long int			& operator<<=(long int & i,		const String & str) CSJP_C0
-inline long long int		& operator<<=(long long int & i,	const String & str) CSJP_C0
-inline unsigned			& operator<<=(unsigned & i,		const String & str) CSJP_C0
-inline long unsigned		& operator<<=(long unsigned & i,	const String & str) CSJP_C0
-inline long long unsigned	& operator<<=(long long unsigned & i,	const String & str) CSJP_C0
-inline float			& operator<<=(float & i,		const String & str) CSJP_C0
-inline double			& operator<<=(double & i,		const String & str) CSJP_C0
-inline long double		& operator<<=(long double & i,		const String & str) CSJP_C0
-inline UInt			& operator<<=(UInt & i,			const String & str) CSJP_C1
-inline Double			& operator<<=(Double & i,		const String & str) CSJP_C2
-inline Char			& operator<<=(Char & i,			const String & str) CSJP_C3
+inline char			& operator<<=(char & i,			const AStr & str) CSJP_P(long)
+inline unsigned char		& operator<<=(unsigned char & i,	const AStr & str) CSJP_P(long)
+inline int			& operator<<=(int & i,			const AStr & str) CSJP_P(long)
+inline long int			& operator<<=(long int & i,		const AStr & str) CSJP_P(long)
+inline long long int		& operator<<=(long long int & i,	const AStr & str)
+										CSJP_P(long long)
+inline unsigned			& operator<<=(unsigned & i,		const AStr & str) CSJP_P(long)
+inline long unsigned		& operator<<=(long unsigned & i,	const AStr & str)
+										CSJP_P(long long)
+inline long long unsigned	& operator<<=(long long unsigned & i,	const AStr & str)
+										CSJP_P(long long)
+inline float			& operator<<=(float & i,		const AStr & str) CSJP_P(double)
+inline double			& operator<<=(double & i,		const AStr & str) CSJP_P(double)
+inline long double		& operator<<=(long double & i,		const AStr & str)
+										CSJP_P(long double)
+inline UInt			& operator<<=(UInt & i,			const AStr & str)
+										{ i.val <<= str; return i; }
+inline Double			& operator<<=(Double & i,		const AStr & str)
+										{ i.val <<= str; return i; }
+inline Char			& operator<<=(Char & i,			const AStr & str)
+										{ i.val <<= str; return i; }
 inline YNBool			& operator<<=(YNBool & i,		const String & str) CSJP_C4
 
 /*}}}*/
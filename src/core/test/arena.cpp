@@ -0,0 +1,544 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2016 Csaszar, Peter
+ */
+
+#include <stdint.h>
+
+#include <csjp_arena.h>
+#include <csjp_string.h>
+#include <csjp_array.h>
+#include <csjp_pod_array.h>
+#include <csjp_owner_container.h>
+#include <csjp_reference_container.h>
+#include <csjp_sorter_owner_container.h>
+#include <csjp_value_container.h>
+#include <csjp_stopper.h>
+#include <csjp_test.h>
+
+TEST_COUNT_ALLOCATIONS
+
+class TestArena
+{
+public:
+	void allocate();
+	void reset();
+	void arenaObject();
+	void string();
+	void array();
+	void podArray();
+	void container();
+	void pool();
+	void poolObject();
+	void poolContainer();
+	void speed();
+};
+
+class Counted : public csjp::ArenaObject
+{
+public:
+	explicit Counted(int i = 0) : i(i) { instances++; }
+	~Counted() { instances--; }
+	bool operator<(const Counted & other) const { return i < other.i; }
+	int i;
+	static int instances;
+};
+int Counted::instances = 0;
+
+/* The first chunk is allocated at the first use. */
+static void warmUp(csjp::Arena & arena)
+{
+	arena.allocate(1);
+	arena.reset();
+}
+
+void TestArena::allocate()
+{
+	csjp::Arena arena(1024);
+
+	TESTSTEP("The first allocation gets the first chunk");
+	VERIFY(arena.reserved() == 0);
+	char * a = (char *)arena.allocate(10);
+	VERIFY(arena.reserved() == 1024);
+	VERIFY(arena.allocated() == 10);
+	VERIFY(((uintptr_t)a % csjp::Arena::alignment) == 0);
+
+	TESTSTEP("Allocations are aligned as asked");
+	char * b = (char *)arena.allocate(3, 1);
+	VERIFY(b == a + 10);
+	char * c = (char *)arena.allocate(8);
+	VERIFY(((uintptr_t)c % csjp::Arena::alignment) == 0);
+	VERIFY(c == a + 16);
+
+	TESTSTEP("The last allocation grows in place");
+	NOALLOC_VERIFY(VERIFY(arena.reallocate(c, 8, 100) == c));
+	VERIFY(arena.allocated() == 10 + 3 + 100);
+
+	TESTSTEP("Others are copied");
+	memcpy(a, "0123456789", 10);
+	char * d = (char *)arena.reallocate(a, 10, 20);
+	VERIFY(d != a);
+	VERIFY(!memcmp(d, "0123456789", 10));
+
+	TESTSTEP("Allocations not fitting into the chunk get a new one");
+	unsigned long long before = testAllocations;
+	char * e = (char *)arena.allocate(4000);
+	VERIFY(testAllocations == before + 1);
+	memset(e, 0, 4000);
+	VERIFY(4000 + 1024 < arena.reserved());
+
+	TESTSTEP("Release frees everything");
+	arena.release();
+	VERIFY(arena.reserved() == 0);
+	VERIFY(arena.allocated() == 0);
+}
+
+void TestArena::reset()
+{
+	csjp::Arena arena(256);
+
+	TESTSTEP("Reset after one chunk does not touch the heap");
+	char * first = (char *)arena.allocate(100);
+	NOALLOC_VERIFY(arena.reset());
+	VERIFY(arena.allocated() == 0);
+	NOALLOC_VERIFY(VERIFY(arena.allocate(100) == first));
+
+	TESTSTEP("Reset after more chunks replaces them with one big chunk");
+	for(int i = 0; i < 20; i++)
+		arena.allocate(100);
+	size_t reserved = arena.reserved();
+	VERIFY(256 < reserved);
+	arena.reset();
+	VERIFY(reserved <= arena.reserved());
+
+	TESTSTEP("The same workload after the reset does not allocate");
+	NOALLOC_VERIFY(
+		for(int i = 0; i < 21; i++)
+			arena.allocate(100);
+		);
+}
+
+void TestArena::arenaObject()
+{
+	csjp::Arena arena;
+	warmUp(arena);
+
+	TESTSTEP("Objects created in the arena can be deleted");
+	Counted * heap = new Counted(1);
+	Counted * inArena = 0;
+	NOALLOC_VERIFY(inArena = new(arena) Counted(2));
+	VERIFY(Counted::instances == 2);
+	NOALLOC_VERIFY(delete inArena);
+	delete heap;
+	VERIFY(Counted::instances == 0);
+
+	TESTSTEP("Object<> deletes arena objects too");
+	{
+		csjp::Object<Counted> o(new(arena) Counted(3));
+		VERIFY(o->i == 3);
+	}
+	VERIFY(Counted::instances == 0);
+}
+
+void TestArena::string()
+{
+	csjp::Arena arena;
+	warmUp(arena);
+
+	TESTSTEP("Long strings allocate from the arena");
+	{
+		csjp::String str(arena);
+		NOALLOC_VERIFY(str << "content-type: text/html; charset=UTF-8");
+		VERIFY(str == "content-type: text/html; charset=UTF-8");
+		VERIFY(!str.isInline());
+		VERIFY(str.getArena() == &arena);
+		NOALLOC_VERIFY(str << ", " << 1234567890 << ", " << 0.5);
+		VERIFY(str == "content-type: text/html; charset=UTF-8, 1234567890, 0.5");
+		NOALLOC_VERIFY(str.clear());
+	}
+
+	TESTSTEP("Short strings stay inline");
+	{
+		csjp::String str(arena);
+		size_t allocated = arena.allocated();
+		str << "short";
+		VERIFY(str.isInline());
+		VERIFY(arena.allocated() == allocated);
+	}
+
+	TESTSTEP("Moving a string moves its arena");
+	{
+		csjp::String str(arena);
+		str << "a string longer than the inline storage";
+		const char * data = str.c_str();
+		csjp::String moved(csjp::move_cast(str));
+		VERIFY(moved.getArena() == &arena);
+		VERIFY(moved.c_str() == data);
+
+		csjp::String assigned;
+		assigned << "heap allocated string, long enough";
+		assigned = csjp::move_cast(moved);
+		VERIFY(assigned.getArena() == &arena);
+		VERIFY(assigned.c_str() == data);
+	}
+
+	TESTSTEP("setArena() moves the content");
+	{
+		csjp::String str("heap allocated string, long enough");
+		str.setArena(&arena);
+		VERIFY(str.getArena() == &arena);
+		VERIFY(str == "heap allocated string, long enough");
+		str.setArena(0);
+		VERIFY(str == "heap allocated string, long enough");
+	}
+
+	TESTSTEP("Adopted buffers are copied into the arena");
+	{
+		csjp::String str(arena);
+		char * buf = (char *)malloc(64);
+		strcpy(buf, "adopted buffer");
+		str.adopt(buf);
+		VERIFY(!buf);
+		VERIFY(str == "adopted buffer");
+	}
+}
+
+void TestArena::array()
+{
+	csjp::Arena arena(1 << 16);
+	warmUp(arena);
+
+	TESTSTEP("Array constructs its objects in the arena");
+	{
+		csjp::Array<csjp::String> array(arena);
+		NOALLOC_VERIFY(
+			for(int i = 0; i < 100; i++)
+				array.add("some text");
+			);
+		VERIFY(array.length == 100);
+		VERIFY(array[99] == "some text");
+		NOALLOC_VERIFY(array.removeAt(0));
+		VERIFY(array.length == 99);
+		NOALLOC_VERIFY(array.clear());
+	}
+
+	TESTSTEP("Objects are destructed, but not freed");
+	{
+		csjp::Array<Counted> array(arena);
+		array.add(1);
+		array.add(2);
+		VERIFY(Counted::instances == 2);
+		array.removeAt(0);
+		VERIFY(Counted::instances == 1);
+	}
+	VERIFY(Counted::instances == 0);
+
+	TESTSTEP("Adopting and giving away objects by pointer is not possible");
+	{
+		csjp::Array<Counted> array(arena);
+		array.add(1);
+		EXC_VERIFY(array.pop(), csjp::InvalidState);
+		csjp::Object<Counted> o(new Counted(2));
+		EXC_VERIFY(array.add(o), csjp::InvalidState);
+		csjp::Array<Counted> heap;
+		EXC_VERIFY(heap.join(array), csjp::InvalidArgument);
+	}
+	VERIFY(Counted::instances == 0);
+
+	TESTSTEP("Split into an arena array");
+	{
+		csjp::Str str("a,b,,c");
+		csjp::Array<csjp::Str> array = str.split(arena, ",");
+		VERIFY(array.getArena() == &arena);
+		VERIFY(array.length == 3);
+		VERIFY(array[2] == "c");
+	}
+}
+
+void TestArena::podArray()
+{
+	csjp::Arena arena(1 << 16);
+	warmUp(arena);
+
+	TESTSTEP("PodArray stores its data in the arena");
+	csjp::PodArray<int> array(arena);
+	NOALLOC_VERIFY(
+		for(int i = 0; i < 1000; i++)
+			array.add(i);
+		);
+	VERIFY(array.length == 1000);
+	VERIFY(array[999] == 999);
+
+	TESTSTEP("Moving keeps the arena");
+	csjp::PodArray<int> moved(csjp::move_cast(array));
+	VERIFY(moved.getArena() == &arena);
+	VERIFY(moved[500] == 500);
+}
+
+void TestArena::container()
+{
+	csjp::Arena arena;
+	warmUp(arena);
+
+	TESTSTEP("Container nodes are allocated from the arena");
+	{
+		csjp::OwnerContainer<Counted> container(arena);
+		for(int i = 0; i < 10; i++){
+			Counted * c = new(arena) Counted(i);
+			NOALLOC_VERIFY(container.add(c));
+		}
+		VERIFY(container.size() == 10);
+		NOALLOC_VERIFY(container.removeAt(3));
+		VERIFY(Counted::instances == 9);
+		NOALLOC_VERIFY(container.clear());
+		VERIFY(Counted::instances == 0);
+	}
+
+	TESTSTEP("Heap objects in arena nodes and arena objects in heap nodes");
+	{
+		csjp::OwnerContainer<Counted> container(arena);
+		csjp::Object<Counted> c(new Counted(1));
+		container.add(c);
+		csjp::OwnerContainer<Counted> heap;
+		Counted * d = new(arena) Counted(2);
+		heap.add(d);
+		VERIFY(Counted::instances == 2);
+	}
+	VERIFY(Counted::instances == 0);
+}
+
+void TestArena::pool()
+{
+	csjp::Pool pool(40, 4);
+
+	TESTSTEP("Block size is rounded up to the alignment");
+	VERIFY(pool.size() == 48);
+	VERIFY(pool.reserved() == 0);
+
+	TESTSTEP("Blocks are cut one after the other from the slab");
+	char * a = (char *)pool.allocate();
+	char * b = (char *)pool.allocate();
+	VERIFY(((uintptr_t)a % csjp::Arena::alignment) == 0);
+	VERIFY(b == a + pool.size());
+	VERIFY(pool.reserved() == 4);
+	VERIFY(pool.allocated() == 2);
+
+	TESTSTEP("Freed block is reused first");
+	NOALLOC_VERIFY(pool.free(a));
+	VERIFY(pool.allocated() == 1);
+	NOALLOC_VERIFY(VERIFY(pool.allocate() == a));
+
+	TESTSTEP("Next slabs are doubled in size");
+	for(int i = 0; i < 3; i++)
+		pool.allocate();
+	VERIFY(pool.reserved() == 4 + 8);
+	VERIFY(pool.allocated() == 5);
+
+	TESTSTEP("Reset frees all the blocks and keeps the slabs");
+	NOALLOC_VERIFY(pool.reset());
+	VERIFY(pool.allocated() == 0);
+	VERIFY(pool.reserved() == 4 + 8);
+	NOALLOC_VERIFY(
+		VERIFY(pool.allocate() == a);
+		for(int i = 0; i < 11; i++)
+			pool.allocate();
+		);
+	VERIFY(pool.reserved() == 4 + 8);
+
+	TESTSTEP("Recycle keeps the slabs of a small pool");
+	NOALLOC_VERIFY(pool.recycle());
+	VERIFY(pool.reserved() == 4 + 8);
+
+	TESTSTEP("Release frees the slabs");
+	pool.release();
+	VERIFY(pool.reserved() == 0);
+	VERIFY(pool.allocated() == 0);
+
+	TESTSTEP("Recycle frees the slabs of a pool grown big");
+	for(size_t i = 0; i <= csjp::Pool::maxKeptBlocks; i++)
+		pool.allocate();
+	VERIFY(csjp::Pool::maxKeptBlocks < pool.reserved());
+	pool.recycle();
+	VERIFY(pool.reserved() == 0);
+	VERIFY(pool.allocated() == 0);
+}
+
+void TestArena::poolObject()
+{
+	csjp::Pool pool(csjp::ArenaObject::header + sizeof(Counted));
+	pool.free(pool.allocate()); // warm up
+
+	TESTSTEP("Objects created in the pool are given back by delete");
+	Counted * c = 0;
+	NOALLOC_VERIFY(c = new(pool) Counted(1));
+	VERIFY(pool.allocated() == 1);
+	NOALLOC_VERIFY(delete c);
+	VERIFY(pool.allocated() == 0);
+	VERIFY(Counted::instances == 0);
+
+	TESTSTEP("Object<> deletes pool objects too");
+	{
+		csjp::Object<Counted> o(new(pool) Counted(2));
+		VERIFY(pool.allocated() == 1);
+	}
+	VERIFY(pool.allocated() == 0);
+
+	TESTSTEP("Object bigger than the blocks is refused");
+	csjp::Pool small(8);
+	EXC_VERIFY(new(small) Counted(3), csjp::InvalidArgument);
+	VERIFY(Counted::instances == 0);
+}
+
+void TestArena::poolContainer()
+{
+	const unsigned count = 10000;
+	csjp::Arena arena;
+	warmUp(arena);
+	csjp::PodArray<Counted *> data;
+	data.setCapacity(count);
+
+	TESTSTEP("Cleared container reuses its nodes without the heap");
+	{
+		csjp::OwnerContainer<Counted> container;
+		for(unsigned i = 0; i < count; i++)
+			container.add(new(arena) Counted(i));
+		NOALLOC_VERIFY(container.clear());
+		VERIFY(Counted::instances == 0);
+		arena.reset();
+		NOALLOC_VERIFY(
+			for(unsigned i = 0; i < count; i++){
+				Counted * c = new(arena) Counted(i);
+				container.add(c);
+			}
+			);
+		VERIFY(container.size() == count);
+		IN_SAFEMODE(container.validity());
+
+		TESTSTEP("Removed nodes are reused");
+		NOALLOC_VERIFY(
+			for(unsigned i = 0; i < count / 2; i++)
+				container.removeAt(0);
+			for(unsigned i = 0; i < count / 2; i++){
+				Counted * c = new(arena) Counted(i);
+				container.add(c);
+			}
+			);
+		VERIFY(Counted::instances == count);
+
+		TESTSTEP("Moved container takes its nodes along");
+		csjp::OwnerContainer<Counted> moved(csjp::move_cast(container));
+		VERIFY(moved.size() == count);
+		container.add(new Counted(0));
+		moved = csjp::move_cast(container);
+		VERIFY(moved.size() == 1);
+		VERIFY(Counted::instances == 1);
+	}
+	VERIFY(Counted::instances == 0);
+	arena.reset();
+
+	TESTSTEP("Reference container");
+	{
+		for(unsigned i = 0; i < count; i++)
+			data.add(new(arena) Counted(i));
+		csjp::ReferenceContainer<Counted> container;
+		for(unsigned i = 0; i < count; i++)
+			container.add(*data[i]);
+		csjp::Stopper stopper;
+		NOALLOC_VERIFY(container.clear());
+		LOG("Clearing % nodes: % sec", count, stopper.stop());
+		NOALLOC_VERIFY(
+			for(unsigned i = 0; i < count; i++)
+				container.add(*data[i]);
+			);
+		csjp::ReferenceContainer<Counted> copy(container);
+		VERIFY(copy.size() == count);
+		VERIFY(Counted::instances == count);
+	}
+	for(unsigned i = 0; i < count; i++)
+		data[i]->~Counted();
+	data.clear();
+	arena.reset();
+
+	TESTSTEP("Sorter container keeps nodes and boxes in one pool");
+	{
+		csjp::SorterOwnerContainer<Counted> container;
+		for(unsigned i = 0; i < count; i++)
+			container.add(new(arena) Counted(count - i));
+		container.sort();
+		VERIFY(container.size() == count);
+		NOALLOC_VERIFY(container.clear());
+		VERIFY(Counted::instances == 0);
+		arena.reset();
+		NOALLOC_VERIFY(
+			for(unsigned i = 0; i < count; i++){
+				Counted * c = new(arena) Counted(i);
+				container.add(c);
+			}
+			);
+		VERIFY(container.queryAt(count - 1).i == (int)count - 1);
+		IN_SAFEMODE(container.validity());
+	}
+	VERIFY(Counted::instances == 0);
+
+	TESTSTEP("Value container");
+	{
+		csjp::ValueContainer<unsigned> container;
+		for(unsigned i = 0; i < count; i++)
+			container.add(i);
+		NOALLOC_VERIFY(container.clear());
+		NOALLOC_VERIFY(
+			for(unsigned i = 0; i < count; i++)
+				container.add(i);
+			);
+		VERIFY(container.size() == count);
+	}
+}
+
+void TestArena::speed()
+{
+	const unsigned count = 100000;
+	const char * text = "content-type: text/html; charset=UTF-8";
+	csjp::Arena arena;
+
+	csjp::Stopper stopper;
+	for(unsigned i = 0; i < count; i++){
+		csjp::Array<csjp::String> array;
+		for(int j = 0; j < 16; j++)
+			array.add(text);
+	}
+	double heap = stopper.stop();
+
+	stopper.restart();
+	unsigned long long before = testAllocations;
+	for(unsigned i = 0; i < count; i++){
+		{
+			csjp::Array<csjp::String> array(arena);
+			for(int j = 0; j < 16; j++){
+				array.add(arena);
+				array.last() << text;
+			}
+		}
+		arena.reset();
+	}
+	double inArena = stopper.stop();
+	VERIFY(testAllocations - before <= 1);
+
+	LOG("Array of 16 strings per sec: heap: %, arena: %",
+			count / heap, count / inArena);
+}
+
+TEST_INIT(Arena)
+
+	TEST_RUN(allocate);
+	TEST_RUN(reset);
+	TEST_RUN(arenaObject);
+	TEST_RUN(string);
+	TEST_RUN(array);
+	TEST_RUN(podArray);
+	TEST_RUN(container);
+	TEST_RUN(pool);
+	TEST_RUN(poolObject);
+	TEST_RUN(poolContainer);
+	TEST_RUN(speed);
+
+TEST_FINISH(Arena)
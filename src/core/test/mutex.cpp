@@ -3,14 +3,20 @@
  * Copyright (C) 2012 Csaszar, Peter
  */
 
+#include <pthread.h>
+
 #include <csjp_mutex.h>
 #include <csjp_string.h>
+#include <csjp_stopper.h>
 #include <csjp_test.h>
 
 class TestMutex
 {
 public:
 	void lock();
+	void counter();
+	void readWrite();
+	void contention();
 };
 
 void TestMutex::lock()
@@ -23,8 +29,137 @@ void TestMutex::lock()
 	LOG("Testing LOG macros with a simple string.");
 }
 
+template <typename MutexType>
+struct Shared
+{
+	MutexType mutex;
+	unsigned iterations;
+	unsigned long counter;
+};
+
+template <typename MutexType>
+static void * increment(void * arg)
+{
+	Shared<MutexType> & shared = *(Shared<MutexType> *)arg;
+	for(unsigned i = 0; i < shared.iterations; i++){
+		typename MutexType::Lock lock(shared.mutex);
+		shared.counter++;
+	}
+	return NULL;
+}
+
+/* Returns the lock and unlock pairs per second. */
+template <typename MutexType>
+static double run(unsigned threads, unsigned iterations)
+{
+	Shared<MutexType> shared;
+	shared.iterations = iterations;
+	shared.counter = 0;
+
+	pthread_t tids[threads];
+	csjp::Stopper stopper;
+	for(unsigned t = 0; t < threads; t++)
+		if(pthread_create(&tids[t], NULL, increment<MutexType>, &shared))
+			throw csjp::SystemError("Failed to create thread.");
+	for(unsigned t = 0; t < threads; t++)
+		pthread_join(tids[t], NULL);
+	double sec = stopper.stop();
+
+	VERIFY(shared.counter == (unsigned long)threads * iterations);
+	return threads * iterations / sec;
+}
+
+void TestMutex::counter()
+{
+	TESTSTEP("No increment is lost under any of the locks");
+	run<csjp::Mutex>(8, 20000);
+	run<csjp::TicketMutex>(8, 20000);
+	run<csjp::MCSMutex>(8, 20000);
+}
+
+struct RWShared
+{
+	csjp::RWMutex mutex;
+	unsigned a;
+	unsigned b;
+	unsigned inconsistent;
+	unsigned concurrentReaders;
+	unsigned maxConcurrentReaders;
+};
+
+static void * writer(void * arg)
+{
+	RWShared & shared = *(RWShared *)arg;
+	for(unsigned i = 0; i < 10000; i++){
+		csjp::RWMutex::WriteLock lock(shared.mutex);
+		shared.a++;
+		shared.b++;
+	}
+	return NULL;
+}
+
+static void * reader(void * arg)
+{
+	RWShared & shared = *(RWShared *)arg;
+	for(unsigned i = 0; i < 10000; i++){
+		csjp::RWMutex::ReadLock lock(shared.mutex);
+		unsigned readers = __sync_add_and_fetch(&shared.concurrentReaders, 1);
+		if(shared.maxConcurrentReaders < readers)
+			shared.maxConcurrentReaders = readers;
+		if(shared.a != shared.b)
+			__sync_add_and_fetch(&shared.inconsistent, 1);
+		__sync_sub_and_fetch(&shared.concurrentReaders, 1);
+	}
+	return NULL;
+}
+
+void TestMutex::readWrite()
+{
+	RWShared shared;
+	shared.a = 0;
+	shared.b = 0;
+	shared.inconsistent = 0;
+	shared.concurrentReaders = 0;
+	shared.maxConcurrentReaders = 0;
+
+	TESTSTEP("Readers share the lock");
+	{
+		csjp::RWMutex::ReadLock first(shared.mutex);
+		csjp::RWMutex::ReadLock second(shared.mutex);
+	}
+
+	TESTSTEP("Readers never see a half done write");
+	pthread_t tids[8];
+	for(unsigned t = 0; t < 8; t++)
+		if(pthread_create(&tids[t], NULL, t < 2 ? writer : reader, &shared))
+			throw csjp::SystemError("Failed to create thread.");
+	for(unsigned t = 0; t < 8; t++)
+		pthread_join(tids[t], NULL);
+	VERIFY(shared.a == 20000);
+	VERIFY(shared.b == 20000);
+	VERIFY(shared.inconsistent == 0);
+	LOG("Max concurrent readers: %", shared.maxConcurrentReaders);
+}
+
+void TestMutex::contention()
+{
+	/* The same amount of work is shared among the threads. */
+	const unsigned total = 400000;
+	for(unsigned threads = 1; threads <= 64; threads *= 2){
+		unsigned iterations = total / threads;
+		double adaptive = run<csjp::Mutex>(threads, iterations);
+		double ticket = run<csjp::TicketMutex>(threads, iterations);
+		double mcs = run<csjp::MCSMutex>(threads, iterations);
+		LOG("Threads: %, locks per sec: adaptive: %, ticket: %, mcs: %",
+				threads, adaptive, ticket, mcs);
+	}
+}
+
 TEST_INIT(Mutex)
 
 	TEST_RUN(lock);
+	TEST_RUN(counter);
+	TEST_RUN(readWrite);
+	TEST_RUN(contention);
 
 TEST_FINISH(Mutex)
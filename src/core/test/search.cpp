@@ -0,0 +1,230 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2016 Csaszar, Peter
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <csjp_search.h>
+#include <csjp_string.h>
+#include <csjp_stopper.h>
+#include <csjp_test.h>
+
+class TestSearch
+{
+public:
+	void kernels();
+	void fuzz();
+	void speed();
+};
+
+static const char * kernelName(csjp::SearchKernel kernel)
+{
+	switch(kernel){
+		case csjp::SearchKernel::AVX2 : return "AVX2";
+		case csjp::SearchKernel::SSE2 : return "SSE2";
+		default : return "Scalar";
+	}
+}
+
+static const csjp::SearchKernel allKernels[] = {
+	csjp::SearchKernel::Scalar,
+	csjp::SearchKernel::SSE2,
+	csjp::SearchKernel::AVX2
+};
+
+/* Straightforward reference implementations. */
+static bool inSet(char c, const char * set, size_t setLength)
+{
+	for(size_t i = 0; i < setLength; i++)
+		if(set[i] == c)
+			return true;
+	return false;
+}
+
+static const char * refFirstOf(const char * begin, const char * end,
+		const char * set, size_t setLength, bool notOf)
+{
+	for(; begin < end; begin++)
+		if(inSet(*begin, set, setLength) != notOf)
+			return begin;
+	return 0;
+}
+
+static const char * refLastOf(const char * begin, const char * end,
+		const char * set, size_t setLength, bool notOf)
+{
+	while(begin < end)
+		if(inSet(*--end, set, setLength) != notOf)
+			return end;
+	return 0;
+}
+
+static const char * refSearch(const char * begin, const char * end,
+		const char * str, size_t length)
+{
+	if(!length)
+		return 0;
+	for(const char * pos = begin; length <= (size_t)(end - pos); pos++)
+		if(!memcmp(pos, str, length))
+			return pos;
+	return 0;
+}
+
+static const char * refSearchLast(const char * begin, const char * end,
+		const char * str, size_t length)
+{
+	if(!length || (size_t)(end - begin) < length)
+		return 0;
+	for(const char * pos = end - length + 1; begin < pos; ){
+		pos--;
+		if(!memcmp(pos, str, length))
+			return pos;
+	}
+	return 0;
+}
+
+static size_t refCount(const char * begin, const char * end, const char * str, size_t length)
+{
+	size_t matches = 0;
+	const char * pos = begin;
+	while((pos = refSearch(pos, end, str, length))){
+		pos += length;
+		matches++;
+	}
+	return matches;
+}
+
+void TestSearch::kernels()
+{
+	TESTSTEP("Scalar kernel is always available");
+	csjp::SearchKernel detected = csjp::searchKernel();
+	LOG("Detected search kernel: %", kernelName(detected));
+	VERIFY(csjp::useSearchKernel(csjp::SearchKernel::Scalar));
+	VERIFY(csjp::searchKernel() == csjp::SearchKernel::Scalar);
+	VERIFY(csjp::useSearchKernel(detected));
+	VERIFY(csjp::searchKernel() == detected);
+}
+
+void TestSearch::fuzz()
+{
+	const unsigned rounds = 20000;
+	char hay[300];
+	char needle[40] = { 0 };
+
+	csjp::SearchKernel detected = csjp::searchKernel();
+	srand(1);
+	for(csjp::SearchKernel kernel : allKernels){
+		if(!csjp::useSearchKernel(kernel))
+			continue;
+		TESTSTEP("Compare % kernel with the reference", kernelName(kernel));
+
+		for(unsigned round = 0; round < rounds; round++){
+			/* Small alphabets give many partial matches. */
+			unsigned alphabet = 1 + rand() % 4;
+			size_t length = rand() % sizeof(hay);
+			for(size_t i = 0; i < length; i++)
+				hay[i] = 'a' + rand() % alphabet;
+			size_t from = length ? rand() % (length + 1) : 0;
+			size_t until = from + (length - from ? rand() % (length - from + 1) : 0);
+			const char * begin = hay + from;
+			const char * end = hay + until;
+
+			size_t needleLength = rand() % sizeof(needle);
+			if(rand() % 2 && needleLength < length){
+				size_t at = rand() % (length - needleLength + 1);
+				memcpy(needle, hay + at, needleLength);
+			} else
+				for(size_t i = 0; i < needleLength; i++)
+					needle[i] = 'a' + rand() % (alphabet + 1);
+
+			VERIFY(csjp::searchByte(begin, end, needle[0]) ==
+					refSearch(begin, end, needle, 1));
+			VERIFY(csjp::searchLastByte(begin, end, needle[0]) ==
+					refSearchLast(begin, end, needle, 1));
+			VERIFY(csjp::search(begin, end, needle, needleLength) ==
+					refSearch(begin, end, needle, needleLength));
+			VERIFY(csjp::searchLast(begin, end, needle, needleLength) ==
+					refSearchLast(begin, end, needle, needleLength));
+			VERIFY(csjp::countMatches(begin, end, needle, needleLength) ==
+					refCount(begin, end, needle, needleLength));
+
+			size_t setLength = rand() % 20;
+			VERIFY(csjp::searchFirstOf(begin, end, needle, setLength) ==
+					refFirstOf(begin, end, needle, setLength, false));
+			VERIFY(csjp::searchFirstNotOf(begin, end, needle, setLength) ==
+					refFirstOf(begin, end, needle, setLength, true));
+			VERIFY(csjp::searchLastOf(begin, end, needle, setLength) ==
+					refLastOf(begin, end, needle, setLength, false));
+			VERIFY(csjp::searchLastNotOf(begin, end, needle, setLength) ==
+					refLastOf(begin, end, needle, setLength, true));
+		}
+	}
+	csjp::useSearchKernel(detected);
+}
+
+void TestSearch::speed()
+{
+	const size_t size = 1024 * 1024;
+	const unsigned repeat = 200;
+	csjp::String text;
+	text.setCapacity(size);
+	/* HTTP header like text without the searched characters. */
+	while(text.length + 32 < size)
+		text << "content-type: text/plain; a=b; ";
+	text << "\r\n\r\n";
+	const char * begin = text.c_str();
+	const char * end = begin + text.length;
+	double megabytes = (double)text.length * repeat / (1024 * 1024);
+	csjp::SearchKernel detected = csjp::searchKernel();
+
+	for(csjp::SearchKernel kernel : allKernels){
+		if(!csjp::useSearchKernel(kernel))
+			continue;
+		csjp::Stopper stopper;
+		for(unsigned i = 0; i < repeat; i++)
+			VERIFY(csjp::searchByte(begin, end, '\r'));
+		double byte = stopper.stop();
+
+		stopper.restart();
+		for(unsigned i = 0; i < repeat; i++)
+			VERIFY(csjp::searchFirstOf(begin, end, "\r\n\"{", 4));
+		double of = stopper.stop();
+
+		stopper.restart();
+		for(unsigned i = 0; i < repeat; i++)
+			VERIFY(csjp::search(begin, end, "\r\n\r\n", 4));
+		double substring = stopper.stop();
+
+		stopper.restart();
+		for(unsigned i = 0; i < repeat; i++)
+			VERIFY(csjp::countMatches(begin, end, ";", 1));
+		double count = stopper.stop();
+
+		LOG("% kernel MiB/sec: byte: %, set of 4: %, substring: %, count: %",
+				kernelName(kernel), megabytes / byte, megabytes / of,
+				megabytes / substring, megabytes / count);
+	}
+
+	csjp::Stopper stopper;
+	for(unsigned i = 0; i < repeat; i++)
+		VERIFY(memchr(begin, '\r', end - begin));
+	double libcByte = stopper.stop();
+	stopper.restart();
+	for(unsigned i = 0; i < repeat; i++)
+		VERIFY(memmem(begin, end - begin, "\r\n\r\n", 4));
+	double libcSubstring = stopper.stop();
+	LOG("libc MiB/sec: memchr: %, memmem: %",
+			megabytes / libcByte, megabytes / libcSubstring);
+
+	csjp::useSearchKernel(detected);
+}
+
+TEST_INIT(Search)
+
+	TEST_RUN(kernels);
+	TEST_RUN(fuzz);
+	TEST_RUN(speed);
+
+TEST_FINISH(Search)
@@ -9,10 +9,14 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include <csjp_string.h>
+#include <csjp_stopper.h>
 #include <csjp_test.h>
 
+TEST_COUNT_ALLOCATIONS
+
 class TestString
 {
 public:
@@ -30,12 +34,17 @@ public:
 	void endsWith();
 	void count();
 	void capacity();
+	void inlineStorage();
+	void growthPolicy();
+	void allocationSpeed();
 	void fill();
 	void assign();
 	void shiftForward();
 	void shiftBackward();
 	void prepend();
 	void append();
+	void appendNumber();
+	void appendNumberSpeed();
 	void print();
 	void insert();
 	void erase();
@@ -51,6 +60,7 @@ public:
 	void adopt();
 	void swap();
 	void appendOperator();
+	void catf();
 	void conversionOperator();
 	void lowerUpper();
 	void exceptionLastMessage();
@@ -213,6 +223,16 @@ void TestString::findFirst()
 	VERIFY(pos == 100);
 	VERIFY(str.findFirst(pos, "k", 9));
 	VERIFY(pos == 11);
+
+	TESTSTEP("Match after a partial match");
+	csjp::String partial("aaab");
+	VERIFY(partial.findFirst(pos, "aab"));
+	VERIFY(pos == 1);
+	VERIFY(partial.findLast(pos, "aa"));
+	VERIFY(pos == 1);
+	csjp::String reverse("abbb");
+	VERIFY(reverse.findLast(pos, "abb"));
+	VERIFY(pos == 0);
 }
 
 void TestString::findFirstOf()
@@ -484,6 +504,154 @@ void TestString::capacity()
 	VERIFY(12 < str.capacity());
 }
 
+void TestString::inlineStorage()
+{
+	TESTSTEP("Short strings do not allocate");
+	unsigned long long before = testAllocations;
+	csjp::String str("content-type");
+	str << ": " << 42;
+	VERIFY(str == "content-type: 42");
+	VERIFY(str.isInline());
+	VERIFY(testAllocations == before);
+
+	TESTSTEP("Growing over the inline capacity moves to the heap");
+	before = testAllocations;
+	str << " and some more text";
+	VERIFY(str == "content-type: 42 and some more text");
+	VERIFY(!str.isInline());
+	VERIFY(testAllocations == before + 1);
+
+	TESTSTEP("Shrinking moves back to the inline storage");
+	str.setCapacity(7);
+	VERIFY(str == "content");
+	VERIFY(str.capacity() == 7);
+	VERIFY(str.isInline());
+
+	TESTSTEP("Moving an inline string");
+	csjp::String moved(csjp::move_cast(str));
+	VERIFY(moved == "content");
+	VERIFY(moved.isInline());
+	VERIFY(moved.c_str() != str.c_str());
+	VERIFY(str.c_str() == 0);
+	VERIFY(str.capacity() == 0);
+	csjp::String assigned("a longer string that lives on the heap");
+	assigned = csjp::move_cast(moved);
+	VERIFY(assigned == "content");
+	VERIFY(assigned.isInline());
+	VERIFY(moved.c_str() == 0);
+
+	TESTSTEP("Adopting over an inline string");
+	char * buf = (char *)malloc(8);
+	strcpy(buf, "adopted");
+	assigned.adopt(buf, 8);
+	VERIFY(buf == 0);
+	VERIFY(assigned == "adopted");
+	VERIFY(!assigned.isInline());
+}
+
+static size_t doubleGrowth(size_t capacity)
+{
+	return capacity * 2;
+}
+
+void TestString::growthPolicy()
+{
+	TESTSTEP("Growth policies");
+	VERIFY(csjp::String::defaultGrowth(100) == 200);
+	VERIFY(csjp::String::defaultGrowth(100000) == 110000);
+	VERIFY(csjp::String::geometricGrowth(100) == 150);
+	VERIFY(csjp::String::pageGrowth(100) == 4095);
+	VERIFY(csjp::String::pageGrowth(4095) == 4095);
+	VERIFY(csjp::String::pageGrowth(4096) == 8191);
+
+	TESTSTEP("Setting the growth policy");
+	VERIFY(csjp::String::growthPolicy() == csjp::String::defaultGrowth);
+	csjp::String::setGrowthPolicy(doubleGrowth);
+	csjp::String str;
+	str.extendCapacity(1000);
+	VERIFY(str.capacity() == 2000);
+	csjp::String::setGrowthPolicy(NULL);
+	VERIFY(csjp::String::growthPolicy() == csjp::String::defaultGrowth);
+}
+
+static const char * headerKeys[] = { "host", "user-agent", "accept", "accept-encoding",
+	"connection", "content-type", "content-length", "cache-control" };
+static const char * headerValues[] = { "localhost:8080", "curl/7.50.1", "*/*", "gzip",
+	"keep-alive", "application/json", "1024", "no-cache" };
+
+/* Splits and rebuilds a request header; keys and values are short strings. */
+static size_t httpWorkload()
+{
+	csjp::String header;
+	for(unsigned i = 0; i < 8; i++)
+		header.catf("%: %\r\n", headerKeys[i], headerValues[i]);
+	size_t sum = 0;
+	size_t pos = 0, end;
+	while(header.findFirst(end, "\r\n", pos)){
+		size_t colon;
+		header.findFirst(colon, ":", pos, end);
+		csjp::String key(header.read(pos, colon));
+		csjp::String value(header.read(colon + 2, end));
+		key.lower();
+		sum += key.length + value.length;
+		pos = end + 2;
+	}
+	return sum;
+}
+
+/* Builds an object of short keys and numeric values. */
+static size_t jsonWorkload()
+{
+	static const char * keys[] = { "id", "name", "price", "count", "tag", "owner" };
+	csjp::String json("{");
+	for(unsigned i = 0; i < 6; i++){
+		csjp::String key(keys[i]);
+		csjp::String value;
+		value << i * 1000 + 7;
+		json.catf("\"%\": %, ", key, value);
+	}
+	json << '}';
+	return json.length;
+}
+
+/* Appends small pieces to a growing string. */
+static size_t appendWorkload()
+{
+	csjp::String str;
+	for(unsigned i = 0; i < 4096; i++)
+		str << "0123456789abcdef";
+	return str.length;
+}
+
+static void measure(const char * name, size_t (*workload)(), unsigned count)
+{
+	unsigned long long before = testAllocations;
+	csjp::Stopper stopper;
+	size_t sum = 0;
+	for(unsigned i = 0; i < count; i++)
+		sum += workload();
+	double elapsed = stopper.stop();
+	VERIFY(sum);
+	LOG("% workload: % allocations / run, % runs / sec",
+			name, (double)(testAllocations - before) / count, count / elapsed);
+}
+
+void TestString::allocationSpeed()
+{
+	measure("HTTP", httpWorkload, 100000);
+	measure("JSON", jsonWorkload, 100000);
+
+	csjp::String::GrowthPolicy policies[] = { csjp::String::defaultGrowth,
+		csjp::String::geometricGrowth, csjp::String::pageGrowth };
+	const char * names[] = { "Append, default growth", "Append, geometric growth",
+		"Append, page growth" };
+	for(unsigned i = 0; i < 3; i++){
+		csjp::String::setGrowthPolicy(policies[i]);
+		measure(names[i], appendWorkload, 1000);
+	}
+	csjp::String::setGrowthPolicy(NULL);
+}
+
 void TestString::fill()
 {
 	TESTSTEP("init");
@@ -735,6 +903,149 @@ void TestString::append()
 	VERIFY(str == "-987654321");
 }
 
+void TestString::appendNumber()
+{
+	csjp::String str;
+
+	TESTSTEP("Integers");
+	str << 0u << ' ' << 7 << ' ' << 10 << ' ' << 99 << ' ' << 100 << ' ' << -12345;
+	VERIFY(str == "0 7 10 99 100 -12345");
+	str.clear();
+	str << (long long unsigned)18446744073709551615ULL << ' '
+		<< (long long int)(-9223372036854775807LL - 1);
+	VERIFY(str == "18446744073709551615 -9223372036854775808");
+
+	TESTSTEP("Integers with every number of digits");
+	long long unsigned n = 1;
+	for(unsigned digits = 1; digits < 20; digits++, n *= 10){
+		char buf[32];
+		str.clear();
+		str << n - 1;
+		snprintf(buf, sizeof(buf), "%llu", n - 1);
+		VERIFY(str == buf);
+		str.clear();
+		str << n;
+		snprintf(buf, sizeof(buf), "%llu", n);
+		VERIFY(str == buf);
+	}
+
+	TESTSTEP("Shortest form of doubles");
+	str.clear();
+	str << 0.0 << ' ' << -0.0 << ' ' << 1.0 << ' ' << 1.5 << ' ' << 0.1 << ' ' << -2.25;
+	VERIFY(str == "0 -0 1 1.5 0.1 -2.25");
+	str.clear();
+	str << 123456789012.0 << ' ' << 0.000001 << ' ' << 1e20 << ' ' << 1e21 << ' ' << 1.5e-7;
+	VERIFY(str == "123456789012 0.000001 100000000000000000000 1e+21 1.5e-7");
+	str.clear();
+	str << 1.7976931348623157e308 << ' ' << 5e-324 << ' ' << 0.30000000000000004;
+	VERIFY(str == "1.7976931348623157e+308 5e-324 0.30000000000000004");
+	str.clear();
+	str << NAN << ' ' << INFINITY << ' ' << -INFINITY;
+	VERIFY(str == "nan inf -inf");
+
+	TESTSTEP("Shortest form of floats");
+	str.clear();
+	str << 0.1f << ' ' << 3.14159f << ' ' << 16777216.0f << ' ' << 1e-45f;
+	VERIFY(str == "0.1 3.14159 16777216 1e-45");
+
+	TESTSTEP("Doubles read back to the same value");
+	srand(1);
+	for(unsigned i = 0; i < 100000; i++){
+		uint64_t bits = 0;
+		for(unsigned j = 0; j < 4; j++)
+			bits = (bits << 16) ^ (rand() & 0xFFFF);
+		double d;
+		memcpy(&d, &bits, sizeof(d));
+		if(isnan(d) || isinf(d))
+			continue;
+		str.clear();
+		str << d;
+		VERIFY(strtod(str.c_str(), NULL) == d);
+		VERIFY(str.length <= 25);
+	}
+
+	TESTSTEP("Floats read back to the same value");
+	for(unsigned i = 0; i < 100000; i++){
+		uint32_t bits = (rand() & 0xFFFF) << 16 | (rand() & 0xFFFF);
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+		if(isnan(f) || isinf(f))
+			continue;
+		str.clear();
+		str << f;
+		VERIFY(strtof(str.c_str(), NULL) == f);
+	}
+}
+
+/* The integer conversion before the digit pair tables. */
+static void legacyAppend(csjp::String & str, long long unsigned n)
+{
+	char buf[sizeof(long long unsigned) * 3 + 1];
+	memset(buf, ' ', sizeof(buf));
+	unsigned s = sizeof(buf) - 1;
+	buf[s--] = 0;
+	do {
+		buf[s--] = '0' + n % 10;
+		n /= 10;
+	} while(n);
+	str.append(buf + s + 1);
+}
+
+void TestString::appendNumberSpeed()
+{
+	const unsigned count = 1000000;
+	csjp::String str;
+	str.setCapacity(32);
+
+	csjp::Stopper stopper;
+	for(unsigned i = 0; i < count; i++){
+		str.cutAt(0);
+		str.appendPrintf("%llu", i * 2654435761ULL);
+	}
+	double printfInt = stopper.stop();
+
+	stopper.restart();
+	for(unsigned i = 0; i < count; i++){
+		str.cutAt(0);
+		legacyAppend(str, i * 2654435761ULL);
+	}
+	double legacyInt = stopper.stop();
+
+	stopper.restart();
+	for(unsigned i = 0; i < count; i++){
+		str.cutAt(0);
+		str << i * 2654435761ULL;
+	}
+	double fastInt = stopper.stop();
+
+	LOG("Integer to string: printf: % /sec, digit by digit: % /sec, digit pairs: % /sec",
+			count / printfInt, count / legacyInt, count / fastInt);
+
+	stopper.restart();
+	for(unsigned i = 0; i < count; i++){
+		str.cutAt(0);
+		str.appendPrintf("%.17g", i * 1.0001);
+	}
+	double printfDouble = stopper.stop();
+
+	stopper.restart();
+	for(unsigned i = 0; i < count; i++){
+		str.cutAt(0);
+		str.append((long double)(i * 1.0001));
+	}
+	double legacyDouble = stopper.stop();
+
+	stopper.restart();
+	for(unsigned i = 0; i < count; i++){
+		str.cutAt(0);
+		str << i * 1.0001;
+	}
+	double fastDouble = stopper.stop();
+
+	LOG("Double to string: printf: % /sec, fixed precision: % /sec, shortest: % /sec",
+			count / printfDouble, count / legacyDouble, count / fastDouble);
+}
+
 void TestString::print()
 {
 	csjp::String str;
@@ -1214,6 +1525,55 @@ void TestString::appendOperator()
 
 }
 
+void TestString::catf()
+{
+	csjp::String str;
+
+	TESTSTEP("Placeholders are replaced in order");
+	str.catf("a % b % c", 1, "two");
+	VERIFY(str == "a 1 b two c");
+
+	TESTSTEP("Escaped percent sign");
+	str.clear();
+	str.catf("%% % %", 10u, 20u);
+	VERIFY(str == "% 10 20");
+
+	TESTSTEP("Rest of format is copied as is after the last argument");
+	str.clear();
+	str.catf("% %%", 'x');
+	VERIFY(str == "x %%");
+	str.clear();
+	str.catf("100%%");
+	VERIFY(str == "100%%");
+
+	TESTSTEP("Trailing placeholder");
+	str.clear();
+	str.catf("value: %", -5);
+	VERIFY(str == "value: -5");
+
+	TESTSTEP("Arguments without placeholder are appended");
+	str.clear();
+	str.catf("% ", 1, 2, 3);
+	VERIFY(str == "1 23");
+	str.clear();
+	str.catf("none", 1, 2);
+	VERIFY(str == "none12");
+
+	TESTSTEP("Capacity is reserved once for known argument types");
+	str.clear();
+	csjp::String arg("an argument");
+	csjp::Str view("a view");
+	const char * fmt = "% and % and % and %";
+	str.catf(fmt, arg, view, 12345678901234LL, "literal");
+	VERIFY(str == "an argument and a view and 12345678901234 and literal");
+	VERIFY(str.capacity() == strlen(fmt) + arg.length + view.length + 20 + 7);
+
+	TESTSTEP("cat appends all arguments");
+	str.clear();
+	str.cat("a", 'b', arg, 15);
+	VERIFY(str == "aban argument15");
+}
+
 void TestString::conversionOperator()
 {
 	csjp::String str("0");
@@ -1233,6 +1593,43 @@ void TestString::conversionOperator()
 	str = "0";
 	i <<= str;
 	VERIFY(i == 0);
+
+	TESTSTEP("Conversions give the same as the C library");
+	const char * texts[] = { "", " ", "-", "+", ".", "x", "12x", "  \t\n-42 ", "+7",
+		"0012345678901234567", "123456781234567812345678", "9223372036854775807",
+		"9223372036854775808", "-9223372036854775808", "-9223372036854775809",
+		"18446744073709551615", "4294967295", "4294967296", "-1", "2147483648",
+		"1.5", "-0.0", ".25", "1.", "3.14159265358979323846", "1e5", "1e", "1e+",
+		"1.5E-3", "2.2250738585072014e-308", "4.9e-324", "1e400", "-1e-400",
+		"123456789012345678901234567890", "9007199254740993", "0.1", "0.3",
+		"1234567.1234567", "0x1A", "0x1p3", "inf", "-nan", "1e22", "1e23" };
+	for(const char * text : texts){
+		str = text;
+		long int l; l <<= str; VERIFY(l == atol(text));
+		long long int ll; ll <<= str; VERIFY(ll == atoll(text));
+		int in; in <<= str; VERIFY(in == atoi(text));
+		unsigned u; u <<= str; VERIFY(u == (unsigned)atol(text));
+		long long unsigned ull; ull <<= str;
+		VERIFY(ull == (long long unsigned)atoll(text));
+		double d; d <<= str;
+		double expected = strtod(text, 0);
+		VERIFY(d == expected || (isnan(d) && isnan(expected)));
+		VERIFY(signbit(d) == signbit(expected));
+		float f; f <<= str;
+		VERIFY(f == (float)atof(text) || isnan(f));
+		long double ld; ld <<= str;
+		VERIFY(ld == strtold(text, 0) || isnan(ld));
+	}
+
+	TESTSTEP("Convert a view without terminating zero");
+	csjp::Str view("1234567890123", 5);
+	long long int ll;
+	ll <<= view;
+	VERIFY(ll == 12345);
+	csjp::Str fraction("0.12345678", 4);
+	double d;
+	d <<= fraction;
+	VERIFY(d == 0.12);
 }
 
 void TestString::lowerUpper()
@@ -1309,12 +1706,17 @@ TEST_INIT(String)
 	TEST_RUN(endsWith);
 	TEST_RUN(count);
 	TEST_RUN(capacity);
+	TEST_RUN(inlineStorage);
+	TEST_RUN(growthPolicy);
+	TEST_RUN(allocationSpeed);
 	TEST_RUN(fill);
 	TEST_RUN(assign);
 	TEST_RUN(shiftForward);
 	TEST_RUN(shiftBackward);
 	TEST_RUN(prepend);
 	TEST_RUN(append);
+	TEST_RUN(appendNumber);
+	TEST_RUN(appendNumberSpeed);
 	TEST_RUN(print);
 	TEST_RUN(insert);
 	TEST_RUN(erase);
@@ -1330,6 +1732,7 @@ TEST_INIT(String)
 	TEST_RUN(adopt);
 	TEST_RUN(swap);
 	TEST_RUN(appendOperator);
+	TEST_RUN(catf);
 	TEST_RUN(conversionOperator);
 	TEST_RUN(lowerUpper);
 	TEST_RUN(exceptionLastMessage);
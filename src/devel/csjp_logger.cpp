@@ -7,8 +7,13 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/futex.h>
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <limits.h>
 
 #include <errno.h>
 #include <time.h>
@@ -26,25 +31,49 @@
 
 namespace csjp {
 
-static void dateStamp(char res[16])
+/* Date and time stamps are cached per thread. The date is recalculated only
+ * when the local midnight passes, the time of day only when the second
+ * changes. */
+struct StampCache
 {
-	time_t t = time(NULL);
-	strftime(res, 16, "%Y-%m-%d-%a", localtime(&t));
-}
+	time_t second;
+	time_t nextDay;
+	char date[16];
+	char time[16];
+	pid_t tid;
+};
+
+static __thread StampCache t_Stamps = { -1, 0, {0}, {0}, 0 };
+static pid_t g_Pid = 0;
 
-static void timeStamp(char res[16])
+static void stamps(const char *& date_stamp, const char *& time_stamp)
 {
-	char timeStr[8] = {0};
+	StampCache & c = t_Stamps;
 	timeval unixTime;
-
 	gettimeofday(&unixTime, NULL);
 	time_t t = unixTime.tv_sec;
 	int unixMillisecs = unixTime.tv_usec/1000;
-	struct tm _tm;
 
-	localtime_r(&t, &_tm);
-	strftime(timeStr, sizeof(timeStr), "%H:%M:%S", &_tm);
-	snprintf(res, 16, "%s:%03d", timeStr, unixMillisecs);
+	if(t != c.second){
+		struct tm _tm;
+		localtime_r(&t, &_tm);
+		if(c.nextDay <= t){ /* date rollover */
+			strftime(c.date, sizeof(c.date), "%Y-%m-%d-%a", &_tm);
+			struct tm midnight = _tm;
+			midnight.tm_sec = 0;
+			midnight.tm_min = 0;
+			midnight.tm_hour = 0;
+			midnight.tm_mday++;
+			midnight.tm_isdst = -1;
+			c.nextDay = mktime(&midnight);
+		}
+		strftime(c.time, sizeof(c.time), "%H:%M:%S", &_tm);
+		c.second = t;
+	}
+	snprintf(c.time + 8, sizeof(c.time) - 8, ":%03d", unixMillisecs);
+
+	date_stamp = c.date;
+	time_stamp = c.time;
 }
 
 static char g_LogDir[128] = {0};
@@ -54,9 +83,26 @@ static char g_BinaryName[64] = "unknown";
 bool verboseMode = false;
 bool haveLogDir = true;
 
+/* The log file is kept open. Whenever the name of it changes, the generation
+ * is increased, so that the writer reopens it on next write. The same happens
+ * on reopenLog() or when the writer finds that the file under the name is not
+ * the opened one anymore (rotated away). */
+static unsigned g_LogFileGeneration = 1;
+static unsigned g_LogFdGeneration = 0;
+static int g_LogFd = -1;
+static dev_t g_LogFdDev = 0;
+static ino_t g_LogFdIno = 0;
+static time_t g_LogFdCheckedAt = 0;
+
 void resetLogFileName()
 {
 	g_LogFileName[0] = 0;
+	__sync_fetch_and_add(&g_LogFileGeneration, 1);
+}
+
+void reopenLog()
+{
+	__sync_fetch_and_add(&g_LogFileGeneration, 1);
 }
 
 void setLogDir(const char * dir)
@@ -116,104 +162,496 @@ void setLogFileNameSpecializer(const char * str)
 	resetLogFileName();
 }
 
-static unsigned loggerMutex = 0; /* Initialized before main() */
-void msgLogger(FILE * stdfile, const char * string, size_t length)
+/* We need to have logging thread safe.
+ * We should not use posix mutex since that might fail, and
+ * on posix failure we should report the issue, thus call
+ * this logger. This would be a circular dependency and a
+ * possible place to have infinite recursion.
+ *
+ * So we are going to use gcc special low level atomic operations.
+ * http://gcc.gnu.org/onlinedocs/gcc-4.1.2/gcc/Atomic-Builtins.html#Atomic-Builtins
+ * type __sync_fetch_and_add (type *ptr, type value, ...)
+ * type __sync_fetch_and_sub (type *ptr, type value, ...)
+ *
+ * The writer lock protects the log file descriptor. In synchronous mode every
+ * logging thread takes it for a single write(), in asynchronous mode only the
+ * flusher thread (and flushLog()) takes it.
+ */
+#if not __GNUC__ >= 4
+#error "We need gcc 4 or later for __sync_fetch_and_add() and __sync_fetch_and_sub()"
+#endif
+static unsigned writerMutex = 0; /* Initialized before main() */
+
+static bool tryLockWriter()
 {
-	if(!length)
-		length = strlen(string);
+	if(__sync_fetch_and_add(&writerMutex, 1)){
+		__sync_fetch_and_sub(&writerMutex, 1);
+		return false;
+	}
+	return true;
+}
 
-	char header[64];
-	{
-		char time_stamp[16];
-		timeStamp(time_stamp);
+static void lockWriter()
+{
+	while(!tryLockWriter())
+		usleep(100);
+}
 
-		char date_stamp[16];
-		dateStamp(date_stamp);
+static void unlockWriter()
+{
+	__sync_fetch_and_sub(&writerMutex, 1);
+}
 
-		double c = (double)(clock())/(double)(CLOCKS_PER_SEC);
+/* Must be called with the writer lock held. At most once in a second it looks
+ * up the file name again, and if it is missing or names an other file than the
+ * opened one, the log was rotated, thus the file gets reopened. (A truncated
+ * file needs nothing, O_APPEND writes to its new end.) */
+static bool logFileRotated()
+{
+	struct timespec now;
+	if(clock_gettime(CLOCK_MONOTONIC_COARSE, &now) < 0 ||
+			now.tv_sec == g_LogFdCheckedAt)
+		return false;
+	g_LogFdCheckedAt = now.tv_sec;
+
+	struct stat fileStat;
+	if(stat(logFileName(), &fileStat) < 0)
+		return true;
+	return fileStat.st_ino != g_LogFdIno || fileStat.st_dev != g_LogFdDev;
+}
 
-		pid_t tid = syscall(SYS_gettid);
-		//syscall(SYS_tgkill, getpid(), tid, SIGHUP);
+/* Must be called with the writer lock held. */
+static bool prepareLogFd()
+{
+	if(!haveLogDir)
+		return false;
+	if(g_LogFdGeneration == g_LogFileGeneration && 0 <= g_LogFd &&
+			!logFileRotated())
+		return true;
+
+	if(0 <= g_LogFd){
+		TEMP_FAILURE_RETRY( close(g_LogFd) );
+		g_LogFd = -1;
+	}
+	g_LogFdGeneration = g_LogFileGeneration;
 
-		snprintf(header, sizeof(header), "%14s %12s %7.3f %5d %5d",
-				date_stamp, time_stamp, c, getpid(), tid);
+	const char * fileName = logFileName();
+	if(!fileName[0])
+		return false;
+
+	g_LogFd = open(fileName, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0666);
+	if(g_LogFd < 0){
+		if(stderr)
+			fprintf(stderr, VT_RED VT_TA_BOLD "ERROR" VT_NORMAL
+					" Could not open logfile: %s\n", fileName);
+		haveLogDir = false;
+		return false;
 	}
 
-	const char * fmt = "%s %s ";
+	struct stat fileStat;
+	if(0 <= fstat(g_LogFd, &fileStat)){
+		g_LogFdDev = fileStat.st_dev;
+		g_LogFdIno = fileStat.st_ino;
+	}
+	return true;
+}
 
-#if ! _ISOC99_SOURCE
-#error We need to use C99 for calculating printed number of characters with vsnprintf().
-#endif
+/* Must be called with the writer lock held. Returns false only on
+ * unrecoverable error. */
+static bool writeAll(struct iovec * iov, int iovcnt)
+{
+	while(iovcnt){
+		ssize_t written;
+		TEMP_FAILURE_RETRY_RESULT(written, writev(g_LogFd, iov, iovcnt));
+		if(written < 0)
+			return false;
+		while(iovcnt && (size_t)written >= iov->iov_len){
+			written -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if(iovcnt){
+			iov->iov_base = (char*)iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+	return true;
+}
 
-	/* Now lets calculate the amount of memory needed by the full log message. */
-	int size = 0;
-	size += strlen(fmt);
-	size += sizeof(header);
-	size += length;
+/* Asynchronous backend {{{
+ *
+ * Each producer thread owns a single producer single consumer byte ring.
+ * Only complete lines are published by moving the tail, so the flusher can
+ * write out everything between head and tail without looking into it.
+ * Rings are linked into a list by lock-free push; only the flusher unlinks.
+ * The producer publishes the tail and the consumer the head with release
+ * stores, the other side reads them with acquire loads.
+ */
 
-	/* Allocate memory */
-	char * msg = (char*)malloc(size);
-	if(!msg){
-		if(stderr)
-			fprintf(stderr, VT_RED VT_TA_BOLD "ERROR" VT_NORMAL
-					"No enoguh memory for log message!");
+struct LogRing
+{
+	char * buf;
+	size_t size; /* power of 2 */
+	size_t head; /* written by consumer */
+	size_t tail; /* written by producer */
+	bool orphan; /* producer thread exited */
+	LogRing * next;
+};
+
+static LogRing * g_LogRings = 0;
+static __thread LogRing * t_LogRing = 0;
+static pthread_key_t g_LogRingKey;
+static pthread_t g_Flusher;
+static bool g_AsyncLogging = false;
+static bool g_FlusherRunning = false;
+static size_t g_LogRingSize = 0;
+static unsigned g_FlushIntervalMillisecs = 0;
+static int g_LogWakeup = 0;
+static bool g_LogAtExitRegistered = false;
+static bool g_LogRingKeyCreated = false;
+
+static void wakeFlusher()
+{
+	int idle = 0;
+	if(__atomic_load_n(&g_LogWakeup, __ATOMIC_RELAXED) ||
+			!__atomic_compare_exchange_n(&g_LogWakeup, &idle, 1, false,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED))
 		return;
+	syscall(SYS_futex, &g_LogWakeup, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static void orphanLogRing(void * ring)
+{
+	__atomic_store_n(&((LogRing*)ring)->orphan, true, __ATOMIC_RELEASE);
+}
+
+static LogRing * threadLogRing()
+{
+	if(t_LogRing)
+		return t_LogRing;
+
+	LogRing * ring = (LogRing*)malloc(sizeof(LogRing));
+	if(!ring)
+		return 0;
+	ring->buf = (char*)malloc(g_LogRingSize);
+	if(!ring->buf){
+		free(ring);
+		return 0;
+	}
+	ring->size = g_LogRingSize;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->orphan = false;
+
+	ring->next = __atomic_load_n(&g_LogRings, __ATOMIC_RELAXED);
+	while(!__atomic_compare_exchange_n(&g_LogRings, &ring->next, ring, true,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+
+	pthread_setspecific(g_LogRingKey, ring);
+	t_LogRing = ring;
+	return ring;
+}
+
+/* Returns false if the message could not be queued. */
+static bool writeAsync(const char * msg, size_t len)
+{
+	LogRing * ring = threadLogRing();
+	if(!ring || ring->size < len)
+		return false;
+
+	size_t tail = ring->tail;
+	while(ring->size - (tail - __atomic_load_n(&ring->head,
+					__ATOMIC_ACQUIRE)) < len){
+		if(!__atomic_load_n(&g_AsyncLogging, __ATOMIC_ACQUIRE))
+			return false;
+		wakeFlusher();
+		usleep(100);
+	}
+
+	size_t pos = tail & (ring->size - 1);
+	size_t chunk = ring->size - pos;
+	if(len <= chunk)
+		memcpy(ring->buf + pos, msg, len);
+	else {
+		memcpy(ring->buf + pos, msg, chunk);
+		memcpy(ring->buf, msg + chunk, len - chunk);
+	}
+
+	__atomic_store_n(&ring->tail, tail + len, __ATOMIC_RELEASE);
+
+	if(ring->size / 2 < tail + len - __atomic_load_n(&ring->head,
+				__ATOMIC_RELAXED))
+		wakeFlusher();
+	return true;
+}
+
+/* Must be called with the writer lock held. Writes out everything published
+ * so far with as few writev() calls as possible and releases the rings of
+ * exited threads. */
+static void drainLogRings()
+{
+	struct iovec iov[IOV_MAX];
+	LogRing * rings[IOV_MAX / 2];
+	size_t tails[IOV_MAX / 2];
+	bool haveFd = prepareLogFd();
+
+	LogRing * ring = __atomic_load_n(&g_LogRings, __ATOMIC_ACQUIRE);
+	while(ring){
+		int iovcnt = 0;
+		unsigned nrings = 0;
+		for(; ring && nrings < IOV_MAX / 2; ring = ring->next){
+			size_t head = ring->head;
+			size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+			if(head == tail)
+				continue;
+
+			size_t pos = head & (ring->size - 1);
+			size_t len = tail - head;
+			size_t chunk = ring->size - pos;
+			iov[iovcnt].iov_base = ring->buf + pos;
+			iov[iovcnt].iov_len = len < chunk ? len : chunk;
+			iovcnt++;
+			if(chunk < len){
+				iov[iovcnt].iov_base = ring->buf;
+				iov[iovcnt].iov_len = len - chunk;
+				iovcnt++;
+			}
+			rings[nrings] = ring;
+			tails[nrings] = tail;
+			nrings++;
+		}
+
+		if(haveFd && iovcnt)
+			writeAll(iov, iovcnt);
+
+		for(unsigned i = 0; i < nrings; i++)
+			__atomic_store_n(&rings[i]->head, tails[i], __ATOMIC_RELEASE);
 	}
 
-	/* Compose the log message */
-	int len = snprintf(msg, size, fmt, header, string);
-	if(len < 0){
+	/* Release the drained rings of exited threads. */
+	LogRing ** link = &g_LogRings;
+	while((ring = __atomic_load_n(link, __ATOMIC_ACQUIRE))){
+		if(!__atomic_load_n(&ring->orphan, __ATOMIC_ACQUIRE) ||
+				ring->head != __atomic_load_n(&ring->tail,
+					__ATOMIC_ACQUIRE)){
+			link = &ring->next;
+			continue;
+		}
+		if(link == &g_LogRings){
+			LogRing * first = ring;
+			if(!__atomic_compare_exchange_n(&g_LogRings, &first, ring->next,
+						false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+				continue; /* a new ring was pushed, retry from new head */
+		} else
+			*link = ring->next;
+		free(ring->buf);
+		free(ring);
+	}
+}
+
+/* The lines already queued in the rings go first, so the lines of a thread
+ * do not get out of order when one of them is too long for its ring. */
+static void writeSync(const char * msg, size_t len)
+{
+	lockWriter();
+	if(__atomic_load_n(&g_LogRings, __ATOMIC_ACQUIRE))
+		drainLogRings();
+	if(prepareLogFd()){
+		struct iovec iov = { (void*)msg, len };
+		writeAll(&iov, 1);
+	}
+	unlockWriter();
+}
+
+static void * logFlusher(void *)
+{
+	while(__atomic_load_n(&g_FlusherRunning, __ATOMIC_ACQUIRE)){
+		if(!__atomic_load_n(&g_LogWakeup, __ATOMIC_ACQUIRE)){
+			timespec timeout;
+			timeout.tv_sec = g_FlushIntervalMillisecs / 1000;
+			timeout.tv_nsec = (g_FlushIntervalMillisecs % 1000) * 1000000;
+			syscall(SYS_futex, &g_LogWakeup, FUTEX_WAIT_PRIVATE, 0,
+					&timeout, NULL, 0);
+		}
+		__atomic_store_n(&g_LogWakeup, 0, __ATOMIC_RELAXED);
+
+		lockWriter();
+		drainLogRings();
+		unlockWriter();
+	}
+	return 0;
+}
+
+/* The flusher thread is not inherited by a forked child. Lines queued before
+ * the fork are written out by the parent, so the child drops them and
+ * continues in synchronous mode. */
+static void logForkChild()
+{
+	g_Pid = 0;
+	t_Stamps.tid = 0;
+	writerMutex = 0;
+	if(!__atomic_load_n(&g_AsyncLogging, __ATOMIC_ACQUIRE))
+		return;
+	__atomic_store_n(&g_AsyncLogging, false, __ATOMIC_RELEASE);
+	__atomic_store_n(&g_FlusherRunning, false, __ATOMIC_RELEASE);
+	for(LogRing * ring = g_LogRings; ring; ring = ring->next)
+		__atomic_store_n(&ring->head, ring->tail, __ATOMIC_RELAXED);
+}
+
+/* Takes the writer lock from the flusher with bounded waiting and drains
+ * the rings in the calling thread. */
+static bool drainLogRingsWithin(unsigned timeoutMillisecs)
+{
+	unsigned waited = 0;
+	while(!tryLockWriter()){
+		if(timeoutMillisecs <= waited / 10)
+			return false;
+		usleep(100);
+		waited++;
+	}
+	drainLogRings();
+	unlockWriter();
+	return true;
+}
+
+/* Joining the flusher might block for unbounded time on a stalled disk,
+ * thus at exit we only do a bounded flush. */
+static void logAtExit()
+{
+	if(!__atomic_load_n(&g_AsyncLogging, __ATOMIC_ACQUIRE))
+		return;
+	__atomic_store_n(&g_AsyncLogging, false, __ATOMIC_RELEASE);
+	__atomic_store_n(&g_FlusherRunning, false, __ATOMIC_RELEASE);
+	wakeFlusher();
+	drainLogRingsWithin(100);
+}
+
+void startAsyncLogging(size_t ringSize, unsigned flushIntervalMillisecs)
+{
+	if(__atomic_load_n(&g_AsyncLogging, __ATOMIC_ACQUIRE))
+		return;
+
+	size_t size = 4096;
+	while(size < ringSize)
+		size *= 2;
+	g_LogRingSize = size;
+	g_FlushIntervalMillisecs = flushIntervalMillisecs ? flushIntervalMillisecs : 1;
+
+	if(!g_LogRingKeyCreated){
+		if(pthread_key_create(&g_LogRingKey, orphanLogRing))
+			return;
+		pthread_atfork(NULL, NULL, logForkChild);
+		g_LogRingKeyCreated = true;
+	}
+
+	__atomic_store_n(&g_FlusherRunning, true, __ATOMIC_RELEASE);
+	if(pthread_create(&g_Flusher, NULL, logFlusher, NULL)){
+		__atomic_store_n(&g_FlusherRunning, false, __ATOMIC_RELEASE);
 		if(stderr)
 			fprintf(stderr, VT_RED VT_TA_BOLD "ERROR" VT_NORMAL
-					"Failed to snprintf the log message and its header!\n");
-		free(msg);
+					" Could not start log flusher thread.\n");
 		return;
 	}
+	__atomic_store_n(&g_AsyncLogging, true, __ATOMIC_RELEASE);
 
-	msg[len++] = '\n';
-	msg[len] = 0;
+	if(!g_LogAtExitRegistered){
+		atexit(logAtExit);
+		g_LogAtExitRegistered = true;
+	}
+}
 
-	/* We need to have logging thread safe.
-	 * We should not use posix mutex since that might fail, and
-	 * on posix failure we should report the issue, thus call
-	 * this logger. This would be a circular dependency and a
-	 * possible place to have infinite recursion.
-	 *
-	 * So we are going to use gcc special low level atomic operations.
-	 * http://gcc.gnu.org/onlinedocs/gcc-4.1.2/gcc/Atomic-Builtins.html#Atomic-Builtins
-	 * type __sync_fetch_and_add (type *ptr, type value, ...)
-	 * type __sync_fetch_and_sub (type *ptr, type value, ...)
-	 */
-#if not __GNUC__ >= 4
-#error "We need gcc 4 or later for __sync_fetch_and_add() and __sync_fetch_and_sub()"
-#endif
-	unsigned loggerMutexLast = 1;
-	while(loggerMutexLast){
-		loggerMutexLast = __sync_fetch_and_add(&loggerMutex, 1);
-		if(loggerMutexLast){
-			__sync_fetch_and_sub(&loggerMutex, 1);
-			usleep(100);
+void stopAsyncLogging()
+{
+	if(!__atomic_load_n(&g_AsyncLogging, __ATOMIC_ACQUIRE))
+		return;
+
+	__atomic_store_n(&g_AsyncLogging, false, __ATOMIC_RELEASE);
+	__atomic_store_n(&g_FlusherRunning, false, __ATOMIC_RELEASE);
+	wakeFlusher();
+	pthread_join(g_Flusher, NULL);
+
+	lockWriter();
+	drainLogRings();
+	unlockWriter();
+}
+
+bool flushLog(unsigned timeoutMillisecs)
+{
+	if(!__atomic_load_n(&g_AsyncLogging, __ATOMIC_ACQUIRE))
+		return true;
+
+	return drainLogRingsWithin(timeoutMillisecs);
+}
+
+bool asyncLogging()
+{
+	return __atomic_load_n(&g_AsyncLogging, __ATOMIC_ACQUIRE);
+}
+
+/*}}}*/
+
+void msgLogger(FILE * stdfile, const char * string, size_t length)
+{
+	if(!length)
+		length = strlen(string);
+
+	char header[64];
+	int headerLen;
+	{
+		const char * time_stamp;
+		const char * date_stamp;
+		stamps(date_stamp, time_stamp);
+
+		double c = (double)(clock())/(double)(CLOCKS_PER_SEC);
+
+		if(!g_Pid)
+			g_Pid = getpid();
+		if(!t_Stamps.tid)
+			t_Stamps.tid = syscall(SYS_gettid);
+		//syscall(SYS_tgkill, getpid(), tid, SIGHUP);
+
+		headerLen = snprintf(header, sizeof(header), "%14s %12s %7.3f %5d %5d ",
+				date_stamp, time_stamp, c, g_Pid, t_Stamps.tid);
+		if(headerLen < 0 || (int)sizeof(header) <= headerLen){
+			if(stderr)
+				fprintf(stderr, VT_RED VT_TA_BOLD "ERROR" VT_NORMAL
+						"Failed to snprintf the log message header!\n");
+			return;
 		}
 	}
 
-	if(haveLogDir && logFileName()[0]){
-		FILE *log = fopen(logFileName(), "a");
-		if(log){
-			fputs(msg, log);
-			fflush(log);
-			TEMP_FAILURE_RETRY( fclose(log) );
-		} else if(stderr) {
-			fprintf(stderr, VT_RED VT_TA_BOLD "ERROR" VT_NORMAL
-					" Could not open logfile: %s\n", logFileName());
-			haveLogDir = false;
+	/* Compose the log message. Most of the messages fit into the stack. */
+	char stackMsg[1024];
+	size_t size = headerLen + length + 3;
+	char * msg = stackMsg;
+	if(sizeof(stackMsg) < size){
+		msg = (char*)malloc(size);
+		if(!msg){
+			if(stderr)
+				fprintf(stderr, VT_RED VT_TA_BOLD "ERROR" VT_NORMAL
+						"No enoguh memory for log message!");
+			return;
 		}
 	}
 
-	basicLogger(msg, stdfile, g_BinaryName);
+	size_t len = headerLen;
+	memcpy(msg, header, len);
+	memcpy(msg + len, string, length);
+	len += length;
+	msg[len++] = ' ';
+	msg[len++] = '\n';
+	msg[len] = 0;
+
+	if(haveLogDir && logFileName()[0])
+		if(!__atomic_load_n(&g_AsyncLogging, __ATOMIC_ACQUIRE) ||
+				!writeAsync(msg, len))
+			writeSync(msg, len);
 
-	__sync_fetch_and_sub(&loggerMutex, 1);
+	basicLogger(msg, stdfile, g_BinaryName);
 
-	free(msg);
+	if(msg != stackMsg)
+		free(msg);
 }
 
 }
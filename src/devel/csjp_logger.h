@@ -19,10 +19,31 @@ const char * getBinaryName() __attribute__ ((no_instrument_function));
 const char * logFileName() __attribute__ ((no_instrument_function));
 void setLogFileNameSpecializer(const char * str = 0) __attribute__ ((no_instrument_function));
 
-/** Thread safe. */
+/** Makes the next write reopen the log file, like after a change of its name.
+ * Async signal safe, so can be called from a SIGHUP handler after the log file
+ * was rotated. A rotation by renaming or removing the file is also noticed
+ * within a second without calling this. */
+void reopenLog() __attribute__ ((no_instrument_function));
+
+/** Thread safe. The log file is kept open between calls. */
 void msgLogger(FILE * stdfile, const char * msg, size_t len = 0)
 		__attribute__ ((no_instrument_function));
 
+/** From now on msgLogger() only copies the message into a per thread lock-free
+ * ring buffer of (at least) ringSize bytes. A background thread writes them
+ * into the log file with batched writev() in every flushIntervalMillisecs or
+ * when any ring gets half full. Messages longer than the ring are written
+ * synchronously. */
+void startAsyncLogging(size_t ringSize = 64 * 1024, unsigned flushIntervalMillisecs = 100)
+		__attribute__ ((no_instrument_function));
+/** Stops the background thread after writing out all the queued messages. */
+void stopAsyncLogging() __attribute__ ((no_instrument_function));
+/** Writes out all the queued messages in the calling thread. Waits at most
+ * timeoutMillisecs for the background thread to finish its current write.
+ * Returns false on timeout. */
+bool flushLog(unsigned timeoutMillisecs = 100) __attribute__ ((no_instrument_function));
+bool asyncLogging() __attribute__ ((no_instrument_function));
+
 extern bool verboseMode;
 
 }
@@ -65,6 +65,34 @@
 					throw (csjp::Exception &&)e; \
 				}
 
+/* Replaces malloc() and realloc() with ones counting the heap allocations of the
+ * library and the test in testAllocations. To be used once in the test at file
+ * scope. */
+#define TEST_COUNT_ALLOCATIONS \
+	extern "C" void * __libc_malloc(size_t size); \
+	extern "C" void * __libc_realloc(void * ptr, size_t size); \
+	static unsigned long long testAllocations = 0; \
+	extern "C" void * malloc(size_t size) \
+	{ \
+		testAllocations++; \
+		return __libc_malloc(size); \
+	} \
+	extern "C" void * realloc(void * ptr, size_t size) \
+	{ \
+		testAllocations++; \
+		return __libc_realloc(ptr, size); \
+	}
+
+/* Excepts the call not to allocate from the heap. */
+#define NOALLOC_VERIFY(call)	{ \
+					unsigned long long before = testAllocations; \
+					call; \
+					if(testAllocations != before) \
+						throw csjp::TestFailure("Heap allocation " \
+							"by '" #call "' at line " \
+							STRING(__LINE__) " in file " __FILE__); \
+				}
+
 /* Starts the main() function, instantiates TestObj object. */
 #define TEST_INIT(obj)	int main(int argc, char *args[]) \
 			{ \
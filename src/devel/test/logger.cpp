@@ -0,0 +1,229 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2016 Csaszar, Peter
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <csjp_logger.h>
+#include <csjp_stopper.h>
+#include <csjp_file.h>
+#include <csjp_test.h>
+
+class TestLogger
+{
+public:
+	void sync();
+	void async();
+	void asyncThreads();
+	void flush();
+	void speed();
+};
+
+static const char * testLine = "Some usual log line with a few words in it.";
+
+static csjp::String useLogFile(const char * specializer)
+{
+	csjp::setLogDir(TESTDIR);
+	csjp::setLogFileNameSpecializer(specializer);
+	csjp::String name(csjp::logFileName());
+	csjp::File file(name);
+	if(file.exists())
+		file.unlink();
+	return name;
+}
+
+static size_t numOfLines(const csjp::String & fileName)
+{
+	csjp::File file(fileName);
+	if(!file.exists())
+		return 0;
+	return file.readAll().count(testLine);
+}
+
+static void * logLines(void * arg)
+{
+	unsigned lines = *(unsigned*)arg;
+	for(unsigned i = 0; i < lines; i++)
+		csjp::msgLogger(NULL, testLine);
+	return 0;
+}
+
+/* The implementation before the asynchronous backend: reopens the log file
+ * for every line under a spin lock. Kept here as a reference for speed(). */
+static unsigned legacyMutex = 0;
+static void legacyMsgLogger(const char * msg)
+{
+	while(__sync_fetch_and_add(&legacyMutex, 1)){
+		__sync_fetch_and_sub(&legacyMutex, 1);
+		usleep(100);
+	}
+	FILE * log = fopen(csjp::logFileName(), "a");
+	if(log){
+		fputs(msg, log);
+		fflush(log);
+		fclose(log);
+	}
+	__sync_fetch_and_sub(&legacyMutex, 1);
+}
+
+static void * legacyLogLines(void * arg)
+{
+	unsigned lines = *(unsigned*)arg;
+	char msg[128];
+	for(unsigned i = 0; i < lines; i++){
+		snprintf(msg, sizeof(msg), "%14s %12s %7.3f %5d %5d %s \n",
+				"2016-01-01-Fri", "12:00:00:000", 0.0, 1, 1, testLine);
+		legacyMsgLogger(msg);
+	}
+	return 0;
+}
+
+static double runThreads(void * (*func)(void *), unsigned threads, unsigned lines)
+{
+	pthread_t tids[threads];
+	csjp::Stopper stopper;
+	for(unsigned t = 0; t < threads; t++)
+		if(pthread_create(&tids[t], NULL, func, &lines))
+			throw csjp::TestFailure("Failed to create thread.");
+	for(unsigned t = 0; t < threads; t++)
+		pthread_join(tids[t], NULL);
+	return stopper.stop();
+}
+
+void TestLogger::sync()
+{
+	csjp::String fileName = useLogFile("sync");
+
+	TESTSTEP("Log lines with kept open log file");
+	VERIFY(!csjp::asyncLogging());
+	for(unsigned i = 0; i < 100; i++)
+		csjp::msgLogger(NULL, testLine);
+	VERIFY(numOfLines(fileName) == 100);
+
+	TESTSTEP("Changing log file name reopens the file");
+	csjp::String otherName = useLogFile("sync-other");
+	csjp::msgLogger(NULL, testLine);
+	VERIFY(numOfLines(otherName) == 1);
+	VERIFY(numOfLines(fileName) == 100);
+
+	TESTSTEP("Rotated log file is reopened on request");
+	csjp::String rotatedName(otherName);
+	rotatedName.append(".1");
+	csjp::File(otherName).rename(rotatedName);
+	csjp::reopenLog();
+	csjp::msgLogger(NULL, testLine);
+	VERIFY(numOfLines(otherName) == 1);
+	VERIFY(numOfLines(rotatedName) == 1);
+
+	TESTSTEP("Rotated log file is reopened without request within a second");
+	csjp::File(rotatedName).unlink();
+	csjp::File(otherName).rename(rotatedName);
+	usleep(1100 * 1000);
+	csjp::msgLogger(NULL, testLine);
+	VERIFY(numOfLines(otherName) == 1);
+	VERIFY(numOfLines(rotatedName) == 1);
+	csjp::File(rotatedName).unlink();
+}
+
+void TestLogger::async()
+{
+	csjp::String fileName = useLogFile("async");
+
+	TESTSTEP("Log lines asynchronously");
+	csjp::startAsyncLogging();
+	VERIFY(csjp::asyncLogging());
+	for(unsigned i = 0; i < 1000; i++)
+		csjp::msgLogger(NULL, testLine);
+	csjp::stopAsyncLogging();
+	VERIFY(!csjp::asyncLogging());
+	VERIFY(numOfLines(fileName) == 1000);
+
+	TESTSTEP("Lines longer than the ring are written synchronously, in order");
+	csjp::startAsyncLogging(4096, 60 * 1000);
+	usleep(10000); /* let the flusher go to sleep */
+	csjp::msgLogger(NULL, "Queued before the long line.");
+	csjp::String longLine;
+	longLine.fill('x', 128 * 1024);
+	longLine.append(testLine);
+	csjp::msgLogger(NULL, longLine.c_str(), longLine.length);
+	VERIFY(numOfLines(fileName) == 1001);
+	{
+		csjp::String content(csjp::File(fileName).readAll());
+		size_t queued, queuedLong;
+		VERIFY(content.findFirst(queued, "Queued before the long line."));
+		VERIFY(content.findFirst(queuedLong, "xxxx"));
+		VERIFY(queued < queuedLong);
+	}
+	csjp::stopAsyncLogging();
+}
+
+void TestLogger::asyncThreads()
+{
+	csjp::String fileName = useLogFile("async-threads");
+
+	TESTSTEP("Log lines asynchronously from many threads with small rings");
+	csjp::startAsyncLogging(4096, 10);
+	runThreads(logLines, 8, 2000);
+	csjp::stopAsyncLogging();
+	VERIFY(numOfLines(fileName) == 8 * 2000);
+
+	TESTSTEP("Rings of exited threads are reused after restart");
+	csjp::startAsyncLogging(4096, 10);
+	runThreads(logLines, 8, 10);
+	csjp::stopAsyncLogging();
+	VERIFY(numOfLines(fileName) == 8 * 2010);
+}
+
+void TestLogger::flush()
+{
+	csjp::String fileName = useLogFile("flush");
+
+	TESTSTEP("Queued lines are written by flushLog without waiting for the flusher");
+	csjp::startAsyncLogging(64 * 1024, 60 * 1000);
+	usleep(10000); /* let the flusher go to sleep */
+	for(unsigned i = 0; i < 10; i++)
+		csjp::msgLogger(NULL, testLine);
+	VERIFY(csjp::flushLog());
+	VERIFY(numOfLines(fileName) == 10);
+	csjp::stopAsyncLogging();
+}
+
+void TestLogger::speed()
+{
+	const unsigned lines = 20000;
+	unsigned threadCounts[] = { 1, 4 };
+
+	for(unsigned threads : threadCounts){
+		useLogFile("speed");
+		double legacy = runThreads(legacyLogLines, threads, lines);
+
+		useLogFile("speed");
+		double sync = runThreads(logLines, threads, lines);
+
+		useLogFile("speed");
+		csjp::Stopper stopper;
+		csjp::startAsyncLogging();
+		double async = runThreads(logLines, threads, lines);
+		csjp::stopAsyncLogging();
+		double asyncFlushed = stopper.stop();
+
+		useLogFile("speed");
+
+		double all = threads * lines;
+		LOG("% threads: reopen per line: % lines/sec, kept open: % lines/sec, "
+				"async: % lines/sec (% lines/sec with final flush)",
+				threads, all / legacy, all / sync, all / async, all / asyncFlushed);
+	}
+}
+
+TEST_INIT(Logger)
+
+	TEST_RUN(sync);
+	TEST_RUN(async);
+	TEST_RUN(asyncThreads);
+	TEST_RUN(flush);
+	TEST_RUN(speed);
+
+TEST_FINISH(Logger)
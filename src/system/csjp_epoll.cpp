@@ -35,12 +35,47 @@ EPoll::EPoll(unsigned maxEvents) :
 		throw SocketError(errno, "epoll_create1() failed");
 }
 
+const char * epollEventMap(int event)
+{
+	switch(event)
+	{
+		case EPOLLERR : return "EPOLLERR"; break;
+		case EPOLLHUP : return "EPOLLHUP"; break;
+		case EPOLLIN : return "EPOLLIN"; break;
+		case EPOLLOUT : return "EPOLLOUT"; break;
+		case EPOLLRDHUP : return "EPOLLRDHUP"; break;
+		case EPOLLPRI : return "EPOLLPRI"; break;
+		case EPOLLET : return "EPOLLET"; break;
+		case EPOLLONESHOT : return "EPOLLONESHOT"; break;
+		default: return "UNKNOWN"; break;
+	}
+}
+
+static bool isSocketListening(int file)
+{
+	if(file < 0)
+		throw InvalidState("Socket is closed.");
+
+	int val;
+	socklen_t len = sizeof(val);
+	if(getsockopt(file, SOL_SOCKET, SO_ACCEPTCONN, &val, &len) == -1){
+		if(errno == ENOTSOCK) // like eventfd
+			return false;
+		throw SocketError(errno,
+				"Failed to query if socket is listening.");
+	}
+	if(val)
+		return true;
+	return false;
+}
+
 void EPoll::add(Socket & socket)
 {
 	struct epoll_event ev;
 
 	ev.events = EPOLL_EDGE_TRIGGERED | EPOLLIN | EPOLLOUT;
 	ev.data.ptr = &socket;
+	socket.listening = isSocketListening(socket.file);
 	if(epoll_ctl(file, EPOLL_CTL_ADD, socket.file, &ev) == -1)
 		throw SocketError(errno, "Failed to add a socket to epoll.");
 	//DBG("Added fd: %", socket.file);
@@ -79,79 +114,19 @@ void EPoll::remove(Socket & socket)
 				"Failed to remove a socket from epoll.");
 }
 
-const char * epollEventMap(int event)
-{
-	switch(event)
-	{
-		case EPOLLERR : return "EPOLLERR"; break;
-		case EPOLLHUP : return "EPOLLHUP"; break;
-		case EPOLLIN : return "EPOLLIN"; break;
-		case EPOLLOUT : return "EPOLLOUT"; break;
-		case EPOLLRDHUP : return "EPOLLRDHUP"; break;
-		case EPOLLPRI : return "EPOLLPRI"; break;
-		case EPOLLET : return "EPOLLET"; break;
-		case EPOLLONESHOT : return "EPOLLONESHOT"; break;
-		default: return "UNKNOWN"; break;
-	}
-}
-
-bool isSocketListening(int file)
-{
-	if(file < 0)
-		throw InvalidState("Socket is closed.");
-
-	int val;
-	socklen_t len = sizeof(val);
-	if(getsockopt(file, SOL_SOCKET, SO_ACCEPTCONN, &val, &len) == -1)
-		throw SocketError(errno,
-				"Failed to query if socket is listening.");
-	if(val)
-		return true;
-	return false;
-}
-
-Array<EPoll::Event> EPoll::wait(int timeout)
+unsigned EPoll::waitForEvents(int timeout)
 {
 	int nfds = 0;
 	TEMP_FAILURE_RETRY_RESULT(nfds, epoll_wait(file, events.ptr, events.size, timeout));
 	if(nfds == -1)
 		throw SocketError(errno, "epoll wait failure");
+	return nfds;
+}
 
+Array<EPoll::Event> EPoll::wait(int timeout)
+{
 	Array<EPoll::Event> list;
-	for(int i = 0; i < nfds; ++i){
-		Socket & socket = *((Socket*)(events.ptr[i].data.ptr));
-		int e = events.ptr[i].events;
-
-		//DBG("epoll event: %-% fd:%",epollEventMap(e),e,socket.file);
-
-		if((e & EPOLLRDHUP) == EPOLLRDHUP){
-			list.add(Event(socket, EventCode::ReadHangup));
-			continue;
-		}
-
-		if((e & EPOLLHUP) == EPOLLHUP){
-			list.add(Event(socket, EventCode::Hangup));
-			continue;
-		}
-
-		if((e & EPOLLERR) == EPOLLERR){
-			list.add(Event(socket, EventCode::Error));
-			continue;
-		}
-
-		bool listening = isSocketListening(socket.file);
-		if(listening && ((e & EPOLLIN) == EPOLLIN))
-			list.add(Event(socket, EventCode::IncomingConnection));
-		if(listening)
-			continue;
-
-		if((e & EPOLLIN) == EPOLLIN)
-			list.add(Event(socket, EventCode::DataIn));
-
-		if((e & EPOLLOUT) == EPOLLOUT)
-			list.add(Event(socket, EventCode::DataOut));
-	}
-
+	dispatch([&list](Event & event){ list.add(event); }, timeout);
 	return list;
 }
 
@@ -21,10 +21,14 @@ public:
 	explicit EPoll(const EPoll & orig) = delete;
 	const EPoll & operator=(const EPoll &) = delete;
 
-	EPoll(EPoll && temp) : Socket(move_cast(temp)) { (void)temp; }
+	EPoll(EPoll && temp) :
+		Socket(move_cast(temp)),
+		events(move_cast(temp.events))
+	{}
 	const EPoll & operator=(EPoll && temp)
 	{
 		Socket::operator=(move_cast(temp));
+		events = move_cast(temp.events);
 		return *this;
 	}
 
@@ -46,9 +50,15 @@ public:
 		ReadWrite = 6,
 	};
 
+	/* Calls handler(Event &) for every event, without allocating anything.
+	 * Returns the number of the ready sockets. */
+	template <typename Handler>
+	unsigned dispatch(Handler && handler, int timeout = 0);
 	Array<EPoll::Event> wait(int timeout = 0);
 
 private:
+	unsigned waitForEvents(int timeout);
+
 	CArray<struct epoll_event> events;
 
 public:
@@ -89,6 +99,53 @@ public:
 
 };
 
+template <typename Handler>
+unsigned EPoll::dispatch(Handler && handler, int timeout)
+{
+	unsigned nfds = waitForEvents(timeout);
+	for(unsigned i = 0; i < nfds; ++i){
+		Socket & socket = *((Socket*)(events.ptr[i].data.ptr));
+		int e = events.ptr[i].events;
+
+		if((e & EPOLLRDHUP) == EPOLLRDHUP){
+			Event event(socket, EventCode::ReadHangup);
+			handler(event);
+			continue;
+		}
+
+		if((e & EPOLLHUP) == EPOLLHUP){
+			Event event(socket, EventCode::Hangup);
+			handler(event);
+			continue;
+		}
+
+		if((e & EPOLLERR) == EPOLLERR){
+			Event event(socket, EventCode::Error);
+			handler(event);
+			continue;
+		}
+
+		if(socket.listening){
+			if((e & EPOLLIN) == EPOLLIN){
+				Event event(socket, EventCode::IncomingConnection);
+				handler(event);
+			}
+			continue;
+		}
+
+		if((e & EPOLLIN) == EPOLLIN){
+			Event event(socket, EventCode::DataIn);
+			handler(event);
+		}
+
+		if((e & EPOLLOUT) == EPOLLOUT){
+			Event event(socket, EventCode::DataOut);
+			handler(event);
+		}
+	}
+	return nfds;
+}
+
 inline String &	operator<<(String & lhs, const EPoll::Event & rhs)
 		{ lhs += EPoll::eventName(rhs.code); return lhs; }
 
@@ -27,10 +27,77 @@
 namespace csjp {
 	
 EPollControl::EPollControl(unsigned maxEvents) :
-	EPoll(maxEvents)
+	EPoll(maxEvents),
+	timers(new EPollTimers(*this)),
+	expiredEvents(NULL)
 {
 }
 
+void SocketDeadline::arm(unsigned msec)
+{
+	timers->wheel.arm(*this, msec);
+}
+
+void SocketDeadline::expired()
+{
+	timers->control->deadlineExpired(*this);
+}
+
+void EPollControl::add(Socket & socket)
+{
+	EPoll::add(socket);
+	socket.readDeadline.timers = timers.ptr;
+	socket.idleDeadline.timers = timers.ptr;
+	socket.writeDeadline.timers = timers.ptr;
+	updateDeadlines(socket);
+}
+
+void EPollControl::remove(Socket & socket)
+{
+	EPoll::remove(socket);
+	timers->wheel.cancel(socket.readDeadline);
+	timers->wheel.cancel(socket.idleDeadline);
+	timers->wheel.cancel(socket.writeDeadline);
+}
+
+/* Called after every event of the socket. */
+void EPollControl::updateDeadlines(Socket & socket)
+{
+	if(socket.file == -1){
+		timers->wheel.cancel(socket.readDeadline);
+		timers->wheel.cancel(socket.idleDeadline);
+		timers->wheel.cancel(socket.writeDeadline);
+		return;
+	}
+
+	if(socket.idleTimeout)
+		timers->wheel.arm(socket.idleDeadline, socket.idleTimeout);
+
+	if(!socket.available)
+		timers->wheel.cancel(socket.readDeadline);
+	else if(socket.readTimeout && !socket.readDeadline.armed())
+		timers->wheel.arm(socket.readDeadline, socket.readTimeout);
+
+	if(!socket.pending){
+		timers->wheel.cancel(socket.writeDeadline);
+	} else if(socket.writeTimeout && (!socket.writeDeadline.armed() ||
+				socket.writeDeadline.mark != socket.totalSent)){
+		socket.writeDeadline.mark = socket.totalSent;
+		timers->wheel.arm(socket.writeDeadline, socket.writeTimeout);
+	}
+}
+
+void EPollControl::deadlineExpired(SocketDeadline & deadline)
+{
+	if(!expiredEvents || deadline.socket.file == -1)
+		return;
+	expiredEvents->add(ControlEvent(deadline.socket,
+				ControlEventCode::TimedOut));
+	DBG("EPollControl control fd: %, event: %",
+			expiredEvents->last().socket.file,
+			expiredEvents->last().name());
+}
+
 Array<EPollControl::ControlEvent> EPollControl::controlDataIn(Socket & socket)
 {
 	Array<EPollControl::ControlEvent> list;
@@ -77,6 +144,12 @@ Array<EPollControl::ControlEvent> EPollControl::controlError(Socket & socket)
 {
 	Array<EPollControl::ControlEvent> list;
 
+	/* Zero copy completions are reported as errors too. */
+	if(socket.zeroCopyThreshold && socket.readZeroCopyCompletions()){
+		socket.checkForError();
+		return list;
+	}
+
 	socket.checkForError();
 
 	list.add(ControlEvent(socket, ControlEventCode::ClosedByPeer));
@@ -90,11 +163,23 @@ Array<EPollControl::ControlEvent> EPollControl::waitAndControl(
 		int timeout, enum ControlMode mode)
 {
 	Array<EPollControl::ControlEvent> list;
-	for(auto event : wait(timeout)){
+	expiredEvents = &list;
+
+	int nearest = timers->wheel.timeout();
+	if(0 <= nearest && (timeout < 0 || nearest < timeout))
+		timeout = nearest;
+
+	bool advanced = false;
+	dispatch([&](Event & event){
 		DBG("EPollControl fd: %, event: %", event.socket.file, event.name());
+		/* Arming relative to the time after the wait. */
+		if(!advanced){
+			timers->wheel.advance();
+			advanced = true;
+		}
 		try {
 			if(event.socket.file == -1)
-				continue;
+				return;
 			switch(event.code)
 			{
 			case csjp::EPoll::EventCode::IncomingConnection :
@@ -126,6 +211,7 @@ Array<EPollControl::ControlEvent> EPollControl::waitAndControl(
 				throw LogicError("Unknown EPollControl::Event");
 				break;
 			}
+			updateDeadlines(event.socket);
 		} catch(Exception & e){
 			list.add(ControlEvent(event.socket,
 					  ControlEventCode::Exception,
@@ -141,7 +227,10 @@ Array<EPollControl::ControlEvent> EPollControl::waitAndControl(
 					list.last().socket.file,
 					list.last().name());
 		}
-	}
+	}, timeout);
+
+	timers->wheel.advance();
+	expiredEvents = NULL;
 	return list;
 }
 
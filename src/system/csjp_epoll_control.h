@@ -11,9 +11,22 @@
 #include <csjp_carray.h>
 #include <csjp_socket.h>
 #include <csjp_epoll.h>
+#include <csjp_timer.h>
 
 namespace csjp {
 
+class EPollControl;
+
+/* The timers of an EPollControl. Held by pointer, so the deadlines of the
+ * sockets referring to it stay valid when the EPollControl is moved. */
+struct EPollTimers
+{
+	explicit EPollTimers(EPollControl & control) : control(&control) {}
+
+	EPollControl * control;
+	TimerWheel wheel;
+};
+
 class EPollControl : public EPoll
 {
 public:
@@ -22,16 +35,38 @@ public:
 	explicit EPollControl(const EPollControl & orig) = delete;
 	const EPollControl & operator=(const EPollControl &) = delete;
 
-	EPollControl(EPollControl && temp) : EPoll(move_cast(temp)) { (void)temp; }
+	/* The sockets added to temp stay added to this one. */
+	EPollControl(EPollControl && temp) :
+		EPoll(move_cast(temp)),
+		timers(move_cast(temp.timers)),
+		expiredEvents(NULL)
+	{
+		timers->control = this;
+		temp.timers = Object<EPollTimers>(new EPollTimers(temp));
+	}
+	/* The sockets added to this one have to be removed before, like before
+	 * destroying it. */
 	const EPollControl & operator=(EPollControl && temp)
 	{
 		EPoll::operator=(move_cast(temp));
+		timers = move_cast(temp.timers);
+		timers->control = this;
+		temp.timers = Object<EPollTimers>(new EPollTimers(temp));
 		return *this;
 	}
 
 	EPollControl(unsigned maxEvents);
 	virtual ~EPollControl() {}
 
+	/* Arms the deadlines of the socket too. */
+	void add(Socket & socket);
+	void remove(Socket & socket);
+
+	/* The timers expire in waitAndControl(), which waits no longer than
+	 * until the nearest one. */
+	void arm(Timer & timer, unsigned msec) { timers->wheel.arm(timer, msec); }
+	void cancel(Timer & timer) { timers->wheel.cancel(timer); }
+
 public:
 	enum ControlMode {
 		Listen    = 1,
@@ -49,12 +84,22 @@ public:
 			int timeout = 0,
 			enum ControlMode mode = ControlMode::ListenReadWrite);
 
+private:
+	void updateDeadlines(Socket & socket);
+	void deadlineExpired(SocketDeadline & deadline);
+
+	Object<EPollTimers> timers;
+	Array<ControlEvent> * expiredEvents; // during waitAndControl()
+
+	friend SocketDeadline;
+
 public:
 
 	enum class ControlEventCode {
 		ClosedByPeer = 0,
 		ClosedByHost,
-		Exception
+		Exception,
+		TimedOut // read, idle or write deadline of the socket expired
 	};
 
 	static inline const char * controlEventName(ControlEventCode code)
@@ -63,6 +108,7 @@ public:
 		case ControlEventCode::ClosedByPeer: return "ClosedByPeer";
 		case ControlEventCode::ClosedByHost: return "ClosedByHost";
 		case ControlEventCode::Exception: return "Exception";
+		case ControlEventCode::TimedOut: return "TimedOut";
 		default: return "Unknown";
 		}
 	}
@@ -3,27 +3,602 @@
  * Copyright (C) 2011-2016 Csaszar, Peter
  */
 
-#include "csjp_http.h"
-
 #undef DEBUG
 //#define DEBUG
 
-/* TODO
- * - HTTP 1.1 continue, keep-alive, chunked transfer support
- */
+#include <stdint.h>
+#include <strings.h>
+#include <string.h>
+
+#include <csjp_search.h>
+
+#include "csjp_http.h"
 
 namespace csjp {
 
+/* Case insensitive FNV-1a hash of the header names. */
+static constexpr char lowerChar(char c)
+{
+	return ('A' <= c && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+static constexpr uint32_t nameHash(const char * name, uint32_t hash = 2166136261u)
+{
+	return *name ? nameHash(name + 1,
+			(hash ^ (unsigned char)lowerChar(*name)) * 16777619u) : hash;
+}
+
+static uint32_t nameHash(const Str & name)
+{
+	uint32_t hash = 2166136261u;
+	for(size_t i = 0; i < name.length; i++)
+		hash = (hash ^ (unsigned char)lowerChar(name[i])) * 16777619u;
+	return hash;
+}
+
+/* In the order of HTTPHeaders::Token. */
+static const char * tokenNames[] = {
+	"",
+	"host",
+	"content-length",
+	"content-type",
+	"transfer-encoding",
+	"connection",
+	"keep-alive",
+	"upgrade",
+	"expect",
+	"date",
+	"server",
+	"accept",
+	"accept-encoding",
+	"user-agent",
+	"cache-control",
+	"etag",
+	"if-none-match",
+	"location",
+	"sec-websocket-key",
+	"sec-websocket-version",
+	"sec-websocket-accept",
+	"sec-websocket-protocol"
+};
+
+HTTPHeaders::Token HTTPHeaders::token(const Str & name)
+{
+	typedef HTTPHeaders::Token T;
+	T token;
+	switch(nameHash(name)){
+#define CASE(str, tok) case nameHash(str): token = T::tok; break;
+		CASE("host", Host)
+		CASE("content-length", ContentLength)
+		CASE("content-type", ContentType)
+		CASE("transfer-encoding", TransferEncoding)
+		CASE("connection", Connection)
+		CASE("keep-alive", KeepAlive)
+		CASE("upgrade", Upgrade)
+		CASE("expect", Expect)
+		CASE("date", Date)
+		CASE("server", Server)
+		CASE("accept", Accept)
+		CASE("accept-encoding", AcceptEncoding)
+		CASE("user-agent", UserAgent)
+		CASE("cache-control", CacheControl)
+		CASE("etag", ETag)
+		CASE("if-none-match", IfNoneMatch)
+		CASE("location", Location)
+		CASE("sec-websocket-key", SecWebSocketKey)
+		CASE("sec-websocket-version", SecWebSocketVersion)
+		CASE("sec-websocket-accept", SecWebSocketAccept)
+		CASE("sec-websocket-protocol", SecWebSocketProtocol)
+#undef CASE
+		default: return T::Other;
+	}
+	/* Only a hash collision of an unknown name. */
+	const char * str = tokenNames[(int)token];
+	if(strlen(str) != name.length || strncasecmp(str, name.c_str(), name.length))
+		return T::Other;
+	return token;
+}
+
+const char * HTTPHeaders::name(Token token)
+{
+	return tokenNames[(int)token];
+}
+
+const HTTPHeaders::Field * HTTPHeaders::find(Token token, const Str & name) const
+{
+	for(size_t i = 0; i < fields.length; i++){
+		const Field & field = fields[i];
+		if(field.token != token)
+			continue;
+		if(token != Token::Other)
+			return &field;
+		if(field.nameLength == name.length && !strncasecmp(
+					nameOf(field).c_str(), name.c_str(), name.length))
+			return &field;
+	}
+	return NULL;
+}
+
+bool HTTPHeaders::sameName(const Field & field, const Field & other) const
+{
+	if(field.token != other.token)
+		return false;
+	if(field.token != Token::Other)
+		return true;
+	return field.nameLength == other.nameLength && !strncasecmp(
+			nameOf(field).c_str(), nameOf(other).c_str(), field.nameLength);
+}
+
+/* The comma separated lists of all the repeated names in one pass, so the
+ * joined values do not move once get() gave them out. */
+void HTTPHeaders::join() const
+{
+	joins.clear();
+	joined.clear();
+	for(size_t i = 0; i < fields.length; i++){
+		const Field & field = fields[i];
+		if(field.token == Token::Other && field.nameLength == 10 &&
+				!strncasecmp(nameOf(field).c_str(), "set-cookie", 10))
+			continue;
+		size_t j = 0;
+		while(j < i && !sameName(fields[j], field))
+			j++;
+		if(j < i) // joined at the first field of the name
+			continue;
+		for(j = i + 1; j < fields.length; j++)
+			if(sameName(fields[j], field))
+				break;
+		if(j == fields.length)
+			continue;
+		Join join;
+		join.field = i;
+		join.value = joined.length;
+		for(j = i; j < fields.length; j++){
+			if(j != i && !sameName(fields[j], field))
+				continue;
+			Str value(valueOf(fields[j]));
+			if(!value.length)
+				continue;
+			if(joined.length != join.value)
+				joined.append(", ", 2);
+			joined.append(value);
+		}
+		join.valueLength = joined.length - join.value;
+		joins.add(join);
+	}
+	isJoined = true;
+}
+
+Str HTTPHeaders::joinedValue(const Field & field) const
+{
+	if(!isJoined)
+		join();
+	size_t i = &field - fields.data;
+	for(size_t j = 0; j < joins.length; j++)
+		if(joins[j].field == i)
+			return Str(joined.c_str() + joins[j].value,
+					joins[j].valueLength);
+	return valueOf(field);
+}
+
+Str HTTPHeaders::get(Token token) const
+{
+	const Field * field = find(token, Str());
+	return field ? joinedValue(*field) : Str();
+}
+
+Str HTTPHeaders::get(const Str & name) const
+{
+	const Field * field = find(token(name), name);
+	return field ? joinedValue(*field) : Str();
+}
+
+bool HTTPHeaders::contains(Token token, const char * item) const
+{
+	size_t length = strlen(item);
+	for(size_t i = 0; i < fields.length; i++){
+		if(fields[i].token != token)
+			continue;
+		Str value(valueOf(fields[i]));
+		size_t from = 0;
+		while(from < value.length){
+			size_t until;
+			if(!value.findFirst(until, ',', from))
+				until = value.length;
+			Str str(value.read(from, until));
+			str.trim(" \t");
+			if(str.length == length &&
+					!strncasecmp(str.c_str(), item, length))
+				return true;
+			from = until + 1;
+		}
+	}
+	return false;
+}
+
+void HTTPHeaders::add(const Str & name, const Str & value)
+{
+	Field field;
+	field.name = storage.length;
+	field.nameLength = name.length;
+	storage.append(name);
+	field.value = storage.length;
+	field.valueLength = value.length;
+	storage.append(value);
+	field.token = token(name);
+	field.stored = true;
+	fields.add(field);
+	isJoined = false;
+}
+
+void HTTPHeaders::set(const Str & name, const Str & value)
+{
+	remove(name);
+	add(name, value);
+}
+
+void HTTPHeaders::remove(const Str & name)
+{
+	Token t = token(name);
+	size_t kept = 0;
+	for(size_t i = 0; i < fields.length; i++){
+		const Field & field = fields[i];
+		if(field.token == t && (t != Token::Other ||
+				(field.nameLength == name.length && !strncasecmp(
+					nameOf(field).c_str(), name.c_str(), name.length))))
+			continue;
+		fields[kept++] = field;
+	}
+	while(kept < fields.length)
+		fields.removeAt(fields.length - 1);
+	isJoined = false;
+}
+
+void HTTPHeaders::keep()
+{
+	for(size_t i = 0; i < fields.length; i++){
+		Field & field = fields[i];
+		if(field.stored)
+			continue;
+		Str name(nameOf(field));
+		Str value(valueOf(field));
+		field.name = storage.length;
+		storage.append(name);
+		field.value = storage.length;
+		storage.append(value);
+		field.stored = true;
+	}
+	base = NULL;
+}
+
+void HTTPHeaders::clear()
+{
+	Arena * arena = fields.getArena();
+	if(arena){ // the memory goes back with the reset of the arena
+		Fields empty(*arena);
+		fields = move_cast(empty);
+		Joins emptyJoins(*arena);
+		joins = move_cast(emptyJoins);
+	} else {
+		fields.clear();
+		joins.clear();
+	}
+	storage.clear();
+	joined.clear();
+	base = NULL;
+	lastParsed = 0;
+	isJoined = false;
+}
+
+void HTTPHeaders::parsed(size_t name, unsigned nameLength, size_t value,
+		unsigned valueLength)
+{
+	Field field;
+	field.name = name;
+	field.nameLength = nameLength;
+	field.value = value;
+	field.valueLength = valueLength;
+	field.token = token(Str(base + name, nameLength));
+	field.stored = false;
+	lastParsed = fields.length;
+	fields.add(field);
+	isJoined = false;
+}
+
+/* The value of a folded header is moved to the end of the storage once, the
+ * further continuation lines extend it there. */
+void HTTPHeaders::continueLast(const Str & value)
+{
+	Field & field = fields[lastParsed];
+	if(!field.stored || field.value + field.valueLength != storage.length){
+		if(!field.stored){
+			Str name(nameOf(field));
+			field.name = storage.length;
+			storage.append(name);
+		}
+		Str last(valueOf(field));
+		field.value = storage.length;
+		storage.append(last);
+		field.stored = true;
+	}
+	storage.append(value);
+	field.valueLength += value.length;
+	isJoined = false;
+}
+
+static void appendHex(String & str, size_t value)
+{
+	char digits[2 * sizeof(size_t)];
+	unsigned length = 0;
+	do {
+		digits[sizeof(digits) - ++length] = "0123456789abcdef"[value & 0xf];
+		value >>= 4;
+	} while(value);
+	str.append(digits + sizeof(digits) - length, length);
+}
+
+/* Upper estimate of the serialized message: the framing added is a
+ * content-length header or the size lines of a chunk and of the last chunk. */
+static size_t serializedLength(const Str & startLine,
+		const HTTPHeaders & headers, const String & body)
+{
+	size_t length = startLine.length + 2 + 2 + body.length + 48;
+	for(size_t i = 0; i < headers.size(); i++)
+		length += headers.name(i).length + headers.value(i).length + 4;
+	return length;
+}
+
+/* The headers of the message and its body framed by content-length or by
+ * chunked transfer encoding if the headers ask for it. A bodyless message
+ * gets the headers only. */
+static void appendHeadersAndBody(String & str, const HTTPHeaders & headers,
+		const String & body, bool bodyless = false)
+{
+	typedef HTTPHeaders::Token Token;
+	bool chunked = false;
+	for(size_t i = 0; i < headers.size(); i++){
+		Token token = headers.token(i);
+		if(token == Token::ContentLength)
+			continue;
+		if(token == Token::TransferEncoding)
+			chunked = headers.contains(Token::TransferEncoding, "chunked");
+		str.append(headers.name(i));
+		str.append(": ", 2);
+		str.append(headers.value(i));
+		str.append("\r\n", 2);
+	}
+	if(bodyless){
+		str.append("\r\n", 2);
+		return;
+	}
+	if(!chunked){
+		str.append("content-length: ", 16);
+		str << body.length;
+		str.append("\r\n\r\n", 4);
+		str.append(body);
+		return;
+	}
+	str.append("\r\n", 2);
+	if(body.length){
+		appendHex(str, body.length);
+		str.append("\r\n", 2);
+		str.append(body);
+		str.append("\r\n", 2);
+	}
+	str.append("0\r\n\r\n", 5);
+}
+
+/* Size of the chunk from its size line, chunk extensions are ignored. */
+static size_t chunkSize(const Str & line)
+{
+	size_t size = 0;
+	size_t i = 0;
+	for(; i < line.length; i++){
+		char c = line[i];
+		unsigned digit;
+		if('0' <= c && c <= '9')
+			digit = c - '0';
+		else if('a' <= c && c <= 'f')
+			digit = c - 'a' + 10;
+		else if('A' <= c && c <= 'F')
+			digit = c - 'A' + 10;
+		else
+			break;
+		if(size >> (8 * sizeof(size_t) - 4))
+			throw HttpProtocolError("Too big chunk size.");
+		size = size << 4 | digit;
+	}
+	if(!i || (i < line.length && line[i] != ';' && line[i] != ' ' &&
+				line[i] != '\t'))
+		throw HttpProtocolError("Invalid chunk size line: %", line);
+	return size;
+}
+
+bool HTTPParser::nextLine(const Str & data, Str & line)
+{
+	const char * begin = data.c_str();
+	const char * end = searchByte(begin + (scanned < pos ? pos : scanned),
+			begin + data.length, '\n');
+	if(!end)
+		scanned = data.length;
+	size_t length = end ? (size_t)(end - begin) : scanned;
+	if(state <= State::Headers && maxHeaderSize < length)
+		throw HttpProtocolError("Too big header, the limit is % bytes.",
+				(size_t)maxHeaderSize);
+	if(!end)
+		return false;
+	size_t until = end - begin;
+	if(pos < until && begin[until - 1] == '\r')
+		line = data.read(pos, until - 1);
+	else
+		line = data.read(pos, until);
+	pos = until + 1;
+	scanned = pos;
+	return true;
+}
+
+/* Repeated content-length values have to be the same (RFC 9110 8.6), an
+ * empty item of the list is malformed. */
+static size_t contentLength(const HTTPHeaders & headers)
+{
+	Str length;
+	for(size_t i = 0; i < headers.size(); i++){
+		if(headers.token(i) != HTTPHeaders::Token::ContentLength)
+			continue;
+		Str value(headers.value(i));
+		size_t from = 0;
+		while(from <= value.length){
+			size_t until;
+			if(!value.findFirst(until, ',', from))
+				until = value.length;
+			Str str(value.read(from, until));
+			str.trim(" \t");
+			if(!str.length)
+				throw HttpProtocolError("Empty item in content-length: %",
+						value);
+			if(!length.length)
+				length = str;
+			else if(str != length)
+				throw HttpProtocolError("Differing content-length "
+						"values: %", value);
+			from = until + 1;
+		}
+	}
+	size_t remaining = 0;
+	if(length.length)
+		remaining <<= length;
+	return remaining;
+}
+
+/* A header line or the continuation of the previous one. */
+void HTTPParser::header(const Str & data, const Str & line,
+		HTTPHeaders & headers)
+{
+	if(line[0] == ' ' || line[0] == '\t' || line[0] == '\r'){
+		if(!headers.size())
+			throw HttpProtocolError("Invalid header line: %", line);
+		Str value(line);
+		value.trim(" \t\r");
+		headers.continueLast(value);
+		return;
+	}
+
+	if(maxHeaders <= headers.size())
+		throw HttpProtocolError("Too many header lines, the limit is %.",
+				(unsigned)maxHeaders);
+	size_t colon;
+	if(!line.findFirst(colon, ':'))
+		throw HttpProtocolError("Invalid header line: %", line);
+	Str name(line.read(0, colon));
+	name.trim(" \t");
+	if(!name.length)
+		throw HttpProtocolError("Invalid header line: %", line);
+	Str value(line.read(colon + 1, line.length));
+	value.trim(" \t\r");
+	headers.parsed(name.c_str() - data.c_str(), name.length,
+			value.c_str() - data.c_str(), value.length);
+}
+
+size_t HTTPParser::parse(const Str & data, HTTPHeaders & headers, String & body)
+{
+	typedef HTTPHeaders::Token Token;
+	headers.rebase(data.c_str()); // the data might have been moved since
+	Str line;
+	while(true){
+		switch(state){
+		case State::StartLine: // parsed by the message
+		case State::Complete:
+			return 0;
+		case State::Headers:
+			if(!nextLine(data, line))
+				return 0;
+			if(line.length){
+				header(data, line, headers);
+				break;
+			}
+			if(noBody){
+				state = State::Complete;
+				return pos;
+			}
+			if(headers.has(Token::TransferEncoding) &&
+					headers.has(Token::ContentLength))
+				throw HttpProtocolError("Message has both "
+						"transfer-encoding and content-length.");
+			if(headers.contains(Token::TransferEncoding, "chunked")){
+				state = State::ChunkSize;
+				break;
+			}
+			remaining = contentLength(headers);
+			if(maxBodySize < remaining)
+				throw HttpProtocolError("Too big body of % bytes, the "
+						"limit is %.", remaining, maxBodySize);
+			state = State::Body;
+			break;
+		case State::Body:
+			if(data.length - pos < remaining)
+				return 0;
+			body <<= data.read(pos, pos + remaining);
+			pos += remaining;
+			state = State::Complete;
+			return pos;
+		case State::ChunkSize:
+			if(!nextLine(data, line))
+				return 0;
+			remaining = chunkSize(line);
+			if(maxBodySize < remaining ||
+					maxBodySize - remaining < body.length)
+				throw HttpProtocolError("Too big chunked body, the limit "
+						"is % bytes.", maxBodySize);
+			state = remaining ? State::ChunkData : State::Trailer;
+			break;
+		case State::ChunkData: {
+			if(data.length - pos <= remaining)
+				return 0;
+			size_t end = pos + remaining;
+			size_t crlf = data[end] == '\r' ? 2 : 1;
+			if(data.length < end + crlf)
+				return 0;
+			if(data[end + crlf - 1] != '\n')
+				throw HttpProtocolError("Chunk is not terminated by CRLF.");
+			body.append(data.read(pos, end));
+			pos = end + crlf;
+			state = State::ChunkSize;
+			break;
+		}
+		case State::Trailer: // the trailer fields are ignored
+			if(!nextLine(data, line))
+				return 0;
+			if(!line.length){
+				state = State::Complete;
+				return pos;
+			}
+			break;
+		}
+	}
+}
+
+HTTPRequest::HTTPRequest() :
+	method(*arena),
+	uri(*arena),
+	version(*arena),
+	headers(*arena),
+	body(*arena),
+	requestLine(*arena)
+{
+}
+
 HTTPRequest::HTTPRequest(
 		const Str & method,
 		const Str & uri,
 		const Str & body,
 		const Str & version) :
-	method(method),
-	uri(uri),
-	version(version),
-	body(body)
+	HTTPRequest()
 {
+	this->method <<= method;
+	this->uri <<= uri;
+	this->version <<= version;
+	this->body <<= body;
+
 	if(method.length)
 		requestLine.cat(method);
 	else
@@ -60,84 +635,62 @@ HTTPRequest HTTPRequest::post(
 String HTTPRequest::toString() const
 {
 	String request;
-	request.catf("%\r\n", requestLine);
-	for(auto & h : headers.properties){
-		if(h.key == "content-length")
-			continue;
-		String k(h.key);
-		k.lower();
-		request.catf("%: %\r\n", k, h.value());
-	}
-	request.catf("content-length: %\r\n", body.length);
-	request.catf("\r\n%", body);
+	request.extendCapacity(serializedLength(requestLine, headers, body));
+	request.append(requestLine);
+	request.append("\r\n", 2);
+	appendHeadersAndBody(request, headers, body);
 	return request;
 }
 
-/**
- * For now we only parse the full request.
- * If any bytes missing even from the body,
- * the parser will report 0 processed bytes.
- */
 unsigned HTTPRequest::parse(const Str & data)
 {
 	DBG("HTTPRequest parser available length: %", data.length);
-	if (data.length < 512) {
-		DBG("HTTPRequest parser available data: %", data);
-	}
 
-	if(!requestLine.length){
-		size_t pos;
-		if(!data.findFirst(pos, "\r\n"))
-			return 0;
-		requestLine <<= data.read(0, pos);
-		auto result = requestLine.regexpMatches("\\([^ ]*\\) \\([^ ]*\\) HTTP/\\(.*\\)$");
-		if(result.size() != 3)
+	if(parser.state == HTTPParser::State::StartLine){
+		Str line;
+		do { // empty lines before the request line are ignored
+			if(!parser.nextLine(data, line))
+				return 0;
+		} while(!line.length);
+		requestLine <<= line;
+		/* method SP uri SP HTTP/version */
+		size_t methodEnd, uriEnd;
+		if(!line.findFirst(methodEnd, ' ') ||
+				!line.findFirst(uriEnd, ' ', methodEnd + 1) ||
+				!line.read(uriEnd + 1, line.length).startsWith("HTTP/"))
 			throw HttpProtocolError("Invalid HTTP request line: %", requestLine);
-		method <<= result[0];
-		uri <<= result[1];
-		version <<= result[2];
+		method <<= line.read(0, methodEnd);
+		uri <<= line.read(methodEnd + 1, uriEnd);
+		version <<= line.read(uriEnd + 6, line.length);
+		parser.state = HTTPParser::State::Headers;
 	}
 
-	if(!headers.value().length){
-		size_t pos;
-		if(!data.findFirst(pos, "\r\n\r\n", requestLine.length+2))
-			return 0;
-		headers <<= data.read(requestLine.length+2, pos);
-		Array<Str> array = headers.value().split("\r\n");
-		String key;
-		for(auto & str : array){
-			if(str.findFirst(pos, ":")){
-				key <<= str.read(0, pos);
-				pos++;
-				key.trim(" \t");
-				key.lower();
-			} else {
-				if(!key.length)
-					throw HttpProtocolError(
-						"Invalid header line: %", str);
-				pos = 0;
-			}
-			Str value(str.c_str() + pos, str.length - pos);
-			if(!value.startsWith(" ") && !value.startsWith("\t"))
-				throw HttpProtocolError(
-						"Invalid multiline header "
-						"line: %", str);
-			value.trim(" \t");
-			headers[key] << value;
-		}
-	}
+	return parser.parse(data, headers, body);
+}
 
-	if(!body.length){
-		size_t readIn = requestLine.length+2 + headers.value().length+4;
-		size_t bodyLength = 0;
-		bodyLength <<= headers["content-length"];
-		if(data.length < readIn + bodyLength)
-			return 0;
-		body <<= data.read(readIn, readIn + bodyLength);
-		return readIn + bodyLength;
-	}
+bool HTTPRequest::keepAlive() const
+{
+	if(version == "1.0")
+		return headers.contains(HTTPHeaders::Token::Connection, "keep-alive");
+	return !headers.contains(HTTPHeaders::Token::Connection, "close");
+}
+
+bool HTTPRequest::expectsContinue() const
+{
+	return headers.contains(HTTPHeaders::Token::Expect, "100-continue");
+}
 
-	return 0;
+void HTTPRequest::renew()
+{
+	Object<Arena> fresh;
+	arena = move_cast(fresh);
+	method = String(*arena);
+	uri = String(*arena);
+	version = String(*arena);
+	headers = HTTPHeaders(*arena);
+	body = String(*arena);
+	requestLine = String(*arena);
+	parser.clear();
 }
 
 void HTTPRequest::clear()
@@ -148,6 +701,8 @@ void HTTPRequest::clear()
 	headers.clear();
 	body.clear();
 	requestLine.clear();
+	parser.clear();
+	arena->reset();
 }
 
 
@@ -185,71 +740,80 @@ HTTPResponse::HTTPResponse(
 String HTTPResponse::toString() const
 {
 	String response;
-	response.catf("%\r\n", statusLine);
-	for(auto & h : headers.properties){
-		if(h.key == "content-length")
-			continue;
-		String k(h.key);
-		k.lower();
-		response.catf("%: %\r\n", k, h.value());
-	}
-	response.catf("content-length: %\r\n", body.length);
-	response.catf("\r\n%", body);
+	response.extendCapacity(serializedLength());
+	appendTo(response);
 	return response;
 }
 
+void HTTPResponse::appendTo(String & buffer) const
+{
+	buffer.append(statusLine);
+	buffer.append("\r\n", 2);
+	appendHeadersAndBody(buffer, headers, body, bodyless());
+}
+
+size_t HTTPResponse::serializedLength() const
+{
+	return csjp::serializedLength(statusLine, headers, body);
+}
+
+bool HTTPResponse::sendTo(Socket & socket) const
+{
+	appendTo(socket.writeBufferFor(serializedLength()));
+	socket.queueWritten();
+	return socket.writeFromBuffer();
+}
+
 unsigned HTTPResponse::parse(const Str & data)
 {
-	if(!statusLine.length){
-		size_t pos;
-		if(!data.findFirst(pos, "\r\n"))
+	if(parser.state == HTTPParser::State::StartLine){
+		Str line;
+		if(!parser.nextLine(data, line))
 			return 0;
-		statusLine <<= data.read(0, pos);
-		auto result = statusLine.regexpMatches("HTTP/\\([^ ]*\\) \\([^ ]*\\) \\(.*\\)$");
-		if(result.size() != 3)
+		statusLine <<= line;
+		/* HTTP/version SP code [SP reason] */
+		size_t versionEnd, codeEnd;
+		if(!line.startsWith("HTTP/") || !line.findFirst(versionEnd, ' '))
+			throw HttpProtocolError("Invalid HTTP status line: %", statusLine);
+		if(!line.findFirst(codeEnd, ' ', versionEnd + 1))
+			codeEnd = line.length;
+		Str code(line.read(versionEnd + 1, codeEnd));
+		if(code.length != 3 || code[0] < '1' || '5' < code[0] ||
+				code[1] < '0' || '9' < code[1] ||
+				code[2] < '0' || '9' < code[2])
 			throw HttpProtocolError("Invalid HTTP status line: %", statusLine);
-		version <<= result[0];
-		statusCode = HTTPStatusCode(result[1]);
-		reasonPhrase <<= result[2];
+		version <<= line.read(5, versionEnd);
+		statusCode = HTTPStatusCode(code);
+		if(codeEnd < line.length)
+			reasonPhrase <<= line.read(codeEnd + 1, line.length);
+		else
+			reasonPhrase.clear();
+		parser.noBody = bodyless();
+		parser.state = HTTPParser::State::Headers;
 	}
 
-	if(!headers.value().length){
-		size_t pos;
-		if(!data.findFirst(pos, "\r\n\r\n", statusLine.length+2))
-			return 0;
-		headers <<= data.read(statusLine.length+2, pos);
-		Array<Str> array = headers.value().split("\r\n");
-		String key;
-		for(auto & str : array){
-			if(str.findFirst(pos, ":")){
-				key <<= str.read(0, pos);
-				key.trim(" \t");
-				key.lower();
-				pos++;
-			} else {
-				if(!key.length)
-					throw HttpProtocolError("Invalid header line: %", str);
-				pos = 0;
-			}
-			Str value(str.c_str() + pos, str.length - pos);
-			if(!value.startsWith(" ") && !value.startsWith("\t"))
-				throw HttpProtocolError("Invalid multiline header line: %", str);
-			value.trim(" \t");
-			headers[key] << value;
-		}
-	}
+	return parser.parse(data, headers, body);
+}
 
-	if(!body.length){
-		size_t readIn = statusLine.length+2 + headers.value().length+4;
-		size_t bodyLength = 0;
-		bodyLength <<= headers["content-length"];
-		if(data.length < readIn + bodyLength)
-			return 0;
-		body <<= data.read(readIn, readIn + bodyLength);
-		return readIn + bodyLength;
-	}
+bool HTTPResponse::keepAlive() const
+{
+	if(version == "1.0")
+		return headers.contains(HTTPHeaders::Token::Connection, "keep-alive");
+	return !headers.contains(HTTPHeaders::Token::Connection, "close");
+}
+
+bool HTTPResponse::bodyless() const
+{
+	int status = statusCode;
+	return status < 200 || status == 204 || status == 304;
+}
 
-	return 0;
+String HTTPResponse::chunk(const Str & data)
+{
+	String str;
+	appendHex(str, data.length);
+	str.catf("\r\n%\r\n", data);
+	return str;
 }
 
 void HTTPResponse::clear()
@@ -260,7 +824,231 @@ void HTTPResponse::clear()
 	//statusCode.clear();
 	reasonPhrase.clear();
 	statusLine.clear();
+	parser.clear();
+}
+
+/* FNV-1a hash of the body as a quoted hex string. */
+static String bodyETag(const String & body)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for(size_t i = 0; i < body.length; i++)
+		hash = (hash ^ (unsigned char)body[i]) * 1099511628211ull;
+	String etag("\"");
+	appendHex(etag, hash);
+	etag.append('"');
+	return etag;
+}
+
+/* The route of the uri is its path without the query. */
+static Str routeOf(const Str & uri)
+{
+	size_t query;
+	if(uri.findFirst(query, '?'))
+		return uri.read(0, query);
+	return Str(uri);
+}
+
+/* The if-none-match list holds the etag or "*". Weak tags compare by their
+ * opaque part as RFC 7232 asks for if-none-match. */
+static bool noneMatch(const Str & list, const String & etag)
+{
+	size_t from = 0;
+	while(from < list.length){
+		size_t until;
+		if(!list.findFirst(until, ',', from))
+			until = list.length;
+		Str tag(list.read(from, until));
+		tag.trim(" \t");
+		if(tag.startsWith("W/"))
+			tag = tag.read(2, tag.length);
+		if(tag == "*" || tag == etag)
+			return true;
+		from = until + 1;
+	}
+	return false;
+}
+
+void HTTPResponseCache::add(const Str & route, HTTPResponse && response)
+{
+	ENSURE(response.version == "1.1", InvalidArgument);
+	typedef HTTPHeaders::Token Token;
+
+	Object<Entry> entry(new Entry);
+	entry->route <<= route;
+	if(response.headers.has(Token::ETag))
+		entry->etag <<= response.headers[Token::ETag];
+	else {
+		entry->etag = bodyETag(response.body);
+		response.headers.add("etag", entry->etag);
+	}
+	response.headers.remove("connection");
+	entry->full.extendCapacity(response.serializedLength());
+	response.appendTo(entry->full);
+
+	HTTPResponse notModified(HTTPStatusCode::Enum::NotModified, "", "1.1");
+	notModified.headers.add("etag", entry->etag);
+	for(size_t i = 0; i < response.headers.size(); i++){
+		Token token = response.headers.token(i);
+		if(token == Token::CacheControl || token == Token::Location)
+			notModified.headers.add(response.headers.name(i),
+					response.headers.value(i));
+	}
+	notModified.appendTo(entry->notModified);
+
+	remove(route);
+	entries.add(entry);
+}
+
+void HTTPResponseCache::remove(const Str & route)
+{
+	if(entries.has(route))
+		entries.remove(route);
+}
+
+bool HTTPResponseCache::appendTo(const HTTPRequest & request,
+		String & buffer) const
+{
+	if(request.method != "GET")
+		return false;
+	Str route(routeOf(request.uri));
+	if(!entries.has(route))
+		return false;
+	const Entry & entry = entries.query(route);
+	if(noneMatch(request.headers[HTTPHeaders::Token::IfNoneMatch], entry.etag))
+		buffer.append(entry.notModified);
+	else
+		buffer.append(entry.full);
+	return true;
+}
+
+HTTPResponseWriter::HTTPResponseWriter(Socket & socket,
+		const HTTPRequest & request) :
+	keepAlive(request.keepAlive()),
+	socket(socket),
+	version10(request.version == "1.0"),
+	done(false)
+{
 }
 
+void HTTPResponseWriter::write(HTTPResponse & response)
+{
+	ENSURE(!done, InvalidState);
+	if(response.headers.contains(HTTPHeaders::Token::Connection, "close"))
+		keepAlive = false;
+	else if(keepAlive && response.version == "1.0")
+		response.headers.set("connection", "keep-alive");
+	else if(!keepAlive && response.version != "1.0")
+		response.headers.set("connection", "close");
+	response.appendTo(socket.writeBufferFor(response.serializedLength()));
+	socket.queueWritten();
+	done = true;
+}
+
+void HTTPResponseWriter::write(HTTPStatusCode status, const Str & body,
+		const Str & contentType)
+{
+	ENSURE(!done, InvalidState);
+	const char * phrase = status.phrase();
+	String & buffer = socket.writeBufferFor(
+			body.length + contentType.length + strlen(phrase) + 128);
+	buffer.append(version10 ? "HTTP/1.0 " : "HTTP/1.1 ", 9);
+	buffer << (int)status;
+	buffer.append(' ');
+	buffer.append(phrase);
+	buffer.append("\r\n", 2);
+	if(contentType.length){
+		buffer.append("content-type: ", 14);
+		buffer.append(contentType);
+		buffer.append("\r\n", 2);
+	}
+	if(keepAlive && version10)
+		buffer.append("connection: keep-alive\r\n", 24);
+	else if(!keepAlive && !version10)
+		buffer.append("connection: close\r\n", 19);
+	int code = status;
+	if(code < 200 || code == 204 || code == 304)
+		buffer.append("\r\n", 2);
+	else {
+		buffer.append("content-length: ", 16);
+		buffer << body.length;
+		buffer.append("\r\n\r\n", 4);
+		buffer.append(body);
+	}
+	socket.queueWritten();
+	done = true;
+}
+
+HTTPConnection::HTTPConnection(const Listener & listener) :
+	Server(listener),
+	requestsServed(0),
+	cache(NULL),
+	continueSent(false)
+{
+}
+
+HTTPConnection::HTTPConnection(int fd) :
+	Server(fd),
+	requestsServed(0),
+	cache(NULL),
+	continueSent(false)
+{
+}
+
+void HTTPConnection::handle(HTTPRequest & request, HTTPResponseWriter & writer)
+{
+	HTTPResponse response(respond(request));
+	writer.write(response);
 }
 
+HTTPResponse HTTPConnection::respond(HTTPRequest & request)
+{
+	return HTTPResponse(HTTPStatusCode::Enum::NotFound, "", request.version);
+}
+
+/* The responses of the requests pipelined in the received data are written in
+ * a single write, small separate writes would be delayed by Nagle's algorithm.
+ * They are serialized straight into the write buffer of the socket. */
+void HTTPConnection::dataReceived()
+{
+	if(closeOnSent){ // the rest after the last request is dropped
+		release(bytesAvailable);
+		return;
+	}
+
+	bool keepAlive = true;
+	while(keepAlive && receive(request)){
+		continueSent = false;
+		keepAlive = request.keepAlive();
+		requestsServed++;
+		if(cache && keepAlive && request.version == "1.1"){
+			String & buffer = writeBufferFor(0);
+			bool cached = cache->appendTo(request, buffer);
+			queueWritten();
+			if(cached){
+				request.clear();
+				continue;
+			}
+		}
+		HTTPResponseWriter writer(*this, request);
+		handle(request, writer);
+		if(!writer.written())
+			writer.write(HTTPStatusCode::Enum::InternalServerError);
+		keepAlive = writer.keepAlive;
+		request.clear();
+	}
+
+	/* Only for a request with complete and valid headers, the framing of
+	 * its body is checked by then. */
+	if(keepAlive && !continueSent && request.headersComplete() &&
+			request.expectsContinue()){
+		writeBufferFor(0).append("HTTP/1.1 100 Continue\r\n\r\n");
+		queueWritten();
+		continueSent = true;
+	}
+	if(!keepAlive)
+		closeOnSent = true;
+	if(bytesToSend)
+		writeFromBuffer();
+}
+
+}
@@ -6,7 +6,9 @@
 #ifndef CSJP_HTTP_H
 #define CSJP_HTTP_H
 
-#include <csjp_json.h>
+#include <csjp_arena.h>
+#include <csjp_pod_array.h>
+#include <csjp_owner_container.h>
 #include <csjp_server.h>
 #include <csjp_client.h>
 
@@ -14,20 +16,244 @@ namespace csjp {
 
 DECL_EXCEPTION(SocketError, HttpProtocolError);
 
+/**
+ * Headers of an HTTP message in a flat array. The parsed headers are views into
+ * the data given to parse() (like Socket::received()), so they are valid only
+ * as long as that data is. keep() copies them for a message used longer. The
+ * headers added by add() and set() are always copied.
+ *
+ * Names are compared case insensitively. The well known names are classified
+ * by a precomputed hash into tokens when a header is added, so looking them up
+ * compares tokens only.
+ *
+ * Repeated headers are kept as separate fields. get() gives them joined into
+ * one comma separated list (RFC 9110 5.3), except set-cookie. The lists are
+ * built at the first get() needing one, all at once, and stay valid until the
+ * headers are modified.
+ *
+ * Do not inherit from this class!
+ */
+class HTTPHeaders
+{
+public:
+	enum class Token : unsigned char
+	{
+		Other,
+		Host,
+		ContentLength,
+		ContentType,
+		TransferEncoding,
+		Connection,
+		KeepAlive,
+		Upgrade,
+		Expect,
+		Date,
+		Server,
+		Accept,
+		AcceptEncoding,
+		UserAgent,
+		CacheControl,
+		ETag,
+		IfNoneMatch,
+		Location,
+		SecWebSocketKey,
+		SecWebSocketVersion,
+		SecWebSocketAccept,
+		SecWebSocketProtocol
+	};
+
+private:
+	struct Field
+	{
+		size_t name; // offset in the parsed data or in the storage
+		size_t value;
+		unsigned nameLength;
+		unsigned valueLength;
+		Token token;
+		bool stored; // in the storage
+	};
+	/* The headers of most messages fit without allocation. */
+	typedef PodArray<Field, 16> Fields;
+	struct Join
+	{
+		size_t field; // the first field of the name
+		size_t value; // offset in the joined
+		size_t valueLength;
+	};
+	typedef PodArray<Join, 4> Joins;
+
+#define HTTPHeadersInitializer : \
+		base(NULL), \
+		lastParsed(0), \
+		isJoined(false)
+public:
+	explicit HTTPHeaders(const HTTPHeaders & orig) = delete;
+	const HTTPHeaders & operator=(const HTTPHeaders &) = delete;
+
+	HTTPHeaders(HTTPHeaders && temp) :
+		base(temp.base),
+		lastParsed(temp.lastParsed),
+		isJoined(temp.isJoined),
+		fields(move_cast(temp.fields)),
+		storage(move_cast(temp.storage)),
+		joins(move_cast(temp.joins)),
+		joined(move_cast(temp.joined))
+	{}
+	const HTTPHeaders & operator=(HTTPHeaders && temp)
+	{
+		base = temp.base;
+		lastParsed = temp.lastParsed;
+		isJoined = temp.isJoined;
+		fields = move_cast(temp.fields);
+		storage = move_cast(temp.storage);
+		joins = move_cast(temp.joins);
+		joined = move_cast(temp.joined);
+		return *this;
+	}
+
+	explicit HTTPHeaders() HTTPHeadersInitializer {}
+	/* The fields and the copies are allocated from the arena. */
+	explicit HTTPHeaders(Arena & arena) HTTPHeadersInitializer,
+		fields(arena),
+		storage(arena),
+		joins(arena),
+		joined(arena)
+	{}
+
+	/* Token of the known header name, Other for the rest. */
+	static Token token(const Str & name);
+	/* Lower case name of the token. */
+	static const char * name(Token token);
+
+	size_t size() const { return fields.length; }
+	Str name(size_t i) const { return nameOf(fields[i]); }
+	Str value(size_t i) const { return valueOf(fields[i]); }
+	Token token(size_t i) const { return fields[i].token; }
+
+	bool has(Token token) const { return find(token, Str()); }
+	bool has(const Str & name) const { return find(token(name), name); }
+	/* Value of the headers of the name, empty if there is none. */
+	Str get(Token token) const;
+	Str get(const Str & name) const;
+	Str operator[](Token token) const { return get(token); }
+	Str operator[](const Str & name) const { return get(name); }
+	/* The comma separated list of any header of the token contains the item. */
+	bool contains(Token token, const char * item) const;
+
+	void add(const Str & name, const Str & value);
+	/* Replaces the headers of the name. */
+	void set(const Str & name, const Str & value);
+	void remove(const Str & name);
+	/* Copies the headers still referring to the parsed data. */
+	void keep();
+	void clear();
+
+private:
+	const Field * find(Token token, const Str & name) const;
+	bool sameName(const Field & field, const Field & other) const;
+	Str joinedValue(const Field & field) const;
+	void join() const;
+	Str nameOf(const Field & field) const
+	{
+		return Str((field.stored ? storage.c_str() : base) + field.name,
+				field.nameLength);
+	}
+	Str valueOf(const Field & field) const
+	{
+		return Str((field.stored ? storage.c_str() : base) + field.value,
+				field.valueLength);
+	}
+	/* For HTTPParser: headers at offsets of the data beginning at base. */
+	void rebase(const char * data) { base = data; }
+	void parsed(size_t name, unsigned nameLength, size_t value,
+			unsigned valueLength);
+	void continueLast(const Str & value);
+
+	const char * base;
+	size_t lastParsed; // the field of the last parsed line
+	mutable bool isJoined; // the joins are up to date
+	Fields fields;
+	String storage;
+	mutable Joins joins;
+	mutable String joined;
+
+	friend class HTTPParser;
+};
+
+/**
+ * State of the incremental parsing of an HTTP message. The data given to the
+ * next parse() has to begin with the data given to the previous one (as the
+ * unreleased data of a Socket does), the parsing continues where it stopped,
+ * so no byte is scanned twice. Lines end with CRLF or a single LF. A message
+ * over maxHeaders header lines or maxHeaderSize bytes before its body, or
+ * with a body over maxBodySize bytes is rejected.
+ */
+class HTTPParser
+{
+public:
+	enum class State
+	{
+		StartLine,
+		Headers,
+		Body,
+		ChunkSize,
+		ChunkData,
+		Trailer,
+		Complete
+	};
+
+	/* Limits of the start line and the headers together. */
+	static const unsigned maxHeaders = 100;
+	static const size_t maxHeaderSize = 64 * 1024;
+	static const size_t defaultMaxBodySize = 64 * 1024 * 1024;
+
+	HTTPParser() : maxBodySize(defaultMaxBodySize) { clear(); }
+	void clear()
+	{
+		state = State::StartLine;
+		pos = 0;
+		scanned = 0;
+		remaining = 0;
+		noBody = false;
+	}
+
+	/* Next complete line from pos without the line end. */
+	bool nextLine(const Str & data, Str & line);
+	/* Continues after the start line, returns the length of the message if it
+	 * is complete, otherwise 0. */
+	size_t parse(const Str & data, HTTPHeaders & headers, String & body);
+
+	State state;
+	size_t pos; // bytes parsed
+	size_t scanned; // bytes searched for the line end
+	size_t remaining; // bytes of the body or of the chunk
+	bool noBody; // like the response of status 1xx, 204 and 304
+	size_t maxBodySize; // kept by clear()
+private:
+	void header(const Str & data, const Str & line, HTTPHeaders & headers);
+};
+
 class HTTPRequest
 {
+	/* All the members allocate from this arena, clear() resets it. Held by
+	 * pointer to stay in place when the request is moved. */
+	Object<Arena> arena;
 public:
 	explicit HTTPRequest(const HTTPRequest & orig) = delete;
 	const HTTPRequest & operator=(const HTTPRequest &) = delete;
 
 	HTTPRequest(HTTPRequest && temp) :
+		arena(move_cast(temp.arena)),
 		method(move_cast(temp.method)),
 		uri(move_cast(temp.uri)),
 		version(move_cast(temp.version)),
 		headers(move_cast(temp.headers)),
 		body(move_cast(temp.body)),
-		requestLine(move_cast(requestLine))
-	{}
+		requestLine(move_cast(temp.requestLine)),
+		parser(temp.parser)
+	{
+		temp.renew();
+	}
 	const HTTPRequest & operator=(HTTPRequest && temp)
 	{
 		method = move_cast(temp.method);
@@ -36,10 +262,15 @@ public:
 		headers = move_cast(temp.headers);
 		body = move_cast(temp.body);
 		requestLine = move_cast(temp.requestLine);
+		parser = temp.parser;
+		/* The members moved in are in the arena of temp, nothing refers to
+		 * the old one any more. */
+		arena = move_cast(temp.arena);
+		temp.renew();
 		return *this;
 	}
 
-	HTTPRequest() {}
+	HTTPRequest();
 
 	HTTPRequest(	const Str & method,
 			const Str & uri = "/",
@@ -55,19 +286,42 @@ public:
 
 	String toString() const;
 
+	/* Returns the bytes of the request parsed from the front of the data
+	 * or 0 if the request is not complete yet. Bodies with content-length
+	 * and chunked bodies are parsed, anything after the request (pipelined
+	 * requests) is left for the next parse after clear(). See HTTPParser
+	 * about calling it again with more data. */
 	unsigned parse(const Str & data);
-
+	/* Bytes of the data already processed by parse(). */
+	size_t parsed() const { return parser.pos; }
+	/* Bigger bodies are rejected by parse(), see HTTPParser. */
+	void setMaxBodySize(size_t size) { parser.maxBodySize = size; }
+	bool headersComplete() const
+			{ return HTTPParser::State::Headers < parser.state; }
+
+	/** Empties the request and gives back all of its memory to its arena. */
 	void clear();
 
+	/* Persistent connection asked by the connection header or by the
+	 * version 1.1 default. */
+	bool keepAlive() const;
+	/* The headers arrived with "expect: 100-continue". */
+	bool expectsContinue() const;
+
 	const String & getRequestLine(){ return requestLine; }
+	const Arena & getArena() const { return *arena; }
 
 	String method;
 	String uri;
 	String version;
-	Json headers;
+	HTTPHeaders headers;
 	String body;
 private:
+	/* Gives a moved from request an empty arena of its own. */
+	void renew();
+
 	String requestLine;
+	HTTPParser parser;
 };
 
 class HTTPStatusCode /*{{{*/
@@ -209,7 +463,8 @@ public:
 		body(move_cast(temp.body)),
 		statusCode(move_cast(temp.statusCode)),
 		reasonPhrase(move_cast(temp.reasonPhrase)),
-		statusLine(move_cast(temp.statusLine))
+		statusLine(move_cast(temp.statusLine)),
+		parser(temp.parser)
 	{}
 	const HTTPResponse & operator=(HTTPResponse && temp)
 	{
@@ -219,6 +474,7 @@ public:
 		statusCode = move_cast(temp.statusCode);
 		reasonPhrase = move_cast(temp.reasonPhrase);
 		statusLine = move_cast(temp.statusLine);
+		parser = temp.parser;
 		return *this;
 	}
 
@@ -232,28 +488,187 @@ public:
 			const Str & version = "1.0");
 
 	String toString() const;
+	/* Appends the status line, the headers and the body to the buffer,
+	 * typically to the write buffer of a socket, see sendTo(). */
+	void appendTo(String & buffer) const;
+	/* At least the bytes appendTo() appends. */
+	size_t serializedLength() const;
+	/* Serializes straight into the write buffer of the socket and sends. */
+	bool sendTo(Socket & socket) const;
 
 	unsigned parse(const Str & data);
+	size_t parsed() const { return parser.pos; }
+	/* Bigger bodies are rejected by parse(), see HTTPParser. */
+	void setMaxBodySize(size_t size) { parser.maxBodySize = size; }
+	bool headersComplete() const
+			{ return HTTPParser::State::Headers < parser.state; }
 
 	void clear();
 
+	bool keepAlive() const;
+	/* The status code does not allow a body (1xx, 204, 304). */
+	bool bodyless() const;
+	/* A chunk of a chunked body, the empty chunk is the last one. */
+	static String chunk(const Str & data);
+
 	HTTPStatusCode status(){ return statusCode; }
 	const String & reason(){ return reasonPhrase; }
 	const String & getStatusLine(){ return statusLine; }
 
 	String version;
-	Json headers;
+	HTTPHeaders headers;
 	String body;
 
 private:
 	HTTPStatusCode statusCode;
 	String reasonPhrase;
 	String statusLine;
+	HTTPParser parser;
+};
+
+/**
+ * Responses of static endpoints serialized in advance, keyed by the route
+ * (the path of the uri). A GET of a cached route is answered by copying the
+ * stored bytes, no formatting at all, or by the stored 304 Not Modified if the
+ * if-none-match of the request holds the ETag of the response.
+ *
+ * The responses are HTTP/1.1 and persistent, a response without an etag
+ * header gets one computed from its body.
+ *
+ * Do not inherit from this class!
+ */
+class HTTPResponseCache
+{
+	struct Entry
+	{
+		String route;
+		String etag;
+		String full;
+		String notModified;
+
+		bool operator<(const Entry & other) const
+				{ return route < other.route; }
+		friend bool operator<(const Entry & lhs, const Str & rhs)
+				{ return lhs.route < rhs; }
+		friend bool operator<(const Str & lhs, const Entry & rhs)
+				{ return lhs < rhs.route; }
+	};
+
+public:
+	explicit HTTPResponseCache(const HTTPResponseCache & orig) = delete;
+	const HTTPResponseCache & operator=(const HTTPResponseCache &) = delete;
+
+	HTTPResponseCache(HTTPResponseCache && temp) = delete;
+	const HTTPResponseCache & operator=(HTTPResponseCache && temp) = delete;
+
+	explicit HTTPResponseCache() {}
+	~HTTPResponseCache() {}
+
+	/* Replaces the response of the route. */
+	void add(const Str & route, HTTPResponse && response);
+	void remove(const Str & route);
+	void clear() { entries.clear(); }
+	unsigned size() const { return entries.size(); }
+	bool has(const Str & route) const { return entries.has(route); }
+	/* Quoted ETag of the cached response. */
+	const String & etag(const Str & route) const
+			{ return entries.query(route).etag; }
+
+	/* Appends the response to the buffer if the request is a GET of a
+	 * cached route. Returns false if it is not. */
+	bool appendTo(const HTTPRequest & request, String & buffer) const;
+
+private:
+	OwnerContainer<Entry> entries;
+};
+
+/**
+ * Writes the response of a request into the write buffer of the connection the
+ * request arrived on. The connection header of the response is set by
+ * keepAlive, which is the persistence the request asked for.
+ *
+ * Do not inherit from this class!
+ */
+class HTTPResponseWriter
+{
+public:
+	explicit HTTPResponseWriter(const HTTPResponseWriter & orig) = delete;
+	const HTTPResponseWriter & operator=(const HTTPResponseWriter &) = delete;
+
+	HTTPResponseWriter(HTTPResponseWriter && temp) = delete;
+	const HTTPResponseWriter & operator=(HTTPResponseWriter && temp) = delete;
+
+	explicit HTTPResponseWriter(Socket & socket, const HTTPRequest & request);
+	~HTTPResponseWriter() {}
+
+	/* Serializes the response, a request gets one response only. */
+	void write(HTTPResponse & response);
+	/* Formats the response of the version of the request without building
+	 * an HTTPResponse. */
+	void write(HTTPStatusCode status, const Str & body = "",
+			const Str & contentType = "");
+	bool written() const { return done; }
+
+	bool keepAlive; // the connection is closed after the response if false
+
+private:
+	Socket & socket;
+	bool version10;
+	bool done;
+};
+
+/**
+ * Server side of a persistent HTTP/1.1 connection. The pipelined requests are
+ * parsed back to back from the read buffer and answered in order by the
+ * handle() of the child. The connection is closed after the response if the
+ * request or the response asks for it (see HTTPRequest::keepAlive()). A
+ * request expecting 100-continue gets the interim response when its headers
+ * arrived. The responses are serialized straight into the write buffer.
+ *
+ * Persistent HTTP/1.1 GET requests of the routes in the cache, if given, are
+ * answered from it without calling handle().
+ */
+class HTTPConnection : public Server
+{
+public:
+	explicit HTTPConnection(const HTTPConnection & orig) = delete;
+	const HTTPConnection & operator=(const HTTPConnection &) = delete;
+
+	HTTPConnection(HTTPConnection && temp) = delete;
+	const HTTPConnection & operator=(HTTPConnection && temp) = delete;
+
+	explicit HTTPConnection(const Listener & listener);
+	/* Takes over a connection accepted elsewhere, see Reactor::serve(). */
+	explicit HTTPConnection(int fd);
+	virtual ~HTTPConnection() {}
+
+	virtual void dataReceived();
+
+	unsigned requestsServed;
+	HTTPResponseCache * cache; // not owned
+
+protected:
+	/* Writes the response of the request, the one given by respond() by
+	 * default. 500 Internal Server Error is sent if nothing is written. */
+	virtual void handle(HTTPRequest & request, HTTPResponseWriter & writer);
+	/* 404 Not Found by default. */
+	virtual HTTPResponse respond(HTTPRequest & request);
+
+private:
+	HTTPRequest request;
+	bool continueSent;
 };
 
 inline bool operator==(const HTTPStatusCode & lhs, const HTTPStatusCode::Enum & rhs)
 		{ return lhs.code == rhs; }
 
+/* The header lines separated by CRLF. */
+inline String &	operator<<(csjp::String & lhs, const csjp::HTTPHeaders & rhs)
+{
+	for(size_t i = 0; i < rhs.size(); i++)
+		lhs.cat(i ? "\r\n" : "", rhs.name(i), ": ", rhs.value(i));
+	return lhs;
+}
 inline String &	operator<<(csjp::String & lhs, const csjp::HTTPResponse & rhs)
 		{ lhs += rhs.toString(); return lhs; }
 inline String &	operator<<(csjp::String & lhs, const csjp::HTTPRequest & rhs)
@@ -22,8 +22,9 @@
 namespace csjp {
 
 Listener::Listener(const char * ip, unsigned port,
-		unsigned incomingConnectionQueueLength ) :
-	Socket()
+		unsigned incomingConnectionQueueLength, bool reusePort) :
+	Socket(),
+	acceptedFd(-1)
 {
 	address.sin_family = AF_INET;
 	address.sin_addr.s_addr = INADDR_ANY;
@@ -44,6 +45,13 @@ Listener::Listener(const char * ip, unsigned port,
 		throw SocketError("Failed to set socket option SO_REUSEADDR.");
 	}
 
+	if(reusePort && setsockopt(file, SOL_SOCKET, SO_REUSEPORT,
+				&ov, sizeof(ov)) == -1){
+		int errNo = errno;
+		close(false);
+		throw SocketError(errNo, "Failed to set socket option SO_REUSEPORT.");
+	}
+
 	if(bind(file, (struct sockaddr *)&address, sizeof(address)) < 0){
 		int errNo = errno;
 		close(false);
@@ -58,5 +66,36 @@ Listener::Listener(const char * ip, unsigned port,
 	}
 }
 
+Listener::~Listener()
+{
+	if(0 <= acceptedFd)
+		::close(acceptedFd);
+}
+
+int Listener::accept(struct sockaddr_in & peer) const
+{
+	socklen_t len = sizeof(peer);
+	if(0 <= acceptedFd){
+		int fd = acceptedFd;
+		acceptedFd = -1;
+		if(getpeername(fd, (struct sockaddr *) &peer, &len) < 0){
+			int errNo = errno;
+			::close(fd);
+			throw SocketError(errNo, "Failed to query peer address "
+					"of fd %.", fd);
+		}
+		return fd;
+	}
+
+	int fd = ::accept4(file, (struct sockaddr *) &peer, &len,
+			SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if(fd < 0){
+		if(errno == EAGAIN || errno == EWOULDBLOCK)
+			return -1;
+		throw SocketError(errno,
+				"Socket failed to accept new connection.");
+	}
+	return fd;
 }
 
+}
@@ -17,18 +17,36 @@ public:
 	explicit Listener(const Listener & orig) = delete;
 	const Listener & operator=(const Listener &) = delete;
 
-	Listener(Listener && temp) : Socket(move_cast(temp)) { (void)temp; }
+	Listener(Listener && temp) :
+		Socket(move_cast(temp)),
+		acceptedFd(temp.acceptedFd)
+	{
+		temp.acceptedFd = -1;
+	}
 	const Listener & operator=(Listener && temp)
 	{
 		Socket::operator=(move_cast(temp));
+		acceptedFd = temp.acceptedFd;
+		temp.acceptedFd = -1;
 		return *this;
 	}
 
+	/* With reusePort more listeners can bind to the same port, the kernel
+	 * balances the incoming connections among them (SO_REUSEPORT). */
 	Listener(const char * ip, unsigned port,
-			unsigned incomingConnectionQueueLength = 0);
-	virtual ~Listener() {}
+			unsigned incomingConnectionQueueLength = 0,
+			bool reusePort = false);
+	virtual ~Listener();
+
+	/* Returns the next incoming connection or -1 if there is none. A
+	 * connection already accepted by URing is given first. */
+	int accept(struct sockaddr_in & peer) const;
+
+private:
+	mutable int acceptedFd; // accepted by URing, not yet taken
 
 	friend Server;
+	friend URing;
 };
 
 }
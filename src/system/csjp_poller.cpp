@@ -0,0 +1,54 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#undef DEBUG
+
+#include "csjp_poller.h"
+
+namespace csjp {
+
+Poller::Poller(Backend backend, unsigned maxEvents) PollerInitializer
+{
+	if(backend == Backend::URing){
+		uring = Object<URing>(new URing(maxEvents));
+		return;
+	}
+
+	if(backend == Backend::Auto && URing::supported()){
+		try {
+			uring = Object<URing>(new URing(maxEvents));
+			return;
+		} catch(Exception & e) {
+			DBG("Falling back to epoll: %", e.what());
+		}
+	}
+
+	epoll = Object<EPollControl>(new EPollControl(maxEvents));
+}
+
+void Poller::add(Socket & socket)
+{
+	if(uring.ptr)
+		uring->add(socket);
+	else
+		epoll->add(socket);
+}
+
+void Poller::remove(Socket & socket)
+{
+	if(uring.ptr)
+		uring->remove(socket);
+	else
+		epoll->remove(socket);
+}
+
+Array<EPollControl::ControlEvent> Poller::waitAndControl(int timeout)
+{
+	if(uring.ptr)
+		return uring->waitAndControl(timeout);
+	return epoll->waitAndControl(timeout);
+}
+
+}
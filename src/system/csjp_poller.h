@@ -0,0 +1,69 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#ifndef CSJP_POLLER_H
+#define CSJP_POLLER_H
+
+#include <csjp_object.h>
+#include <csjp_epoll_control.h>
+#include <csjp_uring.h>
+
+namespace csjp {
+
+/**
+ * Event loop on io_uring where the kernel supports it, on epoll otherwise.
+ * The sockets and the control events are the same with both backends.
+ *
+ * Do not inherit from this class!
+ */
+class Poller
+{
+public:
+	enum class Backend {
+		Auto, // URing if supported, EPoll otherwise
+		EPoll,
+		URing
+	};
+
+	static inline const char * backendName(Backend backend)
+	{
+		switch(backend){
+		case Backend::Auto: return "Auto";
+		case Backend::EPoll: return "EPoll";
+		case Backend::URing: return "URing";
+		default: return "Unknown";
+		}
+	}
+
+#define PollerInitializer : \
+		epoll(NULL), \
+		uring(NULL)
+public:
+	explicit Poller(const Poller & orig) = delete;
+	const Poller & operator=(const Poller &) = delete;
+
+	Poller(Poller && temp) = delete;
+	const Poller & operator=(Poller && temp) = delete;
+
+	/* Throws if the URing backend is asked for explicitly, but it is not
+	 * supported. */
+	explicit Poller(Backend backend = Backend::Auto, unsigned maxEvents = 256);
+	~Poller() {}
+
+	Backend backend() const
+		{ return uring.ptr ? Backend::URing : Backend::EPoll; }
+
+	void add(Socket & socket);
+	void remove(Socket & socket);
+	Array<EPollControl::ControlEvent> waitAndControl(int timeout = 0);
+
+private:
+	Object<EPollControl> epoll;
+	Object<URing> uring;
+};
+
+}
+
+#endif
@@ -0,0 +1,281 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+#include <unistd.h>
+#include <sched.h>
+
+#undef DEBUG
+
+#include "csjp_reactor.h"
+
+namespace csjp {
+
+/* eventfd in the epoll of the reactor, other threads write it to wake it up. */
+class Reactor::Waker : public Socket
+{
+public:
+	explicit Waker(Reactor & reactor) : Socket(), reactor(reactor)
+	{
+		file = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if(file < 0)
+			throw SocketError(errno, "Failed to create eventfd.");
+	}
+	virtual ~Waker() {}
+
+	void wakeup()
+	{
+		uint64_t one = 1;
+		ssize_t written;
+		TEMP_FAILURE_RETRY_RESULT(written, ::write(file, &one, sizeof(one)));
+		/* EAGAIN means the counter is full, the reactor is woken up anyway. */
+		if(written < 0 && errno != EAGAIN)
+			throw SocketError(errno, "Failed to write eventfd.");
+	}
+
+	virtual void dataReceived()
+	{
+		release(bytesAvailable);
+		reactor.takeHandedOver();
+		reactor.wokenUp();
+	}
+
+private:
+	Reactor & reactor;
+};
+
+/* Listener accepting all the pending connections for its reactor. */
+class Reactor::Acceptor : public Listener
+{
+public:
+	Acceptor(Reactor & reactor, const char * ip, unsigned port,
+			unsigned queueLength) :
+		Listener(ip, port, queueLength, true),
+		reactor(reactor)
+	{}
+	virtual ~Acceptor() {}
+
+	virtual void dataReceived()
+	{
+		while(true){
+			int fd = ::accept4(file, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if(fd < 0){
+				if(errno == EAGAIN || errno == EWOULDBLOCK)
+					return;
+				if(errno == EINTR || errno == ECONNABORTED)
+					continue;
+				throw SocketError(errno,
+						"Socket failed to accept new connection.");
+			}
+			reactor.accepted(fd);
+		}
+	}
+
+private:
+	Reactor & reactor;
+};
+
+Reactor::Reactor(unsigned maxEvents) ReactorInitializer
+{
+	waker = Object<Waker>(new Waker(*this));
+	add(*waker);
+}
+
+Reactor::~Reactor()
+{
+	for(int fd : handedOver)
+		::close(fd);
+	for(int fd : taken)
+		::close(fd);
+}
+
+void Reactor::wakeup()
+{
+	waker->wakeup();
+}
+
+void Reactor::stop()
+{
+	__atomic_store_n(&stopped, true, __ATOMIC_RELEASE);
+	wakeup();
+}
+
+void Reactor::handOver(int fd)
+{
+	__atomic_add_fetch(&connections, 1, __ATOMIC_RELAXED);
+	{
+		Mutex::Lock lock(mutex);
+		handedOver.add(fd);
+	}
+	wakeup();
+}
+
+void Reactor::listen(const char * ip, unsigned port, unsigned queueLength)
+{
+	listener = Object<Acceptor>(new Acceptor(*this, ip, port, queueLength));
+	add(*listener);
+}
+
+void Reactor::accepted(int fd)
+{
+	__atomic_add_fetch(&connections, 1, __ATOMIC_RELAXED);
+	try {
+		serve(fd);
+	} catch(...) {
+		::close(fd);
+		disconnected();
+		throw;
+	}
+}
+
+void Reactor::takeHandedOver()
+{
+	{
+		Mutex::Lock lock(mutex);
+		for(int fd : handedOver)
+			taken.add(fd);
+		handedOver.clear();
+	}
+	/* Each fd leaves taken before it is served, so if serve() throws, the
+	 * rest is served at the next wakeup and none of them twice. */
+	while(taken.length){
+		int fd = taken[taken.length - 1];
+		taken.removeAt(taken.length - 1);
+		try {
+			serve(fd);
+		} catch(...) {
+			::close(fd);
+			disconnected();
+			throw;
+		}
+	}
+}
+
+void Reactor::run()
+{
+	if(0 <= cpu){
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		if(sched_setaffinity(0, sizeof(set), &set) < 0)
+			throw SystemError(errno, "Failed to pin reactor to cpu %.", cpu);
+	}
+
+	while(!__atomic_load_n(&stopped, __ATOMIC_ACQUIRE))
+		for(auto & event : waitAndControl(-1))
+			controlled(event);
+}
+
+/* Reactor of the accept thread, hands out the connections to the pool. */
+class ReactorPool::Distributor : public Reactor
+{
+public:
+	explicit Distributor(ReactorPool & pool) : Reactor(16), pool(pool) {}
+	virtual ~Distributor() {}
+
+protected:
+	virtual void serve(int fd)
+	{
+		disconnected();
+		pool.handOut(fd);
+	}
+
+private:
+	ReactorPool & pool;
+};
+
+ReactorPool::~ReactorPool()
+{
+	stop();
+}
+
+void ReactorPool::add(Reactor * reactor)
+{
+	ENSURE(!running, InvalidState);
+	reactors.add(move_cast(reactor));
+}
+
+void ReactorPool::listen(const char * ip, unsigned port, Balance balance,
+		unsigned queueLength)
+{
+	ENSURE(!running, InvalidState);
+	ENSURE(reactors.length, InvalidState);
+	this->balance = balance;
+	if(balance == Balance::ReusePort){
+		for(auto & reactor : reactors)
+			reactor.listen(ip, port, queueLength);
+		return;
+	}
+	acceptor = Object<Reactor>(new Distributor(*this));
+	acceptor->listen(ip, port, queueLength);
+}
+
+void ReactorPool::handOut(int fd)
+{
+	size_t i = 0;
+	if(balance == Balance::LeastLoaded){
+		for(size_t j = 1; j < reactors.length; j++)
+			if(reactors[j].load() < reactors[i].load())
+				i = j;
+	} else {
+		i = next++ % reactors.length;
+	}
+	reactors[i].handOver(fd);
+}
+
+static void * runReactor(void * arg)
+{
+	try {
+		((Reactor *)arg)->run();
+	} catch(Exception & e) {
+		e.note("Reactor thread stopped.");
+		EXCEPTION(e);
+	}
+	return NULL;
+}
+
+void ReactorPool::start(bool pinToCpus)
+{
+	ENSURE(!running, InvalidState);
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if(cpus < 1)
+		cpus = 1;
+
+	for(size_t i = 0; i < reactors.length; i++){
+		if(pinToCpus)
+			reactors[i].setCpu(i % cpus);
+		pthread_t thread;
+		if(pthread_create(&thread, NULL, runReactor, &reactors[i]))
+			throw SystemError("Failed to create reactor thread.");
+		threads.add(thread);
+		running = true;
+	}
+	if(acceptor.ptr){
+		pthread_t thread;
+		if(pthread_create(&thread, NULL, runReactor, acceptor.ptr))
+			throw SystemError("Failed to create accept thread.");
+		threads.add(thread);
+	}
+	running = true;
+}
+
+void ReactorPool::stop()
+{
+	if(!running)
+		return;
+	if(acceptor.ptr)
+		acceptor->stop();
+	for(auto & reactor : reactors)
+		reactor.stop();
+	for(pthread_t thread : threads)
+		pthread_join(thread, NULL);
+	threads.clear();
+	running = false;
+}
+
+}
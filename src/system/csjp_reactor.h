@@ -0,0 +1,149 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#ifndef CSJP_REACTOR_H
+#define CSJP_REACTOR_H
+
+#include <pthread.h>
+
+#include <csjp_object.h>
+#include <csjp_mutex.h>
+#include <csjp_array.h>
+#include <csjp_pod_array.h>
+#include <csjp_listener.h>
+#include <csjp_epoll_control.h>
+
+namespace csjp {
+
+/**
+ * Event loop of one thread. Connections come either from its own listener (see
+ * listen()) or are handed over by other threads (see handOver()). The
+ * connections are created by the serve() of the child class, the control
+ * events of the loop are given to its controlled().
+ *
+ * wakeup(), stop() and handOver() can be called from any thread, everything
+ * else belongs to the thread running run().
+ */
+class Reactor : public EPollControl
+{
+public:
+	class Waker;
+	class Acceptor;
+
+#define ReactorInitializer : \
+		EPollControl(maxEvents), \
+		waker(NULL), \
+		listener(NULL), \
+		stopped(false), \
+		connections(0), \
+		cpu(-1)
+public:
+	explicit Reactor(const Reactor & orig) = delete;
+	const Reactor & operator=(const Reactor &) = delete;
+
+	Reactor(Reactor && temp) = delete;
+	const Reactor & operator=(Reactor && temp) = delete;
+
+	explicit Reactor(unsigned maxEvents = 256);
+	virtual ~Reactor();
+
+	/* Wakes up the loop, wokenUp() is called in the reactor thread. */
+	void wakeup();
+	/* Makes run() return after the current iteration. */
+	void stop();
+	/* The accepted connection is going to be served in the reactor thread. */
+	void handOver(int fd);
+	/* Number of the connections being served. */
+	unsigned load() const { return __atomic_load_n(&connections, __ATOMIC_RELAXED); }
+
+	/* Listens on its own SO_REUSEPORT listener, so that more reactors can
+	 * listen on the same port. */
+	void listen(const char * ip, unsigned port, unsigned queueLength = 128);
+	/* The thread running run() is pinned to the cpu, -1 for any. */
+	void setCpu(int cpu) { this->cpu = cpu; }
+	int getCpu() const { return cpu; }
+
+	void run();
+
+protected:
+	/* Creates the connection (Server) object for the accepted fd and adds it
+	 * to the reactor. The fd is taken over only if it returns, if it throws
+	 * the reactor closes the fd. */
+	virtual void serve(int fd) = 0;
+	virtual void controlled(ControlEvent & event) { (void)event; }
+	virtual void wokenUp() {}
+	/* A connection given to serve() is closed. */
+	void disconnected() { __atomic_sub_fetch(&connections, 1, __ATOMIC_RELAXED); }
+
+private:
+	void accepted(int fd);
+	void takeHandedOver();
+
+	Object<Waker> waker;
+	Object<Acceptor> listener;
+	Mutex mutex;
+	PodArray<int> handedOver; // guarded by mutex
+	PodArray<int> taken;
+	bool stopped;
+	int connections;
+	int cpu;
+};
+
+/**
+ * Runs reactors in threads of their own. The connections are balanced among
+ * them either by the kernel (each reactor has its own SO_REUSEPORT listener)
+ * or by an accept thread handing them over to the reactors round-robin or to
+ * the least loaded one.
+ */
+class ReactorPool
+{
+#define ReactorPoolInitializer : \
+		acceptor(NULL), \
+		balance(Balance::ReusePort), \
+		next(0), \
+		running(false)
+public:
+	explicit ReactorPool(const ReactorPool & orig) = delete;
+	const ReactorPool & operator=(const ReactorPool &) = delete;
+
+	ReactorPool(ReactorPool && temp) = delete;
+	const ReactorPool & operator=(ReactorPool && temp) = delete;
+
+	explicit ReactorPool() ReactorPoolInitializer {}
+	~ReactorPool();
+
+	enum class Balance {
+		ReusePort,
+		RoundRobin,
+		LeastLoaded
+	};
+
+	/* Takes the ownership. */
+	void add(Reactor * reactor);
+	Reactor & operator[](size_t i) { return reactors[i]; }
+	size_t size() const { return reactors.length; }
+
+	void listen(const char * ip, unsigned port,
+			Balance balance = Balance::ReusePort,
+			unsigned queueLength = 128);
+	/* With pinning the reactors are pinned to the cpus one after the other. */
+	void start(bool pinToCpus = false);
+	void stop();
+
+private:
+	class Distributor;
+	void handOut(int fd);
+
+	Array<Reactor> reactors;
+	Object<Reactor> acceptor;
+	PodArray<pthread_t> threads;
+	Balance balance;
+	size_t next;
+	bool running;
+};
+
+}
+
+#endif
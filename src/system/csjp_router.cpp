@@ -0,0 +1,335 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#include <string.h>
+
+#undef DEBUG
+
+#include "csjp_router.h"
+
+namespace csjp {
+
+Str RouteMatch::operator[](const Str & name) const
+{
+	for(unsigned i = 0; i < count; i++)
+		if(this->name(i) == name)
+			return value(i);
+	return Str();
+}
+
+String RouteMatch::allowed() const
+{
+	String list;
+	for(unsigned i = 0; i < Router::methods; i++){
+		if(!(methods & (1u << i)))
+			continue;
+		if(list.length)
+			list.append(", ", 2);
+		list.append(Router::name((Router::Method)i));
+	}
+	return list;
+}
+
+Router::Node::Node() :
+	param(0),
+	catchAll(0),
+	any(NULL),
+	endpoint(false)
+{
+	for(unsigned i = 0; i < methods; i++)
+		handlers[i] = NULL;
+}
+
+Router::Router() :
+	routes(0)
+{
+	newNode(); // root
+}
+
+Router::Method Router::method(const Str & name)
+{
+	switch(name.length){
+	case 3:
+		if(name == "GET")
+			return Method::Get;
+		if(name == "PUT")
+			return Method::Put;
+		break;
+	case 4:
+		if(name == "HEAD")
+			return Method::Head;
+		if(name == "POST")
+			return Method::Post;
+		break;
+	case 5:
+		if(name == "PATCH")
+			return Method::Patch;
+		break;
+	case 6:
+		if(name == "DELETE")
+			return Method::Delete;
+		break;
+	case 7:
+		if(name == "OPTIONS")
+			return Method::Options;
+		break;
+	}
+	return Method::Other;
+}
+
+const char * Router::name(Method method)
+{
+	switch(method){
+	case Method::Get : return "GET";
+	case Method::Head : return "HEAD";
+	case Method::Post : return "POST";
+	case Method::Put : return "PUT";
+	case Method::Delete : return "DELETE";
+	case Method::Patch : return "PATCH";
+	case Method::Options : return "OPTIONS";
+	case Method::Other : break;
+	}
+	return "";
+}
+
+unsigned Router::newNode()
+{
+	nodes.add(new Node);
+	return nodes.length - 1;
+}
+
+/* The static text is inserted into the radix tree, the edge sharing only a
+ * prefix with it is split. */
+unsigned Router::insertStatic(unsigned index, Str text)
+{
+	while(text.length){
+		Node & node = nodes[index];
+		size_t at;
+		if(!node.firsts.findFirst(at, text[0])){
+			unsigned leaf = newNode();
+			nodes[leaf].label <<= text;
+			node.firsts.append(text[0]);
+			node.children.add(leaf);
+			return leaf;
+		}
+
+		Node & next = nodes[node.children[at]];
+		size_t common = 1;
+		while(common < text.length && common < next.label.length &&
+				text[common] == next.label[common])
+			common++;
+		if(common < next.label.length){
+			unsigned split = newNode();
+			Node & middle = nodes[split];
+			middle.label.append(next.label.c_str(), common);
+			next.label.chopFront(common);
+			middle.firsts.append(next.label[0]);
+			middle.children.add(node.children[at]);
+			node.children[at] = split;
+		}
+		index = node.children[at];
+		text = text.read(common, text.length);
+	}
+	return index;
+}
+
+unsigned Router::insertParam(unsigned index, const Str & name, bool catchAll)
+{
+	unsigned existing = catchAll ? nodes[index].catchAll : nodes[index].param;
+	if(existing){
+		if(nodes[existing].name != name)
+			throw InvalidArgument("Route parameter % conflicts with %.",
+					name, nodes[existing].name);
+		return existing;
+	}
+
+	unsigned param = newNode();
+	nodes[param].name <<= name;
+	if(catchAll)
+		nodes[index].catchAll = param;
+	else
+		nodes[index].param = param;
+	return param;
+}
+
+void Router::add(const Str & method, const Str & pattern, RouteHandler & handler)
+{
+	if(!pattern.length || pattern[0] != '/')
+		throw InvalidArgument("Route pattern % does not start with /.",
+				pattern);
+
+	unsigned index = 0;
+	unsigned params = 0;
+	size_t pos = 0;
+	while(pos < pattern.length){
+		size_t mark;
+		if(!pattern.findFirstOf(mark, ":*", pos))
+			mark = pattern.length;
+		if(pos < mark)
+			index = insertStatic(index, pattern.read(pos, mark));
+		if(mark == pattern.length)
+			break;
+
+		size_t end;
+		if(!pattern.findFirst(end, '/', mark))
+			end = pattern.length;
+		bool catchAll = pattern[mark] == '*';
+		if(pattern[mark - 1] != '/' || end == mark + 1 ||
+				(catchAll && end != pattern.length) ||
+				RouteMatch::maxParams <= params++)
+			throw InvalidArgument("Invalid route pattern: %", pattern);
+		index = insertParam(index, pattern.read(mark + 1, end), catchAll);
+		pos = end;
+	}
+
+	Node & node = nodes[index];
+	RouteHandler ** slot;
+	if(method == "*")
+		slot = &node.any;
+	else {
+		Method m = Router::method(method);
+		if(m == Method::Other)
+			throw InvalidArgument("Unknown method % for route %.",
+					method, pattern);
+		slot = &node.handlers[(unsigned)m];
+	}
+	if(*slot)
+		throw InvalidArgument("Route % % has a handler already.",
+				method, pattern);
+	*slot = &handler;
+	if(!node.endpoint){
+		node.endpoint = true;
+		routes++;
+	}
+}
+
+const Router::Node * Router::match(unsigned index, const char * path,
+		size_t length, RouteMatch & match) const
+{
+	const Node & node = nodes[index];
+	if(!length && node.endpoint)
+		return &node;
+
+	if(length && node.firsts.length){
+		const char * first = (const char *)memchr(
+				node.firsts.c_str(), *path, node.firsts.length);
+		if(first){
+			unsigned child = node.children[first - node.firsts.c_str()];
+			const String & label = nodes[child].label;
+			if(label.length <= length &&
+					!memcmp(path, label.c_str(), label.length)){
+				const Node * found = this->match(child,
+						path + label.length, length - label.length,
+						match);
+				if(found)
+					return found;
+			}
+		}
+	}
+
+	if(length && node.param){
+		const char * slash = (const char *)memchr(path, '/', length);
+		size_t segment = slash ? slash - path : length;
+		if(segment){
+			const Node & param = nodes[node.param];
+			RouteMatch::Param & p = match.params[match.count++];
+			p.name = param.name.c_str();
+			p.nameLength = param.name.length;
+			p.value = path;
+			p.valueLength = segment;
+			const Node * found = this->match(node.param,
+					path + segment, length - segment, match);
+			if(found)
+				return found;
+			match.count--;
+		}
+	}
+
+	if(node.catchAll){
+		const Node & rest = nodes[node.catchAll];
+		RouteMatch::Param & p = match.params[match.count++];
+		p.name = rest.name.c_str();
+		p.nameLength = rest.name.length;
+		p.value = path;
+		p.valueLength = length;
+		return &rest;
+	}
+
+	return NULL;
+}
+
+void Router::resolve(const Str & method, const Str & uri,
+		RouteMatch & match) const
+{
+	match.clear();
+	size_t length;
+	if(!uri.findFirst(length, '?'))
+		length = uri.length;
+	const Node * node = this->match(0, uri.c_str(), length, match);
+	if(!node){
+		match.count = 0;
+		return;
+	}
+
+	Method m = Router::method(method);
+	RouteHandler * handler = m == Method::Other ?
+			NULL : node->handlers[(unsigned)m];
+	if(!handler)
+		handler = node->any;
+	if(!handler){
+		for(unsigned i = 0; i < methods; i++)
+			if(node->handlers[i])
+				match.methods |= 1u << i;
+		match.result = RouteMatch::Result::MethodNotAllowed;
+		return;
+	}
+	match.handler = handler;
+	match.result = RouteMatch::Result::Found;
+}
+
+void RoutedConnection::handle(HTTPRequest & request, HTTPResponseWriter & writer)
+{
+	router.resolve(request.method, request.uri, match);
+	switch(match.result){
+	case RouteMatch::Result::Found :
+		match.handler->handle(request, match, writer);
+		break;
+	case RouteMatch::Result::NotFound :
+		writer.write(HTTPStatusCode::Enum::NotFound);
+		break;
+	case RouteMatch::Result::MethodNotAllowed : {
+			HTTPResponse response(HTTPStatusCode::Enum::MethodNotAllowed,
+					"", request.version);
+			response.headers.set("allow", match.allowed());
+			writer.write(response);
+		}
+		break;
+	}
+}
+
+void RoutingReactor::serve(int fd)
+{
+	Object<RoutedConnection> connection(new RoutedConnection(fd, router));
+	RoutedConnection & socket = *connection;
+	try {
+		connections.add(connection);
+		add(socket);
+	} catch(...) {
+		socket.detach(); // the reactor closes the fd
+		if(!connection.ptr)
+			connections.remove(socket);
+		throw;
+	}
+}
+
+void RoutingReactor::controlled(ControlEvent & event)
+{
+	if(!connections.has(event.socket))
+		return;
+	connections.remove(event.socket);
+	disconnected();
+}
+
+}
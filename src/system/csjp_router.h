@@ -0,0 +1,220 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#ifndef CSJP_ROUTER_H
+#define CSJP_ROUTER_H
+
+#include <csjp_array.h>
+#include <csjp_pod_array.h>
+#include <csjp_owner_container.h>
+#include <csjp_http.h>
+#include <csjp_reactor.h>
+
+namespace csjp {
+
+class RouteMatch;
+
+/* Business logic of a route. */
+class RouteHandler
+{
+public:
+	virtual ~RouteHandler() {}
+	virtual void handle(HTTPRequest & request, const RouteMatch & match,
+			HTTPResponseWriter & writer) = 0;
+};
+
+/**
+ * Result of Router::resolve(): the handler and the path parameters as views
+ * into the uri of the request. Resolving does not allocate.
+ *
+ * Do not inherit from this class!
+ */
+class RouteMatch
+{
+public:
+	static const unsigned maxParams = 16;
+
+	enum class Result {
+		Found,
+		NotFound,
+		MethodNotAllowed
+	};
+
+	explicit RouteMatch() :
+		result(Result::NotFound), handler(NULL), count(0), methods(0) {}
+
+	unsigned size() const { return count; }
+	Str name(unsigned i) const { return Str(params[i].name, params[i].nameLength); }
+	Str value(unsigned i) const { return Str(params[i].value, params[i].valueLength); }
+	/* Value of the named parameter, empty if there is none. */
+	Str operator[](const Str & name) const;
+	/* Comma separated methods having a handler for the path, the value of
+	 * the allow header of a MethodNotAllowed result. */
+	String allowed() const;
+
+	Result result;
+	RouteHandler * handler;
+
+private:
+	struct Param {
+		const char * name;
+		const char * value;
+		unsigned nameLength;
+		unsigned valueLength;
+	};
+
+	void clear()
+			{ result = Result::NotFound; handler = NULL; count = 0; methods = 0; }
+
+	Param params[maxParams];
+	unsigned count;
+	unsigned methods; // bits by Router::Method, set on MethodNotAllowed
+
+	friend class Router;
+};
+
+/**
+ * Route table compiled into a radix tree. A pattern is a path with static parts,
+ * parameters matching one segment (/users/:id) and at its end a catch-all
+ * parameter (*path) matching the rest of the path. Static parts win
+ * over parameters, parameters over catch-all, with backtracking when a
+ * preferred branch turns out to be a dead end.
+ *
+ * Every route has handlers per method; "*" registers one for any method not
+ * given explicitly. The handlers are not owned by the router.
+ *
+ * Do not inherit from this class!
+ */
+class Router
+{
+public:
+	enum class Method : unsigned char {
+		Get,
+		Head,
+		Post,
+		Put,
+		Delete,
+		Patch,
+		Options,
+		Other
+	};
+	static const unsigned methods = (unsigned)Method::Other + 1;
+
+private:
+	struct Node
+	{
+		Node();
+
+		String label; // static text, empty for the parameter nodes
+		String name; // of the parameter
+		String firsts; // first bytes of the static children
+		PodArray<unsigned> children; // in the order of firsts
+		unsigned param; // child matching a segment, 0 if none
+		unsigned catchAll; // child matching the rest, 0 if none
+		RouteHandler * handlers[methods];
+		RouteHandler * any;
+		bool endpoint;
+	};
+
+public:
+	explicit Router(const Router & orig) = delete;
+	const Router & operator=(const Router &) = delete;
+
+	Router(Router && temp) = delete;
+	const Router & operator=(Router && temp) = delete;
+
+	explicit Router();
+	~Router() {}
+
+	static Method method(const Str & name);
+	static const char * name(Method method);
+
+	/* Throws InvalidArgument for a malformed pattern, for a parameter
+	 * named differently than the one already at the same place and for a
+	 * route and method already having a handler. */
+	void add(const Str & method, const Str & pattern, RouteHandler & handler);
+	/* Resolves the path of the uri, the query is ignored. */
+	void resolve(const Str & method, const Str & uri, RouteMatch & match) const;
+	unsigned size() const { return routes; }
+
+private:
+	unsigned newNode();
+	unsigned insertStatic(unsigned node, Str text);
+	unsigned insertParam(unsigned node, const Str & name, bool catchAll);
+	/* The endpoint node matching the rest of the path after the node. */
+	const Node * match(unsigned node, const char * path, size_t length,
+			RouteMatch & match) const;
+
+	Array<Node> nodes;
+	unsigned routes;
+};
+
+/**
+ * HTTP connection dispatching the requests with a Router. Unknown paths get
+ * 404 Not Found, known paths without a handler of the method get 405 Method
+ * Not Allowed with the allow header listing the methods of the path.
+ */
+class RoutedConnection : public HTTPConnection
+{
+public:
+	explicit RoutedConnection(const RoutedConnection & orig) = delete;
+	const RoutedConnection & operator=(const RoutedConnection &) = delete;
+
+	RoutedConnection(RoutedConnection && temp) = delete;
+	const RoutedConnection & operator=(RoutedConnection && temp) = delete;
+
+	explicit RoutedConnection(const Listener & listener, const Router & router) :
+		HTTPConnection(listener), router(router) {}
+	explicit RoutedConnection(int fd, const Router & router) :
+		HTTPConnection(fd), router(router) {}
+	virtual ~RoutedConnection() {}
+
+protected:
+	virtual void handle(HTTPRequest & request, HTTPResponseWriter & writer);
+
+private:
+	const Router & router;
+	RouteMatch match;
+};
+
+inline bool operator<(const RoutedConnection & lhs, const RoutedConnection & rhs)
+		{ return &lhs < &rhs; }
+inline bool operator<(const Socket & lhs, const RoutedConnection & rhs)
+		{ return &lhs < &rhs; }
+inline bool operator<(const RoutedConnection & lhs, const Socket & rhs)
+		{ return &lhs < &rhs; }
+
+/**
+ * Reactor serving its connections with the routes of the router, see
+ * ReactorPool for running more of them. The router is not to be changed while
+ * the reactor runs.
+ *
+ * Do not inherit from this class!
+ */
+class RoutingReactor : public Reactor
+{
+public:
+	explicit RoutingReactor(const RoutingReactor & orig) = delete;
+	const RoutingReactor & operator=(const RoutingReactor &) = delete;
+
+	RoutingReactor(RoutingReactor && temp) = delete;
+	const RoutingReactor & operator=(RoutingReactor && temp) = delete;
+
+	explicit RoutingReactor(const Router & router, unsigned maxEvents = 256) :
+		Reactor(maxEvents), router(router) {}
+	virtual ~RoutingReactor() { connections.clear(); }
+
+protected:
+	virtual void serve(int fd);
+	virtual void controlled(ControlEvent & event);
+
+private:
+	const Router & router;
+	OwnerContainer<RoutedConnection> connections;
+};
+
+}
+
+#endif
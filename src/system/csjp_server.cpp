@@ -23,16 +23,22 @@ namespace csjp {
 
 Server::Server(const Listener & listener) : Socket()
 {
+	file = listener.accept(address);
+	if(file < 0)
+		throw SocketNoneConnecting(errno, "There is no "
+				"connection attempt to this socket.");
+}
+
+Server::Server(int fd) : Socket()
+{
+	if(fd < 0)
+		throw InvalidArgument("Invalid file descriptor % for Server.", fd);
+	/* The fd is taken over only if the constructor succeeds, otherwise the
+	 * one who gave it closes it. */
 	socklen_t clilen = sizeof(address);
-	file = ::accept4(listener.file, 
-			(struct sockaddr *) &address, &clilen, SOCK_NONBLOCK);
-	if(file < 0){
-		if(errno == EAGAIN || errno == EWOULDBLOCK)
-			throw SocketNoneConnecting(errno, "There is no "
-					"connection attempt to this socket.");
-		throw SocketError(errno,
-				"Socket failed to accept new connection.");
-	}
+	if(getpeername(fd, (struct sockaddr *) &address, &clilen) < 0)
+		throw SocketError(errno, "Failed to query peer address of fd %.", fd);
+	file = fd;
 }
 
 }
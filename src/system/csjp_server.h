@@ -24,6 +24,8 @@ public:
 	}
 
 	Server(const Listener &);
+	/* Takes over a connection accepted elsewhere, like in another thread. */
+	explicit Server(int fd);
 	virtual ~Server() {}
 };
 
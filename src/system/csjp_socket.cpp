@@ -5,6 +5,9 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
 
 #include <unistd.h>
 #include <netdb.h>
@@ -17,16 +20,35 @@
 #undef DEBUG
 
 #include "csjp_socket.h"
+#include "csjp_uring.h"
 
 namespace csjp {
 
 Socket::Socket() :
 	file(-1),
+	listening(false),
+	sendHead(0),
+	pending(0),
+	zeroCopySent(0),
+	zeroCopyCompleted(0),
+	composeFrom(0),
+	sendingBytes(0),
+	uring(NULL),
+	uringSlot(0),
+	readPos(0),
+	available(0),
 	totalReceived(0),
 	totalSent(0),
+	readDeadline(*this, SocketDeadline::Kind::Read),
+	idleDeadline(*this, SocketDeadline::Kind::Idle),
+	writeDeadline(*this, SocketDeadline::Kind::Write),
 	closeOnSent(false),
-	bytesAvailable(readBuffer.length),
-	bytesToSend(writeBuffer.length),
+	zeroCopyThreshold(0),
+	readTimeout(0),
+	idleTimeout(0),
+	writeTimeout(0),
+	bytesAvailable(available),
+	bytesToSend(pending),
 	totalBytesReceived(totalReceived),
 	totalBytesSent(totalSent)
 {
@@ -44,6 +66,9 @@ void Socket::close(bool throws) const
 	if(file < 0)
 		return;
 
+	if(uring)
+		uring->forget(*this);
+
 #if 1 // might cause TIME_WAIT on the other side, which is not always desired
 	DBG("Shutdown socket fd:%", file);
 	if(::shutdown(file, SHUT_RDWR) < 0){
@@ -77,25 +102,57 @@ void Socket::close(bool throws) const
 	file = -1;
 }
 
+/* Free space kept at the end of the read buffer for the next read. */
+static const size_t minReadSpace = 16*1024;
+
+/* Makes room for a read of at least minReadSpace bytes at the end of the buffer.
+ * The released bytes are dropped only when the remainder is small or the
+ * buffer would have to grow anyway, so most reads need no copy at all. */
+void Socket::prepareRead()
+{
+	if(readPos && readPos == readBuffer.length){
+		readBuffer.setLength(0);
+		readPos = 0;
+	}
+
+	if(minReadSpace <= readBuffer.capacity() - readBuffer.length)
+		return;
+
+	if(readPos && (available < readPos ||
+			minReadSpace <= readBuffer.capacity() - available)){
+		readBuffer.chopFront(readPos);
+		readPos = 0;
+		if(minReadSpace <= readBuffer.capacity() - readBuffer.length)
+			return;
+	}
+
+	readBuffer.extendCapacity(readBuffer.length + minReadSpace);
+}
+
 bool Socket::readToBuffer()
 {
 	if(file < 0)
 		throw SocketClosed("Can not read on closed Socket.");
 
-	char buffer[64*1024];
+	if(uring) // URing receives in the background
+		return false;
+
 	ssize_t readIn = 0;
 
 	do{
-		readIn = 0;
 		do {
-			readBuffer.append(buffer, readIn);
+			prepareRead();
+			size_t space = readBuffer.capacity() - readBuffer.length;
+			readIn = ::read(file, &readBuffer[readBuffer.length], space);
 			if(0 < readIn){
+				readBuffer.setLength(readBuffer.length + readIn);
+				readBuffer[readBuffer.length] = 0;
+				available += readIn;
 				totalReceived += readIn;
 				dataReceived();
 				if(file == -1) // closed by child class
 					return true;
 			}
-			readIn = ::read(file, buffer, sizeof(buffer));
 		} while(0 < readIn);
 	} while(readIn < 0 && errno == EINTR);
 
@@ -105,44 +162,132 @@ bool Socket::readToBuffer()
 	return 0 <= readIn; // false if EAGAIN or EWOULDBLOCK happened
 }
 
-String Socket::receive(size_t length)
+/* Data received by URing into its own buffers. */
+void Socket::appendReceived(const char * data, size_t length)
+{
+	prepareRead();
+	if(readBuffer.capacity() - readBuffer.length < length)
+		readBuffer.extendCapacity(readBuffer.length + length);
+	memcpy(&readBuffer[readBuffer.length], data, length);
+	readBuffer.setLength(readBuffer.length + length);
+	readBuffer[readBuffer.length] = 0;
+	available += length;
+	totalReceived += length;
+}
+
+Str Socket::peek(size_t length)
 {
 	if(file < 0)
 		throw SocketClosed("Can not receive on closed Socket.");
 
-	if(readBuffer.length < length){
+	if(available < length){
 		readToBuffer();
-		if(readBuffer.length < length)
+		if(available < length)
 			throw SocketError("Can not yet read % byte long "
 					"string from socket.", length);
 	}
 
-	String ret(readBuffer.read(0, length));
-	readBuffer.chopFront(length);
+	return Str(readBuffer.c_str() + readPos, length);
+}
 
+void Socket::release(size_t length)
+{
+	if(available < length)
+		throw InvalidArgument("Can not release % bytes, only % are "
+				"available.", length, available);
+	readPos += length;
+	available -= length;
+}
+
+String Socket::receive(size_t length)
+{
+	String ret(peek(length));
+	release(length);
 	return ret;
 }
 
+/* Writes at most this many segments at once. */
+static const int maxIovecs = 64;
+
 bool Socket::writeFromBuffer()
 {
 	if(file < 0)
 		throw SocketClosed("Can not write on closed Socket.");
 
+	if(uring){ // sent by URing when the loop submits next time
+		uring->dataIsPending(*this);
+		return false;
+	}
+
+	return writeQueue();
+}
+
+bool Socket::writeQueue()
+{
 	long unsigned written = 0;
-	int justWritten = 0;
-	do {
-		justWritten = 0;
+	ssize_t justWritten = 0;
+	int errNo = 0;
+	while(sendHead < sendQueue.length){
+		SendSegment & segment = sendQueue[sendHead];
+		if(segment.type == SendSegment::Type::File){
+			off_t offset = segment.offset;
+			justWritten = ::sendfile(file, segment.fd, &offset,
+					segment.length);
+			if(justWritten == 0)
+				throw SocketError("File fd:% ended before the % bytes "
+						"to send.", segment.fd, segment.length);
+#ifdef MSG_ZEROCOPY
+		} else if(segment.type == SendSegment::Type::ZeroCopy &&
+				zeroCopyThreshold){
+			struct iovec iov = { (void *)segment.data, segment.length };
+			struct msghdr msg;
+			bzero(&msg, sizeof(msg));
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+			justWritten = ::sendmsg(file, &msg, MSG_ZEROCOPY);
+			if(0 < justWritten)
+				zeroCopySent++;
+#endif
+		} else {
+			struct iovec iov[maxIovecs];
+			int count = 0;
+			for(size_t i = sendHead; i < sendQueue.length &&
+					count < maxIovecs; i++){
+				const SendSegment & s = sendQueue[i];
+				if(s.type == SendSegment::Type::File ||
+						(s.type == SendSegment::Type::ZeroCopy &&
+						 zeroCopyThreshold))
+					break;
+				iov[count].iov_base = (void *)(s.type ==
+						SendSegment::Type::Owned ?
+						writeBuffer.c_str() + s.offset : s.data);
+				iov[count].iov_len = s.length;
+				count++;
+			}
+			justWritten = ::writev(file, iov, count);
+		}
+
+		if(justWritten < 0){
+			errNo = errno;
+			if(errNo == EINTR)
+				continue;
+			break;
+		}
+		written += justWritten;
+		sent(justWritten);
+	}
+
+	/* Once all is written, a last empty write reports the reset by the peer
+	 * (EPIPE or ECONNRESET), as the data itself went to the socket buffer. */
+	if(0 <= justWritten && sendHead == sendQueue.length){
 		do {
-			written += justWritten;
-			justWritten = ::write(file,
-					writeBuffer.c_str() + written,
-					writeBuffer.length - written);
-		} while(0 < justWritten);
-	} while(justWritten < 0 && errno == EINTR);
-	int errNo = errno;
+			justWritten = ::write(file, "", 0);
+		} while(justWritten < 0 && errno == EINTR);
+		if(justWritten < 0)
+			errNo = errno;
+	}
 
 	totalSent += written;
-	writeBuffer.chopFront(written);
 
 	if(justWritten < 0 && (errNo == EPIPE || errNo == ECONNRESET))
 		throw SocketClosedByPeer(errNo, "Error after writting % bytes "
@@ -152,22 +297,191 @@ bool Socket::writeFromBuffer()
 		throw SocketError(errNo, "Error after writting % bytes "
 				"to socket.", written);
 
-	if(closeOnSent && writeBuffer.length == 0)
+	if(closeOnSent && !pending)
 		close();
 
+	/* Data left behind outside of the event handling of EPollControl. */
+	if(justWritten < 0 && writeTimeout && writeDeadline.timers &&
+			!writeDeadline.armed()){
+		writeDeadline.mark = totalSent;
+		writeDeadline.arm(writeTimeout);
+	}
+
 	return 0 <= justWritten; // false if EAGAIN or EWOULDBLOCK happened
 }
 
+/* Drops the sent bytes from the front of the queue. */
+void Socket::sent(size_t length)
+{
+	pending -= length;
+	sendingBytes -= length < sendingBytes ? length : sendingBytes;
+	while(length){
+		SendSegment & segment = sendQueue[sendHead];
+		size_t n = length < segment.length ? length : segment.length;
+		if(segment.data)
+			segment.data += n;
+		else
+			segment.offset += n;
+		segment.length -= n;
+		length -= n;
+		if(!segment.length)
+			sendHead++;
+	}
+
+	if(sendHead == sendQueue.length){
+		sendQueue.clear();
+		sendHead = 0;
+		if(64*1024 < writeBuffer.capacity())
+			writeBuffer.clear();
+		else if(writeBuffer.length)
+			writeBuffer.setLength(0);
+	}
+
+	if(!sendingBytes && sendingBuffer.length){
+		if(64*1024 < sendingBuffer.capacity())
+			sendingBuffer.clear();
+		else
+			sendingBuffer.setLength(0);
+	}
+}
+
+void Socket::queue(const SendSegment & segment)
+{
+	if(!segment.length)
+		return;
+	if(sendHead && sendQueue.length == sendQueue.capacity){
+		sendQueue.erase(0, sendHead);
+		sendHead = 0;
+	}
+	sendQueue.add(segment);
+	pending += segment.length;
+}
+
+String & Socket::writeBufferFor(size_t length)
+{
+	if(file < 0)
+		throw SocketClosed("Can not send on closed Socket.");
+
+	/* Owned segments are appended to the write buffer. Its sent part is
+	 * dropped when the buffer would have to grow anyway. */
+	if(writeBuffer.capacity() < writeBuffer.length + length){
+		size_t sentPart = writeBuffer.length;
+		for(size_t i = sendHead; i < sendQueue.length; i++)
+			if(sendQueue[i].type == SendSegment::Type::Owned){
+				sentPart = sendQueue[i].offset;
+				break;
+			}
+		if(sentPart){
+			writeBuffer.chopFront(sentPart);
+			for(size_t i = sendHead; i < sendQueue.length; i++)
+				if(sendQueue[i].type == SendSegment::Type::Owned)
+					sendQueue[i].offset -= sentPart;
+		}
+		if(writeBuffer.capacity() < writeBuffer.length + length)
+			writeBuffer.extendCapacity(writeBuffer.length + length);
+	}
+
+	composeFrom = writeBuffer.length;
+	return writeBuffer;
+}
+
+void Socket::queueWritten()
+{
+	ENSURE(composeFrom <= writeBuffer.length, InvalidState);
+	size_t length = writeBuffer.length - composeFrom;
+	if(!length)
+		return;
+
+	if(sendHead < sendQueue.length &&
+			sendQueue.last().type == SendSegment::Type::Owned &&
+			sendQueue.last().offset + sendQueue.last().length ==
+				composeFrom){
+		sendQueue.last().length += length;
+		pending += length;
+	} else {
+		SendSegment segment = { SendSegment::Type::Owned, 0,
+			composeFrom, length, -1 };
+		queue(segment);
+	}
+	composeFrom = writeBuffer.length;
+}
+
 bool Socket::send(const Str & data)
+{
+	writeBufferFor(data.length).append(data);
+	queueWritten();
+
+	return writeFromBuffer();
+}
+
+bool Socket::sendBorrowed(const Str & data)
+{
+	if(file < 0)
+		throw SocketClosed("Can not send on closed Socket.");
+
+	SendSegment segment = { SendSegment::Type::Borrowed, data.c_str(), 0,
+		data.length, -1 };
+	if(zeroCopyThreshold && zeroCopyThreshold <= data.length)
+		segment.type = SendSegment::Type::ZeroCopy;
+	queue(segment);
+
+	return writeFromBuffer();
+}
+
+bool Socket::sendFile(int fd, off_t offset, size_t length)
 {
 	if(file < 0)
 		throw SocketClosed("Can not send on closed Socket.");
 
-	writeBuffer.append(data);
+	SendSegment segment = { SendSegment::Type::File, 0, (size_t)offset,
+		length, fd };
+	queue(segment);
 
 	return writeFromBuffer();
 }
 
+bool Socket::enableZeroCopy(size_t threshold)
+{
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+	int one = 1;
+	if(setsockopt(file, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0)
+		return false;
+	zeroCopyThreshold = threshold;
+	return true;
+#else
+	(void)threshold;
+	return false;
+#endif
+}
+
+bool Socket::readZeroCopyCompletions()
+{
+	bool any = false;
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+	while(true){
+		char control[128];
+		struct msghdr msg;
+		bzero(&msg, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if(::recvmsg(file, &msg, MSG_ERRQUEUE) < 0)
+			break;
+		for(struct cmsghdr * cm = CMSG_FIRSTHDR(&msg); cm;
+				cm = CMSG_NXTHDR(&msg, cm)){
+			struct sock_extended_err * err =
+				(struct sock_extended_err *)CMSG_DATA(cm);
+			if(err->ee_errno != 0 ||
+					err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+			/* The sends from ee_info to ee_data are completed. */
+			zeroCopyCompleted += err->ee_data - err->ee_info + 1;
+			any = true;
+		}
+	}
+#endif
+	return any;
+}
+
 void Socket::checkForError()
 {
 	int errNo = 0;
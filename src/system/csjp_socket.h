@@ -7,8 +7,11 @@
 #define CSJP_SOCKET_H
 
 #include <netinet/in.h>
+#include <sys/types.h>
 #include <string>
 #include <csjp_string.h>
+#include <csjp_pod_array.h>
+#include <csjp_timer.h>
 
 /**
  * Usefull info:
@@ -26,9 +29,45 @@
 
 namespace csjp {
 
+/* Part of the outgoing data of a Socket. */
+struct SendSegment
+{
+	enum class Type { Owned, Borrowed, ZeroCopy, File };
+	Type type;
+	const char * data; // Borrowed, ZeroCopy
+	size_t offset; // Owned: position in the write buffer, File: in the file
+	size_t length; // not yet sent
+	int fd; // File
+};
+
 class EPoll;
 class EPollControl;
+struct EPollTimers;
+class URing;
 class DupSocket;
+class Socket;
+
+/* Read, idle or write deadline of a Socket, armed by EPollControl. */
+class SocketDeadline : public Timer
+{
+public:
+	enum class Kind { Read, Idle, Write };
+
+	SocketDeadline(Socket & socket, Kind kind) :
+		socket(socket), kind(kind), timers(NULL), mark(0) {}
+	virtual ~SocketDeadline() {}
+
+	void arm(unsigned msec);
+
+	Socket & socket;
+	const Kind kind;
+	EPollTimers * timers; // of the EPollControl the socket is added to
+	size_t mark; // sent bytes when the write deadline was armed
+
+protected:
+	virtual void expired();
+};
+
 class Socket
 {
 public:
@@ -37,29 +76,78 @@ public:
 
 	Socket(Socket && temp) :
 		file(temp.file),
+		listening(temp.listening),
+		sendQueue(move_cast(temp.sendQueue)),
+		sendHead(temp.sendHead),
+		pending(temp.pending),
+		zeroCopySent(temp.zeroCopySent),
+		zeroCopyCompleted(temp.zeroCopyCompleted),
+		writeBuffer(move_cast(temp.writeBuffer)),
+		composeFrom(temp.composeFrom),
+		sendingBuffer(move_cast(temp.sendingBuffer)),
+		sendingBytes(temp.sendingBytes),
+		uring(NULL),
+		uringSlot(0),
+		readBuffer(move_cast(temp.readBuffer)),
+		readPos(temp.readPos),
+		available(temp.available),
 		totalReceived(temp.totalReceived),
 		totalSent(temp.totalSent),
+		readDeadline(*this, SocketDeadline::Kind::Read),
+		idleDeadline(*this, SocketDeadline::Kind::Idle),
+		writeDeadline(*this, SocketDeadline::Kind::Write),
 		closeOnSent(temp.closeOnSent),
-		bytesAvailable(readBuffer.length),
-		bytesToSend(writeBuffer.length),
+		zeroCopyThreshold(temp.zeroCopyThreshold),
+		readTimeout(temp.readTimeout),
+		idleTimeout(temp.idleTimeout),
+		writeTimeout(temp.writeTimeout),
+		bytesAvailable(available),
+		bytesToSend(pending),
 		totalBytesReceived(totalReceived),
 		totalBytesSent(totalSent)
 	{
 		temp.file = -1;
 		bzero((char *) &address, sizeof(address));
-		totalReceived = 0;
-		totalSent = 0;
+		temp.sendHead = 0;
+		temp.pending = 0;
+		temp.sendingBytes = 0;
+		temp.readPos = 0;
+		temp.available = 0;
+		temp.totalReceived = 0;
+		temp.totalSent = 0;
 	}
 	const Socket & operator=(Socket && temp)
 	{
 		file = temp.file;
 		address = temp.address; // FIXME is this right?
+		listening = temp.listening;
+		sendQueue = move_cast(temp.sendQueue);
+		sendHead = temp.sendHead;
+		pending = temp.pending;
+		zeroCopySent = temp.zeroCopySent;
+		zeroCopyCompleted = temp.zeroCopyCompleted;
+		writeBuffer = move_cast(temp.writeBuffer);
+		composeFrom = temp.composeFrom;
+		sendingBuffer = move_cast(temp.sendingBuffer);
+		sendingBytes = temp.sendingBytes;
+		readBuffer = move_cast(temp.readBuffer);
+		readPos = temp.readPos;
+		available = temp.available;
 		totalReceived = temp.totalReceived;
 		totalSent = temp.totalSent;
 		closeOnSent = temp.closeOnSent;
+		zeroCopyThreshold = temp.zeroCopyThreshold;
+		readTimeout = temp.readTimeout;
+		idleTimeout = temp.idleTimeout;
+		writeTimeout = temp.writeTimeout;
 
 		temp.file = -1;
 		bzero((char *) &address, sizeof(address));
+		temp.sendHead = 0;
+		temp.pending = 0;
+		temp.sendingBytes = 0;
+		temp.readPos = 0;
+		temp.available = 0;
 		temp.totalReceived = 0;
 		temp.totalSent = 0;
 		temp.closeOnSent = false;
@@ -67,15 +155,42 @@ public:
 		return *this;
 	}
 
-	String receive(size_t length);
-	bool send(const Str & data); // returns false on EAGAIN or EWOULDBLOCK
-				     // EPoll takes care of this in the background
+	/* The received data can be processed in place: received() and peek() give
+	 * views of the read buffer, release() drops the processed bytes. The views
+	 * are valid until the next read into the buffer (see dataReceived()). */
+	Str received() const
+		{ return Str(readBuffer.c_str() + readPos, available); }
+	Str peek(size_t length);
+	void release(size_t length);
+	String receive(size_t length); // copy of peek(length) and release(length)
+	/* The send functions queue the data and write as much of the queue as
+	 * possible. They return false on EAGAIN or EWOULDBLOCK, then EPoll takes
+	 * care of the rest in the background. */
+	bool send(const Str & data); // copies the data
+	/* The data is not copied, it has to stay valid until sent (bytesToSend).
+	 * At least zeroCopyThreshold long data is sent with MSG_ZEROCOPY if
+	 * enabled, then it has to stay valid until zeroCopyPending() is 0. */
+	bool sendBorrowed(const Str & data);
+	bool sendFile(int fd, off_t offset, size_t length); // the fd is not closed
+	/* For serializing straight into the write buffer: the data appended to
+	 * the returned buffer (at least length bytes are room for) is queued by
+	 * queueWritten() and written by the next send or writeFromBuffer().
+	 * Nothing else may send in between. */
+	String & writeBufferFor(size_t length);
+	void queueWritten();
+
+	/* Returns false if the socket does not support MSG_ZEROCOPY. */
+	bool enableZeroCopy(size_t threshold = 64*1024);
+	/* Collects the completion notifications of the zero copy sends.
+	 * Returns true if there was any. EPoll reports them as Error. */
+	bool readZeroCopyCompletions();
+	unsigned zeroCopyPending() const { return zeroCopySent - zeroCopyCompleted; }
 
 	template <typename TypeReceive>
 	bool receive(TypeReceive & parser)
 	{
-		unsigned processedBytes = parser.parse(readBuffer);
-		readBuffer.chopFront(processedBytes);
+		unsigned processedBytes = parser.parse(received());
+		release(processedBytes);
 		return 0 < processedBytes;
 	}
 
@@ -88,26 +203,60 @@ protected:
 
 private:
 public:
+	void prepareRead();
+	void queue(const SendSegment & segment);
+	void sent(size_t length);
 	bool readToBuffer(); // returns false on EAGAIN or EWOULDBLOCK
 	bool writeFromBuffer(); // returns false on EAGAIN or EWOULDBLOCK
+	bool writeQueue();
+	void appendReceived(const char * data, size_t length);
 
 	virtual void dataReceived() {} // place for child's business logic
 	virtual void readyToSend() {} // place for child's business logic
 public:
 	int fd() const { return file; }
+	/* Gives up the fd without closing it. */
+	int detach() { int fd = file; file = -1; return fd; }
+	/* Known since the socket is added to an EPoll. */
+	bool isListening() const { return listening; }
 
 protected:
 	mutable int file;
 	struct sockaddr_in address;
 
 private:
-	String writeBuffer;
+	bool listening;
+	PodArray<SendSegment> sendQueue;
+	size_t sendHead; // segments before are sent
+	size_t pending;
+	unsigned zeroCopySent;
+	unsigned zeroCopyCompleted;
+	String writeBuffer; // data of the Owned segments
+	size_t composeFrom; // see writeBufferFor()
+	/* Owned data handed over to URing sends, see URing::flush(). */
+	String sendingBuffer;
+	size_t sendingBytes; // queued bytes up to the last one in sendingBuffer
+	mutable URing * uring; // not NULL while added to a URing
+	unsigned uringSlot;
 	String readBuffer;
+	size_t readPos; // bytes of readBuffer already released
+	size_t available;
 	size_t totalReceived;
 	size_t totalSent;
+	SocketDeadline readDeadline;
+	SocketDeadline idleDeadline;
+	SocketDeadline writeDeadline;
 
 public:
-	bool closeOnSent; // close connection when writeBuffer empty
+	bool closeOnSent; // close connection when all the data is sent
+	size_t zeroCopyThreshold; // 0 if zero copy is disabled
+	/* Milliseconds, 0 for none. EPollControl reports TimedOut when
+	 * - read: received data stays unprocessed (not released) for longer,
+	 * - idle: there is no event on the socket for longer,
+	 * - write: the data to send makes no progress for longer. */
+	unsigned readTimeout;
+	unsigned idleTimeout;
+	unsigned writeTimeout;
 
 	const size_t & bytesAvailable;
 	const size_t & bytesToSend;
@@ -116,6 +265,7 @@ public:
 
 	friend EPoll;
 	friend EPollControl;
+	friend URing;
 	friend DupSocket;
 };
 
@@ -0,0 +1,242 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#include <time.h>
+#include <limits.h>
+#include <string.h>
+
+#undef DEBUG
+
+#include <csjp_string.h>
+
+#include "csjp_timer.h"
+
+namespace csjp {
+
+void Timer::cancel()
+{
+	if(wheel)
+		wheel->cancel(*this);
+}
+
+/* Bits of the slots after the given one. */
+static inline uint64_t slotsAfter(uint64_t occupied, unsigned slot)
+{
+	if(slot == TimerWheel::slots - 1)
+		return 0;
+	return occupied & (~(uint64_t)0 << (slot + 1));
+}
+
+TimerWheel::TimerWheel(unsigned tickMsec) TimerWheelInitializer
+{
+	ENSURE(tickMsec, InvalidArgument);
+	current = clock() / tickMsec;
+	memset(occupied, 0, sizeof(occupied));
+	memset(wheel, 0, sizeof(wheel));
+}
+
+TimerWheel::TimerWheel(uint64_t now, unsigned tickMsec) TimerWheelInitializer
+{
+	ENSURE(tickMsec, InvalidArgument);
+	current = now / tickMsec;
+	memset(occupied, 0, sizeof(occupied));
+	memset(wheel, 0, sizeof(wheel));
+}
+
+TimerWheel::~TimerWheel()
+{
+	for(unsigned level = 0; level < levels; level++)
+		for(unsigned slot = 0; slot < slots; slot++)
+			for(Timer * timer = wheel[level][slot]; timer; ){
+				Timer * next = timer->next;
+				timer->wheel = NULL;
+				timer->next = NULL;
+				timer->pprev = NULL;
+				timer = next;
+			}
+}
+
+uint64_t TimerWheel::clock()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void TimerWheel::arm(Timer & timer, unsigned msec, uint64_t now)
+{
+	if(timer.armed())
+		timer.cancel();
+
+	uint64_t expires = (now + msec + tickMsec - 1) / tickMsec;
+	timer.expires = expires <= current ? current + 1 : expires;
+	timer.wheel = this;
+	insert(timer);
+	count++;
+}
+
+void TimerWheel::cancel(Timer & timer)
+{
+	if(!timer.pprev)
+		return;
+	ENSURE(timer.wheel == this, InvalidArgument);
+
+	*timer.pprev = timer.next;
+	if(timer.next)
+		timer.next->pprev = timer.pprev;
+	/* Emptied slot, unless the timer is in a list being expired. */
+	Timer ** first = &wheel[0][0];
+	if(!*timer.pprev && first <= timer.pprev &&
+			timer.pprev < first + levels * slots){
+		size_t index = timer.pprev - first;
+		occupied[index / slots] &= ~((uint64_t)1 << (index % slots));
+	}
+
+	timer.next = NULL;
+	timer.pprev = NULL;
+	count--;
+}
+
+/* The level is given by the highest slotBits wide group of the expiry differing
+ * from the current tick, so the slot of the timer is distributed to the lower
+ * levels exactly when the current tick gets into its group. */
+void TimerWheel::insert(Timer & timer)
+{
+	uint64_t expires = timer.expires < current ? current : timer.expires;
+	unsigned level = 0;
+	while(level < levels - 1 && (expires >> (slotBits * (level + 1))) !=
+			(current >> (slotBits * (level + 1))))
+		level++;
+
+	unsigned slot;
+	if((expires >> (slotBits * levels)) != (current >> (slotBits * levels)))
+		/* Too far, the first top slot is distributed when the top level
+		 * turns over. No timer of the current turn can be there. */
+		slot = 0;
+	else
+		slot = (expires >> (slotBits * level)) & (slots - 1);
+
+	Timer *& head = wheel[level][slot];
+	timer.next = head;
+	if(head)
+		head->pprev = &timer.next;
+	head = &timer;
+	timer.pprev = &head;
+	occupied[level] |= (uint64_t)1 << slot;
+}
+
+/* The current tick just got into a new group of the level below. */
+void TimerWheel::cascade(unsigned level)
+{
+	if(levels <= level)
+		return;
+	unsigned slot = (current >> (slotBits * level)) & (slots - 1);
+	if(!slot)
+		cascade(level + 1);
+
+	Timer * list = wheel[level][slot];
+	wheel[level][slot] = NULL;
+	occupied[level] &= ~((uint64_t)1 << slot);
+	while(list){
+		Timer & timer = *list;
+		list = timer.next;
+		insert(timer);
+	}
+}
+
+/* Expires the timers of the level 0 slot. The list is taken out of the wheel
+ * first, so expired() can arm and cancel any timer. A periodic timer skips the
+ * periods missed until the target tick of the advance. */
+unsigned TimerWheel::expire(unsigned slot, uint64_t target)
+{
+	Timer * list = wheel[0][slot];
+	if(!list)
+		return 0;
+	wheel[0][slot] = NULL;
+	occupied[0] &= ~((uint64_t)1 << slot);
+	list->pprev = &list;
+
+	unsigned expired = 0;
+	while(list){
+		Timer & timer = *list;
+		list = timer.next;
+		if(list)
+			list->pprev = &list;
+		timer.next = NULL;
+		timer.pprev = NULL;
+		count--;
+
+		if(timer.period){
+			uint64_t period = (timer.period + tickMsec - 1) / tickMsec;
+			timer.expires += period;
+			if(timer.expires <= target)
+				timer.expires += ((target - timer.expires) / period + 1) *
+					period;
+			insert(timer);
+			count++;
+		}
+		expired++;
+		timer.expired();
+	}
+	return expired;
+}
+
+unsigned TimerWheel::advance(uint64_t now)
+{
+	uint64_t target = now / tickMsec;
+	unsigned expired = 0;
+	while(current < target){
+		uint64_t next = slotsAfter(occupied[0], current & (slots - 1));
+		if(next){
+			next = (current & ~(uint64_t)(slots - 1)) |
+				__builtin_ctzll(next);
+			if(target < next)
+				break;
+			current = next;
+			expired += expire(current & (slots - 1), target);
+			continue;
+		}
+
+		/* Nothing until the next group of the level 0. */
+		next = (current | (slots - 1)) + 1;
+		if(target < next)
+			break;
+		current = next;
+		cascade(1);
+		expired += expire(0, target);
+	}
+	if(current < target)
+		current = target;
+	return expired;
+}
+
+int TimerWheel::timeout(uint64_t now) const
+{
+	if(!count)
+		return -1;
+
+	uint64_t tick = 0;
+	for(unsigned level = 0; level < levels && !tick; level++){
+		unsigned shift = slotBits * level;
+		uint64_t next = slotsAfter(occupied[level],
+				(current >> shift) & (slots - 1));
+		if(!next)
+			continue;
+		uint64_t group = current >> (shift + slotBits) << (shift + slotBits);
+		tick = group | ((uint64_t)__builtin_ctzll(next) << shift);
+	}
+	if(!tick) // only timers too far, wait until the top level turns
+		tick = ((current >> (slotBits * levels)) + 1) <<
+			(slotBits * levels);
+
+	uint64_t at = tick * tickMsec;
+	if(at <= now)
+		return 0;
+	if(INT_MAX < at - now)
+		return INT_MAX;
+	return at - now;
+}
+
+}
@@ -0,0 +1,118 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#ifndef CSJP_TIMER_H
+#define CSJP_TIMER_H
+
+#include <stdint.h>
+
+#include <csjp_defines.h>
+
+namespace csjp {
+
+class TimerWheel;
+
+/**
+ * Timer to be armed on a TimerWheel. The child class gets expired() called
+ * when the time is up. A periodic timer is armed again with its period
+ * before expired() is called. Destroying the timer cancels it.
+ */
+class Timer
+{
+#define TimerInitializer : \
+		period(0), \
+		wheel(NULL), \
+		next(NULL), \
+		pprev(NULL), \
+		expires(0)
+public:
+	explicit Timer(const Timer & orig) = delete;
+	const Timer & operator=(const Timer &) = delete;
+
+	Timer(Timer && temp) = delete;
+	const Timer & operator=(Timer && temp) = delete;
+
+	explicit Timer() TimerInitializer {}
+	virtual ~Timer() { cancel(); }
+
+	bool armed() const { return pprev; }
+	void cancel();
+
+	unsigned period; // milliseconds, 0 for a one shot timer
+
+protected:
+	virtual void expired() = 0;
+
+private:
+	TimerWheel * wheel;
+	Timer * next;
+	Timer ** pprev;
+	uint64_t expires; // tick
+
+	friend TimerWheel;
+};
+
+/**
+ * Hierarchical timer wheel of four levels of 64 slots each. Arming and
+ * cancelling is O(1), a slot of an upper level is distributed to the lower
+ * levels only when the time gets there. A timer further than 2^24 ticks is
+ * kept at the top level until it gets close enough.
+ *
+ * Times are milliseconds of CLOCK_MONOTONIC unless given explicitly.
+ *
+ * Do not inherit from this class!
+ */
+class TimerWheel
+{
+public:
+	static const unsigned levels = 4;
+	static const unsigned slotBits = 6;
+	static const unsigned slots = 1 << slotBits;
+
+#define TimerWheelInitializer : \
+		tickMsec(tickMsec), \
+		current(0), \
+		count(0)
+public:
+	explicit TimerWheel(const TimerWheel & orig) = delete;
+	const TimerWheel & operator=(const TimerWheel &) = delete;
+
+	TimerWheel(TimerWheel && temp) = delete;
+	const TimerWheel & operator=(TimerWheel && temp) = delete;
+
+	explicit TimerWheel(unsigned tickMsec = 1);
+	explicit TimerWheel(uint64_t now, unsigned tickMsec);
+	~TimerWheel();
+
+	static uint64_t clock(); // CLOCK_MONOTONIC in milliseconds
+
+	/* The timer expires msec after now, an armed timer is rearmed. */
+	void arm(Timer & timer, unsigned msec, uint64_t now);
+	void arm(Timer & timer, unsigned msec) { arm(timer, msec, clock()); }
+	void cancel(Timer & timer);
+	/* Expires the timers due until now. Returns the number expired. */
+	unsigned advance(uint64_t now);
+	unsigned advance() { return advance(clock()); }
+	/* Milliseconds from now until the nearest expiry or until the wheel
+	 * has to distribute an upper slot. -1 if there is no timer. */
+	int timeout(uint64_t now) const;
+	int timeout() const { return timeout(clock()); }
+	unsigned size() const { return count; }
+
+private:
+	void insert(Timer & timer);
+	void cascade(unsigned level);
+	unsigned expire(unsigned slot, uint64_t target);
+
+	unsigned tickMsec;
+	uint64_t current; // tick of the last advance()
+	unsigned count;
+	uint64_t occupied[levels]; // bit per non empty slot
+	Timer * wheel[levels][slots];
+};
+
+}
+
+#endif
@@ -0,0 +1,601 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/utsname.h>
+
+#include <unistd.h>
+#include <poll.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#undef DEBUG
+
+#include "csjp_uring.h"
+
+namespace csjp {
+
+static inline uint64_t userData(unsigned slot, unsigned op)
+{
+	return (uint64_t)op << 32 | slot;
+}
+
+URing::URing(unsigned entries, unsigned buffers, unsigned bufferSize) :
+	Socket(),
+	sqes((struct io_uring_sqe *)MAP_FAILED),
+	sqLocalTail(0),
+	toSubmit(0),
+	ringPtr(MAP_FAILED),
+	ringSize(0),
+	sqesSize(0),
+	bufRing((struct io_uring_buf *)MAP_FAILED),
+	bufRingTail(NULL),
+	bufRingSize(0),
+	bufferMemory(NULL),
+	bufferCount(buffers),
+	bufferSize(bufferSize)
+{
+	ENSURE(buffers && buffers <= 32768 && !(buffers & (buffers - 1)),
+			InvalidArgument);
+
+	struct io_uring_params params;
+	bzero(&params, sizeof(params));
+	file = syscall(__NR_io_uring_setup, entries, &params);
+	if(file < 0)
+		throw SocketError(errno, "io_uring_setup() failed.");
+
+	unsigned needed = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+		IORING_FEAT_EXT_ARG;
+	if((params.features & needed) != needed)
+		throw SocketError("The io_uring of the kernel lacks features, "
+				"has only 0x%.", params.features);
+
+	ringSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	size_t cqSize = params.cq_off.cqes +
+		params.cq_entries * sizeof(struct io_uring_cqe);
+	if(ringSize < cqSize)
+		ringSize = cqSize;
+	ringPtr = mmap(NULL, ringSize, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, file, IORING_OFF_SQ_RING);
+	if(ringPtr == MAP_FAILED)
+		throw SocketError(errno, "Failed to map the io_uring rings.");
+
+	sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	sqes = (struct io_uring_sqe *)mmap(NULL, sqesSize,
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			file, IORING_OFF_SQES);
+	if(sqes == MAP_FAILED){
+		int errNo = errno;
+		munmap(ringPtr, ringSize);
+		throw SocketError(errNo, "Failed to map the io_uring "
+				"submission entries.");
+	}
+
+	char * ring = (char *)ringPtr;
+	sqHead = (unsigned *)(ring + params.sq_off.head);
+	sqTail = (unsigned *)(ring + params.sq_off.tail);
+	sqMask = *(unsigned *)(ring + params.sq_off.ring_mask);
+	sqArray = (unsigned *)(ring + params.sq_off.array);
+	cqHead = (unsigned *)(ring + params.cq_off.head);
+	cqTail = (unsigned *)(ring + params.cq_off.tail);
+	cqMask = *(unsigned *)(ring + params.cq_off.ring_mask);
+	cqes = (struct io_uring_cqe *)(ring + params.cq_off.cqes);
+
+	/* The entries are used in ring order. */
+	for(unsigned i = 0; i <= sqMask; i++)
+		sqArray[i] = i;
+	sqLocalTail = *sqTail;
+
+	bufRingSize = bufferCount * sizeof(struct io_uring_buf);
+	bufRing = (struct io_uring_buf *)mmap(NULL, bufRingSize,
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	bufferMemory = (char *)malloc((size_t)bufferCount * bufferSize);
+	struct io_uring_buf_reg reg;
+	bzero(&reg, sizeof(reg));
+	reg.ring_addr = (uint64_t)bufRing;
+	reg.ring_entries = bufferCount;
+	reg.bgid = 0;
+	if(bufRing == MAP_FAILED || !bufferMemory || syscall(
+				__NR_io_uring_register, file,
+				IORING_REGISTER_PBUF_RING, &reg, 1) < 0){
+		int errNo = errno;
+		if(bufRing != MAP_FAILED)
+			munmap(bufRing, bufRingSize);
+		free(bufferMemory);
+		munmap(sqes, sqesSize);
+		munmap(ringPtr, ringSize);
+		throw SocketError(errNo, "Failed to register the provided "
+				"buffer ring.");
+	}
+
+	/* The tail overlays the resv field of the first entry. */
+	bufRingTail = &bufRing[0].resv;
+	*bufRingTail = 0;
+	for(unsigned i = 0; i < bufferCount; i++)
+		recycle(i);
+}
+
+URing::~URing()
+{
+	for(auto & slot : slots)
+		if(slot.socket)
+			slot.socket->uring = NULL;
+	/* The operations are cancelled by closing the ring before the buffers
+	 * are freed. */
+	close(false);
+	munmap(bufRing, bufRingSize);
+	free(bufferMemory);
+	munmap(sqes, sqesSize);
+	munmap(ringPtr, ringSize);
+}
+
+bool URing::supported()
+{
+	/* Multishot receive is there since 6.0 */
+	struct utsname name;
+	unsigned major = 0, minor = 0;
+	if(uname(&name) < 0 ||
+			sscanf(name.release, "%u.%u", &major, &minor) != 2 ||
+			major < 6)
+		return false;
+
+	try {
+		URing ring(4, 1, 4096);
+	} catch(Exception &) {
+		return false;
+	}
+	return true;
+}
+
+void URing::add(Socket & socket)
+{
+	if(socket.file < 0)
+		throw InvalidState("Socket is closed.");
+	ENSURE(!socket.uring, InvalidState);
+
+	unsigned slot;
+	if(freeSlots.length){
+		slot = freeSlots.pop();
+	} else {
+		slot = slots.length;
+		slots.add(Slot());
+	}
+	Slot & s = slots[slot];
+	s.socket = &socket;
+	s.ops = 0;
+	s.sends = 0;
+	s.flushing = false;
+	s.sendFailed = false;
+	socket.uring = this;
+	socket.uringSlot = slot;
+
+	socket.listening = dynamic_cast<Listener *>(&socket);
+	if(socket.listening)
+		submitAccept(slot);
+	else
+		submitReceive(slot);
+	if(socket.pending)
+		dataIsPending(socket);
+}
+
+void URing::remove(Socket & socket)
+{
+	ENSURE(socket.uring == this, InvalidArgument);
+	forget(socket);
+}
+
+void URing::forget(const Socket & socket)
+{
+	unsigned slot = socket.uringSlot;
+	socket.uring = NULL;
+	slots[slot].socket = NULL;
+	if(!slots[slot].ops){
+		release(slot);
+		return;
+	}
+
+	/* Cancelled now, before the fd is closed. */
+	struct io_uring_sqe * sqe = getSqe();
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = socket.file;
+	sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+	sqe->user_data = userData(slot, (unsigned)Op::Cancel);
+	enter(toSubmit, 0, 0);
+}
+
+void URing::dataIsPending(Socket & socket)
+{
+	Slot & s = slots[socket.uringSlot];
+	if(s.flushing)
+		return;
+	s.flushing = true;
+	flushList.add(socket.uringSlot);
+}
+
+void URing::release(unsigned slot)
+{
+	Slot & s = slots[slot];
+	s.socket = NULL;
+	s.ops = 0;
+	s.sends = 0;
+	s.flushing = false;
+	s.sendFailed = false;
+	freeSlots.add(slot);
+}
+
+void URing::recycle(unsigned bufferId)
+{
+	unsigned short tail = *bufRingTail;
+	struct io_uring_buf & buf = bufRing[tail & (bufferCount - 1)];
+	buf.addr = (uint64_t)(bufferMemory + (size_t)bufferId * bufferSize);
+	buf.len = bufferSize;
+	buf.bid = bufferId;
+	__atomic_store_n(bufRingTail, (unsigned short)(tail + 1),
+			__ATOMIC_RELEASE);
+}
+
+struct io_uring_sqe * URing::getSqe()
+{
+	if(sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) > sqMask)
+		enter(toSubmit, 0, 0);
+	if(sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) > sqMask)
+		throw SocketError("The io_uring submission queue is full.");
+
+	struct io_uring_sqe * sqe = &sqes[sqLocalTail & sqMask];
+	bzero(sqe, sizeof(*sqe));
+	sqLocalTail++;
+	toSubmit++;
+	return sqe;
+}
+
+/* Submits the prepared entries and waits for at least minComplete
+ * completions at most timeout milliseconds (-1 for no limit). */
+unsigned URing::enter(unsigned count, unsigned minComplete, int timeout)
+{
+	__atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+	if(!count && !minComplete)
+		return 0;
+
+	unsigned flags = 0;
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	void * argPtr = NULL;
+	size_t argSize = 0;
+	if(minComplete){
+		flags |= IORING_ENTER_GETEVENTS;
+		if(0 <= timeout){
+			ts.tv_sec = timeout / 1000;
+			ts.tv_nsec = (timeout % 1000) * 1000000;
+			bzero(&arg, sizeof(arg));
+			arg.ts = (uint64_t)&ts;
+			flags |= IORING_ENTER_EXT_ARG;
+			argPtr = &arg;
+			argSize = sizeof(arg);
+		}
+	}
+
+	int ret = syscall(__NR_io_uring_enter, file, count, minComplete, flags,
+			argPtr, argSize);
+	toSubmit = sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+	if(ret < 0){
+		if(errno == ETIME || errno == EINTR || errno == EAGAIN ||
+				errno == EBUSY)
+			return 0;
+		throw SocketError(errno, "io_uring_enter() failed.");
+	}
+	return ret;
+}
+
+void URing::submitAccept(unsigned slot)
+{
+	struct io_uring_sqe * sqe = getSqe();
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = slots[slot].socket->file;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	sqe->user_data = userData(slot, (unsigned)Op::Accept);
+	slots[slot].ops++;
+}
+
+void URing::submitReceive(unsigned slot)
+{
+	struct io_uring_sqe * sqe = getSqe();
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = slots[slot].socket->file;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = 0;
+	sqe->user_data = userData(slot, (unsigned)Op::Receive);
+	slots[slot].ops++;
+}
+
+void URing::flush()
+{
+	for(size_t i = 0; i < flushList.length; i++)
+		flush(flushList[i]);
+	flushList.clear();
+}
+
+/* Submits the queued data of the socket as a chain of sends. The Owned data
+ * is moved aside into the sendingBuffer, so that the socket can go on queueing
+ * into its writeBuffer while the sends are in flight. */
+void URing::flush(unsigned slot)
+{
+	Slot & s = slots[slot];
+	s.flushing = false;
+	if(!s.socket || s.sends || s.sendFailed)
+		return;
+	Socket & socket = *s.socket;
+	if(socket.file < 0 || socket.sendHead == socket.sendQueue.length)
+		return;
+
+	if(socket.sendQueue[socket.sendHead].type == SendSegment::Type::File){
+		struct io_uring_sqe * sqe = getSqe();
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = socket.file;
+		sqe->poll32_events = POLLOUT;
+		sqe->user_data = userData(slot, (unsigned)Op::Poll);
+		s.ops++;
+		s.sends++;
+		return;
+	}
+
+	if(!socket.sendingBytes && socket.writeBuffer.length){
+		String spare(move_cast(socket.sendingBuffer));
+		socket.sendingBuffer = move_cast(socket.writeBuffer);
+		socket.writeBuffer = move_cast(spare);
+		size_t bytes = 0;
+		for(size_t i = socket.sendHead; i < socket.sendQueue.length; i++){
+			SendSegment & segment = socket.sendQueue[i];
+			bytes += segment.length;
+			if(segment.type != SendSegment::Type::Owned)
+				continue;
+			segment.type = SendSegment::Type::Borrowed;
+			segment.data = socket.sendingBuffer.c_str() + segment.offset;
+			socket.sendingBytes = bytes;
+		}
+	}
+
+	unsigned count = 0;
+	size_t i = socket.sendHead;
+	for(; i < socket.sendQueue.length && count <= sqMask / 2; i++, count++)
+		if(socket.sendQueue[i].type == SendSegment::Type::File ||
+				socket.sendQueue[i].type == SendSegment::Type::Owned)
+			break;
+	if(!count)
+		return;
+
+	/* The whole chain goes in the same submission. */
+	if(sqMask + 1 - (sqLocalTail - __atomic_load_n(sqHead,
+					__ATOMIC_ACQUIRE)) < count)
+		enter(toSubmit, 0, 0);
+
+	for(i = socket.sendHead; i < socket.sendHead + count; i++){
+		const SendSegment & segment = socket.sendQueue[i];
+		struct io_uring_sqe * sqe = getSqe();
+		sqe->opcode = IORING_OP_SEND;
+		sqe->fd = socket.file;
+		sqe->addr = (uint64_t)segment.data;
+		sqe->len = segment.length;
+		sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+		if(i + 1 < socket.sendHead + count)
+			sqe->flags = IOSQE_IO_LINK;
+		sqe->user_data = userData(slot, (unsigned)Op::Send);
+	}
+	s.ops += count;
+	s.sends += count;
+}
+
+Array<EPollControl::ControlEvent> URing::waitAndControl(int timeout)
+{
+	Array<ControlEvent> list;
+
+	flush();
+	unsigned head = *cqHead;
+	bool ready = head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+	enter(toSubmit, ready || !timeout ? 0 : 1, timeout);
+
+	unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+	while(head != tail){
+		struct io_uring_cqe & cqe = cqes[head & cqMask];
+		unsigned slot = cqe.user_data & 0xffffffff;
+		Op op = (Op)(cqe.user_data >> 32);
+		int res = cqe.res;
+		unsigned flags = cqe.flags;
+		head++;
+		__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+		if(op == Op::Cancel)
+			continue;
+
+		if(!(flags & IORING_CQE_F_MORE))
+			slots[slot].ops--;
+		Socket * socket = slots[slot].socket;
+		if(!socket){
+			if(flags & IORING_CQE_F_BUFFER)
+				recycle(flags >> IORING_CQE_BUFFER_SHIFT);
+			if(!slots[slot].ops)
+				release(slot);
+			continue;
+		}
+
+		try {
+			completed(slot, op, res, flags, list);
+		} catch(Exception & e){
+			list.add(ControlEvent(*socket, ControlEventCode::Exception,
+					move_cast(e)));
+			DBG("URing control fd: %, event: %",
+					list.last().socket.file, list.last().name());
+		} catch(std::exception & e){
+			list.add(ControlEvent(*socket, ControlEventCode::Exception,
+					Exception(e)));
+			DBG("URing control fd: %, event: %",
+					list.last().socket.file, list.last().name());
+		}
+	}
+
+	return list;
+}
+
+void URing::completed(unsigned slot, Op op, int res, unsigned flags,
+		Array<ControlEvent> & list)
+{
+	switch(op)
+	{
+	case Op::Accept :
+		accepted(slot, res, flags);
+		break;
+	case Op::Receive :
+		received(slot, res, flags, list);
+		break;
+	case Op::Send :
+		sendCompleted(slot, res, list);
+		break;
+	case Op::Poll :
+		pollCompleted(slot, res, list);
+		break;
+	default:
+		throw LogicError("Unknown URing operation.");
+	}
+}
+
+void URing::accepted(unsigned slot, int res, unsigned flags)
+{
+	Listener & listener = *(Listener *)slots[slot].socket;
+	if(res == -ECANCELED)
+		return;
+	if(!(flags & IORING_CQE_F_MORE))
+		submitAccept(slot);
+	if(res < 0){
+		if(res == -ECONNABORTED || res == -EINTR)
+			return;
+		throw SocketError(-res, "Socket failed to accept new connection.");
+	}
+
+	if(0 <= listener.acceptedFd)
+		::close(listener.acceptedFd);
+	listener.acceptedFd = res;
+	listener.dataReceived();
+	if(0 <= listener.acceptedFd){ // nobody took it
+		::close(listener.acceptedFd);
+		listener.acceptedFd = -1;
+	}
+}
+
+void URing::received(unsigned slot, int res, unsigned flags,
+		Array<ControlEvent> & list)
+{
+	Socket & socket = *slots[slot].socket;
+	if(flags & IORING_CQE_F_BUFFER){
+		unsigned bufferId = flags >> IORING_CQE_BUFFER_SHIFT;
+		if(0 < res)
+			socket.appendReceived(bufferMemory +
+					(size_t)bufferId * bufferSize, res);
+		recycle(bufferId);
+	}
+
+	if(0 < res){
+		if(!(flags & IORING_CQE_F_MORE))
+			submitReceive(slot);
+		socket.dataReceived();
+		if(socket.file == -1){ // closed by business logic in child class
+			list.add(ControlEvent(socket,
+					ControlEventCode::ClosedByHost));
+			DBG("URing control fd: %, event: %",
+					list.last().socket.file, list.last().name());
+		}
+		return;
+	}
+
+	switch(res){
+	case -ENOBUFS: // all the buffers were in use
+		submitReceive(slot);
+		return;
+	case -ECANCELED:
+		return;
+	case 0:
+	case -ECONNRESET:
+		list.add(ControlEvent(socket, ControlEventCode::ClosedByPeer));
+		DBG("URing control fd: %, event: %",
+				list.last().socket.file, list.last().name());
+		return;
+	default:
+		throw SocketError(-res, "Error while reading from socket.");
+	}
+}
+
+/* A link of the chain completed. A failed send cancels the rest of the
+ * chain, a short one too, then the rest is submitted again. */
+void URing::sendCompleted(unsigned slot, int res, Array<ControlEvent> & list)
+{
+	Slot & s = slots[slot];
+	Socket & socket = *s.socket;
+	s.sends--;
+
+	if(0 < res){
+		socket.totalSent += res;
+		socket.sent(res);
+	} else if(res < 0 && res != -ECANCELED && !s.sendFailed){
+		s.sendFailed = true;
+		if(res != -EPIPE && res != -ECONNRESET)
+			throw SocketError(-res, "Error after writting % bytes "
+					"to socket.", socket.totalSent);
+		list.add(ControlEvent(socket, ControlEventCode::ClosedByPeer));
+		DBG("URing control fd: %, event: %",
+				list.last().socket.file, list.last().name());
+	}
+
+	if(s.sends || s.sendFailed)
+		return;
+	sendsDone(slot, list);
+}
+
+/* The socket is writable for the sendfile() of the File segment. */
+void URing::pollCompleted(unsigned slot, int res, Array<ControlEvent> & list)
+{
+	Slot & s = slots[slot];
+	Socket & socket = *s.socket;
+	s.sends--;
+	if(res == -ECANCELED)
+		return;
+	if(res < 0)
+		throw SocketError(-res, "Failed to poll socket for writing.");
+
+	try {
+		socket.writeQueue();
+	} catch(csjp::SocketClosedByPeer & e){
+		slots[slot].sendFailed = true;
+		list.add(ControlEvent(socket, ControlEventCode::ClosedByPeer));
+		DBG("URing control fd: %, event: %",
+				list.last().socket.file, list.last().name());
+		return;
+	}
+	sendsDone(slot, list);
+}
+
+void URing::sendsDone(unsigned slot, Array<ControlEvent> & list)
+{
+	Socket & socket = *slots[slot].socket;
+	if(socket.pending){
+		dataIsPending(socket);
+		return;
+	}
+
+	if(socket.file != -1 && socket.closeOnSent)
+		socket.close();
+	if(socket.file != -1)
+		socket.readyToSend();
+	if(socket.file == -1){ // closed by business logic in child class
+		list.add(ControlEvent(socket, ControlEventCode::ClosedByHost));
+		DBG("URing control fd: %, event: %",
+				list.last().socket.file, list.last().name());
+	}
+}
+
+}
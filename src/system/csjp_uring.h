@@ -0,0 +1,127 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#ifndef CSJP_URING_H
+#define CSJP_URING_H
+
+#include <linux/io_uring.h>
+
+#include <csjp_pod_array.h>
+#include <csjp_socket.h>
+#include <csjp_listener.h>
+#include <csjp_epoll_control.h>
+
+namespace csjp {
+
+/**
+ * Completion based alternative of EPollControl on io_uring. Listeners accept
+ * with a multishot accept, the other sockets receive with a multishot receive
+ * into the buffers of a provided buffer ring. The queued data of the sockets
+ * (see Socket::send()) is sent by linked send operations submitted together
+ * with the next wait, thus a loop iteration is a single system call.
+ *
+ * The received data is copied from the provided buffer into the read buffer of
+ * the socket, so received(), peek() and release() work as with EPoll. File
+ * segments are sent with sendfile() after a poll for POLLOUT.
+ *
+ * Do not inherit from this class!
+ */
+class URing : public Socket
+{
+public:
+	explicit URing(const URing & orig) = delete;
+	const URing & operator=(const URing &) = delete;
+
+	URing(URing && temp) = delete;
+	const URing & operator=(URing && temp) = delete;
+
+	/* Throws SocketError if io_uring or any of the used features is not
+	 * supported by the kernel. */
+	explicit URing(unsigned entries = 256, unsigned buffers = 256,
+			unsigned bufferSize = 16*1024);
+	virtual ~URing();
+
+	/* True if the running kernel has all the features used. */
+	static bool supported();
+
+	void add(Socket & socket);
+	void remove(Socket & socket);
+	/* Called by the socket having data to send. */
+	void dataIsPending(Socket & socket);
+	/* Called by the socket being closed, cancels its operations. */
+	void forget(const Socket & socket);
+
+	/* Same events as EPollControl::waitAndControl() gives. */
+	Array<EPollControl::ControlEvent> waitAndControl(int timeout = 0);
+
+private:
+	typedef EPollControl::ControlEvent ControlEvent;
+	typedef EPollControl::ControlEventCode ControlEventCode;
+
+	enum class Op { Accept = 1, Receive, Send, Poll, Cancel };
+
+	/* The operations refer to the slot of the socket instead of the socket,
+	 * so that a completion arriving after the socket is gone finds the slot
+	 * empty. The slot is reused when all of its operations are completed. */
+	struct Slot {
+		Socket * socket;
+		unsigned ops; // submitted, not yet finally completed
+		unsigned sends; // sends in flight
+		bool flushing; // in the flush list
+		bool sendFailed; // the peer is gone, nothing is sent any more
+	};
+
+	struct io_uring_sqe * getSqe();
+	void submitReceive(unsigned slot);
+	void submitAccept(unsigned slot);
+	void flush();
+	void flush(unsigned slot);
+	unsigned enter(unsigned toSubmit, unsigned minComplete, int timeout);
+	void recycle(unsigned bufferId);
+	void release(unsigned slot);
+
+	void completed(unsigned slot, Op op, int res, unsigned flags,
+			Array<ControlEvent> & list);
+	void accepted(unsigned slot, int res, unsigned flags);
+	void received(unsigned slot, int res, unsigned flags,
+			Array<ControlEvent> & list);
+	void sendCompleted(unsigned slot, int res, Array<ControlEvent> & list);
+	void pollCompleted(unsigned slot, int res, Array<ControlEvent> & list);
+	void sendsDone(unsigned slot, Array<ControlEvent> & list);
+
+	/* submission queue */
+	unsigned * sqHead;
+	unsigned * sqTail;
+	unsigned sqMask;
+	unsigned * sqArray;
+	struct io_uring_sqe * sqes;
+	unsigned sqLocalTail; // not yet published
+	unsigned toSubmit;
+	/* completion queue */
+	unsigned * cqHead;
+	unsigned * cqTail;
+	unsigned cqMask;
+	struct io_uring_cqe * cqes;
+
+	void * ringPtr;
+	size_t ringSize;
+	size_t sqesSize;
+
+	/* provided buffer ring, see struct io_uring_buf_ring */
+	struct io_uring_buf * bufRing;
+	unsigned short * bufRingTail;
+	size_t bufRingSize;
+	char * bufferMemory;
+	unsigned bufferCount;
+	unsigned bufferSize;
+
+	PodArray<Slot> slots;
+	PodArray<unsigned> freeSlots;
+	PodArray<unsigned> flushList;
+};
+
+}
+
+#endif
@@ -3,13 +3,17 @@
  * Copyright (C) 2020 Csaszar, Peter
  */
 
+#undef DEBUG
+//#define DEBUG
+
 #include <arpa/inet.h>
+#include <endian.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "csjp_websocket.h"
 
-#undef DEBUG
-#define DEBUG
-
 // https://tools.ietf.org/html/rfc6455
 
 /** TODO Idea for server protection:
@@ -105,11 +109,9 @@ String WebSocketFrame::toString(const char * _maskingKey, unsigned length) const
 		ptr += 2;
 	}
 	else if ((h1 & 0x7f) == 127){
-		// FIXME lets assume this host little endian (might fail on cloud hosts)
-		*(uint32_t*)ptr = htonl(longLength & 0xffffffff);
-		ptr += 4;
-		*(uint32_t*)ptr = htonl(longLength >> 32);
-		ptr += 4;
+		longLength = htobe64(longLength);
+		memcpy(ptr, &longLength, 8);
+		ptr += 8;
 	}
 
 	if (maskingKey.length)
@@ -123,14 +125,7 @@ String WebSocketFrame::toString(const char * _maskingKey, unsigned length) const
 	memcpy(ptr, payload.c_str(), payload.length);
 
 	if (maskingKey.length)
-	{
-		// FIXME take care of byte alignment
-		uint32_t * iptr = (uint32_t*) ptr;
-		uint32_t * endptr = (uint32_t*)(ptr + payload.length);
-		uint32_t mask = * (uint32_t*) maskingKey.c_str();
-		for (; iptr < endptr; iptr++)
-			* iptr ^= mask;
-	}
+		mask(ptr, payload.length, maskingKey.c_str());
 
 	frame.setLength(headerLength + payload.length);
 	frame[headerLength + payload.length] = 0;
@@ -141,20 +136,49 @@ String WebSocketFrame::toString(const char * _maskingKey, unsigned length) const
 	return frame;
 }
 
-/**
- * For now we only parse the full request.
- * If any bytes missing even from the body,
- * the parser will report 0 processed bytes.
+/** The head is XORed bytewise until the data gets aligned, then the body
+ * 16 (SSE2) or 8 bytes at a time with the key rotated to the alignment and
+ * repeated, finally the tail bytewise again.
  */
-unsigned WebSocketFrame::parse(const Str & data)
+void WebSocketFrame::mask(char * data, size_t length, const char * key,
+		unsigned offset)
 {
-	DBG("WebSocket parser available length: %", data.length);
-	if (data.length < 512) {
-		DBG("WebSocket parser available data: %", data);
+	unsigned char * ptr = (unsigned char *)data;
+	unsigned char * end = ptr + length;
+	const unsigned char * k = (const unsigned char *)key;
+
+	while (ptr < end && ((uintptr_t)ptr & 15))
+		*ptr++ ^= k[offset++ & 3];
+
+	unsigned char rotated[16];
+	for (unsigned i = 0; i < sizeof(rotated); i++)
+		rotated[i] = k[(offset + i) & 3];
+
+#ifdef __SSE2__
+	__m128i wide = _mm_loadu_si128((const __m128i *)rotated);
+	for (; 16 <= end - ptr; ptr += 16)
+		_mm_store_si128((__m128i *)ptr, _mm_xor_si128(wide,
+				_mm_load_si128((const __m128i *)ptr)));
+#endif
+	uint64_t word;
+	memcpy(&word, rotated, sizeof(word));
+	for (; 8 <= end - ptr; ptr += 8) {
+		uint64_t value;
+		memcpy(&value, ptr, sizeof(value));
+		value ^= word;
+		memcpy(ptr, &value, sizeof(value));
 	}
 
-	String maskingKey;
+	/* The body was a multiple of 4 long, the tail starts with the rotated
+	 * key again. */
+	for (unsigned i = 0; ptr < end; i++)
+		*ptr++ ^= rotated[i];
+}
 
+/** Returns the length of the header or 0 if it is not complete yet. */
+size_t WebSocketFrame::parseHeader(const Str & data, uint64_t & length,
+		const char *& maskingKey)
+{
 	// two byte is the minimal frame length
 	if (data.length < 2)
 		return 0;
@@ -162,81 +186,66 @@ unsigned WebSocketFrame::parse(const Str & data)
 	uint8_t h0 = *(uint8_t*)(data.c_str());
 	uint8_t h1 = *(uint8_t*)(data.c_str()+1);
 
-	finalBit        = h0 & 0x80;
-
-	opcode          = WebSocketOpcode(h0 & 0xf);
-
-	bool maskedBit  = h1 & 0x80;
-	uint64_t length = h1 & 0x7f;
-
 	unsigned reservedBits = h0 & 0x70;
 	if (reservedBits)
 		throw WebSocketError("Reserved bits of WebSocket "
 				"frame header should not be set.");
 
-	unsigned payloadStartPos = 0;
-
-	if (length < 126)
-	{
-		payloadStartPos = 2;
+	finalBit        = h0 & 0x80;
+	opcode          = WebSocketOpcode(h0 & 0xf);
 
-		if (maskedBit)
-		{
-			payloadStartPos = 6;
-			maskingKey = data.read(2, 6);
-		}
-	}
-	else if (length == 126)
-	{
-		payloadStartPos = 4;
-		length = ntohs(*(uint16_t*)(data.c_str()+2));
+	bool maskedBit  = h1 & 0x80;
+	length = h1 & 0x7f;
 
-		if (maskedBit)
-		{
-			payloadStartPos = 8;
-			maskingKey = data.read(4, 8);
-		}
-	}
+	size_t headerLength = 2;
+	if (length == 126)
+		headerLength += 2;
 	else if (length == 127)
-	{
-		payloadStartPos = 10;
-		uint32_t l1 = ntohl(*(uint32_t*)(data.c_str()+2));
-		uint32_t l2 = ntohl(*(uint32_t*)(data.c_str()+6));
-		// FIXME lets assume this host little endian (might fail on cloud hosts)
-		length = l2;
-		length <<= 32;
-		length += l1;
-
-		DBG("parsed l1: %, l2: %, length: % ", l1, l2, length);
-
-		if (maskedBit)
-		{
-			payloadStartPos = 14;
-			maskingKey = data.read(10, 14);
-		}
+		headerLength += 8;
+	if (maskedBit)
+		headerLength += 4;
+	if (data.length < headerLength)
+		return 0;
+
+	if (length == 126) {
+		uint16_t shortLength;
+		memcpy(&shortLength, data.c_str() + 2, 2);
+		length = ntohs(shortLength);
+	} else if (length == 127) {
+		uint64_t longLength;
+		memcpy(&longLength, data.c_str() + 2, 8);
+		length = be64toh(longLength);
 	}
+	maskingKey = maskedBit ? data.c_str() + headerLength - 4 : NULL;
 
-	if (frameLengthLimit < length + payloadStartPos)
+	if (frameLengthLimit < length ||
+			frameLengthLimit < length + headerLength)
 		throw WebSocketLimitError("Too long frame received. "
 				"Received length is %, the limit is %.",
 				length, frameLengthLimit);
 
-	if (data.length < length + payloadStartPos)
-	{
-		DBG("parsed length : %, header length: %, available length: %",
-				length, payloadStartPos, data.length);
-		if (data.length < 512) {
-			DBG("Available data: %", data);
-		}
+	return headerLength;
+}
+
+/**
+ * For now we only parse the full request.
+ * If any bytes missing even from the body,
+ * the parser will report 0 processed bytes.
+ */
+unsigned WebSocketFrame::parse(const Str & data)
+{
+	DBG("WebSocket parser available length: %", data.length);
+
+	uint64_t length;
+	const char * maskingKey;
+	size_t payloadStartPos = parseHeader(data, length, maskingKey);
+	if (!payloadStartPos || data.length < length + payloadStartPos)
 		return 0;
-	}
 
-	payload = data.read(payloadStartPos, length + payloadStartPos);
-	if (maskedBit)
-	{
-		for (unsigned i = 0, m = 0; i < payload.length; i++, m++)
-			payload[i] ^= maskingKey[m % 4];
-	}
+	payload.assign(data.c_str() + payloadStartPos, length);
+	if (maskingKey)
+		mask((char *)payload.c_str(), payload.length, maskingKey);
+	view = Str(payload);
 
 	DBG("parsed length : % payload startPos : % payload.length : %",
 			length, payloadStartPos, payload.length);
@@ -244,11 +253,29 @@ unsigned WebSocketFrame::parse(const Str & data)
 	return length + payloadStartPos;
 }
 
+unsigned WebSocketFrame::parseInPlace(const Str & data)
+{
+	uint64_t length;
+	const char * maskingKey;
+	size_t payloadStartPos = parseHeader(data, length, maskingKey);
+	if (!payloadStartPos || data.length < length + payloadStartPos)
+		return 0;
+
+	char * start = (char *)data.c_str() + payloadStartPos;
+	if (maskingKey)
+		mask(start, length, maskingKey);
+	payload.clear();
+	view = Str(start, length);
+
+	return length + payloadStartPos;
+}
+
 void WebSocketFrame::clear()
 {
 	finalBit = false;
 	opcode = 0;
 	payload.clear();
+	view = Str();
 }
 
 }
@@ -74,15 +74,19 @@ public:
 	const WebSocketFrame & operator=(const WebSocketFrame &) = delete;
 
 	WebSocketFrame(WebSocketFrame && temp) :
+		frameLengthLimit(temp.frameLengthLimit),
 		finalBit(temp.finalBit),
 		opcode(temp.opcode),
-		payload(move_cast(temp.payload))
+		payload(move_cast(temp.payload)),
+		view(move_cast(temp.view))
 	{}
 	const WebSocketFrame & operator=(WebSocketFrame && temp)
 	{
+		frameLengthLimit = temp.frameLengthLimit;
 		finalBit = temp.finalBit;
 		opcode = temp.opcode;
 		payload = move_cast(temp.payload);
+		view = move_cast(temp.view);
 		return *this;
 	}
 
@@ -100,7 +104,19 @@ public:
 	String toString(const AStr & maskingKey) const
 		{ return toString(maskingKey.c_str(), maskingKey.length); }
 
+	/* Parses a complete frame from the front of the data, returns 0 if it is
+	 * not complete yet. The payload is copied into payload. */
 	unsigned parse(const Str & data);
+	/* As parse(), but the payload is unmasked in place in the data and is
+	 * given by view only, payload is left empty. The data has to be
+	 * writable, like the read buffer of a socket (see Socket::received()),
+	 * the view is valid as long as the data is. */
+	unsigned parseInPlace(const Str & data);
+
+	/* XORs the data with the 4 byte masking key, the first byte with the
+	 * key byte at the offset. Masking and unmasking are the same. */
+	static void mask(char * data, size_t length, const char * key,
+			unsigned offset = 0);
 
 	void clear();
 
@@ -109,6 +125,10 @@ public:
 	bool finalBit;          // 1 bit Indicates the last fragment of a message
 	WebSocketOpcode opcode; // 4 bit
 	String payload;
+	Str view; // payload of the parsed frame
+private:
+	size_t parseHeader(const Str & data, uint64_t & length,
+			const char *& maskingKey);
 };
 
 
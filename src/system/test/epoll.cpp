@@ -4,7 +4,10 @@
  */
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
 
+#include <csjp_stopper.h>
 #include <csjp_test.h>
 #include <csjp_signal.h>
 #include <csjp_server.h>
@@ -135,12 +138,34 @@ public:
 	void close(){ Client::close(); }
 };
 
+class PairSocket : public csjp::Socket
+{
+public:
+	explicit PairSocket(int fd) : Socket() { file = fd; }
+	virtual ~PairSocket() {}
+};
+
+class CountingTimer : public csjp::Timer
+{
+public:
+	CountingTimer() : fired(0) {}
+	virtual ~CountingTimer() {}
+	unsigned fired;
+protected:
+	virtual void expired() { fired++; }
+};
+
+TEST_COUNT_ALLOCATIONS
+
 class TestEPoll
 {
 public:
 	void create();
 	void receiveMsg();
 	void flood();
+	void loopSpeed();
+	void deadlines();
+	void periodicTimer();
 };
 
 void TestEPoll::create()
@@ -255,11 +280,205 @@ void TestEPoll::flood()
 	TESTSTEP("Destructors do the rest of cleanup");
 }
 
+void TestEPoll::loopSpeed()
+{
+	const unsigned count = 64;
+	const unsigned rounds = 2000;
+
+	TESTSTEP("Registering % socket pairs", count);
+	csjp::EPoll epoll(count);
+	csjp::Array<PairSocket> sockets;
+	int peers[count];
+	for(unsigned i = 0; i < count; i++){
+		int fds[2];
+		VERIFY(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+		fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+		sockets.add(fds[0]);
+		peers[i] = fds[1];
+		epoll.add(sockets.last());
+		VERIFY(!sockets.last().isListening());
+	}
+	/* Each round sends a byte on every pair and reads it back afterwards. */
+	auto send = [&](){
+		for(unsigned i = 0; i < count; i++)
+			VERIFY(write(peers[i], "x", 1) == 1);
+	};
+	auto receive = [&](){
+		char c;
+		for(unsigned i = 0; i < count; i++)
+			VERIFY(read(sockets[i].fd(), &c, 1) == 1);
+	};
+	/* Initial writability of the sockets. */
+	VERIFY(epoll.dispatch([](csjp::EPoll::Event &){}) == count);
+
+	TESTSTEP("Ready sockets are dispatched without allocation");
+	csjp::Stopper dispatchTime;
+	dispatchTime.stop();
+	unsigned long dispatched = 0;
+	for(unsigned r = 0; r < rounds; r++){
+		send();
+		dispatchTime.cont();
+		NOALLOC_VERIFY(epoll.dispatch([&dispatched](csjp::EPoll::Event & event){
+				if(event.code == csjp::EPoll::EventCode::DataIn)
+					dispatched++;
+			}));
+		dispatchTime.stop();
+		receive();
+	}
+	VERIFY(dispatched == count * rounds);
+
+	TESTSTEP("The same with the list of events");
+	csjp::Stopper listTime;
+	listTime.stop();
+	unsigned long listed = 0;
+	for(unsigned r = 0; r < rounds; r++){
+		send();
+		listTime.cont();
+		for(auto & event : epoll.wait())
+			if(event.code == csjp::EPoll::EventCode::DataIn)
+				listed++;
+		listTime.stop();
+		receive();
+	}
+	VERIFY(listed == count * rounds);
+
+	LOG("Events per sec: list: %, dispatch: %",
+			listed / listTime.elapsed, dispatched / dispatchTime.elapsed);
+
+	for(unsigned i = 0; i < count; i++)
+		close(peers[i]);
+}
+
+static int pairFor(int & peer)
+{
+	int fds[2];
+	VERIFY(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+	peer = fds[1];
+	return fds[0];
+}
+
+/* Waits at most rounds times for the TimedOut event of the socket. */
+static bool waitForTimeout(csjp::EPollControl & epoll, csjp::Socket & socket,
+		unsigned rounds, int timeout = -1)
+{
+	for(unsigned i = 0; i < rounds; i++)
+		for(auto & event : epoll.waitAndControl(timeout))
+			if(event.code == csjp::EPollControl::ControlEventCode::TimedOut){
+				VERIFY(&event.socket == &socket);
+				return true;
+			}
+	return false;
+}
+
+void TestEPoll::deadlines()
+{
+	csjp::Signal pipeSignal(SIGPIPE, csjp::Signal::sigpipeHandler);
+
+	TESTSTEP("Slowloris: a request trickling in is reaped by the read deadline");
+	{
+		csjp::EPollControl epoll(8);
+		int peer;
+		PairSocket slow(pairFor(peer));
+		slow.readTimeout = 100;
+		slow.idleTimeout = 1000;
+		epoll.add(slow);
+		csjp::Stopper stopper;
+		bool timedOut = false;
+		for(unsigned i = 0; i < 100 && !timedOut; i++){
+			VERIFY(write(peer, "G", 1) == 1);
+			timedOut = waitForTimeout(epoll, slow, 2, 10);
+		}
+		double sec = stopper.stop();
+		VERIFY(timedOut);
+		VERIFY(0.09 <= sec && sec < 1);
+		LOG("Slow connection reaped after % sec, % bytes",
+				sec, slow.bytesAvailable);
+		close(peer);
+	}
+
+	TESTSTEP("Idle connection is reaped, the wait ends at the deadline");
+	{
+		csjp::EPollControl epoll(8);
+		int peer;
+		PairSocket idle(pairFor(peer));
+		idle.idleTimeout = 50;
+		epoll.add(idle);
+		csjp::Stopper stopper;
+		VERIFY(waitForTimeout(epoll, idle, 3));
+		double sec = stopper.stop();
+		VERIFY(0.04 <= sec && sec < 1);
+		close(peer);
+	}
+
+	TESTSTEP("Peer not reading is reaped by the write deadline");
+	{
+		csjp::EPollControl epoll(8);
+		int peer;
+		PairSocket writer(pairFor(peer));
+		writer.writeTimeout = 50;
+		epoll.add(writer);
+		epoll.waitAndControl(0);
+		csjp::String data;
+		data.fill('x', 8*1024*1024);
+		VERIFY(!writer.send(data));
+		VERIFY(writer.bytesToSend);
+		VERIFY(waitForTimeout(epoll, writer, 3));
+		close(peer);
+	}
+
+	TESTSTEP("Moved control keeps the sockets and their deadlines");
+	{
+		csjp::EPollControl first(8);
+		int peer;
+		PairSocket idle(pairFor(peer));
+		idle.idleTimeout = 50;
+		first.add(idle);
+		csjp::EPollControl epoll(csjp::move_cast(first));
+		VERIFY(waitForTimeout(epoll, idle, 3));
+		VERIFY(write(peer, "x", 1) == 1);
+		first = csjp::move_cast(epoll);
+		VERIFY(waitForTimeout(first, idle, 3));
+		VERIFY(idle.bytesAvailable == 1);
+		first.remove(idle);
+		close(peer);
+	}
+}
+
+void TestEPoll::periodicTimer()
+{
+	csjp::EPollControl epoll(8);
+	CountingTimer timer;
+
+	TESTSTEP("Periodic timer wakes up the waiting loop");
+	timer.period = 10;
+	epoll.arm(timer, 10);
+	unsigned rounds = 0;
+	csjp::Stopper stopper;
+	while(timer.fired < 5){
+		VERIFY(epoll.waitAndControl(-1).length == 0);
+		rounds++;
+	}
+	double sec = stopper.stop();
+	VERIFY(0.04 <= sec);
+	VERIFY(rounds < 20);
+
+	TESTSTEP("Cancelled timer does not wake up the loop");
+	epoll.cancel(timer);
+	VERIFY(!timer.armed());
+	unsigned fired = timer.fired;
+	epoll.waitAndControl(30);
+	VERIFY(timer.fired == fired);
+}
+
 TEST_INIT(EPoll)
 
 	TEST_RUN(create);
 	TEST_RUN(receiveMsg);
 	TEST_RUN(flood);
+	TEST_RUN(loopSpeed);
+	TEST_RUN(deadlines);
+	TEST_RUN(periodicTimer);
 
 TEST_FINISH(EPoll)
 
@@ -6,14 +6,23 @@
 #undef DEBUG
 #define DEBUG
 
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
 #include <csjp_signal.h>
 #include <csjp_server.h>
 #include <csjp_client.h>
 #include <csjp_epoll_control.h>
 #include <csjp_owner_container.h>
 #include <csjp_http.h>
+#include <csjp_stopper.h>
 #include <csjp_test.h>
 
+TEST_COUNT_ALLOCATIONS
+
 csjp::String requestStr, responseStr;
 
 class HTTPServer : public csjp::Server
@@ -36,7 +45,9 @@ public:
 		DBG("request version: %", request.version);
 		VERIFY(request.version == "1.0");
 		DBG("request headers: %", request.headers);
-		VERIFY(request.headers == "content-length: 4");
+		csjp::String headers;
+		headers << request.headers;
+		VERIFY(headers == "content-length: 4");
 		//DBG("request.headers.type: %", request.headers.type);
 		//VERIFY(request.headers.type == Json::Type::Object);
 		DBG("request.headers.size(): %", request.headers.size());
@@ -113,7 +124,9 @@ public:
 		DBG("response version: %", response.version);
 		VERIFY(response.version == "1.0");
 		DBG("response headers: %", response.headers);
-		VERIFY(response.headers == "content-length: 6");
+		csjp::String headers;
+		headers << response.headers;
+		VERIFY(headers == "content-length: 6");
 		VERIFY(response.headers.size() == 1);
 		VERIFY(response.headers["content-length"] == "6");
 		DBG("response body: %", response.body);
@@ -138,7 +151,156 @@ public:
 };
 
 
+static const unsigned servicePort = 30304;
+
+/* Answers with the body of the request or with its uri if it has no body. */
+class EchoConnection : public csjp::HTTPConnection
+{
+public:
+	explicit EchoConnection(const csjp::Listener & listener) :
+		csjp::HTTPConnection(listener) {}
+	virtual ~EchoConnection() {}
+
+protected:
+	virtual csjp::HTTPResponse respond(csjp::HTTPRequest & request)
+	{
+		csjp::HTTPResponse response(csjp::Str(request.body.length ?
+				request.body : request.uri), request.version);
+		if(request.uri == "/chunked")
+			response.headers.set("transfer-encoding", "chunked");
+		if(request.uri == "/close")
+			response.headers.set("connection", "close");
+		return response;
+	}
+};
+
+bool operator<(const EchoConnection & lhs, const EchoConnection & rhs)
+{
+	return &lhs < &rhs;
+}
+
+bool operator<(const csjp::Socket & lhs, const EchoConnection & rhs)
+{
+	return &lhs < &rhs;
+}
+
+bool operator<(const EchoConnection & lhs, const csjp::Socket & rhs)
+{
+	return &lhs < &rhs;
+}
+
+/* HTTP service running its EPollControl in a thread of its own. The cache is
+ * not to be changed while the service runs. */
+class EchoService : public csjp::Listener
+{
+public:
+	explicit EchoService(csjp::HTTPResponseCache * cache = NULL) :
+		csjp::Listener("127.0.0.1", servicePort, 128),
+		epoll(64),
+		cache(cache),
+		stopped(false)
+	{
+		epoll.add(*this);
+		if(pthread_create(&thread, NULL, run, this))
+			throw csjp::SystemError("Failed to create service thread.");
+	}
+	virtual ~EchoService()
+	{
+		__atomic_store_n(&stopped, true, __ATOMIC_RELEASE);
+		pthread_join(thread, NULL);
+		connections.clear();
+		close();
+	}
+
+	virtual void dataReceived()
+	{
+		while(true){
+			EchoConnection * connection;
+			try {
+				connection = new EchoConnection(*this);
+			} catch(csjp::SocketNoneConnecting &) {
+				return;
+			}
+			connection->cache = cache;
+			epoll.add(*connection);
+			connections.add(connection);
+		}
+	}
+
+private:
+	static void * run(void * arg)
+	{
+		EchoService & service = *(EchoService *)arg;
+		while(!__atomic_load_n(&service.stopped, __ATOMIC_ACQUIRE))
+			for(auto & event : service.epoll.waitAndControl(10)){
+				if(event.code == csjp::EPollControl::
+						ControlEventCode::Exception)
+					EXCEPTION(event.exception);
+				if(service.connections.has(event.socket))
+					service.connections.remove(event.socket);
+			}
+		return NULL;
+	}
+
+	csjp::EPollControl epoll;
+	csjp::HTTPResponseCache * cache;
+	csjp::OwnerContainer<EchoConnection> connections;
+	pthread_t thread;
+	bool stopped;
+};
 
+/* Blocking client parsing the responses with HTTPResponse. */
+class BlockingClient
+{
+public:
+	explicit BlockingClient(unsigned port) : pos(0)
+	{
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		struct sockaddr_in addr;
+		bzero(&addr, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		VERIFY(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+	}
+	~BlockingClient() { ::close(fd); }
+
+	void send(const csjp::Str & data)
+	{
+		VERIFY(::write(fd, data.c_str(), data.length) ==
+				(ssize_t)data.length);
+	}
+
+	/* The next response, reads as much as needed. */
+	csjp::HTTPResponse & next()
+	{
+		response.clear();
+		while(true){
+			unsigned processed = response.parse(
+					csjp::Str(data.c_str() + pos, data.length - pos));
+			if(processed){
+				pos += processed;
+				return response;
+			}
+			char buffer[16*1024];
+			ssize_t got = ::read(fd, buffer, sizeof(buffer));
+			VERIFY(0 < got);
+			data.append(buffer, got);
+		}
+	}
+
+	bool closedByPeer()
+	{
+		char c;
+		return pos == data.length && ::read(fd, &c, 1) == 0;
+	}
+
+private:
+	int fd;
+	csjp::String data;
+	size_t pos;
+	csjp::HTTPResponse response;
+};
 
 class TestHTTP
 {
@@ -146,6 +308,15 @@ public:
 	void create();
 	void requestResponseOverSocket();
 	void multiLineHeaders();
+	void parseWithoutAllocation();
+	void chunked();
+	void pipelining();
+	void persistentConnection();
+	void loadBenchmark();
+	void incrementalParse();
+	void headerMap();
+	void serialize();
+	void responseCache();
 };
 
 void TestHTTP::create()
@@ -185,6 +356,8 @@ void TestHTTP::requestResponseOverSocket()
 			break;
 		case csjp::EPollControl::ControlEventCode::ClosedByHost:
 			break;
+		case csjp::EPollControl::ControlEventCode::TimedOut:
+			break;
 		case csjp::EPollControl::ControlEventCode::Exception:
 			EXCEPTION(event.exception);
 			throw;
@@ -202,6 +375,8 @@ void TestHTTP::requestResponseOverSocket()
 				break;
 			case csjp::EPollControl::ControlEventCode::ClosedByHost:
 				break;
+			case csjp::EPollControl::ControlEventCode::TimedOut:
+				break;
 			case csjp::EPollControl::ControlEventCode::Exception:
 				EXCEPTION(event.exception);
 				throw;
@@ -220,8 +395,8 @@ void TestHTTP::multiLineHeaders()
 	{
 		csjp::HTTPRequest request("POST");
 
-		request.headers["multiline-test-header-key"] =
-			"multiline-test-\r\n\theader-value";
+		request.headers.set("multiline-test-header-key",
+			"multiline-test-\r\n\theader-value");
 
 		DBG("Whole request:\n%", request);
 
@@ -238,8 +413,8 @@ void TestHTTP::multiLineHeaders()
 	{
 		csjp::HTTPRequest request("POST");
 
-		request.headers["multiline-test-header-key"] =
-			"multiline-test-\n header-value";
+		request.headers.set("multiline-test-header-key",
+			"multiline-test-\n header-value");
 
 		DBG("Whole request:\n%", request);
 
@@ -257,8 +432,8 @@ void TestHTTP::multiLineHeaders()
 	{
 		csjp::HTTPRequest request("POST");
 
-		request.headers["multiline-test-header-key"] =
-			"multiline-test-\nheader-value";
+		request.headers.set("multiline-test-header-key",
+			"multiline-test-\nheader-value");
 
 		DBG("Whole request:\n%", request);
 
@@ -271,8 +446,8 @@ void TestHTTP::multiLineHeaders()
 	{
 		csjp::HTTPResponse response("POST");
 
-		response.headers["multiline-test-header-key"] =
-			"multiline-test-\n\r\theader-value";
+		response.headers.set("multiline-test-header-key",
+			"multiline-test-\n\r\theader-value");
 
 		DBG("Whole response:\n%", response);
 
@@ -289,8 +464,8 @@ void TestHTTP::multiLineHeaders()
 	{
 		csjp::HTTPResponse response("POST");
 
-		response.headers["multiline-test-header-key"] =
-			"multiline-test-\n header-value";
+		response.headers.set("multiline-test-header-key",
+			"multiline-test-\n header-value");
 
 		DBG("Whole response:\n%", response);
 
@@ -308,8 +483,8 @@ void TestHTTP::multiLineHeaders()
 	{
 		csjp::HTTPResponse response("POST");
 
-		response.headers["multiline-test-header-key"] =
-			"multiline-test-\nheader-value";
+		response.headers.set("multiline-test-header-key",
+			"multiline-test-\nheader-value");
 
 		DBG("Whole response:\n%", response);
 
@@ -319,11 +494,642 @@ void TestHTTP::multiLineHeaders()
 	}
 }
 
+void TestHTTP::parseWithoutAllocation()
+{
+	csjp::Str data(
+			"POST /api/v1/items?sort=name&order=ascending HTTP/1.1\r\n"
+			"Host: www.example.com\r\n"
+			"User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:45.0) Gecko/20100101\r\n"
+			"Accept: text/html,application/xhtml+xml,application/xml;q=0.9\r\n"
+			"Accept-Language: en-US,en;q=0.5\r\n"
+			"Accept-Encoding: gzip, deflate\r\n"
+			"Content-Type: application/x-www-form-urlencoded\r\n"
+			"Connection: keep-alive\r\n"
+			"Content-Length: 27\r\n"
+			"\r\n"
+			"name=apple&color=red&size=3");
+	csjp::HTTPRequest request;
+
+	TESTSTEP("First parse allocates the arena of the request");
+	VERIFY(request.parse(data) == data.length);
+	VERIFY(request.method == "POST");
+	VERIFY(request.uri == "/api/v1/items?sort=name&order=ascending");
+	VERIFY(request.version == "1.1");
+	VERIFY(request.headers.size() == 8);
+	VERIFY(request.headers["user-agent"] ==
+			"Mozilla/5.0 (X11; Linux x86_64; rv:45.0) Gecko/20100101");
+	VERIFY(request.body == "name=apple&color=red&size=3");
+	request.clear();
+
+	TESTSTEP("Steady state parse does not allocate from the heap");
+	for(int i = 0; i < 10; i++){
+		NOALLOC_VERIFY(VERIFY(request.parse(data) == data.length));
+		VERIFY(request.headers["content-length"] == "27");
+		VERIFY(request.body == "name=apple&color=red&size=3");
+		NOALLOC_VERIFY(request.clear());
+	}
+
+	TESTSTEP("Moved from request is empty and reusable");
+	VERIFY(request.parse(data) == data.length);
+	csjp::HTTPRequest moved(csjp::move_cast(request));
+	VERIFY(moved.body == "name=apple&color=red&size=3");
+	VERIFY(moved.headers["host"] == "www.example.com");
+	VERIFY(request.headers.size() == 0);
+	request.clear();
+	VERIFY(request.parse(data) == data.length);
+	moved = csjp::move_cast(request);
+	VERIFY(moved.headers["content-length"] == "27");
+	request.body.append("reused");
+	VERIFY(request.body == "reused");
+	request.clear();
+	moved.clear();
+
+	TESTSTEP("Requests per sec");
+	const unsigned count = 100000;
+	csjp::Stopper stopper;
+	for(unsigned i = 0; i < count; i++){
+		request.parse(data);
+		request.clear();
+	}
+	LOG("Parsed requests per sec: %", count / stopper.stop());
+}
+
+void TestHTTP::chunked()
+{
+	TESTSTEP("Chunked request is encoded and parsed back");
+	{
+		csjp::HTTPRequest request("POST", "/", "chunked body", "1.1");
+		request.headers.set("transfer-encoding", "chunked");
+		csjp::String str(request.toString());
+		VERIFY(!str.contains("content-length"));
+		VERIFY(str.endsWith("\r\n\r\nc\r\nchunked body\r\n0\r\n\r\n"));
+
+		csjp::HTTPRequest parsed;
+		VERIFY(parsed.parse(str) == str.length);
+		VERIFY(parsed.body == "chunked body");
+	}
+
+	TESTSTEP("Chunks with extensions and trailer arriving byte by byte");
+	{
+		csjp::Str data(
+				"POST /upload HTTP/1.1\r\n"
+				"Transfer-Encoding: gzip, chunked\r\n"
+				"\r\n"
+				"5;name=value\r\nhello\r\n"
+				"1A\r\n, chunked transfer encodin\r\n"
+				"1\r\ng\r\n"
+				"0\r\n"
+				"checksum: none\r\n"
+				"\r\n"
+				"GET /next HTTP/1.1\r\n\r\n");
+		size_t end = data.length - strlen("GET /next HTTP/1.1\r\n\r\n");
+		csjp::HTTPRequest request;
+		for(size_t length = 0; length < end; length++)
+			VERIFY(request.parse(data.read(0, length)) == 0);
+		VERIFY(request.parse(data) == end);
+		VERIFY(request.body == "hello, chunked transfer encoding");
+	}
+
+	TESTSTEP("Invalid chunk size");
+	{
+		csjp::HTTPRequest request;
+		EXC_VERIFY(request.parse("POST / HTTP/1.1\r\n"
+					"transfer-encoding: chunked\r\n\r\n"
+					"x\r\nhello\r\n0\r\n\r\n"),
+				csjp::HttpProtocolError);
+	}
+
+	TESTSTEP("Chunked response streamed chunk by chunk");
+	{
+		csjp::HTTPResponse response("", "1.1");
+		response.headers.set("transfer-encoding", "chunked");
+		csjp::String str(response.toString());
+		VERIFY(str.endsWith("\r\n\r\n0\r\n\r\n"));
+		/* Replacing the last chunk with the streamed ones. */
+		str.cutAt(str.length - 5);
+		str << csjp::HTTPResponse::chunk("first ");
+		str << csjp::HTTPResponse::chunk("second");
+		str << csjp::HTTPResponse::chunk("");
+
+		csjp::HTTPResponse parsed;
+		VERIFY(parsed.parse(str) == str.length);
+		VERIFY(parsed.body == "first second");
+	}
+}
+
+void TestHTTP::pipelining()
+{
+	csjp::Str data(
+			"GET /first HTTP/1.1\r\nHost: a\r\n\r\n"
+			"POST /second HTTP/1.1\r\nHost: a\r\nContent-Length: 4\r\n\r\nbody"
+			"GET /third HTTP/1.1\r\nHost: a\r\nConnection: close\r\n\r\n"
+			"GET /fourth HTTP/1.1\r\n");
+	csjp::HTTPRequest request;
+
+	TESTSTEP("Pipelined requests are parsed back to back from one buffer");
+	size_t pos = 0;
+	const char * uris[] = { "/first", "/second", "/third" };
+	for(unsigned i = 0; i < 3; i++){
+		unsigned processed = request.parse(data.read(pos, data.length));
+		VERIFY(processed);
+		VERIFY(request.uri == uris[i]);
+		VERIFY(request.keepAlive() == (i < 2));
+		pos += processed;
+		request.clear();
+	}
+	VERIFY(request.body.length == 0);
+
+	TESTSTEP("The incomplete request waits for more data");
+	VERIFY(request.parse(data.read(pos, data.length)) == 0);
+	VERIFY(request.uri == "/fourth");
+
+	TESTSTEP("Version 1.0 is persistent only if asked for");
+	request.clear();
+	VERIFY(request.parse("GET / HTTP/1.0\r\n\r\n"));
+	VERIFY(!request.keepAlive());
+	request.clear();
+	VERIFY(request.parse("GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n"));
+	VERIFY(request.keepAlive());
+}
+
+void TestHTTP::persistentConnection()
+{
+	csjp::Signal pipeSignal(SIGPIPE, csjp::Signal::sigpipeHandler);
+	EchoService service;
+	BlockingClient client(servicePort);
+
+	TESTSTEP("Pipelined requests are answered in order on one connection");
+	client.send("GET /one HTTP/1.1\r\nhost: a\r\n\r\n"
+			"GET /two HTTP/1.1\r\nhost: a\r\n\r\n"
+			"POST /three HTTP/1.1\r\nhost: a\r\ncontent-length: 5\r\n\r\nthree");
+	VERIFY(client.next().body == "/one");
+	VERIFY(client.next().body == "/two");
+	csjp::HTTPResponse & third = client.next();
+	VERIFY(third.body == "three");
+	VERIFY(third.keepAlive());
+
+	TESTSTEP("Chunked request and chunked response");
+	client.send("POST / HTTP/1.1\r\ntransfer-encoding: chunked\r\n\r\n"
+			"4\r\nabcd\r\n");
+	client.send("3\r\nefg\r\n0\r\n\r\n");
+	VERIFY(client.next().body == "abcdefg");
+	client.send("GET /chunked HTTP/1.1\r\n\r\n");
+	csjp::HTTPResponse & chunked = client.next();
+	VERIFY(chunked.headers["transfer-encoding"] == "chunked");
+	VERIFY(chunked.body == "/chunked");
+
+	TESTSTEP("Expect: 100-continue gets the interim response first");
+	client.send("POST / HTTP/1.1\r\nexpect: 100-continue\r\n"
+			"content-length: 7\r\n\r\n");
+	VERIFY(client.next().status() == csjp::HTTPStatusCode::Enum::Continue);
+	client.send("payload");
+	csjp::HTTPResponse & answer = client.next();
+	VERIFY(answer.status() == csjp::HTTPStatusCode::Enum::OK);
+	VERIFY(answer.body == "payload");
+
+	TESTSTEP("Connection: close ends the connection after the response");
+	client.send("GET /last HTTP/1.1\r\nconnection: close\r\n\r\n");
+	csjp::HTTPResponse & last = client.next();
+	VERIFY(last.body == "/last");
+	VERIFY(!last.keepAlive());
+	VERIFY(client.closedByPeer());
+
+	TESTSTEP("Version 1.0 request without keep-alive is not persistent");
+	BlockingClient old(servicePort);
+	old.send("GET /old HTTP/1.0\r\n\r\n");
+	VERIFY(old.next().body == "/old");
+	VERIFY(old.closedByPeer());
+}
+
+void TestHTTP::loadBenchmark()
+{
+	csjp::Signal pipeSignal(SIGPIPE, csjp::Signal::sigpipeHandler);
+	EchoService service;
+	const unsigned count = 2000;
+	const unsigned depth = 16;
+	csjp::Str request("GET /benchmark HTTP/1.1\r\nhost: localhost\r\n\r\n");
+
+	TESTSTEP("New connection per request");
+	csjp::Stopper stopper;
+	for(unsigned i = 0; i < count; i++){
+		BlockingClient client(servicePort);
+		client.send("GET /benchmark HTTP/1.1\r\nhost: localhost\r\n"
+				"connection: close\r\n\r\n");
+		VERIFY(client.next().body == "/benchmark");
+		VERIFY(client.closedByPeer());
+	}
+	double perConnection = count / stopper.stop();
+	LOG("Connection per request: % requests per sec", perConnection);
+
+	TESTSTEP("Keep-alive connection");
+	{
+		BlockingClient client(servicePort);
+		stopper.restart();
+		for(unsigned i = 0; i < count; i++){
+			client.send(request);
+			VERIFY(client.next().body == "/benchmark");
+		}
+		double keepAlive = count / stopper.stop();
+		LOG("Keep-alive: % requests per sec, % times faster",
+				keepAlive, keepAlive / perConnection);
+	}
+
+	TESTSTEP("Keep-alive connection with pipelining");
+	{
+		csjp::String batch;
+		for(unsigned i = 0; i < depth; i++)
+			batch << request;
+		BlockingClient client(servicePort);
+		stopper.restart();
+		for(unsigned i = 0; i < count / depth; i++){
+			client.send(batch);
+			for(unsigned j = 0; j < depth; j++)
+				VERIFY(client.next().body == "/benchmark");
+		}
+		double pipelined = count / depth * depth / stopper.stop();
+		LOG("Pipelined by %: % requests per sec, % times faster",
+				depth, pipelined, pipelined / perConnection);
+	}
+}
+
+void TestHTTP::incrementalParse()
+{
+	csjp::Str data(
+			"POST /api/v1/items?sort=name&order=ascending HTTP/1.1\r\n"
+			"Host: www.example.com\r\n"
+			"User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:45.0) Gecko/20100101\r\n"
+			"Accept: text/html,application/xhtml+xml,application/xml;q=0.9\r\n"
+			"Accept-Language: en-US,en;q=0.5\r\n"
+			"Accept-Encoding: gzip, deflate\r\n"
+			"Content-Type: application/x-www-form-urlencoded\r\n"
+			"Connection: keep-alive\r\n"
+			"Content-Length: 27\r\n"
+			"\r\n"
+			"name=apple&color=red&size=3");
+	size_t headerLength = data.length - 27;
+	csjp::HTTPRequest request;
+
+	TESTSTEP("Parse progress is kept between the partial reads");
+	size_t parsed = 0;
+	for(size_t length = 0; length < data.length; length++){
+		VERIFY(request.parse(data.read(0, length)) == 0);
+		VERIFY(parsed <= request.parsed());
+		VERIFY(request.parsed() <= length);
+		parsed = request.parsed();
+		VERIFY(request.headersComplete() == (headerLength <= length));
+	}
+	VERIFY(request.parsed() == headerLength);
+	VERIFY(request.parse(data) == data.length);
+	VERIFY(request.uri == "/api/v1/items?sort=name&order=ascending");
+	VERIFY(request.headers.size() == 8);
+	VERIFY(request.headers["accept-encoding"] == "gzip, deflate");
+	VERIFY(request.body == "name=apple&color=red&size=3");
+
+	TESTSTEP("Lines ended by a single LF, repeated headers are joined by get");
+	request.clear();
+	VERIFY(request.parse("\r\nGET / HTTP/1.1\nAccept: a\nAccept: b\n\n") ==
+			strlen("\r\nGET / HTTP/1.1\nAccept: a\nAccept: b\n\n"));
+	VERIFY(request.headers.size() == 2);
+	VERIFY(request.headers.value(1) == "b");
+	VERIFY(request.headers["accept"] == "a, b");
+
+	TESTSTEP("Framing by repeated and conflicting headers");
+	request.clear();
+	VERIFY(request.parse("POST / HTTP/1.1\r\n"
+				"Transfer-Encoding: gzip\r\n"
+				"Transfer-Encoding: chunked\r\n\r\n"
+				"3\r\nabc\r\n0\r\n\r\n"));
+	VERIFY(request.body == "abc");
+	request.clear();
+	VERIFY(request.parse("POST / HTTP/1.1\r\n"
+				"Content-Length: 3\r\n"
+				"Content-Length: 3\r\n\r\nabc"));
+	VERIFY(request.body == "abc");
+	request.clear();
+	EXC_VERIFY(request.parse("POST / HTTP/1.1\r\n"
+				"Content-Length: 3\r\n"
+				"Content-Length: 4\r\n\r\nabcd"),
+			csjp::HttpProtocolError);
+	request.clear();
+	VERIFY(request.parse("POST / HTTP/1.1\r\n"
+				"Content-Length: 3, 3\r\n\r\nabc"));
+	request.clear();
+	EXC_VERIFY(request.parse("POST / HTTP/1.1\r\n"
+				"Content-Length: 5,\r\n\r\nabcde"),
+			csjp::HttpProtocolError);
+	request.clear();
+	EXC_VERIFY(request.parse("POST / HTTP/1.1\r\n"
+				"Content-Length: 3\r\n"
+				"Transfer-Encoding: chunked\r\n\r\n"
+				"3\r\nabc\r\n0\r\n\r\n"),
+			csjp::HttpProtocolError);
+
+	TESTSTEP("Huge body sizes are rejected instead of wrapping around");
+	request.clear();
+	EXC_VERIFY(request.parse("POST / HTTP/1.1\r\n"
+				"Content-Length: 18446744073709551615\r\n\r\nabc"),
+			csjp::HttpProtocolError);
+	request.clear();
+	EXC_VERIFY(request.parse("POST / HTTP/1.1\r\n"
+				"Transfer-Encoding: chunked\r\n\r\n"
+				"ffffffffffffffff\r\nabc\r\n"),
+			csjp::HttpProtocolError);
+	request.clear();
+	request.setMaxBodySize(5);
+	VERIFY(request.parse("POST / HTTP/1.1\r\n"
+				"Content-Length: 5\r\n\r\nabcde"));
+	request.clear();
+	EXC_VERIFY(request.parse("POST / HTTP/1.1\r\n"
+				"Content-Length: 6\r\n\r\nabcdef"),
+			csjp::HttpProtocolError);
+	request.clear();
+	EXC_VERIFY(request.parse("POST / HTTP/1.1\r\n"
+				"Transfer-Encoding: chunked\r\n\r\n"
+				"3\r\nabc\r\n3\r\ndef\r\n0\r\n\r\n"),
+			csjp::HttpProtocolError);
+	request.setMaxBodySize(csjp::HTTPParser::defaultMaxBodySize);
+
+	TESTSTEP("Folded lines extend the value in place, limits of the header");
+	{
+		csjp::String data("GET / HTTP/1.1\r\nX-Folded: a\r\n");
+		for(unsigned i = 0; i < 2000; i++)
+			data.append(" b\r\n");
+		data.append("\r\n");
+		request.clear();
+		VERIFY(request.parse(data) == data.length);
+		VERIFY(request.headers["x-folded"].length == 2001);
+		VERIFY(request.headers["x-folded"].endsWith("bbb"));
+
+		data = "GET / HTTP/1.1\r\n";
+		for(unsigned i = 0; i <= csjp::HTTPParser::maxHeaders; i++)
+			data.append("X: a\r\n");
+		request.clear();
+		EXC_VERIFY(request.parse(data), csjp::HttpProtocolError);
+
+		csjp::String value;
+		value.fill('a', csjp::HTTPParser::maxHeaderSize);
+		data = "GET / HTTP/1.1\r\nX: ";
+		data.append(value);
+		request.clear();
+		EXC_VERIFY(request.parse(data), csjp::HttpProtocolError);
+	}
+
+	TESTSTEP("Status line");
+	{
+		csjp::HTTPResponse response;
+		VERIFY(response.parse("HTTP/1.1 404 Not Found\r\n"
+					"content-length: 0\r\n\r\n"));
+		VERIFY(response.status() == csjp::HTTPStatusCode::Enum::NotFound);
+		VERIFY(response.reason() == "Not Found");
+		VERIFY(response.version == "1.1");
+		response.clear();
+		VERIFY(response.parse("HTTP/1.1 204\r\n\r\n"));
+		VERIFY(response.status() == csjp::HTTPStatusCode::Enum::NoContent);
+		response.clear();
+		EXC_VERIFY(response.parse("HTTP/1.1 2x0 OK\r\n\r\n"),
+				csjp::HttpProtocolError);
+		response.clear();
+		EXC_VERIFY(response.parse("HTTX/1.1 200 OK\r\n\r\n"),
+				csjp::HttpProtocolError);
+	}
+
+	TESTSTEP("Requests per sec arriving in 16 byte pieces");
+	const unsigned count = 20000;
+	csjp::Stopper stopper;
+	for(unsigned i = 0; i < count; i++){
+		request.clear();
+		size_t length = 0;
+		do {
+			length = length + 16 < data.length ? length + 16 : data.length;
+		} while(!request.parse(data.read(0, length)));
+	}
+	LOG("Parsed requests per sec: %", count / stopper.stop());
+}
+
+void TestHTTP::headerMap()
+{
+	typedef csjp::HTTPHeaders::Token Token;
+
+	TESTSTEP("Known names are tokens, case insensitively");
+	VERIFY(csjp::HTTPHeaders::token("Content-Length") == Token::ContentLength);
+	VERIFY(csjp::HTTPHeaders::token("CONNECTION") == Token::Connection);
+	VERIFY(csjp::HTTPHeaders::token("sec-websocket-key") ==
+			Token::SecWebSocketKey);
+	VERIFY(csjp::HTTPHeaders::token("x-content-length") == Token::Other);
+	VERIFY(csjp::HTTPHeaders::token("") == Token::Other);
+	VERIFY(csjp::HTTPHeaders::name(Token::ETag) == csjp::Str("etag"));
+
+	TESTSTEP("Parsed headers refer to the data until kept");
+	csjp::HTTPRequest request;
+	{
+		csjp::String data("GET / HTTP/1.1\r\n"
+				"Host: example.com\r\n"
+				"X-Custom: first\r\n"
+				"Upgrade: websocket\r\n\r\n");
+		VERIFY(request.parse(data) == data.length);
+		VERIFY(request.headers.get(Token::Host).c_str() ==
+				data.c_str() + strlen("GET / HTTP/1.1\r\nHost: "));
+		VERIFY(request.headers["x-custom"] == "first");
+		VERIFY(request.headers["X-CUSTOM"] == "first");
+		VERIFY(request.headers[Token::Upgrade] == "websocket");
+		VERIFY(!request.headers.has(Token::ContentLength));
+		VERIFY(request.headers["missing"].length == 0);
+		request.headers.keep();
+		data.fill('x');
+	}
+	VERIFY(request.headers["host"] == "example.com");
+	VERIFY(request.headers["x-custom"] == "first");
+
+	TESTSTEP("Added headers are copied, set replaces, remove removes");
+	request.headers.add("X-Custom", "second");
+	VERIFY(request.headers.size() == 4);
+	VERIFY(request.headers["x-custom"] == "first, second");
+	request.headers.set("x-custom", "third");
+	VERIFY(request.headers.size() == 3);
+	VERIFY(request.headers["x-custom"] == "third");
+	request.headers.remove("Upgrade");
+	VERIFY(!request.headers.has(Token::Upgrade));
+	VERIFY(request.headers.size() == 2);
+
+	TESTSTEP("Lookups per sec");
+	request.clear();
+	csjp::Str data(
+			"GET / HTTP/1.1\r\n"
+			"Host: www.example.com\r\n"
+			"User-Agent: Mozilla/5.0\r\n"
+			"Accept: text/html\r\n"
+			"Accept-Language: en-US,en;q=0.5\r\n"
+			"Accept-Encoding: gzip, deflate\r\n"
+			"Connection: keep-alive\r\n\r\n");
+	VERIFY(request.parse(data) == data.length);
+	const unsigned count = 1000000;
+	unsigned found = 0;
+	csjp::Stopper stopper;
+	for(unsigned i = 0; i < count; i++){
+		found += request.headers.has(Token::Connection);
+		found += request.headers.has("accept-language");
+	}
+	VERIFY(found == 2 * count);
+	LOG("Header lookups per sec: %", 2 * count / stopper.stop());
+}
+
+void TestHTTP::serialize()
+{
+	csjp::HTTPResponse response(csjp::Str("<html>hello</html>"), "1.1");
+	response.headers.add("content-type", "text/html");
+	response.headers.add("cache-control", "max-age=60");
+
+	TESTSTEP("appendTo() appends what toString() gives");
+	csjp::String buffer("prefix");
+	response.appendTo(buffer);
+	csjp::String expected("prefix");
+	expected << response.toString();
+	VERIFY(buffer == expected);
+	VERIFY(response.toString() == "HTTP/1.1 200 OK\r\n"
+			"content-type: text/html\r\n"
+			"cache-control: max-age=60\r\n"
+			"content-length: 18\r\n\r\n<html>hello</html>");
+	VERIFY(response.toString().length <= response.serializedLength());
+
+	TESTSTEP("No body and no content-length for 304");
+	csjp::HTTPResponse notModified(
+			csjp::HTTPStatusCode::Enum::NotModified, "", "1.1");
+	VERIFY(notModified.toString() == "HTTP/1.1 304 Not Modified\r\n\r\n");
+
+	TESTSTEP("Serializing into a reused buffer does not allocate");
+	buffer.clear();
+	buffer.extendCapacity(4096);
+	NOALLOC_VERIFY(
+		for(unsigned i = 0; i < 10; i++){
+			buffer.chopFront(buffer.length);
+			response.appendTo(buffer);
+		}
+	);
+
+	TESTSTEP("Serializations per sec");
+	const unsigned count = 200000;
+	size_t bytes = 0;
+	csjp::Stopper stopper;
+	for(unsigned i = 0; i < count; i++)
+		bytes += response.toString().length;
+	double toString = count / stopper.stop();
+	stopper.restart();
+	for(unsigned i = 0; i < count; i++){
+		buffer.chopFront(buffer.length);
+		response.appendTo(buffer);
+		bytes += buffer.length;
+	}
+	double appendTo = count / stopper.stop();
+	VERIFY(bytes);
+	LOG("toString(): % per sec, appendTo(): % per sec", toString, appendTo);
+}
+
+void TestHTTP::responseCache()
+{
+	csjp::Signal pipeSignal(SIGPIPE, csjp::Signal::sigpipeHandler);
+	csjp::HTTPResponseCache cache;
+
+	TESTSTEP("Cached response gets an etag");
+	csjp::HTTPResponse index(csjp::Str("<html>index</html>"), "1.1");
+	index.headers.add("content-type", "text/html");
+	cache.add("/index.html", move_cast(index));
+	csjp::HTTPResponse logo(csjp::Str("logo"), "1.1");
+	logo.headers.add("ETag", "\"v1\"");
+	cache.add("/logo", move_cast(logo));
+	VERIFY(cache.size() == 2);
+	VERIFY(cache.etag("/logo") == "\"v1\"");
+	csjp::String etag(cache.etag("/index.html"));
+	VERIFY(etag.length && etag[0] == '"');
+
+	TESTSTEP("Only GET of the cached routes are answered");
+	csjp::HTTPRequest request;
+	csjp::String buffer;
+	VERIFY(request.parse("GET /index.html?lang=en HTTP/1.1\r\n\r\n"));
+	VERIFY(cache.appendTo(request, buffer));
+	csjp::HTTPResponse response;
+	VERIFY(response.parse(buffer) == buffer.length);
+	VERIFY(response.body == "<html>index</html>");
+	VERIFY(response.headers["etag"] == etag);
+	request.clear();
+	VERIFY(request.parse("POST /index.html HTTP/1.1\r\n\r\n"));
+	VERIFY(!cache.appendTo(request, buffer));
+	request.clear();
+	VERIFY(request.parse("GET /other HTTP/1.1\r\n\r\n"));
+	VERIFY(!cache.appendTo(request, buffer));
+
+	TESTSTEP("Matching if-none-match gets 304 Not Modified");
+	request.clear();
+	VERIFY(request.parse("GET /logo HTTP/1.1\r\n"
+				"if-none-match: \"v0\", W/\"v1\"\r\n\r\n"));
+	buffer.clear();
+	VERIFY(cache.appendTo(request, buffer));
+	response.clear();
+	VERIFY(response.parse(buffer) == buffer.length);
+	VERIFY(response.status() == csjp::HTTPStatusCode::Enum::NotModified);
+	VERIFY(response.headers["etag"] == "\"v1\"");
+	VERIFY(response.body.length == 0);
+
+	TESTSTEP("Replaced and removed routes");
+	cache.add("/logo", csjp::HTTPResponse(csjp::Str("new logo"), "1.1"));
+	VERIFY(cache.size() == 2);
+	VERIFY(cache.etag("/logo") != "\"v1\"");
+	cache.remove("/logo");
+	VERIFY(!cache.has("/logo"));
+	cache.add("/logo", csjp::HTTPResponse(csjp::Str("logo"), "1.1"));
+
+	TESTSTEP("Connection answers from the cache, the rest by respond()");
+	EchoService service(&cache);
+	BlockingClient client(servicePort);
+	client.send("GET /index.html HTTP/1.1\r\n\r\n"
+			"GET /echo HTTP/1.1\r\n\r\n");
+	VERIFY(client.next().body == "<html>index</html>");
+	VERIFY(client.next().body == "/echo");
+	csjp::String conditional("GET /index.html HTTP/1.1\r\nif-none-match: ");
+	conditional << etag << "\r\n\r\n";
+	client.send(conditional);
+	VERIFY(client.next().status() ==
+			csjp::HTTPStatusCode::Enum::NotModified);
+
+	TESTSTEP("Cached versus formatted responses per sec");
+	const unsigned count = 2000;
+	const unsigned depth = 16;
+	csjp::String cached, formatted;
+	for(unsigned i = 0; i < depth; i++){
+		cached << "GET /index.html HTTP/1.1\r\nhost: localhost\r\n\r\n";
+		formatted << "GET /formatted HTTP/1.1\r\nhost: localhost\r\n\r\n";
+	}
+	csjp::Stopper stopper;
+	for(unsigned i = 0; i < count / depth; i++){
+		client.send(formatted);
+		for(unsigned j = 0; j < depth; j++)
+			VERIFY(client.next().body == "/formatted");
+	}
+	double formattedRate = count / depth * depth / stopper.stop();
+	stopper.restart();
+	for(unsigned i = 0; i < count / depth; i++){
+		client.send(cached);
+		for(unsigned j = 0; j < depth; j++)
+			VERIFY(client.next().body == "<html>index</html>");
+	}
+	double cachedRate = count / depth * depth / stopper.stop();
+	LOG("Pipelined by %: formatted % and cached % requests per sec",
+			depth, formattedRate, cachedRate);
+}
+
 TEST_INIT(HTTP)
 
 	TEST_RUN(create);
 	TEST_RUN(requestResponseOverSocket);
 	TEST_RUN(multiLineHeaders);
+	TEST_RUN(parseWithoutAllocation);
+	TEST_RUN(chunked);
+	TEST_RUN(pipelining);
+	TEST_RUN(persistentConnection);
+	TEST_RUN(loadBenchmark);
+	TEST_RUN(incrementalParse);
+	TEST_RUN(headerMap);
+	TEST_RUN(serialize);
+	TEST_RUN(responseCache);
 
 TEST_FINISH(HTTP)
 
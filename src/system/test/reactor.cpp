@@ -0,0 +1,286 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <csjp_test.h>
+#include <csjp_signal.h>
+#include <csjp_server.h>
+#include <csjp_reactor.h>
+#include <csjp_owner_container.h>
+
+class EchoServer : public csjp::Server
+{
+public:
+	explicit EchoServer(int fd) : csjp::Server(fd) {}
+	virtual ~EchoServer() {}
+
+	virtual void dataReceived()
+	{
+		send(received());
+		release(bytesAvailable);
+	}
+};
+
+bool operator<(const EchoServer & lhs, const EchoServer & rhs)
+{
+	return &lhs < &rhs;
+}
+
+bool operator<(const csjp::Socket & lhs, const EchoServer & rhs)
+{
+	return &lhs < &rhs;
+}
+
+bool operator<(const EchoServer & lhs, const csjp::Socket & rhs)
+{
+	return &lhs < &rhs;
+}
+
+class EchoReactor : public csjp::Reactor
+{
+public:
+	EchoReactor() : wakeups(0) {}
+	virtual ~EchoReactor() {}
+
+	unsigned wakeups;
+
+protected:
+	virtual void serve(int fd)
+	{
+		EchoServer * server = new EchoServer(fd);
+		add(*server);
+		servers.add(server);
+	}
+
+	virtual void controlled(ControlEvent & event)
+	{
+		if(event.code == ControlEventCode::Exception)
+			EXCEPTION(event.exception);
+		if(!servers.has(event.socket))
+			return;
+		servers.remove(event.socket);
+		disconnected();
+	}
+
+	virtual void wokenUp()
+	{
+		__atomic_add_fetch(&wakeups, 1, __ATOMIC_SEQ_CST);
+	}
+
+private:
+	csjp::OwnerContainer<EchoServer> servers;
+};
+
+/* Tells whether the fd was still open when the connection for it failed. */
+class CheckingReactor : public EchoReactor
+{
+public:
+	CheckingReactor() : openAfterFailure(-1) {}
+	virtual ~CheckingReactor() {}
+
+	int openAfterFailure;
+
+protected:
+	virtual void serve(int fd)
+	{
+		try {
+			EchoReactor::serve(fd);
+		} catch(...) {
+			__atomic_store_n(&openAfterFailure, 0 <= fcntl(fd, F_GETFD),
+					__ATOMIC_SEQ_CST);
+			throw;
+		}
+	}
+};
+
+class TestReactor
+{
+public:
+	void wakeup();
+	void failedServe();
+	void reusePort();
+	void roundRobin();
+	void leastLoaded();
+};
+
+static int connectTo(unsigned port)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	bzero(&addr, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	VERIFY(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+	return fd;
+}
+
+static void verifyEcho(int fd, const char * msg)
+{
+	size_t length = strlen(msg);
+	VERIFY(write(fd, msg, length) == (ssize_t)length);
+	char buffer[64];
+	size_t got = 0;
+	while(got < length){
+		ssize_t n = read(fd, buffer + got, sizeof(buffer) - got);
+		VERIFY(0 < n);
+		got += n;
+	}
+	VERIFY(csjp::Str(buffer, got) == msg);
+}
+
+static void waitForLoad(csjp::ReactorPool & pool, unsigned load)
+{
+	for(unsigned i = 0; i < 1000; i++){
+		unsigned sum = 0;
+		for(size_t r = 0; r < pool.size(); r++)
+			sum += pool[r].load();
+		if(sum == load)
+			return;
+		usleep(1000);
+	}
+	VERIFY(false);
+}
+
+void TestReactor::wakeup()
+{
+	csjp::ReactorPool pool;
+	EchoReactor * reactor = new EchoReactor();
+	pool.add(reactor);
+
+	TESTSTEP("Reactor is woken up from another thread");
+	pool.start(true);
+	VERIFY(reactor->getCpu() == 0);
+	reactor->wakeup();
+	for(unsigned i = 0; i < 1000 && !__atomic_load_n(&reactor->wakeups,
+				__ATOMIC_SEQ_CST); i++)
+		usleep(1000);
+	VERIFY(reactor->wakeups);
+
+	TESTSTEP("Stopping the pool stops the reactor threads");
+	pool.stop();
+}
+
+void TestReactor::failedServe()
+{
+	csjp::ReactorPool pool;
+	CheckingReactor * reactor = new CheckingReactor();
+	pool.add(reactor);
+	pool.start();
+
+	TESTSTEP("Fd of a failed serve() is closed by the reactor only");
+	int fd = socket(AF_INET, SOCK_STREAM, 0); // not connected
+	VERIFY(0 <= fd);
+	reactor->handOver(fd);
+	for(unsigned i = 0; i < 1000 && __atomic_load_n(
+				&reactor->openAfterFailure, __ATOMIC_SEQ_CST) < 0; i++)
+		usleep(1000);
+	VERIFY(reactor->openAfterFailure == 1);
+	for(unsigned i = 0; i < 1000 && 0 <= fcntl(fd, F_GETFD); i++)
+		usleep(1000);
+	VERIFY(fcntl(fd, F_GETFD) < 0);
+	VERIFY(reactor->load() == 0);
+
+	pool.stop();
+}
+
+void TestReactor::reusePort()
+{
+	csjp::Signal pipeSignal(SIGPIPE, csjp::Signal::sigpipeHandler);
+	csjp::ReactorPool pool;
+	for(unsigned i = 0; i < 4; i++)
+		pool.add(new EchoReactor());
+
+	TESTSTEP("Every reactor listens on the same port");
+	pool.listen("127.0.0.1", 30505);
+	pool.start();
+
+	TESTSTEP("The connections are served by the reactors");
+	int fds[16];
+	for(unsigned i = 0; i < 16; i++)
+		fds[i] = connectTo(30505);
+	for(unsigned i = 0; i < 16; i++)
+		verifyEcho(fds[i], "hello reactor");
+	waitForLoad(pool, 16);
+
+	TESTSTEP("Closed connections are released");
+	for(unsigned i = 0; i < 16; i++)
+		close(fds[i]);
+	waitForLoad(pool, 0);
+}
+
+void TestReactor::roundRobin()
+{
+	csjp::Signal pipeSignal(SIGPIPE, csjp::Signal::sigpipeHandler);
+	csjp::ReactorPool pool;
+	for(unsigned i = 0; i < 4; i++)
+		pool.add(new EchoReactor());
+
+	TESTSTEP("Accept thread hands the connections out one by one");
+	pool.listen("127.0.0.1", 30505, csjp::ReactorPool::Balance::RoundRobin);
+	pool.start();
+	int fds[8];
+	for(unsigned i = 0; i < 8; i++)
+		fds[i] = connectTo(30505);
+	for(unsigned i = 0; i < 8; i++)
+		verifyEcho(fds[i], "round robin");
+	waitForLoad(pool, 8);
+	for(size_t r = 0; r < pool.size(); r++)
+		VERIFY(pool[r].load() == 2);
+
+	for(unsigned i = 0; i < 8; i++)
+		close(fds[i]);
+	waitForLoad(pool, 0);
+}
+
+void TestReactor::leastLoaded()
+{
+	csjp::Signal pipeSignal(SIGPIPE, csjp::Signal::sigpipeHandler);
+	csjp::ReactorPool pool;
+	for(unsigned i = 0; i < 2; i++)
+		pool.add(new EchoReactor());
+	pool.listen("127.0.0.1", 30505, csjp::ReactorPool::Balance::LeastLoaded);
+	pool.start();
+
+	TESTSTEP("Connections go to the least loaded reactor");
+	int fds[4];
+	for(unsigned i = 0; i < 4; i++){
+		fds[i] = connectTo(30505);
+		verifyEcho(fds[i], "least loaded");
+	}
+	waitForLoad(pool, 4);
+	VERIFY(pool[0].load() == 2);
+	VERIFY(pool[1].load() == 2);
+
+	TESTSTEP("The reactor with closed connections gets the new ones");
+	close(fds[0]);
+	close(fds[2]);
+	waitForLoad(pool, 2);
+	VERIFY(pool[0].load() == 0);
+	fds[0] = connectTo(30505);
+	fds[2] = connectTo(30505);
+	verifyEcho(fds[0], "least loaded");
+	verifyEcho(fds[2], "least loaded");
+	waitForLoad(pool, 4);
+	VERIFY(pool[0].load() == 2);
+
+	for(unsigned i = 0; i < 4; i++)
+		close(fds[i]);
+}
+
+TEST_INIT(Reactor)
+
+	TEST_RUN(wakeup);
+	TEST_RUN(failedServe);
+	TEST_RUN(reusePort);
+	TEST_RUN(roundRobin);
+	TEST_RUN(leastLoaded);
+
+TEST_FINISH(Reactor)
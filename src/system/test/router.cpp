@@ -0,0 +1,338 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <csjp_test.h>
+#include <csjp_signal.h>
+#include <csjp_stopper.h>
+#include <csjp_router.h>
+
+TEST_COUNT_ALLOCATIONS
+
+static const unsigned port = 30507;
+
+/* Answers with its name and the parameters of the match. */
+class NamedHandler : public csjp::RouteHandler
+{
+public:
+	explicit NamedHandler(const char * name) : name(name), calls(0) {}
+	virtual ~NamedHandler() {}
+
+	virtual void handle(csjp::HTTPRequest & request,
+			const csjp::RouteMatch & match,
+			csjp::HTTPResponseWriter & writer)
+	{
+		(void)request;
+		__atomic_add_fetch(&calls, 1, __ATOMIC_RELAXED);
+		csjp::String body(name);
+		for(unsigned i = 0; i < match.size(); i++)
+			body << " " << match.name(i) << "=" << match.value(i);
+		writer.write(csjp::HTTPStatusCode::Enum::OK, body, "text/plain");
+	}
+
+	const char * name;
+	unsigned calls;
+};
+
+class TestRouter
+{
+public:
+	void staticRoutes();
+	void parameters();
+	void methods();
+	void invalidPatterns();
+	void reactor();
+	void benchmark();
+};
+
+/* Name of the handler the path resolves to, or the failure. */
+static csjp::String resolve(const csjp::Router & router, const char * method,
+		const char * uri, csjp::RouteMatch & match)
+{
+	router.resolve(method, uri, match);
+	switch(match.result){
+	case csjp::RouteMatch::Result::Found :
+		return csjp::String(((NamedHandler *)match.handler)->name);
+	case csjp::RouteMatch::Result::NotFound :
+		return csjp::String("404");
+	case csjp::RouteMatch::Result::MethodNotAllowed :
+		return csjp::String("405");
+	}
+	return csjp::String();
+}
+
+void TestRouter::staticRoutes()
+{
+	csjp::Router router;
+	NamedHandler root("root"), users("users"), user("user"),
+			usage("usage"), api("api");
+	router.add("GET", "/", root);
+	router.add("GET", "/users", users);
+	router.add("GET", "/user", user);
+	router.add("GET", "/usage", usage);
+	router.add("GET", "/api/v1/usage", api);
+	csjp::RouteMatch match;
+
+	TESTSTEP("Static paths sharing prefixes");
+	VERIFY(router.size() == 5);
+	VERIFY(resolve(router, "GET", "/", match) == "root");
+	VERIFY(resolve(router, "GET", "/users", match) == "users");
+	VERIFY(resolve(router, "GET", "/user", match) == "user");
+	VERIFY(resolve(router, "GET", "/usage", match) == "usage");
+	VERIFY(resolve(router, "GET", "/api/v1/usage", match) == "api");
+	VERIFY(match.size() == 0);
+
+	TESTSTEP("Prefixes of routes and longer paths are not found");
+	VERIFY(resolve(router, "GET", "/us", match) == "404");
+	VERIFY(resolve(router, "GET", "/users/", match) == "404");
+	VERIFY(resolve(router, "GET", "/api/v1", match) == "404");
+	VERIFY(resolve(router, "GET", "", match) == "404");
+
+	TESTSTEP("The query is ignored");
+	VERIFY(resolve(router, "GET", "/users?page=2", match) == "users");
+}
+
+void TestRouter::parameters()
+{
+	csjp::Router router;
+	NamedHandler user("user"), post("post"), me("me"), files("files"),
+			settings("settings");
+	router.add("GET", "/users/:id", user);
+	router.add("GET", "/users/:id/posts/:post", post);
+	router.add("GET", "/users/me", me);
+	router.add("GET", "/files/*path", files);
+	router.add("GET", "/users/:id/settings", settings);
+	csjp::RouteMatch match;
+
+	TESTSTEP("Parameters match a segment");
+	VERIFY(resolve(router, "GET", "/users/42", match) == "user");
+	VERIFY(match.size() == 1);
+	VERIFY(match["id"] == "42");
+	VERIFY(resolve(router, "GET", "/users/42/posts/7?x=1", match) == "post");
+	VERIFY(match.size() == 2);
+	VERIFY(match.name(0) == "id");
+	VERIFY(match["id"] == "42");
+	VERIFY(match["post"] == "7");
+	VERIFY(match["missing"].length == 0);
+	VERIFY(resolve(router, "GET", "/users/", match) == "404");
+
+	TESTSTEP("Static segment wins, backtracking to the parameter");
+	VERIFY(resolve(router, "GET", "/users/me", match) == "me");
+	VERIFY(match.size() == 0);
+	VERIFY(resolve(router, "GET", "/users/me/settings", match) ==
+			"settings");
+	VERIFY(match["id"] == "me");
+	VERIFY(resolve(router, "GET", "/users/mea", match) == "user");
+	VERIFY(match["id"] == "mea");
+
+	TESTSTEP("Catch-all matches the rest");
+	VERIFY(resolve(router, "GET", "/files/css/site.css", match) == "files");
+	VERIFY(match["path"] == "css/site.css");
+	VERIFY(resolve(router, "GET", "/files/", match) == "files");
+	VERIFY(match["path"].length == 0);
+
+	TESTSTEP("Resolving does not allocate");
+	NOALLOC_VERIFY(router.resolve("GET", "/users/42/posts/7", match));
+	VERIFY(match["post"] == "7");
+}
+
+void TestRouter::methods()
+{
+	csjp::Router router;
+	NamedHandler get("get"), post("post"), any("any");
+	router.add("GET", "/items/:id", get);
+	router.add("POST", "/items/:id", post);
+	router.add("*", "/anything", any);
+	csjp::RouteMatch match;
+
+	TESTSTEP("Handlers per method");
+	VERIFY(resolve(router, "GET", "/items/1", match) == "get");
+	VERIFY(resolve(router, "POST", "/items/1", match) == "post");
+	VERIFY(resolve(router, "DELETE", "/items/1", match) == "405");
+	VERIFY(resolve(router, "get", "/items/1", match) == "405");
+	VERIFY(match.allowed() == "GET, POST");
+
+	TESTSTEP("Any method");
+	VERIFY(resolve(router, "PATCH", "/anything", match) == "any");
+	VERIFY(resolve(router, "BREW", "/anything", match) == "any");
+	VERIFY(router.size() == 2);
+}
+
+void TestRouter::invalidPatterns()
+{
+	csjp::Router router;
+	NamedHandler handler("handler");
+	router.add("GET", "/a/:id", handler);
+
+	TESTSTEP("Malformed patterns and conflicts are rejected");
+	EXC_VERIFY(router.add("GET", "no/slash", handler), csjp::InvalidArgument);
+	EXC_VERIFY(router.add("GET", "/a:b", handler), csjp::InvalidArgument);
+	EXC_VERIFY(router.add("GET", "/a/:", handler), csjp::InvalidArgument);
+	EXC_VERIFY(router.add("GET", "/a/*rest/b", handler),
+			csjp::InvalidArgument);
+	EXC_VERIFY(router.add("GET", "/a/:name", handler), csjp::InvalidArgument);
+	EXC_VERIFY(router.add("GET", "/a/:id", handler), csjp::InvalidArgument);
+	EXC_VERIFY(router.add("BREW", "/b", handler), csjp::InvalidArgument);
+	VERIFY(router.size() == 1);
+}
+
+static int connectTo(unsigned port)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	bzero(&addr, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	VERIFY(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+	return fd;
+}
+
+/* The next response on the connection, data after it is kept. */
+static csjp::HTTPResponse & next(int fd, csjp::String & data,
+		csjp::HTTPResponse & response)
+{
+	response.clear();
+	while(true){
+		unsigned processed = response.parse(data);
+		if(processed){
+			response.headers.keep();
+			data.chopFront(processed);
+			return response;
+		}
+		char buffer[16*1024];
+		ssize_t got = ::read(fd, buffer, sizeof(buffer));
+		VERIFY(0 < got);
+		data.append(buffer, got);
+	}
+}
+
+void TestRouter::reactor()
+{
+	csjp::Signal pipeSignal(SIGPIPE, csjp::Signal::sigpipeHandler);
+	csjp::Router router;
+	NamedHandler user("user"), create("create");
+	router.add("GET", "/users/:id", user);
+	router.add("POST", "/users", create);
+	csjp::ReactorPool pool;
+	pool.add(new csjp::RoutingReactor(router));
+	pool.listen("127.0.0.1", port);
+	pool.start();
+
+	TESTSTEP("Routed requests on a reactor connection");
+	int fd = connectTo(port);
+	csjp::Str requests(
+			"GET /users/42 HTTP/1.1\r\nhost: a\r\n\r\n"
+			"POST /users HTTP/1.1\r\ncontent-length: 2\r\n\r\n{}"
+			"GET /nowhere HTTP/1.1\r\n\r\n"
+			"DELETE /users HTTP/1.1\r\n\r\n"
+			"GET /users/7 HTTP/1.0\r\n\r\n");
+	VERIFY(write(fd, requests.c_str(), requests.length) ==
+			(ssize_t)requests.length);
+	csjp::String data;
+	csjp::HTTPResponse response;
+	VERIFY(next(fd, data, response).body == "user id=42");
+	VERIFY(response.headers["content-type"] == "text/plain");
+	VERIFY(next(fd, data, response).body == "create");
+	VERIFY(next(fd, data, response).status() ==
+			csjp::HTTPStatusCode::Enum::NotFound);
+	VERIFY(next(fd, data, response).status() ==
+			csjp::HTTPStatusCode::Enum::MethodNotAllowed);
+	VERIFY(response.headers["allow"] == "POST");
+	VERIFY(next(fd, data, response).body == "user id=7");
+	VERIFY(!response.keepAlive());
+	char c;
+	VERIFY(read(fd, &c, 1) == 0);
+	close(fd);
+	VERIFY(user.calls == 2);
+
+	pool.stop();
+}
+
+void TestRouter::benchmark()
+{
+	const unsigned routeCount = 1000;
+	csjp::Router router;
+	NamedHandler handler("handler");
+	csjp::Array<csjp::String> uris;
+
+	TESTSTEP("Table of % routes", routeCount);
+	/* REST like routes of 100 resources, 10 kinds of routes each. */
+	for(unsigned r = 0; r < routeCount / 10; r++){
+		csjp::String base("/api/v2/resource");
+		base << r;
+		const char * suffixes[] = { "", "/:id", "/:id/edit", "/:id/items",
+			"/:id/items/:item", "/search", "/stats", "/export/*format",
+			"/:id/owner", "/:id/history" };
+		for(unsigned s = 0; s < 10; s++){
+			csjp::String pattern(base);
+			pattern << suffixes[s];
+			router.add("GET", pattern, handler);
+		}
+		csjp::String uri(base);
+		uri << "/" << r * 7 << "/items/" << r;
+		uris.add(uri);
+		uri = base;
+		uri << "/stats";
+		uris.add(uri);
+	}
+	VERIFY(router.size() == routeCount);
+
+	csjp::RouteMatch match;
+	for(auto & uri : uris){
+		router.resolve("GET", uri, match);
+		VERIFY(match.result == csjp::RouteMatch::Result::Found);
+	}
+
+	TESTSTEP("Lookups per sec");
+	const unsigned rounds = 1000;
+	unsigned found = 0;
+	csjp::Stopper stopper;
+	for(unsigned i = 0; i < rounds; i++)
+		for(auto & uri : uris){
+			router.resolve("GET", uri, match);
+			found += match.size();
+		}
+	double sec = stopper.stop();
+	VERIFY(found == rounds * uris.length);
+	LOG("Resolved % lookups per sec over % routes",
+			rounds * uris.length / sec, routeCount);
+
+	TESTSTEP("Linear string comparison for reference");
+	csjp::Array<csjp::String> paths;
+	for(unsigned r = 0; r < routeCount; r++){
+		csjp::String path("/api/v2/resource");
+		path << r / 10 << "/stats" << r % 10;
+		paths.add(path);
+	}
+	csjp::String last(paths[routeCount - 1]);
+	found = 0;
+	stopper.restart();
+	for(unsigned i = 0; i < rounds; i++)
+		for(unsigned u = 0; u < uris.length; u++)
+			for(auto & path : paths)
+				if(path == last){
+					found++;
+					break;
+				}
+	sec = stopper.stop();
+	VERIFY(found == rounds * uris.length);
+	LOG("Linear scan: % lookups per sec", rounds * uris.length / sec);
+}
+
+TEST_INIT(Router)
+
+	TEST_RUN(staticRoutes);
+	TEST_RUN(parameters);
+	TEST_RUN(methods);
+	TEST_RUN(invalidPatterns);
+	TEST_RUN(reactor);
+	TEST_RUN(benchmark);
+
+TEST_FINISH(Router)
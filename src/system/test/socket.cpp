@@ -3,6 +3,14 @@
  * Copyright (C) 2016 Csaszar, Peter
  */
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <stdlib.h>
+
 #include <csjp_socket.h>
 #include <csjp_test.h>
 
@@ -10,6 +18,7 @@ class SocketChild : public csjp::Socket
 {
 public:
 	SocketChild() : Socket() {}
+	explicit SocketChild(int fd) : Socket() { file = fd; }
 	virtual ~SocketChild() {}
 };
 
@@ -17,6 +26,12 @@ class TestSocket
 {
 public:
 	void create();
+	void receiveInPlace();
+	void receiveMuch();
+	void sendQueue();
+	void sendFile();
+	void closeOnSent();
+	void zeroCopy();
 };
 
 void TestSocket::create()
@@ -25,8 +40,240 @@ void TestSocket::create()
 	// and  just destruct ...
 }
 
+/* The socket gets one end, the other one is returned for the test. */
+static int socketPair(int & peer)
+{
+	int fds[2];
+	if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+		throw csjp::SocketError(errno, "Failed to create socket pair.");
+	fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+	peer = fds[1];
+	return fds[0];
+}
+
+void TestSocket::receiveInPlace()
+{
+	int peer;
+	SocketChild socket(socketPair(peer));
+
+	TESTSTEP("Received data is available as a view of the read buffer");
+	VERIFY(write(peer, "hello world", 11) == 11);
+	VERIFY(!socket.readToBuffer());
+	VERIFY(socket.bytesAvailable == 11);
+	csjp::Str data = socket.received();
+	VERIFY(data == "hello world");
+	VERIFY(socket.peek(5) == "hello");
+	VERIFY(socket.peek(5).c_str() == data.c_str());
+
+	TESTSTEP("Released bytes are not available anymore");
+	socket.release(6);
+	VERIFY(socket.bytesAvailable == 5);
+	VERIFY(socket.received() == "world");
+	VERIFY(socket.received().c_str() == data.c_str() + 6);
+	EXC_VERIFY(socket.release(6), csjp::InvalidArgument);
+
+	TESTSTEP("New data is read after the not yet released bytes");
+	VERIFY(write(peer, "!", 1) == 1);
+	socket.readToBuffer();
+	VERIFY(socket.received() == "world!");
+	VERIFY(socket.receive(6) == "world!");
+	VERIFY(socket.bytesAvailable == 0);
+
+	TESTSTEP("Once everything is released the buffer is reused from its begining");
+	VERIFY(write(peer, "again", 5) == 5);
+	socket.readToBuffer();
+	VERIFY(socket.received() == "again");
+	VERIFY(socket.received().c_str() == data.c_str());
+
+	TESTSTEP("Not yet received bytes can not be peeked");
+	EXC_VERIFY(socket.peek(6), csjp::SocketError);
+
+	close(peer);
+}
+
+void TestSocket::receiveMuch()
+{
+	int peer;
+	SocketChild socket(socketPair(peer));
+
+	TESTSTEP("Partially released data survives the growing of the buffer");
+	csjp::String sent;
+	csjp::String got;
+	char chunk[1000];
+	for(unsigned i = 0; i < 1000; i++){
+		for(unsigned j = 0; j < sizeof(chunk); j++)
+			chunk[j] = 'a' + (i + j) % 26;
+		VERIFY(write(peer, chunk, sizeof(chunk)) == sizeof(chunk));
+		sent.append(chunk, sizeof(chunk));
+		socket.readToBuffer();
+		/* Keep back some of the bytes to force compaction and growth */
+		size_t length = socket.bytesAvailable - (i % 7) * 100;
+		got << socket.peek(length);
+		socket.release(length);
+	}
+	got << socket.received();
+	VERIFY(got == sent);
+	VERIFY(socket.totalBytesReceived == sent.length);
+
+	close(peer);
+}
+
+/* Reads everything available on the fd. */
+static csjp::String drain(int fd)
+{
+	csjp::String data;
+	char buffer[64*1024];
+	ssize_t n;
+	while(0 < (n = read(fd, buffer, sizeof(buffer))))
+		data.append(buffer, n);
+	return data;
+}
+
+void TestSocket::sendQueue()
+{
+	int peer;
+	SocketChild socket(socketPair(peer));
+
+	TESTSTEP("Owned and borrowed data is sent in order");
+	VERIFY(socket.send("owned "));
+	VERIFY(socket.sendBorrowed("borrowed"));
+	VERIFY(socket.bytesToSend == 0);
+	VERIFY(drain(peer) == "owned borrowed");
+	VERIFY(socket.totalBytesSent == 14);
+
+	TESTSTEP("Data is queued when the peer does not read");
+	csjp::String big;
+	for(unsigned i = 0; i < 64*1024; i++)
+		big << (char)('a' + i % 26);
+	csjp::String expected;
+	unsigned sends = 0;
+	while(socket.sendBorrowed(big)){
+		expected << big;
+		sends++;
+		VERIFY(sends < 1000);
+	}
+	expected << big;
+	VERIFY(0 < socket.bytesToSend);
+	VERIFY(!socket.send("1"));
+	VERIFY(!socket.send("2"));
+	VERIFY(!socket.sendBorrowed("3"));
+	expected << "123";
+
+	TESTSTEP("The queue is flushed after EAGAIN as the peer reads");
+	csjp::String got;
+	while(socket.bytesToSend){
+		got << drain(peer);
+		socket.writeFromBuffer();
+	}
+	got << drain(peer);
+	VERIFY(got.length == expected.length);
+	VERIFY(got == expected);
+
+	close(peer);
+}
+
+void TestSocket::sendFile()
+{
+	int peer;
+	SocketChild socket(socketPair(peer));
+
+	char name[] = "/tmp/csjp-socket-test-XXXXXX";
+	int fd = mkstemp(name);
+	VERIFY(0 <= fd);
+	unlink(name);
+	VERIFY(write(fd, "0123456789", 10) == 10);
+
+	TESTSTEP("Part of a file is sent between other data");
+	VERIFY(socket.send("<"));
+	VERIFY(socket.sendFile(fd, 2, 5));
+	VERIFY(socket.send(">"));
+	VERIFY(drain(peer) == "<23456>");
+
+	TESTSTEP("Sending more than the file has fails");
+	EXC_VERIFY(socket.sendFile(fd, 8, 5), csjp::SocketError);
+
+	close(fd);
+	close(peer);
+}
+
+void TestSocket::closeOnSent()
+{
+	int peer;
+	SocketChild socket(socketPair(peer));
+
+	TESTSTEP("Socket closes when all the queued data is sent");
+	socket.closeOnSent = true;
+	VERIFY(socket.sendBorrowed("last words"));
+	VERIFY(socket.fd() == -1);
+	VERIFY(drain(peer) == "last words");
+	EXC_VERIFY(socket.send("more"), csjp::SocketClosed);
+
+	close(peer);
+}
+
+void TestSocket::zeroCopy()
+{
+	TESTSTEP("Connecting on loopback");
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	bzero(&addr, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	VERIFY(bind(listener, (struct sockaddr *)&addr, len) == 0);
+	VERIFY(listen(listener, 1) == 0);
+	VERIFY(getsockname(listener, (struct sockaddr *)&addr, &len) == 0);
+	int peer = socket(AF_INET, SOCK_STREAM, 0);
+	VERIFY(connect(peer, (struct sockaddr *)&addr, len) == 0);
+	int fd = accept(listener, NULL, NULL);
+	VERIFY(0 <= fd);
+	close(listener);
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	fcntl(peer, F_SETFL, fcntl(peer, F_GETFL) | O_NONBLOCK);
+	SocketChild socket(fd);
+
+	if(!socket.enableZeroCopy(1024)){
+		LOG("MSG_ZEROCOPY is not supported, skipping.");
+		close(peer);
+		return;
+	}
+
+	TESTSTEP("Big borrowed data is sent without copy");
+	csjp::String big;
+	for(unsigned i = 0; i < 256*1024; i++)
+		big << (char)('a' + i % 26);
+	socket.sendBorrowed("small");
+	socket.sendBorrowed(big);
+	csjp::String got;
+	while(got.length < big.length + 5){
+		struct pollfd pfd = { peer, POLLIN, 0 };
+		poll(&pfd, 1, 100);
+		got << drain(peer);
+		socket.writeFromBuffer();
+	}
+	VERIFY(got.read(5, got.length) == big);
+
+	TESTSTEP("Completions arrive on the error queue");
+	VERIFY(0 < socket.zeroCopyPending());
+	for(unsigned i = 0; i < 100 && socket.zeroCopyPending(); i++){
+		struct pollfd pfd = { socket.fd(), 0, 0 };
+		poll(&pfd, 1, 10);
+		socket.readZeroCopyCompletions();
+	}
+	VERIFY(socket.zeroCopyPending() == 0);
+
+	close(peer);
+}
+
 TEST_INIT(Socket)
 
 	TEST_RUN(create);
+	TEST_RUN(receiveInPlace);
+	TEST_RUN(receiveMuch);
+	TEST_RUN(sendQueue);
+	TEST_RUN(sendFile);
+	TEST_RUN(closeOnSent);
+	TEST_RUN(zeroCopy);
 
 TEST_FINISH(Socket)
@@ -0,0 +1,265 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#include <stdlib.h>
+
+#include <csjp_test.h>
+#include <csjp_stopper.h>
+#include <csjp_pod_array.h>
+#include <csjp_timer.h>
+
+class TestTimer : public csjp::Timer
+{
+public:
+	TestTimer() : fired(0), firedAt(0), now(NULL) {}
+	virtual ~TestTimer() {}
+
+	unsigned fired;
+	uint64_t firedAt;
+	const uint64_t * now;
+
+protected:
+	virtual void expired()
+	{
+		fired++;
+		if(now)
+			firedAt = *now;
+	}
+};
+
+/* Cancels an other timer of the same slot when expiring. */
+class CancellingTimer : public csjp::Timer
+{
+public:
+	explicit CancellingTimer(csjp::Timer & other) : other(other), fired(0) {}
+	virtual ~CancellingTimer() {}
+
+	csjp::Timer & other;
+	unsigned fired;
+
+protected:
+	virtual void expired()
+	{
+		fired++;
+		other.cancel();
+	}
+};
+
+class TestTimerWheel
+{
+public:
+	void armAndCancel();
+	void order();
+	void cascade();
+	void timeout();
+	void periodic();
+	void cancelWhileExpiring();
+	void speed();
+};
+
+void TestTimerWheel::armAndCancel()
+{
+	csjp::TimerWheel wheel(1000, 1);
+	TestTimer timer;
+
+	TESTSTEP("Armed timer expires on time");
+	wheel.arm(timer, 10, 1000);
+	VERIFY(timer.armed());
+	VERIFY(wheel.size() == 1);
+	VERIFY(wheel.advance(1009) == 0);
+	VERIFY(wheel.advance(1010) == 1);
+	VERIFY(timer.fired == 1);
+	VERIFY(!timer.armed());
+	VERIFY(wheel.size() == 0);
+
+	TESTSTEP("Cancelled timer does not expire");
+	wheel.arm(timer, 10, 1010);
+	timer.cancel();
+	VERIFY(!timer.armed());
+	VERIFY(wheel.size() == 0);
+	VERIFY(wheel.advance(2000) == 0);
+	VERIFY(timer.fired == 1);
+
+	TESTSTEP("Rearming moves the deadline");
+	wheel.arm(timer, 10, 2000);
+	wheel.arm(timer, 100, 2005);
+	VERIFY(wheel.size() == 1);
+	VERIFY(wheel.advance(2100) == 0);
+	VERIFY(wheel.advance(2105) == 1);
+
+	TESTSTEP("Destroyed timer is cancelled");
+	{
+		TestTimer temp;
+		wheel.arm(temp, 10, 2105);
+		VERIFY(wheel.size() == 1);
+	}
+	VERIFY(wheel.size() == 0);
+	VERIFY(wheel.advance(3000) == 0);
+}
+
+void TestTimerWheel::order()
+{
+	const unsigned count = 1000;
+	uint64_t now = 0;
+	csjp::TimerWheel wheel(now, 1);
+	TestTimer timers[count];
+	unsigned delays[count];
+
+	TESTSTEP("Random timers expire exactly at their deadline");
+	srand(1);
+	for(unsigned i = 0; i < count; i++){
+		delays[i] = rand() % 300000; // up to 5 minutes
+		timers[i].now = &now;
+		wheel.arm(timers[i], delays[i], now);
+	}
+	VERIFY(wheel.size() == count);
+	while(wheel.size()){
+		now += 1 + rand() % 50;
+		wheel.advance(now);
+	}
+	/* Expired at the first advance reaching the deadline. */
+	for(unsigned i = 0; i < count; i++){
+		VERIFY(timers[i].fired == 1);
+		VERIFY(delays[i] <= timers[i].firedAt);
+		VERIFY(timers[i].firedAt < delays[i] + 51 || delays[i] == 0);
+	}
+}
+
+void TestTimerWheel::cascade()
+{
+	uint64_t now = 5;
+	csjp::TimerWheel wheel(now, 1);
+	TestTimer near, far, farther, beyond;
+	near.now = far.now = farther.now = beyond.now = &now;
+
+	TESTSTEP("Timers of the upper levels come down and expire on time");
+	wheel.arm(near, 63, now);
+	wheel.arm(far, 64 * 64 + 7, now);
+	wheel.arm(farther, 64 * 64 * 64 * 3 + 11, now);
+	wheel.arm(beyond, 64 * 64 * 64 * 64 + 13, now); // over all the levels
+	for(now = 6; wheel.size(); now++)
+		wheel.advance(now);
+	VERIFY(near.firedAt == 5 + 63);
+	VERIFY(far.firedAt == 5 + 64 * 64 + 7);
+	VERIFY(farther.firedAt == 5 + 64 * 64 * 64 * 3 + 11);
+	VERIFY(beyond.firedAt == 5 + 64 * 64 * 64 * 64 + 13);
+
+	TESTSTEP("A single advance over a long time expires everything");
+	wheel.arm(near, 10, now);
+	wheel.arm(far, 100000, now);
+	wheel.arm(farther, 20000000, now);
+	VERIFY(wheel.advance(now + 30000000) == 3);
+}
+
+void TestTimerWheel::timeout()
+{
+	csjp::TimerWheel wheel(1000, 1);
+	TestTimer a, b;
+
+	TESTSTEP("No timer, no timeout");
+	VERIFY(wheel.timeout(1000) == -1);
+
+	TESTSTEP("Timeout until the nearest timer");
+	wheel.arm(a, 30, 1000);
+	wheel.arm(b, 10, 1000);
+	VERIFY(wheel.timeout(1000) == 10);
+	VERIFY(wheel.timeout(1004) == 6);
+	VERIFY(wheel.timeout(1020) == 0);
+	wheel.advance(1010);
+	/* The upper slot of the timer is distributed before it expires. */
+	int timeout = wheel.timeout(1010);
+	VERIFY(0 < timeout && timeout <= 20);
+	wheel.advance(1010 + timeout);
+	VERIFY(wheel.timeout(1010 + timeout) == 20 - timeout);
+
+	TESTSTEP("Far timer is a lower bound, the wheel wakes up in time");
+	a.cancel();
+	uint64_t now = 1010;
+	wheel.arm(a, 100000, now);
+	unsigned wakeups = 0;
+	while(wheel.size()){
+		int timeout = wheel.timeout(now);
+		VERIFY(0 < timeout);
+		now += timeout;
+		wheel.advance(now);
+		wakeups++;
+	}
+	VERIFY(now == 1010 + 100000);
+	LOG("Wakeups for a timer of 100 sec: %", wakeups);
+	VERIFY(wakeups < 200);
+}
+
+void TestTimerWheel::periodic()
+{
+	uint64_t now = 0;
+	csjp::TimerWheel wheel(now, 1);
+	TestTimer timer;
+
+	TESTSTEP("Periodic timer is rearmed with its period");
+	timer.period = 25;
+	wheel.arm(timer, 25, now);
+	for(now = 1; now <= 1000; now++)
+		wheel.advance(now);
+	VERIFY(timer.fired == 40);
+	VERIFY(timer.armed());
+
+	TESTSTEP("A late advance does not fire it repeatedly");
+	wheel.advance(5000);
+	VERIFY(timer.fired == 41);
+	timer.cancel();
+	VERIFY(!timer.armed());
+}
+
+void TestTimerWheel::cancelWhileExpiring()
+{
+	csjp::TimerWheel wheel(0, 1);
+	TestTimer victim;
+	CancellingTimer killer(victim);
+
+	TESTSTEP("Expiring timer cancels an other due at the same time");
+	wheel.arm(victim, 10, 0);
+	wheel.arm(killer, 10, 0);
+	VERIFY(wheel.advance(10) == 1);
+	VERIFY(victim.fired == 0);
+	VERIFY(killer.fired == 1);
+	VERIFY(!victim.armed());
+	VERIFY(wheel.size() == 0);
+}
+
+void TestTimerWheel::speed()
+{
+	const unsigned count = 100000;
+	csjp::TimerWheel wheel(0, 1);
+	csjp::PodArray<TestTimer *> timers;
+	for(unsigned i = 0; i < count; i++)
+		timers.add(new TestTimer());
+
+	TESTSTEP("Arming and cancelling is constant time");
+	csjp::Stopper stopper;
+	for(unsigned r = 0; r < 10; r++){
+		for(unsigned i = 0; i < count; i++)
+			wheel.arm(*timers[i], (i * 7919) % 600000, 0);
+		for(unsigned i = 0; i < count; i++)
+			timers[i]->cancel();
+	}
+	double sec = stopper.stop();
+	VERIFY(wheel.size() == 0);
+	LOG("Arm and cancel pairs per sec: %", 10 * count / sec);
+
+	for(unsigned i = 0; i < count; i++)
+		delete timers[i];
+}
+
+TEST_INIT(TimerWheel)
+
+	TEST_RUN(armAndCancel);
+	TEST_RUN(order);
+	TEST_RUN(cascade);
+	TEST_RUN(timeout);
+	TEST_RUN(periodic);
+	TEST_RUN(cancelWhileExpiring);
+	TEST_RUN(speed);
+
+TEST_FINISH(TimerWheel)
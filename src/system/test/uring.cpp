@@ -0,0 +1,272 @@
+/*
+ * Author: Csaszar, Peter <csjpeter@gmail.com>
+ * Copyright (C) 2020 Csaszar, Peter
+ */
+
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <csjp_test.h>
+#include <csjp_signal.h>
+#include <csjp_stopper.h>
+#include <csjp_server.h>
+#include <csjp_poller.h>
+#include <csjp_owner_container.h>
+
+static const unsigned port = 30506;
+static const size_t bulkSize = 4*1024*1024;
+static const size_t borrowedSize = 1024*1024;
+
+static csjp::String pattern(size_t length, unsigned seed)
+{
+	csjp::String data;
+	data.extendCapacity(length);
+	for(size_t i = 0; i < length; i++)
+		data.append((char)('a' + (i + seed) % 26));
+	return data;
+}
+
+static csjp::String borrowed = pattern(borrowedSize, 7);
+
+/* Echoes everything, but answers "bulk" with a lot of data and closes. */
+class EchoServer : public csjp::Server
+{
+public:
+	explicit EchoServer(const csjp::Listener & listener) :
+		csjp::Server(listener) {}
+	virtual ~EchoServer() {}
+
+	virtual void dataReceived()
+	{
+		if(received() == "bulk"){
+			release(bytesAvailable);
+			send(pattern(bulkSize, 0));
+			sendBorrowed(borrowed);
+			closeOnSent = true;
+			return;
+		}
+		send(received());
+		release(bytesAvailable);
+	}
+};
+
+bool operator<(const EchoServer & lhs, const EchoServer & rhs)
+{
+	return &lhs < &rhs;
+}
+
+bool operator<(const csjp::Socket & lhs, const EchoServer & rhs)
+{
+	return &lhs < &rhs;
+}
+
+bool operator<(const EchoServer & lhs, const csjp::Socket & rhs)
+{
+	return &lhs < &rhs;
+}
+
+/* Echo service running its poller in a thread of its own. */
+class EchoService : public csjp::Listener
+{
+public:
+	explicit EchoService(csjp::Poller::Backend backend) :
+		csjp::Listener("127.0.0.1", port, 128),
+		poller(backend),
+		stopped(false)
+	{
+		poller.add(*this);
+		if(pthread_create(&thread, NULL, run, this))
+			throw csjp::SystemError("Failed to create poller thread.");
+	}
+	virtual ~EchoService()
+	{
+		__atomic_store_n(&stopped, true, __ATOMIC_RELEASE);
+		pthread_join(thread, NULL);
+		servers.clear();
+		close();
+	}
+
+	virtual void dataReceived()
+	{
+		while(true){
+			EchoServer * server;
+			try {
+				server = new EchoServer(*this);
+			} catch(csjp::SocketNoneConnecting &) {
+				return;
+			}
+			poller.add(*server);
+			servers.add(server);
+		}
+	}
+
+	csjp::Poller poller;
+
+private:
+	static void * run(void * arg)
+	{
+		EchoService & service = *(EchoService *)arg;
+		while(!__atomic_load_n(&service.stopped, __ATOMIC_ACQUIRE))
+			for(auto & event : service.poller.waitAndControl(10)){
+				if(event.code == csjp::EPollControl::
+						ControlEventCode::Exception)
+					EXCEPTION(event.exception);
+				if(service.servers.has(event.socket))
+					service.servers.remove(event.socket);
+			}
+		return NULL;
+	}
+
+	csjp::OwnerContainer<EchoServer> servers;
+	pthread_t thread;
+	bool stopped;
+};
+
+class TestURing
+{
+public:
+	void backend();
+	void echo();
+	void bulk();
+	void throughput();
+};
+
+static int connectTo(unsigned port)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	bzero(&addr, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	VERIFY(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+	return fd;
+}
+
+static void readFully(int fd, char * buffer, size_t length)
+{
+	size_t got = 0;
+	while(got < length){
+		ssize_t n = read(fd, buffer + got, length - got);
+		VERIFY(0 < n);
+		got += n;
+	}
+}
+
+static void verifyEcho(int fd, const char * msg)
+{
+	size_t length = strlen(msg);
+	VERIFY(write(fd, msg, length) == (ssize_t)length);
+	char buffer[64];
+	readFully(fd, buffer, length);
+	VERIFY(csjp::Str(buffer, length) == msg);
+}
+
+/* The backends to compare on this machine. */
+static csjp::PodArray<csjp::Poller::Backend> backends()
+{
+	csjp::PodArray<csjp::Poller::Backend> list;
+	list.add(csjp::Poller::Backend::EPoll);
+	if(csjp::URing::supported())
+		list.add(csjp::Poller::Backend::URing);
+	else
+		LOG("io_uring is not supported, only epoll is tested.");
+	return list;
+}
+
+void TestURing::backend()
+{
+	TESTSTEP("Auto falls back to epoll where io_uring is not supported");
+	csjp::Poller poller;
+	VERIFY(poller.backend() == (csjp::URing::supported() ?
+				csjp::Poller::Backend::URing :
+				csjp::Poller::Backend::EPoll));
+	LOG("Auto backend: %", csjp::Poller::backendName(poller.backend()));
+}
+
+void TestURing::echo()
+{
+	csjp::Signal pipeSignal(SIGPIPE, csjp::Signal::sigpipeHandler);
+	for(auto backend : backends()){
+		TESTSTEP("Echo service on %", csjp::Poller::backendName(backend));
+		EchoService service(backend);
+		VERIFY(service.poller.backend() == backend);
+		int fds[4];
+		for(unsigned i = 0; i < 4; i++)
+			fds[i] = connectTo(port);
+		for(unsigned round = 0; round < 16; round++)
+			for(unsigned i = 0; i < 4; i++)
+				verifyEcho(fds[i], "hello poller");
+		for(unsigned i = 0; i < 4; i++)
+			close(fds[i]);
+	}
+}
+
+void TestURing::bulk()
+{
+	csjp::Signal pipeSignal(SIGPIPE, csjp::Signal::sigpipeHandler);
+	csjp::String expected(pattern(bulkSize, 0));
+	expected.append(borrowed);
+	for(auto backend : backends()){
+		TESTSTEP("Data more than the socket buffers on %",
+				csjp::Poller::backendName(backend));
+		EchoService service(backend);
+		int fd = connectTo(port);
+		VERIFY(write(fd, "bulk", 4) == 4);
+		csjp::String data;
+		data.extendCapacity(expected.length + 1);
+		char buffer[64*1024];
+		ssize_t n;
+		while(0 < (n = read(fd, buffer, sizeof(buffer))))
+			data.append(buffer, n);
+		VERIFY(data.length == expected.length);
+		VERIFY(data == expected);
+		close(fd);
+	}
+}
+
+void TestURing::throughput()
+{
+	csjp::Signal pipeSignal(SIGPIPE, csjp::Signal::sigpipeHandler);
+	const unsigned connections = 32;
+	const unsigned rounds = 2000;
+	const char * msg = "0123456789abcdef0123456789abcdef"
+		"0123456789abcdef0123456789abcdef";
+	size_t length = strlen(msg);
+
+	for(auto backend : backends()){
+		TESTSTEP("Echo throughput on %", csjp::Poller::backendName(backend));
+		EchoService service(backend);
+		int fds[connections];
+		for(unsigned i = 0; i < connections; i++)
+			fds[i] = connectTo(port);
+
+		csjp::Stopper stopper;
+		char buffer[64];
+		for(unsigned round = 0; round < rounds; round++){
+			for(unsigned i = 0; i < connections; i++)
+				VERIFY(write(fds[i], msg, length) == (ssize_t)length);
+			for(unsigned i = 0; i < connections; i++)
+				readFully(fds[i], buffer, length);
+		}
+		double sec = stopper.stop();
+		LOG("%: % echoed messages per sec over % connections",
+				csjp::Poller::backendName(backend),
+				connections * rounds / sec, connections);
+
+		for(unsigned i = 0; i < connections; i++)
+			close(fds[i]);
+	}
+}
+
+TEST_INIT(URing)
+
+	TEST_RUN(backend);
+	TEST_RUN(echo);
+	TEST_RUN(bulk);
+	TEST_RUN(throughput);
+
+TEST_FINISH(URing)
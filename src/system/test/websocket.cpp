@@ -12,6 +12,7 @@
 #include <csjp_epoll.h>
 #include <csjp_owner_container.h>
 #include <csjp_websocket.h>
+#include <csjp_stopper.h>
 #include <csjp_test.h>
 
 class TestWebSocket
@@ -22,6 +23,9 @@ public:
 	void textMedium();
 	void textLong();
 	void close();
+	void mask();
+	void parseInPlace();
+	void unmaskSpeed();
 };
 
 void TestWebSocket::pingpong()
@@ -160,6 +164,110 @@ void TestWebSocket::close()
 	VERIFY(client.payload == "");
 }
 
+/* Bytewise masking as reference. */
+static void maskBytewise(char * data, size_t length, const char * key)
+{
+	for (size_t i = 0; i < length; i++)
+		data[i] ^= key[i % 4];
+}
+
+void TestWebSocket::mask()
+{
+	const char * key = "\x12\x34\x56\x78";
+	char buffer[200];
+	char expected[200];
+
+	TESTSTEP("Every length from every alignment is masked as bytewise");
+	for (unsigned align = 0; align < 16; align++)
+		for (unsigned length = 0; length < 160; length++) {
+			for (unsigned i = 0; i < sizeof(buffer); i++)
+				buffer[i] = expected[i] = (char)(i * 7);
+			csjp::WebSocketFrame::mask(buffer + align, length, key);
+			maskBytewise(expected + align, length, key);
+			VERIFY(!memcmp(buffer, expected, sizeof(buffer)));
+		}
+
+	TESTSTEP("Masking with key offset continues a masked data");
+	for (unsigned i = 0; i < sizeof(buffer); i++)
+		buffer[i] = expected[i] = (char)i;
+	csjp::WebSocketFrame::mask(buffer, 37, key);
+	csjp::WebSocketFrame::mask(buffer + 37, 100, key, 37);
+	maskBytewise(expected, 137, key);
+	VERIFY(!memcmp(buffer, expected, sizeof(buffer)));
+}
+
+void TestWebSocket::parseInPlace()
+{
+	csjp::String payload;
+	for (unsigned i = 0; i < 70000; i++)
+		payload << (char)('a' + i % 26);
+	csjp::WebSocketFrame client(csjp::WebSocketOpcode::Enum::Binary, payload);
+	csjp::String data(client.toString("csjp"));
+
+	TESTSTEP("64 bit length is in network byte order");
+	VERIFY((unsigned char)data[1] == (0x80 | 127));
+	VERIFY(!memcmp(data.c_str() + 2, "\0\0\0\0\0\x01\x11\x70", 8));
+
+	TESTSTEP("Incomplete frame is left untouched");
+	csjp::String copy(data);
+	csjp::WebSocketFrame server;
+	VERIFY(server.parseInPlace(csjp::Str(data.c_str(), 9)) == 0);
+	VERIFY(server.parseInPlace(csjp::Str(data.c_str(), data.length - 1)) == 0);
+	VERIFY(data == copy);
+
+	TESTSTEP("Payload is unmasked in the data and given as a view");
+	VERIFY(server.parseInPlace(data) == data.length);
+	VERIFY(server.opcode == csjp::WebSocketOpcode::Enum::Binary);
+	VERIFY(server.payload.length == 0);
+	VERIFY(server.view.c_str() == data.c_str() + 14);
+	VERIFY(server.view == payload);
+
+	TESTSTEP("Copying parse gives the payload too");
+	VERIFY(server.parse(copy) == copy.length);
+	VERIFY(server.payload == payload);
+	VERIFY(server.view == payload);
+}
+
+void TestWebSocket::unmaskSpeed()
+{
+	const size_t sizes[] = { 16, 256, 4096, 65536, 1024*1024, 2*1024*1024 };
+	for (size_t size : sizes) {
+		TESTSTEP("Unmasking frames of % bytes", size);
+		csjp::String payload;
+		payload.fill('x', size);
+		csjp::WebSocketFrame client(csjp::WebSocketOpcode::Enum::Binary,
+				payload);
+		csjp::String data(client.toString("csjp"));
+		csjp::WebSocketFrame server;
+		server.frameLengthLimit = 4*1024*1024;
+
+		/* About 256 MiB each; parsing in place toggles the mask, odd
+		 * rounds leave it unmasked. */
+		unsigned rounds = 2 * (128*1024*1024 / (size + 64)) + 1;
+		csjp::Stopper stopper;
+		for (unsigned i = 0; i < rounds; i++)
+			VERIFY(server.parseInPlace(data) == data.length);
+		double inPlace = rounds * (double)size / stopper.stop();
+		VERIFY(server.view == payload);
+
+		stopper.restart();
+		for (unsigned i = 0; i < rounds / 4 + 1; i++)
+			VERIFY(server.parse(data) == data.length);
+		double copied = (rounds / 4 + 1) * (double)size / stopper.stop();
+
+		char * start = (char *)server.view.c_str();
+		stopper.restart();
+		for (unsigned i = 0; i < rounds / 4 + 1; i++)
+			maskBytewise(start, size, "csjp");
+		double bytewise = (rounds / 4 + 1) * (double)size / stopper.stop();
+
+		LOG("% bytes: in place % MiB/s, copying % MiB/s, "
+				"bytewise unmask % MiB/s", size,
+				inPlace / (1024*1024), copied / (1024*1024),
+				bytewise / (1024*1024));
+	}
+}
+
 TEST_INIT(WebSocket)
 
 	TEST_RUN(pingpong);
@@ -167,6 +275,9 @@ TEST_INIT(WebSocket)
 	TEST_RUN(textMedium);
 	TEST_RUN(textLong);
 	TEST_RUN(close);
+	TEST_RUN(mask);
+	TEST_RUN(parseInPlace);
+	TEST_RUN(unmaskSpeed);
 
 TEST_FINISH(WebSocket)
 